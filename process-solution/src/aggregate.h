@@ -0,0 +1,88 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+/* For bool etc. */
+#include <stdbool.h>
+
+/* The kinds of operator a reader can run over the values it reads: their sum, smallest and largest, how
+ * many lie in a range, and their exclusive or. */
+#define AGGREGATE_SUM (0)
+#define AGGREGATE_MIN (1)
+#define AGGREGATE_MAX (2)
+#define AGGREGATE_COUNT (3)
+#define AGGREGATE_XOR (4)
+#define AGGREGATE_KINDS (5)
+
+/* The most operators a pipeline can hold. */
+#define AGGREGATE_MAX_OPS (8)
+
+/* The number of values a reader collects before running its operators over them together. */
+#define AGGREGATE_BLOCK_ITEMS (256)
+
+/* The most bytes the results of a pipeline take once formatted, including the terminator. */
+#define AGGREGATE_REPORT_SIZE (512)
+
+/*
+ * An operator of a pipeline. A count counts the values from low to high inclusive; the other kinds ignore
+ * the range.
+ */
+typedef struct AggregateOp
+{
+    int kind;
+    int low;
+    int high;
+} AggregateOp;
+
+/*
+ * The operators every reader runs over the values it reads, in order, as given by --aggregate.
+ */
+typedef struct AggregatePipeline
+{
+    /* The number of operators, or 0 for readers to run none. */
+    int count;
+    AggregateOp ops[AGGREGATE_MAX_OPS];
+} AggregatePipeline;
+
+/* Runs an operator over count values, folding them into its result. */
+typedef void (*AggregateKernel)(int *values, int count, AggregateOp *op, long long *result);
+
+/*
+ * The kernels of every kind of operator for an instruction set.
+ */
+typedef struct AggregateKernels
+{
+    /* The instruction set, as reported with the results. */
+    char *name;
+
+    /* The kernel of each kind of operator, indexed by kind. */
+    AggregateKernel kernels[AGGREGATE_KINDS];
+} AggregateKernels;
+
+/*
+ * A reader's progress through its pipeline.
+ *
+ * Values are collected into a block as they are read, and every operator is run over the block at once
+ * when it fills, so that each kernel works through a contiguous run of values rather than one at a time.
+ */
+typedef struct Aggregate
+{
+    /* The operators run, and the kernels they run with, chosen for the machine's instruction set. */
+    AggregatePipeline *pipeline;
+    const AggregateKernels *kernels;
+
+    /* The number of values folded into the results, and each operator's result so far. */
+    long long items;
+    long long results[AGGREGATE_MAX_OPS];
+
+    /* Values read since the operators were last run. */
+    int used;
+    int block[AGGREGATE_BLOCK_ITEMS];
+} Aggregate;
+
+int parseAggregatePipeline(AggregatePipeline *pipeline, char *spec);
+void initializeAggregate(Aggregate *aggregate, AggregatePipeline *pipeline);
+void aggregateValue(Aggregate *aggregate, int value);
+void flushAggregate(Aggregate *aggregate);
+void formatAggregate(Aggregate *aggregate, char *report, int size);
+
+#endif /* ifndef AGGREGATE_H */
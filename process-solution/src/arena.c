@@ -0,0 +1,48 @@
+#include "arena.h"
+
+/*
+ * Lays out an empty arena of size bytes, or none if size is 0.
+ */
+void initializeArena(Arena *arena, int size)
+{
+    arena->size = size;
+    arena->head = 0;
+    arena->tail = 0;
+    arena->tailSequence = 0;
+}
+
+/*
+ * Returns the number of bytes a payload of length bytes takes from the head: the payload itself, after
+ * padding to the beginning of the arena if it would otherwise run past the end.
+ */
+static int reservedBytes(Arena *arena, int length)
+{
+    int offset = arena->head % arena->size;
+
+    return offset + length > arena->size ? arena->size - offset + length : length;
+}
+
+/*
+ * Returns true if a payload of length bytes can be reserved without overwriting a payload that some
+ * consumer may still read.
+ *
+ * Must be called with writeMutex and rpMutex held.
+ */
+bool arenaHasRoom(Arena *arena, int length)
+{
+    return arena->head + reservedBytes(arena, length) - arena->tail <= arena->size;
+}
+
+/*
+ * Reserves the space for a payload of length bytes, which arenaHasRoom() has found.
+ *
+ * Must be called with writeMutex held.
+ *
+ * Returns the position of the payload's first byte.
+ */
+long long reserveArena(Arena *arena, int length)
+{
+    arena->head += reservedBytes(arena, length);
+
+    return arena->head - length;
+}
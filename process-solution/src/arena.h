@@ -0,0 +1,46 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+
+/*
+ * Where an item's payload lies in the arena. With an arena, each slot of the buffer holds one of these
+ * rather than the item itself.
+ */
+typedef struct ArenaDescriptor
+{
+    /* The position of the payload's first byte. The arena holds position p at byte p % size. */
+    long long position;
+
+    /* The number of bytes in the payload. */
+    int length;
+} ArenaDescriptor;
+
+/*
+ * A ring of bytes that holds the payloads of the items in the buffer, each contiguous, in the order they
+ * were published. A payload that would run past the end of the arena starts again at the beginning,
+ * leaving the rest of the arena as padding.
+ *
+ * Positions count every byte ever reserved, so they only grow. Space is reclaimed as the items holding
+ * it are released from the buffer: every payload before the oldest item some consumer still holds a
+ * claim on is free.
+ */
+typedef struct Arena
+{
+    /* The number of bytes in the arena, or 0 when items are published as integers. */
+    int size;
+
+    /* The position one past the newest payload. Bound to writeMutex. */
+    long long head;
+
+    /* The position of the oldest payload some consumer may still read, and its item's sequence number.
+     * Bound to rpMutex. */
+    long long tail;
+    int tailSequence;
+} Arena;
+
+void initializeArena(Arena *arena, int size);
+bool arenaHasRoom(Arena *arena, int length);
+long long reserveArena(Arena *arena, int length);
+
+#endif /* ifndef ARENA_H */
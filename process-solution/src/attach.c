@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "shared.h"
+#include "channel.h"
+#include "reader.h"
+
+/*
+ * Entry point for sds-attach.
+ *
+ * Attaches a reader to a running sds that reserved slots for attaching readers with --attach-slots, and
+ * reads the stream until it ends or the reader is detached. "--from SEQ" starts the reader at the item
+ * with sequence number SEQ, if the buffer still holds it, rather than at the next item published, and
+ * "--sink SINK" forwards its stream to SINK, numbered as sds numbers its readers' sinks.
+ * "--detach ID" instead detaches reader ID, whether it was started with the run or attached since.
+ * "--name NAME" and "--channel CHANNEL" pick the run and the channel, as given to sds.
+ */
+int main(int argc, char **argv)
+{
+    RWConfig *rwConfig;
+    char *instanceName = NULL, *channelName = NULL, *detachId = NULL, *sinkName = NULL;
+    int idx, start = -1;
+
+    for (idx = 1; idx + 1 < argc; idx += 2)
+    {
+        if (!strcmp(argv[idx], "--name"))
+        {
+            instanceName = argv[idx + 1];
+        }
+        else if (!strcmp(argv[idx], "--channel"))
+        {
+            channelName = argv[idx + 1];
+        }
+        else if (!strcmp(argv[idx], "--from"))
+        {
+            sscanf(argv[idx + 1], "%d", &start);
+        }
+        else if (!strcmp(argv[idx], "--sink"))
+        {
+            sinkName = argv[idx + 1];
+        }
+        else if (!strcmp(argv[idx], "--detach"))
+        {
+            detachId = argv[idx + 1];
+        }
+    }
+    nameSegments(instanceName, channelName);
+
+    rwConfig = (RWConfig *)openSharedMemory(SHARED_CONFIG_NAME, SHARED_CONFIG_SIZE);
+    if (rwConfig == MAP_FAILED)
+    {
+        printf("Error: Could not map %s; is the run going?\n", segmentName(SHARED_CONFIG_NAME));
+        return 1;
+    }
+
+    if (detachId != NULL)
+    {
+        idx = -1;
+        sscanf(detachId, "%d", &idx);
+        return dismissReader(rwConfig, idx) ? 1 : 0;
+    }
+
+    return attachedReader(rwConfig, start, sinkName) ? 1 : 0;
+}
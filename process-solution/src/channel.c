@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "channel.h"
+
+/* The prefix of every shared memory segment this process creates or opens. */
+static char segmentPrefix[SEGMENT_PREFIX_SIZE] = "";
+
+/* The end of a relay's pipe that a process keeps once forked, or -1. */
+static int relayPipe = -1;
+
+/*
+ * Reads a channel from a specification of the form NAME[:SIZE]=SOURCE. Without a SIZE, the channel's buffer
+ * has SHM_BUFFER_SIZE slots. NAME may not contain '/', since it becomes part of file names.
+ *
+ * Returns 0 on success, or -1 if the specification is malformed.
+ */
+int readChannel(Channel *channel, char *spec)
+{
+    char *source = strchr(spec, '='), *size = strchr(spec, ':');
+    int nameLength;
+
+    if (source == NULL || (size != NULL && size > source))
+    {
+        return -1;
+    }
+
+    nameLength = (size != NULL ? size : source) - spec;
+    if (nameLength <= 0 || nameLength >= CHANNEL_NAME_SIZE || memchr(spec, '/', nameLength) != NULL)
+    {
+        return -1;
+    }
+    memcpy(channel->name, spec, nameLength);
+    channel->name[nameLength] = '\0';
+
+    channel->capacity = SHM_BUFFER_SIZE;
+    if (size != NULL && (sscanf(size + 1, "%d", &channel->capacity) != 1 || channel->capacity <= 0))
+    {
+        return -1;
+    }
+
+    channel->inputName = source + 1;
+
+    return 0;
+}
+
+/*
+ * Derives a channel's file name from the name given for the run, by appending ".NAME". Leaves the file
+ * name NULL if none was given.
+ */
+static char *channelFileName(char *path, char *runName, char *channelName)
+{
+    if (runName == NULL)
+    {
+        return NULL;
+    }
+    snprintf(path, CHANNEL_PATH_SIZE, "%s.%s", runName, channelName);
+
+    return path;
+}
+
+/*
+ * Turns the configuration of a run into that of one of its channels.
+ */
+void applyChannel(ProgramConfig *config, Channel *channel)
+{
+    config->channelName = channel->name;
+    config->inputName = channel->inputName;
+    config->capacity = channel->capacity;
+    config->sinkName = channelFileName(channel->sinkName, config->sinkName, channel->name);
+    config->journalName = channelFileName(channel->journalName, config->journalName, channel->name);
+    config->spillName = channelFileName(channel->spillName, config->spillName, channel->name);
+}
+
+/*
+ * Keys the shared memory segments this process creates or opens from now on by an instance name and a
+ * channel name, either of which may be NULL. Segments are named INSTANCE.CHANNEL.SEGMENT, so that runs
+ * with different instance names, and the channels of one run, never share a segment. With neither, the
+ * segments keep their plain names.
+ *
+ * Processes forked afterwards inherit the key, so every worker of a channel opens that channel's segments.
+ */
+void nameSegments(char *instanceName, char *channelName)
+{
+    snprintf(segmentPrefix, SEGMENT_PREFIX_SIZE, "%s%s%s%s", instanceName != NULL ? instanceName : "",
+        instanceName != NULL ? "." : "", channelName != NULL ? channelName : "", channelName != NULL ? "." : "");
+}
+
+/*
+ * Returns the name under which the segment with the given plain name is kept. The name is held in a
+ * static buffer, overwritten by the next call.
+ */
+char *segmentName(char *name)
+{
+    static char segment[SEGMENT_PREFIX_SIZE + CHANNEL_NAME_SIZE];
+
+    snprintf(segment, sizeof(segment), "%s%s", segmentPrefix, name);
+
+    return segment;
+}
+
+/*
+ * Sets the end of a relay's pipe that processes forked from now on keep: the write end for the relay
+ * itself, and the read end for the writer of the relay's buffer. Every other process is forked with -1.
+ */
+void keepRelayPipe(int fd)
+{
+    relayPipe = fd;
+}
+
+/*
+ * Returns the end of a relay's pipe this process was forked to keep, or -1.
+ */
+int keptRelayPipe()
+{
+    return relayPipe;
+}
@@ -0,0 +1,43 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "shared.h"
+
+/* The longest channel name, and the longest file name derived from one. */
+#define CHANNEL_NAME_SIZE (64)
+#define CHANNEL_PATH_SIZE (4096)
+
+/* The longest prefix put before the name of a shared memory segment. The buffer of a relay is named
+ * after its channel with a suffix of its own. */
+#define SEGMENT_PREFIX_SIZE (3 * CHANNEL_NAME_SIZE)
+
+/*
+ * One of the independent streams hosted by a run, parsed from a "--channel NAME[:SIZE]=SOURCE" option.
+ *
+ * Each channel has a buffer of its own, read from its own source, in shared memory segments keyed by the
+ * channel's name. The files named by the sink, journal and spill options are kept apart by appending
+ * ".NAME" to each, so a channel's files live alongside the others'.
+ */
+typedef struct Channel
+{
+    /* The name the channel is keyed by. */
+    char name[CHANNEL_NAME_SIZE];
+
+    /* The input source writers read from, and the number of slots in the buffer. */
+    char *inputName;
+    int capacity;
+
+    /* The channel's own sink, journal and spill names, derived from the run's. */
+    char sinkName[CHANNEL_PATH_SIZE];
+    char journalName[CHANNEL_PATH_SIZE];
+    char spillName[CHANNEL_PATH_SIZE];
+} Channel;
+
+int readChannel(Channel *channel, char *spec);
+void applyChannel(ProgramConfig *config, Channel *channel);
+void nameSegments(char *instanceName, char *channelName);
+char *segmentName(char *name);
+void keepRelayPipe(int fd);
+int keptRelayPipe();
+
+#endif /* ifndef CHANNEL_H */
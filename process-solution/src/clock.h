@@ -0,0 +1,9 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <time.h>
+
+long long readClockNs(void);
+void readDeadline(struct timespec *deadline, long long time);
+
+#endif /* ifndef CLOCK_H */
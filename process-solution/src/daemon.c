@@ -0,0 +1,455 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+
+/*
+ * Forks a worker process of the pool running callback, with a socket of its own to the daemon, recording
+ * the process in *pid and the daemon's end of the socket in pool->sockets[i].
+ *
+ * Returns 0 on success, or -1 if the socket could not be created.
+ */
+static int startPoolWorker(WorkerPool *pool, int i, pid_t *pid, void (*callback) (void))
+{
+    int pair[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair))
+    {
+        *pid = 0;
+        pool->sockets[i] = -1;
+        return -1;
+    }
+
+    keepPoolSocket(pair[1]);
+    createProcesses(pid, 1, callback);
+    keepPoolSocket(-1);
+    close(pair[1]);
+    pool->sockets[i] = pair[0];
+
+    return 0;
+}
+
+/*
+ * Stops every worker process of the pool and waits for it to exit. Each is told to stop by shutting down
+ * its socket, which every other worker holds a copy of, so closing it would not do.
+ */
+static void stopPool(WorkerPool *pool)
+{
+    ChannelHost *host = &pool->host;
+    int i, workers = host->readerProcesses + host->writerProcesses;
+    pid_t pid;
+
+    for (i = 0; i < workers; i++)
+    {
+        if (pool->sockets[i] >= 0)
+        {
+            shutdown(pool->sockets[i], SHUT_RDWR);
+            close(pool->sockets[i]);
+        }
+    }
+    for (i = 0; i < workers; i++)
+    {
+        pid = i < host->readerProcesses ? host->readers[i] : host->writers[i - host->readerProcesses];
+        if (pid > 0)
+        {
+            waitpid(pid, NULL, 0);
+        }
+    }
+}
+
+/*
+ * Listens for job submissions on a Unix-domain socket at path, replacing any socket left behind by a
+ * previous daemon.
+ *
+ * Returns the listening socket, or -1 if it could not be created.
+ */
+static int openControlSocket(char *path)
+{
+    int listener;
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener >= 0)
+    {
+        unlink(path);
+        if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) || listen(listener, DAEMON_BACKLOG))
+        {
+            close(listener);
+            listener = -1;
+        }
+    }
+
+    return listener;
+}
+
+/*
+ * Reads a single line of request from a client into request, without its newline.
+ *
+ * Returns false if the client closed the connection before sending anything.
+ */
+static bool readRequest(int fd, char *request)
+{
+    int length = 0;
+    ssize_t count = 1;
+
+    while (length < DAEMON_REQUEST_SIZE - 1 && count > 0 && memchr(request, '\n', length) == NULL)
+    {
+        count = read(fd, request + length, DAEMON_REQUEST_SIZE - 1 - length);
+        length += count > 0 ? count : 0;
+    }
+    request[length] = '\0';
+    request[strcspn(request, "\r\n")] = '\0';
+
+    return length > 0;
+}
+
+/*
+ * Resets the buffer in place for a job that the first readers readers of the pool take part in: the
+ * stream starts again from its first item, and the readers that sit the job out are detached, so that
+ * writers do not wait for them. Every worker is idle, waiting for the job.
+ */
+static void resetBuffer(WorkerPool *pool, int readers)
+{
+    ChannelHost *host = &pool->host;
+    RWConfig *rwConfig = host->rwConfig;
+    ProgramConfig *pConfig = &rwConfig->pConfig;
+    int i;
+
+    initializeRing(&rwConfig->ring, pConfig->capacity, pConfig->maxCapacity);
+    rwConfig->idxWrite = 0;
+    rwConfig->writes = 0;
+    rwConfig->eof = false;
+    rwConfig->consumers = readers;
+    rwConfig->rwWriter = 0;
+    rwConfig->rwWaiters = 0;
+    rwConfig->unpublished.holding = false;
+    rwConfig->lostWrites = 0;
+    initializeArena(&rwConfig->arena, pConfig->arenaSize);
+
+    initializeDefaultValueArray(host->pendingReads, rwConfig->ring.slots, 0);
+    initializeDefaultValueArray(host->sequence, rwConfig->ring.slots, SEQUENCE_NONE);
+    initializeDefaultValueArray(pool->writerIds, rwConfig->ring.slots, -1);
+    memset(pool->publishTimes, 0, rwConfig->ring.slots * sizeof(long long));
+    if (pool->summaries != NULL)
+    {
+        clearBlockSummaries(pool->summaries, BLOCK_SUMMARY_COUNT(rwConfig));
+    }
+    if (pool->checksums != NULL)
+    {
+        clearRangeChecksums(pool->checksums, &rwConfig->published);
+    }
+
+    memset(host->latencies, 0, pConfig->readerCount * sizeof(Histogram));
+    initializeStatsRegion(host->stats, pConfig->readerCount, pConfig->writerCount, pConfig->capacity);
+
+    for (i = 0; i < pConfig->readerCount; i++)
+    {
+        host->readerStates[i].cursor = 0;
+        host->readerStates[i].detached = i >= readers;
+        host->readerStates[i].dismissed = false;
+    }
+}
+
+/*
+ * Waits for every worker process of the pool to finish its part of the current job, adding up the items
+ * they read and published. A worker whose socket closes has died: the daemon reaps it and gives up its
+ * claims on the buffer, as it would for a run's worker, so that the rest of the job's workers can finish,
+ * and tells the client on fd.
+ */
+static void awaitWorkers(WorkerPool *pool, int fd)
+{
+    ChannelHost *host = &pool->host;
+    int workers = host->readerProcesses + host->writerProcesses, remaining = 0, count, status, i;
+    struct pollfd *waiting = (struct pollfd *)malloc(workers * sizeof(struct pollfd));
+    pid_t *pid;
+
+    for (i = 0; i < workers; i++)
+    {
+        waiting[i].fd = pool->sockets[i];
+        waiting[i].events = POLLIN;
+        waiting[i].revents = 0;
+        remaining += pool->sockets[i] >= 0;
+    }
+
+    while (remaining)
+    {
+        if (poll(waiting, workers, -1) < 0)
+        {
+            continue;
+        }
+
+        for (i = 0; i < workers; i++)
+        {
+            if (waiting[i].fd < 0 || !waiting[i].revents)
+            {
+                continue;
+            }
+
+            if (recv(waiting[i].fd, &count, sizeof(int), 0) == sizeof(int))
+            {
+                *(i < host->readerProcesses ? &pool->reads : &pool->writes) += count;
+            }
+            else
+            {
+                pid = i < host->readerProcesses ? &host->readers[i] : &host->writers[i - host->readerProcesses];
+                waitpid(*pid, &status, 0);
+                printf("Process terminated with code=%d\n", status);
+                dprintf(fd, "Error: Worker process %d died during job %d.\n", *pid, pool->job);
+                workerExited(host, *pid, true);
+                *pid = 0;
+                close(pool->sockets[i]);
+                pool->sockets[i] = -1;
+                pool->broken = true;
+            }
+            waiting[i].fd = -1;
+            remaining--;
+        }
+    }
+
+    free(waiting);
+}
+
+/*
+ * Runs a job through the pool and reports how it went to the client. A request has the form
+ * SOURCE [READERS [WRITERS [SINK]]]: the input source to publish, how many of the pool's readers and
+ * writers take part, by default all of them, and the output sink each reader forwards its stream to, by
+ * default the one the daemon was started with.
+ *
+ * The buffer is reset in place, the daemon opens the source, and every worker process is handed the job
+ * over its socket, the writers the source along with it. Nothing is forked or mapped for the job.
+ *
+ * Returns a status code:
+ *   ERROR_OPENING_SOURCE:
+ *     The request was malformed, or its input source could not be opened.
+ *   ERROR_INCORRECT_READS:
+ *     A reader failed to read every item published, or a worker died.
+ *   ERROR_INCORRECT_WRITES:
+ *     The writers failed to publish every item between them.
+ *   0:
+ *     No errors were encountered.
+ */
+static int runJob(WorkerPool *pool, int fd, char *request, char *sinkName)
+{
+    ChannelHost *host = &pool->host;
+    RWConfig *rwConfig = host->rwConfig;
+    ProgramConfig *pConfig = &rwConfig->pConfig;
+    PoolJob job;
+    char source[DAEMON_REQUEST_SIZE];
+    int sCode = 0, fields, i;
+    long long start = readClockNs();
+
+    job.readers = pConfig->readerCount;
+    job.writers = pConfig->writerCount;
+    fields = sscanf(request, "%4095s %d %d %4095s", source, &job.readers, &job.writers, job.sinkName);
+    if (fields < 1 || job.readers < 1 || job.readers > pConfig->readerCount || job.writers < 1 ||
+        job.writers > pConfig->writerCount)
+    {
+        dprintf(fd, "Error: Expected SOURCE [READERS [WRITERS [SINK]]], with 1 to %d readers and 1 to %d "
+            "writers.\n", pConfig->readerCount, pConfig->writerCount);
+        return ERROR_OPENING_SOURCE;
+    }
+    if (!strncmp(source, SOURCE_JOURNAL_PREFIX, strlen(SOURCE_JOURNAL_PREFIX)))
+    {
+        /* A journal is read through a mapping, which the pool, forked before it was opened, would not
+         * share. */
+        dprintf(fd, "Error: The daemon cannot replay journal %s.\n", source);
+        return ERROR_OPENING_SOURCE;
+    }
+    if (fields < 4)
+    {
+        snprintf(job.sinkName, sizeof(job.sinkName), "%s", sinkName != NULL ? sinkName : "");
+    }
+
+    resetBuffer(pool, job.readers);
+    if (openInputSource(&rwConfig->source, source, pConfig->replaySpeed))
+    {
+        dprintf(fd, "Error: Could not open input source %s.\n", source);
+        attachInputSource(&rwConfig->source, pool->sourceFd);
+        return ERROR_OPENING_SOURCE;
+    }
+
+    /* Every writer reads the source through the same descriptor number. */
+    if (rwConfig->source.fd != pool->sourceFd)
+    {
+        dup2(rwConfig->source.fd, pool->sourceFd);
+        if (rwConfig->source.fd > STDIN_FILENO)
+        {
+            close(rwConfig->source.fd);
+        }
+        rwConfig->source.fd = pool->sourceFd;
+    }
+
+    /* Start the job, and wait for every worker to finish its part. */
+    job.job = ++pool->job;
+    pool->reads = 0;
+    pool->writes = 0;
+    host->liveWriters = job.writers;
+    for (i = 0; i < host->readerProcesses + host->writerProcesses; i++)
+    {
+        if (pool->sockets[i] >= 0)
+        {
+            sendPoolJob(pool->sockets[i], &job, i < host->readerProcesses ? -1 : pool->sourceFd);
+        }
+    }
+    awaitWorkers(pool, fd);
+
+    releasePoolSource(pool->sourceFd);
+    reportLatency(host->latencies, pConfig->readerCount);
+
+    /* Check the job as a run is checked once its processes have exited. */
+    if (pool->writes != rwConfig->writes)
+    {
+        sCode = ERROR_INCORRECT_WRITES;
+        dprintf(fd, "Error: Incorrect number of total writes: %d\n", pool->writes);
+    }
+    for (i = 0; i < job.readers; i++)
+    {
+        if (!host->readerStates[i].detached && host->readerStates[i].cursor != rwConfig->writes)
+        {
+            sCode = ERROR_INCORRECT_READS || sCode;
+            dprintf(fd, "Error: Incorrect number of reads: %d\n", host->readerStates[i].cursor);
+        }
+    }
+    if (pool->broken)
+    {
+        sCode = ERROR_INCORRECT_READS || sCode;
+        dprintf(fd, "Error: The pool lost a worker; stopping the daemon.\n");
+    }
+
+    dprintf(fd, "Job %d: published %d items and read %d in %lld ns.\n", pool->job, rwConfig->writes,
+        pool->reads, readClockNs() - start);
+
+    return sCode;
+}
+
+/*
+ * Runs as a daemon: creates a single buffer and forks its reader and writer processes once, then runs the
+ * jobs submitted on the control socket named by config->daemonName back to back, through the same buffer
+ * and processes, until a client submits DAEMON_STOP_REQUEST.
+ *
+ * The pool holds config->readerCount reader processes and config->writerCount writer processes, each
+ * hosting one reader or writer. A worker that dies fails the job it died in, and the daemon stops after
+ * it. Channels, fan-out, consumer groups, recording, spilling, --threads and --attach-slots are not
+ * supported by the daemon, nor are journal sources.
+ *
+ * Returns the status code of the first error encountered, or 0 if there were none.
+ */
+int runDaemon(ProgramConfig *config)
+{
+    WorkerPool pool;
+    ProgramConfig pConfig = *config;
+    char request[DAEMON_REQUEST_SIZE];
+    int sCode = 0, listener, fd, i;
+    bool stopping = false;
+
+    /* Jobs name their own input source. */
+    if (pConfig.channelCount || pConfig.relayCount || pConfig.groupCount || pConfig.journalName != NULL ||
+        pConfig.spillName != NULL || pConfig.threadsPerProcess > 1 || pConfig.attachCount)
+    {
+        printf("Error: Ignoring --channel, --fan-out, --group, --record, --spill, --threads and --attach-slots "
+            "with --daemon.\n");
+    }
+    pConfig.inputName = NULL;
+    pConfig.channelCount = 0;
+    pConfig.relayCount = 0;
+    pConfig.groupCount = 0;
+    pConfig.memberCount = 0;
+    pConfig.journalName = NULL;
+    pConfig.spillName = NULL;
+    pConfig.threadsPerProcess = 1;
+    pConfig.attachCount = 0;
+
+    /* Create the buffer, and fork every worker before the first job, and never again. Every worker
+     * inherits the descriptor number jobs' sources are read through. */
+    createBuffer(&pool.host, pConfig);
+    openSpill(&pool.host.rwConfig->spill, NULL);
+    pool.writerIds = (int *)openSharedMemory(SLOT_WRITER_NAME, pool.host.rwConfig->ring.slots * sizeof(int));
+    pool.publishTimes = (long long *)openSharedMemory(SLOT_TIME_NAME,
+        pool.host.rwConfig->ring.slots * sizeof(long long));
+    pool.summaries = pConfig.filterCount ? (BlockSummary *)openSharedMemory(BLOCK_SUMMARY_NAME,
+        BLOCK_SUMMARY_COUNT(pool.host.rwConfig) * sizeof(BlockSummary)) : NULL;
+    pool.checksums = pConfig.verify ? (RangeChecksum *)openSharedMemory(RANGE_CHECKSUM_NAME,
+        CHECKSUM_RANGES * sizeof(RangeChecksum)) : NULL;
+    pool.sourceFd = open("/dev/null", O_RDONLY);
+    attachInputSource(&pool.host.rwConfig->source, pool.sourceFd);
+    pool.job = 0;
+    pool.broken = false;
+
+    pool.host.readers = (pid_t *)malloc(pConfig.readerCount * sizeof(pid_t));
+    pool.host.writers = (pid_t *)malloc(pConfig.writerCount * sizeof(pid_t));
+    pool.host.members = NULL;
+    pool.host.readerProcesses = pConfig.readerCount;
+    pool.host.writerProcesses = pConfig.writerCount;
+    pool.host.restarts = 0;
+    pool.sockets = (int *)malloc((pConfig.readerCount + pConfig.writerCount) * sizeof(int));
+    for (i = 0; i < pConfig.readerCount; i++)
+    {
+        pool.broken = startPoolWorker(&pool, i, &pool.host.readers[i], &poolReader) || pool.broken;
+    }
+    for (i = 0; i < pConfig.writerCount; i++)
+    {
+        pool.broken = startPoolWorker(&pool, pConfig.readerCount + i, &pool.host.writers[i], &poolWriter) ||
+            pool.broken;
+    }
+
+    listener = pool.broken ? -1 : openControlSocket(config->daemonName);
+    if (listener < 0)
+    {
+        printf("Error: Could not %s\n", pool.broken ? "start the worker pool." : "listen on the control socket.");
+        sCode = ERROR_OPENING_SOURCE;
+        stopping = true;
+    }
+    else
+    {
+        printf("Daemon listening on %s with %d reader and %d writer processes.\n", config->daemonName,
+            pConfig.readerCount, pConfig.writerCount);
+        fflush(stdout);
+    }
+
+    while (!stopping)
+    {
+        fd = accept(listener, NULL, NULL);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        if (!readRequest(fd, request))
+        {
+            /* The client left without submitting anything. */
+        }
+        else if (!strcmp(request, DAEMON_STOP_REQUEST))
+        {
+            dprintf(fd, "Stopping after %d jobs.\n", pool.job);
+            stopping = true;
+        }
+        else
+        {
+            sCode = runJob(&pool, fd, request, config->sinkName) || sCode;
+            stopping = pool.broken;
+        }
+        close(fd);
+        fflush(stdout);
+    }
+
+    if (listener >= 0)
+    {
+        close(listener);
+        unlink(config->daemonName);
+    }
+
+    /* Let every worker exit, then close the buffer. */
+    stopPool(&pool);
+    close(pool.sourceFd);
+    closeChannel(&pool.host);
+
+    free(pool.host.readers);
+    free(pool.host.writers);
+    free(pool.sockets);
+
+    return sCode;
+}
@@ -0,0 +1,52 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "main.h"
+#include "pool.h"
+
+/* The request that stops a daemon once the job before it has finished. */
+#define DAEMON_STOP_REQUEST "stop"
+
+/* The most connections waiting to submit a job while another runs. */
+#define DAEMON_BACKLOG (16)
+
+/*
+ * The reader and writer processes a daemon keeps running between jobs, each forked once with a socket of
+ * its own to the daemon.
+ *
+ * Each process takes its identifier once, then waits for a job on its socket. A job names how many of the
+ * readers and writers take part; the rest sit it out and wait for the next.
+ */
+typedef struct WorkerPool
+{
+    /* The buffer every job is carried through, and its reader and writer processes. */
+    ChannelHost host;
+
+    /* The slot stamps, block summaries and range checksums of the buffer, cleared between jobs. The
+     * summaries and checksums are NULL without --filter and --verify. */
+    int *writerIds;
+    long long *publishTimes;
+    BlockSummary *summaries;
+    RangeChecksum *checksums;
+
+    /* The daemon's end of the socket to each reader process, then to each writer process. */
+    int *sockets;
+
+    /* The descriptor number every writer reads a job's input source through. It is opened before the
+     * pool is forked, so that it is taken in every writer, and held open on /dev/null between jobs. */
+    int sourceFd;
+
+    /* The number of the current job, from 1; 0 before the first. */
+    int job;
+
+    /* The items read by all readers, and published by all writers, in the current job. */
+    int reads;
+    int writes;
+
+    /* Set once a worker has died. The daemon stops after the job it died in. */
+    bool broken;
+} WorkerPool;
+
+int runDaemon(ProgramConfig *config);
+
+#endif /* ifndef DAEMON_H */
@@ -0,0 +1,108 @@
+#include "histogram.h"
+
+#include <string.h>
+
+/*
+ * Returns the index of the bucket holding value.
+ *
+ * Values below HISTOGRAM_SUB_BUCKETS have a bucket each. Above that, each power of two [2^k, 2^(k+1)) is
+ * split into HISTOGRAM_SUB_BUCKETS / 2 equal buckets, identified by the value's top bits.
+ */
+static int bucketIndex(long long value)
+{
+    int shift;
+
+    if (value < HISTOGRAM_SUB_BUCKETS)
+    {
+        return value < 0 ? 0 : (int)value;
+    }
+
+    /* Shift the value down so that it has exactly HISTOGRAM_SUB_BUCKET_BITS significant bits. */
+    shift = 64 - __builtin_clzll((unsigned long long)value) - HISTOGRAM_SUB_BUCKET_BITS;
+
+    return HISTOGRAM_SUB_BUCKETS + (shift - 1) * (HISTOGRAM_SUB_BUCKETS / 2) +
+        (int)(value >> shift) - HISTOGRAM_SUB_BUCKETS / 2;
+}
+
+/*
+ * Returns the largest value that falls in the bucket at index.
+ */
+static long long bucketHighestValue(int index)
+{
+    int shift, subBucket;
+
+    if (index < HISTOGRAM_SUB_BUCKETS)
+    {
+        return index;
+    }
+
+    shift = (index - HISTOGRAM_SUB_BUCKETS) / (HISTOGRAM_SUB_BUCKETS / 2) + 1;
+    subBucket = (index - HISTOGRAM_SUB_BUCKETS) % (HISTOGRAM_SUB_BUCKETS / 2) + HISTOGRAM_SUB_BUCKETS / 2;
+
+    return (((long long)subBucket + 1) << shift) - 1;
+}
+
+/*
+ * Empties a histogram.
+ */
+void initializeHistogram(Histogram *histogram)
+{
+    memset(histogram, 0, sizeof(Histogram));
+}
+
+/*
+ * Records a single value. Negative values are recorded as 0.
+ */
+void recordHistogramValue(Histogram *histogram, long long value)
+{
+    histogram->counts[bucketIndex(value)]++;
+    histogram->total++;
+    if (value > histogram->max)
+    {
+        histogram->max = value;
+    }
+}
+
+/*
+ * Adds every value recorded in from to into.
+ */
+void mergeHistogram(Histogram *into, Histogram *from)
+{
+    int i;
+
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        into->counts[i] += from->counts[i];
+    }
+    into->total += from->total;
+    if (from->max > into->max)
+    {
+        into->max = from->max;
+    }
+}
+
+/*
+ * Returns the value at the given percentile (0-100): the highest value equivalent to the smallest
+ * recorded value that at least that percentage of values do not exceed. Returns 0 for an empty histogram.
+ */
+long long histogramPercentile(Histogram *histogram, double percentile)
+{
+    long long target = (long long)(percentile / 100 * histogram->total + 0.5), seen = 0;
+    int i;
+
+    if (target < 1)
+    {
+        target = 1;
+    }
+
+    for (i = 0; i < HISTOGRAM_BUCKETS && histogram->total; i++)
+    {
+        seen += histogram->counts[i];
+        if (seen >= target)
+        {
+            return bucketHighestValue(i) < histogram->max ? bucketHighestValue(i) : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
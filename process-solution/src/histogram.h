@@ -0,0 +1,37 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+/* Each power of two is split into this many bits' worth of linear sub-buckets. 7 bits keeps every
+ * recorded value within about 1.6% of its true value. */
+#define HISTOGRAM_SUB_BUCKET_BITS (7)
+
+/* The number of values below which every value has a bucket of its own. */
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+
+/* The number of buckets needed to cover every non-negative long long. */
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS + (63 - HISTOGRAM_SUB_BUCKET_BITS) * (HISTOGRAM_SUB_BUCKETS / 2))
+
+/*
+ * A log-linear (HDR-style) histogram of non-negative values.
+ *
+ * Recording a value is a bucket index computation and an increment, so it can be done on every read.
+ * Histograms of the same layout are merged by adding their counts.
+ */
+typedef struct Histogram
+{
+    /* The number of values recorded in each bucket. */
+    long long counts[HISTOGRAM_BUCKETS];
+
+    /* The number of values recorded. */
+    long long total;
+
+    /* The largest value recorded. */
+    long long max;
+} Histogram;
+
+void initializeHistogram(Histogram *histogram);
+void recordHistogramValue(Histogram *histogram, long long value);
+void mergeHistogram(Histogram *into, Histogram *from);
+long long histogramPercentile(Histogram *histogram, double percentile);
+
+#endif /* ifndef HISTOGRAM_H */
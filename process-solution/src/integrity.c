@@ -0,0 +1,348 @@
+#include "integrity.h"
+
+#include <nmmintrin.h>
+#include <stdio.h>
+#include <string.h>
+
+/* The CRC32C polynomial, reflected. */
+#define CRC32C_POLYNOMIAL (0x82F63B78)
+
+/*
+ * Folds size bytes into a CRC32C a bit at a time, for machines without SSE4.2.
+ */
+static unsigned int crc32cScalar(unsigned int crc, const unsigned char *bytes, int size)
+{
+    int i, bit;
+
+    for (i = 0; i < size; i++)
+    {
+        crc ^= bytes[i];
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+        }
+    }
+
+    return crc;
+}
+
+/*
+ * Folds size bytes into a CRC32C with the SSE4.2 crc32 instruction, eight bytes at a time.
+ */
+__attribute__((target("sse4.2")))
+static unsigned int crc32cHardware(unsigned int crc, const unsigned char *bytes, int size)
+{
+    unsigned long long word, wide = crc;
+    unsigned int half;
+
+    for (; size >= 8; size -= 8, bytes += 8)
+    {
+        memcpy(&word, bytes, sizeof(word));
+        wide = _mm_crc32_u64(wide, word);
+    }
+    crc = (unsigned int)wide;
+    if (size >= 4)
+    {
+        memcpy(&half, bytes, sizeof(half));
+        crc = _mm_crc32_u32(crc, half);
+        size -= 4;
+        bytes += 4;
+    }
+    for (; size > 0; size--, bytes++)
+    {
+        crc = _mm_crc32_u8(crc, *bytes);
+    }
+
+    return crc;
+}
+
+static const ChecksumKernel scalarKernel = { "scalar", &crc32cScalar };
+static const ChecksumKernel hardwareKernel = { "SSE4.2", &crc32cHardware };
+
+/*
+ * Returns the fastest CRC32C kernel the machine supports.
+ */
+const ChecksumKernel *selectChecksumKernel(void)
+{
+    return __builtin_cpu_supports("sse4.2") ? &hardwareKernel : &scalarKernel;
+}
+
+/*
+ * Spreads the bits of x over all 64 of the result, so that the hashes of neighbouring items share no
+ * structure their sum could cancel out.
+ */
+static unsigned long long mixHash(unsigned long long x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+
+    return x;
+}
+
+/*
+ * Returns the hash of the size bytes of an item together with its sequence number: the CRC32C of both,
+ * mixed with the sequence number into 64 bits.
+ */
+unsigned long long hashItem(const ChecksumKernel *kernel, int sequence, const void *item, int size)
+{
+    unsigned int crc;
+
+    crc = kernel->crc(0xFFFFFFFF, (const unsigned char *)&sequence, sizeof(sequence));
+    crc = kernel->crc(crc, (const unsigned char *)item, size) ^ 0xFFFFFFFF;
+
+    return mixHash((unsigned long long)(unsigned int)sequence << 32 | crc);
+}
+
+/*
+ * Readies the CHECKSUM_RANGES checksums writers keep of the ranges they publish, and of the whole stream,
+ * to checksum a stream from its start.
+ */
+void clearRangeChecksums(RangeChecksum *ranges, StreamChecksum *published)
+{
+    int i;
+
+    for (i = 0; i < CHECKSUM_RANGES; i++)
+    {
+        ranges[i].range = RANGE_NONE;
+        ranges[i].sum.items = 0;
+        ranges[i].sum.hash = 0;
+    }
+    published->items = 0;
+    published->hash = 0;
+}
+
+/*
+ * Adds the hash of an item just published, with the given sequence number, to the checksum of its range
+ * and to that of the whole stream. The ranges' checksums are reused in turn, each holding every
+ * CHECKSUM_RANGES-th range, and a range's checksum begins again with the first of its items published.
+ */
+void addItemChecksum(RangeChecksum *ranges, StreamChecksum *published, int sequence, unsigned long long hash)
+{
+    int range = sequence / CHECKSUM_RANGE_ITEMS;
+    RangeChecksum *checksum = &ranges[range % CHECKSUM_RANGES];
+
+    if (checksum->range != range)
+    {
+        checksum->range = range;
+        checksum->sum.items = 0;
+        checksum->sum.hash = 0;
+    }
+    checksum->sum.items++;
+    checksum->sum.hash += hash;
+    published->items++;
+    published->hash += hash;
+}
+
+/*
+ * Readies a reader's check of the stream it reads from the item with sequence number start, hashing items
+ * with kernel. A reader that starts part way through a range cannot check that range.
+ */
+void openVerifier(StreamVerifier *verifier, const ChecksumKernel *kernel, int start)
+{
+    verifier->kernel = kernel;
+    verifier->stream.items = 0;
+    verifier->stream.hash = 0;
+    verifier->whole = start == 0;
+    verifier->published.items = 0;
+    verifier->published.hash = 0;
+    verifier->range = start / CHECKSUM_RANGE_ITEMS;
+    verifier->current.items = 0;
+    verifier->current.hash = 0;
+    verifier->broken = start % CHECKSUM_RANGE_ITEMS != 0;
+    verifier->block = BLOCK_NONE;
+    verifier->blockSum.items = 0;
+    verifier->blockSum.hash = 0;
+    verifier->matched = 0;
+    verifier->unchecked = 0;
+    verifier->diverged = 0;
+    verifier->firstDiverged = RANGE_NONE;
+}
+
+/*
+ * Adds the size bytes of the item read with the given sequence number to the reader's checksums.
+ *
+ * Returns true if the item is the last of its range, which the caller should then check with
+ * checkRange().
+ */
+bool verifyItem(StreamVerifier *verifier, int sequence, const void *item, int size)
+{
+    unsigned long long hash = hashItem(verifier->kernel, sequence, item, size);
+
+    verifier->stream.items++;
+    verifier->stream.hash += hash;
+    verifier->current.items++;
+    verifier->current.hash += hash;
+    if (verifier->block != sequence / FILTER_BLOCK_ITEMS)
+    {
+        verifier->block = sequence / FILTER_BLOCK_ITEMS;
+        verifier->blockSum.items = 0;
+        verifier->blockSum.hash = 0;
+    }
+    verifier->blockSum.items++;
+    verifier->blockSum.hash += hash;
+
+    return (sequence + 1) % CHECKSUM_RANGE_ITEMS == 0;
+}
+
+/*
+ * Records that a reader missed the items from sequence number from up to to, which it lost or skipped
+ * without reading them. Neither the ranges they lie in nor the whole stream can be checked.
+ */
+void missItems(StreamVerifier *verifier, int from, int to)
+{
+    if (from >= to)
+    {
+        return;
+    }
+
+    verifier->whole = false;
+    verifier->broken = true;
+    if (to / CHECKSUM_RANGE_ITEMS != verifier->range)
+    {
+        verifier->unchecked += to / CHECKSUM_RANGE_ITEMS - verifier->range;
+        verifier->range = to / CHECKSUM_RANGE_ITEMS;
+        verifier->current.items = 0;
+        verifier->current.hash = 0;
+        verifier->broken = to % CHECKSUM_RANGE_ITEMS != 0;
+    }
+}
+
+/*
+ * Records that a filtering reader skipped the items from sequence number from up to to, all of one filter
+ * block, without reading them. blockHash is the sum of the hashes of the items of the block up to to, from
+ * the block's summary. If the reader read or skipped every item of the block before from, the skipped
+ * items' hashes are that sum less its own, and they are added to its checksums as if read; otherwise they
+ * are missed.
+ *
+ * Returns true if the items end their range, which the caller should then check with checkRange().
+ */
+bool skipItems(StreamVerifier *verifier, int from, int to, unsigned long long blockHash)
+{
+    int block = from / FILTER_BLOCK_ITEMS;
+    unsigned long long hash;
+
+    if (from >= to)
+    {
+        return false;
+    }
+    if (verifier->block != block)
+    {
+        verifier->block = block;
+        verifier->blockSum.items = 0;
+        verifier->blockSum.hash = 0;
+    }
+    if (verifier->blockSum.items != from - block * FILTER_BLOCK_ITEMS)
+    {
+        missItems(verifier, from, to);
+        return false;
+    }
+
+    hash = blockHash - verifier->blockSum.hash;
+    verifier->stream.items += to - from;
+    verifier->stream.hash += hash;
+    verifier->current.items += to - from;
+    verifier->current.hash += hash;
+    verifier->blockSum.items += to - from;
+    verifier->blockSum.hash += hash;
+
+    return to % CHECKSUM_RANGE_ITEMS == 0;
+}
+
+/*
+ * Compares the checksum of the range a reader has read with the writers', then readies it for the next
+ * range. A range cannot be checked if the reader missed any of its items, or if the writers have reused
+ * its checksum for a later range.
+ *
+ * Must be called with the lock writers add to ranges under held.
+ */
+void checkRange(StreamVerifier *verifier, RangeChecksum *ranges)
+{
+    RangeChecksum *checksum = &ranges[verifier->range % CHECKSUM_RANGES];
+
+    if (verifier->broken || checksum->range != verifier->range)
+    {
+        verifier->unchecked++;
+    }
+    else if (checksum->sum.items == verifier->current.items && checksum->sum.hash == verifier->current.hash)
+    {
+        verifier->matched++;
+    }
+    else
+    {
+        verifier->diverged++;
+        verifier->firstDiverged = verifier->firstDiverged == RANGE_NONE ? verifier->range :
+            verifier->firstDiverged;
+    }
+
+    verifier->range++;
+    verifier->current.items = 0;
+    verifier->current.hash = 0;
+    verifier->broken = false;
+}
+
+/*
+ * Finishes a reader's check once it has stopped before the item with sequence number end: every item
+ * after it is missed, and the last range, which the stream may end part way through, is checked. The
+ * writers' checksum of the whole stream is kept for comparison.
+ *
+ * Must be called with the lock writers add to ranges under held.
+ */
+void finishVerifier(StreamVerifier *verifier, RangeChecksum *ranges, StreamChecksum *published, int end)
+{
+    missItems(verifier, end, published->items);
+    if (verifier->current.items || verifier->broken)
+    {
+        checkRange(verifier, ranges);
+    }
+    verifier->published = *published;
+}
+
+/*
+ * Returns true if a reader found that the stream it read diverged from the one the writers published:
+ * some range did not match, or it read the whole stream and the whole did not match.
+ */
+bool verifierDiverged(StreamVerifier *verifier)
+{
+    return verifier->diverged || (verifier->whole && (verifier->stream.items != verifier->published.items ||
+        verifier->stream.hash != verifier->published.hash));
+}
+
+/*
+ * Formats the outcome of a reader's finished check into report, as a single line without a newline, e.g.
+ * "checksum 1a2b3c4d5e6f7081 of 100 items matches the writers', with 1 of 1 ranges checked".
+ */
+void formatVerification(StreamVerifier *verifier, char *report, int size)
+{
+    int ranges = verifier->matched + verifier->unchecked + verifier->diverged,
+        last = (verifier->firstDiverged + 1) * CHECKSUM_RANGE_ITEMS;
+
+    /* The stream may end part way through the range that diverged. */
+    last = last < verifier->published.items ? last : verifier->published.items;
+
+    if (verifierDiverged(verifier) && verifier->firstDiverged != RANGE_NONE)
+    {
+        snprintf(report, size, "checksum %016llx of %d items against the writers' %016llx of %d; %d of %d "
+            "ranges diverged, the first being items #%d to #%d", verifier->stream.hash, verifier->stream.items,
+            verifier->published.hash, verifier->published.items, verifier->diverged, ranges,
+            verifier->firstDiverged * CHECKSUM_RANGE_ITEMS, last - 1);
+    }
+    else if (verifierDiverged(verifier))
+    {
+        snprintf(report, size, "checksum %016llx of %d items against the writers' %016llx of %d; %d of %d "
+            "ranges could not be checked to find where", verifier->stream.hash, verifier->stream.items,
+            verifier->published.hash, verifier->published.items, verifier->unchecked, ranges);
+    }
+    else if (verifier->whole)
+    {
+        snprintf(report, size, "checksum %016llx of %d items matches the writers', with %d of %d ranges checked",
+            verifier->stream.hash, verifier->stream.items, verifier->matched, ranges);
+    }
+    else
+    {
+        snprintf(report, size, "%d of the %d items published were read, and %d of %d ranges matched the "
+            "writers'", verifier->stream.items, verifier->published.items, verifier->matched, ranges);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+/* Identifies a file as an sds journal. */
+#define JOURNAL_MAGIC "SDSJRNL1"
+
+/* The number of records the journal file grows by whenever it fills. Space is allocated ahead of the
+ * records being written, so appending a record is a store into mapped memory. */
+#define JOURNAL_GROW_RECORDS (65536)
+
+/*
+ * The header at the start of a journal file.
+ */
+typedef struct JournalHeader
+{
+    /* JOURNAL_MAGIC, without its terminator. */
+    char magic[8];
+
+    /* The number of records that follow the header. Updated after every append, so a journal cut short
+     * by a crash is still readable up to its last complete record. */
+    long long records;
+} JournalHeader;
+
+/*
+ * A single published item, as captured by the journal reader.
+ */
+typedef struct JournalRecord
+{
+    /* The time the item was published, from readClockNs(). */
+    long long publishTime;
+
+    /* The item's position in the stream. */
+    int sequence;
+
+    /* The identifier of the writer that published the item. */
+    int writerId;
+
+    /* The item itself. */
+    int value;
+
+    /* Keeps records a multiple of 8 bytes. */
+    int reserved;
+} JournalRecord;
+
+/*
+ * An append-only journal file, written through a memory map.
+ */
+typedef struct Journal
+{
+    /* The journal file, or -1 if the journal could not be opened. */
+    int fd;
+
+    /* The mapped file: the header followed by capacity records. */
+    JournalHeader *header;
+
+    /* The number of records the mapped file has room for. */
+    long long capacity;
+} Journal;
+
+int openJournal(Journal *journal, char *path);
+void appendJournalRecord(Journal *journal, int sequence, int writerId, long long publishTime, int value);
+void closeJournal(Journal *journal);
+
+JournalHeader *mapJournal(char *path, long long *records, long long *mappedBytes);
+
+#endif /* ifndef JOURNAL_H */
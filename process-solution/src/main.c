@@ -1,10 +1,24 @@
 #include "main.h"
+#include "daemon.h"
 
 /* 
  * Store all reader and writer processes in the following arrays.
  */
 static pid_t *readers = NULL;
 static pid_t *writers = NULL;
+static pid_t *members = NULL;
+
+/*
+ * With fan-out, every relay process and the writer process of each relay's buffer.
+ */
+static pid_t *relays = NULL;
+
+/*
+ * Both ends of the pipe to each relay's buffer of the channel being started. Each process forked while
+ * they are open closes every end but the one it was forked to keep.
+ */
+static int relayPipes[MAX_RELAYS][2];
+static int relayPipeCount = 0;
 
 static void clearMemory()
 {
@@ -16,10 +30,39 @@ static void clearMemory()
     {
         free(writers);
     }
+    if (members != NULL)
+    {
+        free(members);
+    }
+    if (relays != NULL)
+    {
+        free(relays);
+    }
 }
 
 /*
- * Creates a segment of shared memory with read-write access.
+ * Closes the ends of the relays' pipes that this process does not keep. The pipe to a relay's buffer only
+ * reaches end-of-stream once every process holding its write end has closed it.
+ */
+static void closeRelayPipes()
+{
+    int i, j;
+
+    for (i = 0; i < relayPipeCount; i++)
+    {
+        for (j = 0; j < 2; j++)
+        {
+            if (relayPipes[i][j] >= 0 && relayPipes[i][j] != keptRelayPipe())
+            {
+                close(relayPipes[i][j]);
+            }
+        }
+    }
+    relayPipeCount = 0;
+}
+
+/*
+ * Creates a segment of shared memory with read-write access, under the name given by segmentName().
  *
  * Returns a memory map of the shared memory.
  *
@@ -27,7 +70,7 @@ static void clearMemory()
  */
 void *createSharedMemory(char *name, int size)
 {
-    int fd = shm_open(name, O_CREAT | O_RDWR, 0666);
+    int fd = shm_open(segmentName(name), O_CREAT | O_RDWR, 0666);
     ftruncate(fd, size);
 
     return mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
@@ -51,6 +94,7 @@ int createProcesses(pid_t *array, int num, void (*callback) (void))
              * in shared memory, and is hence not duplicated. The parent process can handle that.
              */
             clearMemory();
+            closeRelayPipes();
 
             /* Child process: call the callback. */
             callback();
@@ -62,19 +106,39 @@ int createProcesses(pid_t *array, int num, void (*callback) (void))
 }
 
 /*
- * Starts a set of writer procesess, inserting each writer process into the passed array.
+ * Starts a set of writer procesess, inserting each writer process into the passed array. Each process
+ * hosts as many writers as --threads gives it.
  */
 int startWriters(pid_t *array, RWConfig *config)
 {
-    return createProcesses(array, config->pConfig.writerCount, &writer);
+    return createProcesses(array, workerProcesses(config->pConfig.writerCount, config->pConfig.threadsPerProcess),
+        &writer);
 }
 
 /*
- * Starts a set of reader processes, inserting each reader process into the passed array.
+ * Starts a set of reader processes, inserting each reader process into the passed array. Each process
+ * hosts as many readers as --threads gives it.
  */
 int startReaders(pid_t *array, RWConfig *config)
 {
-    return createProcesses(array, config->pConfig.readerCount, &reader);
+    return createProcesses(array, workerProcesses(config->pConfig.readerCount, config->pConfig.threadsPerProcess),
+        &reader);
+}
+
+/*
+ * Starts the members of every consumer group, inserting each member process into the passed array.
+ */
+int startMembers(pid_t *array, RWConfig *config)
+{
+    return createProcesses(array, config->pConfig.memberCount, &groupMember);
+}
+
+/*
+ * Starts the journal reader process if the stream is being recorded.
+ */
+int startJournalReader(pid_t *process, RWConfig *config)
+{
+    return config->pConfig.journalName != NULL ? createProcesses(process, 1, &journalReader) : 0;
 }
 
 /*
@@ -88,6 +152,52 @@ int readInt(char *str)
     return value;
 }
 
+/*
+ * Reads a floating point number from a string.
+ */
+double readDouble(char *str)
+{
+    double value = 0;
+    sscanf(str, "%lf", &value);
+
+    return value;
+}
+
+/*
+ * Reads the value of an optional argument. If argv[*idx] is the option named name and is followed by a
+ * value, advances *idx past both and returns the value. Otherwise returns NULL.
+ */
+char *readOption(int argc, char **argv, int *idx, char *name)
+{
+    char *value = NULL;
+
+    if (*idx + 1 < argc && !strcmp(argv[*idx], name))
+    {
+        value = argv[*idx + 1];
+        *idx += 2;
+    }
+
+    return value;
+}
+
+/*
+ * Merges the latency histograms of every reader and writes the distribution to the sim_out file.
+ */
+void reportLatency(Histogram *latencies, int readerCount)
+{
+    int i;
+    Histogram *merged = (Histogram *)malloc(sizeof(Histogram));
+
+    initializeHistogram(merged);
+    for (i = 0; i < readerCount; i++)
+    {
+        mergeHistogram(merged, &latencies[i]);
+    }
+    simWriteLatency(merged);
+
+    free(merged);
+}
+
 /*
  * Prints a message to the console based on the status code.
  */
@@ -110,9 +220,10 @@ void printStatus(int sCode)
  * The returned structure will contain values that may be needed for the functioning of the program,
  * but in an encapsulating struct.
  */
-ProgramConfig readCommandLineArguments(char **argv)
+ProgramConfig readCommandLineArguments(int argc, char **argv)
 {
     ProgramConfig config;
+    char *value;
 
     /* Skip program name. */
     int idx = 1;
@@ -126,25 +237,315 @@ ProgramConfig readCommandLineArguments(char **argv)
     /* Read the number of seconds to sleep for writers. */
     config.writerSleepTime = readInt(argv[idx++]);
 
+    /* Read the optional arguments. Anything that is not an option names the input source, which defaults
+     * to the shared_data file. */
+    config.inputName = SHARED_FILE_NAME;
+    config.sinkName = NULL;
+    config.journalName = NULL;
+    config.replaySpeed = 1;
+    config.maxLagItems = 0;
+    config.maxLagNs = 0;
+    config.lagPolicy = LAG_POLICY_DETACH;
+    config.overwrite = false;
+    config.spillName = NULL;
+    config.capacity = SHM_BUFFER_SIZE;
+    config.maxCapacity = 0;
+    config.groupCount = 0;
+    config.memberCount = 0;
+    config.channelCount = 0;
+    config.channelName = NULL;
+    config.attachCount = 0;
+    config.relayCount = 0;
+    config.sinkBase = 0;
+    config.itemFields = 1;
+    config.instanceName = NULL;
+    config.daemonName = NULL;
+    config.subscriberCount = 0;
+    config.threadsPerProcess = 1;
+    config.arenaSize = 0;
+    config.aggregate.count = 0;
+    config.filterCount = 0;
+    config.verify = false;
+    config.trace = true;
+    while (idx < argc)
+    {
+        if (!strcmp(argv[idx], "--overwrite"))
+        {
+            config.overwrite = true;
+            idx++;
+        }
+        else if (!strcmp(argv[idx], "--verify"))
+        {
+            config.verify = true;
+            config.trace = false;
+            idx++;
+        }
+        else if (!strcmp(argv[idx], "--no-trace"))
+        {
+            config.trace = false;
+            idx++;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--sink")))
+        {
+            config.sinkName = value;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--record")))
+        {
+            config.journalName = value;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--replay-speed")))
+        {
+            config.replaySpeed = readDouble(value);
+        }
+        else if ((value = readOption(argc, argv, &idx, "--spill")))
+        {
+            config.spillName = value;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--item-size")))
+        {
+            if (readInt(value) >= (int)sizeof(int) && readInt(value) <= MAX_ITEM_SIZE && !(readInt(value) % sizeof(int)))
+            {
+                config.itemFields = readInt(value) / sizeof(int);
+            }
+            else
+            {
+                printf("Error: Ignoring item size of %s bytes; a multiple of %d bytes, at most %d.\n", value,
+                    (int)sizeof(int), MAX_ITEM_SIZE);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--arena")))
+        {
+            if (readInt(value) >= ARENA_MIN_SIZE)
+            {
+                config.arenaSize = readInt(value);
+            }
+            else
+            {
+                printf("Error: Ignoring arena of %s bytes; at least %d.\n", value, ARENA_MIN_SIZE);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--aggregate")))
+        {
+            if (parseAggregatePipeline(&config.aggregate, value))
+            {
+                printf("Error: Ignoring aggregate %s; expected up to %d of sum, min, max, count:LOW:HIGH and xor, "
+                    "separated by commas.\n", value, AGGREGATE_MAX_OPS);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--filter")))
+        {
+            if (config.filterCount < MAX_FILTERS && !parseReaderFilter(&config.filters[config.filterCount], value))
+            {
+                config.filterCount++;
+            }
+            else
+            {
+                printf("Error: Ignoring filter %s; expected [N=]range:LOW:HIGH or [N=]bits:MASK, at most %d filters.\n",
+                    value, MAX_FILTERS);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--elastic")))
+        {
+            config.maxCapacity = readInt(value);
+        }
+        else if ((value = readOption(argc, argv, &idx, "--group")))
+        {
+            if (config.groupCount < MAX_CONSUMER_GROUPS && readInt(value) > 0)
+            {
+                config.groupSizes[config.groupCount++] = readInt(value);
+                config.memberCount += readInt(value);
+            }
+            else
+            {
+                printf("Error: Ignoring consumer group of %s members; at most %d groups of at least one member.\n",
+                    value, MAX_CONSUMER_GROUPS);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--channel")))
+        {
+            if (config.channelCount < MAX_CHANNELS)
+            {
+                config.channelSpecs[config.channelCount++] = value;
+            }
+            else
+            {
+                printf("Error: Ignoring channel %s; at most %d channels.\n", value, MAX_CHANNELS);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--name")))
+        {
+            if (strlen(value) < CHANNEL_NAME_SIZE && strchr(value, '/') == NULL)
+            {
+                config.instanceName = value;
+            }
+            else
+            {
+                printf("Error: Ignoring instance name %s; at most %d characters, and no '/'.\n", value,
+                    CHANNEL_NAME_SIZE - 1);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--threads")))
+        {
+            if (readInt(value) > 0)
+            {
+                config.threadsPerProcess = readInt(value);
+            }
+            else
+            {
+                printf("Error: Ignoring %s threads per process; at least one.\n", value);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--attach-slots")))
+        {
+            config.attachCount = readInt(value) > 0 ? readInt(value) : 0;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--fan-out")))
+        {
+            if (readInt(value) > 0 && readInt(value) <= MAX_RELAYS && readInt(value) <= config.readerCount)
+            {
+                config.relayCount = readInt(value);
+            }
+            else
+            {
+                printf("Error: Ignoring fan-out of %s; between 1 and %d relays, and no more than the readers.\n",
+                    value, MAX_RELAYS);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--daemon")))
+        {
+            config.daemonName = value;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--subscribe")))
+        {
+            config.subscriberCount++;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--max-lag")))
+        {
+            config.maxLagItems = readInt(value);
+        }
+        else if ((value = readOption(argc, argv, &idx, "--max-lag-ms")))
+        {
+            config.maxLagNs = (long long)(readDouble(value) * 1000000);
+        }
+        else if ((value = readOption(argc, argv, &idx, "--lag-policy")))
+        {
+            config.lagPolicy = strcmp(value, "catch-up") ? LAG_POLICY_DETACH : LAG_POLICY_CATCH_UP;
+        }
+        else
+        {
+            config.inputName = argv[idx++];
+        }
+    }
+
+    /* The journal and the spill file hold integers rather than payloads, and an item's payload must stay
+     * in the arena until every consumer has read it. */
+    if (config.arenaSize && (config.journalName != NULL || config.spillName != NULL || config.overwrite ||
+        config.itemFields > 1))
+    {
+        printf("Error: Ignoring --record, --spill, --overwrite and --item-size with --arena.\n");
+        config.journalName = NULL;
+        config.spillName = NULL;
+        config.overwrite = false;
+        config.itemFields = 1;
+    }
+
+    /* The journal and the spill file hold a single field of each item. */
+    if (config.itemFields > 1 && (config.journalName != NULL || config.spillName != NULL))
+    {
+        printf("Error: Ignoring --record and --spill with items of more than %d bytes.\n", (int)sizeof(int));
+        config.journalName = NULL;
+        config.spillName = NULL;
+    }
+
     return config;
 }
 
 /*
- * Entry point for the program.
+ * Reads the channels the run hosts into the passed array. A run given no channels hosts a single unnamed
+ * channel. Channels that are malformed, or named the same as an earlier channel, are ignored.
+ *
+ * Returns the number of channels read.
  */
-int main(int argc, char **argv)
+int readChannels(Channel *channels, ProgramConfig *config)
 {
-    int sCode = 0, status, processes = 0, *data_buffer = NULL, *pendingReads = NULL;
+    int i, j, count = 0;
 
-    /*
-     * Store the rwConfig as a global so children can free it.
-     */
+    for (i = 0; i < config->channelCount; i++)
+    {
+        if (readChannel(&channels[count], config->channelSpecs[i]))
+        {
+            printf("Error: Ignoring channel %s; expected NAME[:SIZE]=SOURCE.\n", config->channelSpecs[i]);
+            continue;
+        }
+        for (j = 0; j < count && strcmp(channels[j].name, channels[count].name); j++)
+        {
+        }
+        if (j < count)
+        {
+            printf("Error: Ignoring channel %s; the name is already taken.\n", config->channelSpecs[i]);
+            continue;
+        }
+        count++;
+    }
+
+    return config->channelCount ? count : 1;
+}
+
+/*
+ * Derives the configuration of the buffer of one of the relays of a stream that fans out. The relays share
+ * out the stream's readers as evenly as they can, in order. Recording, spilling, consumer groups and the
+ * slots readers may attach to stay with the stream's own buffer, and the relay publishes to its buffer
+ * without pausing.
+ */
+ProgramConfig relayConfig(ProgramConfig *config, int relayId, char *name)
+{
+    ProgramConfig relay = *config;
+    int first = relayId * config->readerCount / config->relayCount;
+
+    relay.readerCount = (relayId + 1) * config->readerCount / config->relayCount - first;
+    relay.sinkBase = config->sinkBase + first;
+    relay.writerCount = 1;
+    relay.writerSleepTime = 0;
+    relay.inputName = NULL;
+    relay.journalName = NULL;
+    relay.spillName = NULL;
+    relay.groupCount = 0;
+    relay.memberCount = 0;
+    relay.attachCount = 0;
+    relay.relayCount = 0;
+
+    /* Name the relay's buffer after the channel, so that its segments and statistics are its own. */
+    snprintf(name, RELAY_NAME_SIZE, "%s%srelay%d", config->channelName != NULL ? config->channelName : "",
+        config->channelName != NULL ? "." : "", relayId);
+    relay.channelName = name;
+
+    return relay;
+}
+
+/*
+ * Creates the shared memory of a buffer for the given configuration, keyed by the name of its channel.
+ * Its processes are started by startBuffer().
+ */
+void createBuffer(ChannelHost *host, ProgramConfig config)
+{
+    int *data_buffer, *pendingReads, *sequence, *writerIds, i;
+    ReaderState *readerStates;
     RWConfig *rwConfig;
 
+    nameSegments(config.instanceName, config.channelName);
+
     /*
-     * The program's command-line configuration.
+     * Create shared memory for the RWConfig.
+     *
+     * This will be used by all reader and writer processes. It contains a single RWConfig, which will
+     * be used to communicate process configurations through the use of semaphores.
      */
-    ProgramConfig config;
+    rwConfig = (RWConfig *)createSharedMemory(SHARED_CONFIG_NAME, SHARED_CONFIG_SIZE);
+    *rwConfig = createRWConfig(config);
+    host->rwConfig = rwConfig;
+    host->relays = NULL;
+    host->started = false;
+    host->workers = 0;
 
     /* Create shared memory for the data_buffer.
      * 
@@ -153,16 +554,12 @@ int main(int argc, char **argv)
      *
      * This is an array of values that we read from the file. Writers will add values to this, while
      * readers read values from it.
-     */
-    data_buffer = (int *)createSharedMemory(SHARED_FILE_BUFFER_NAME, SHM_BUFFER_SIZE * sizeof(int));
-
-    /*
-     * Create shared memory for the RWConfig.
      *
-     * This will be used by all reader and writer processes. It contains a single RWConfig, which will
-     * be used to communicate process configurations through the use of semaphores.
+     * This and every other per-slot array are sized for the largest layout of the buffer up front, so
+     * that an elastic buffer can move to a new generation without the children remapping anything.
+     * Slots outside the generations in use are never touched.
      */
-    rwConfig = (RWConfig *)createSharedMemory(SHARED_CONFIG_NAME, SHARED_CONFIG_SIZE);
+    data_buffer = (int *)createSharedMemory(SHARED_FILE_BUFFER_NAME, SHARED_FILE_BUFFER_SIZE(rwConfig));
 
     /* 
      * Create shared memory for a list of pending reads.
@@ -170,39 +567,273 @@ int main(int argc, char **argv)
      * Reader processes will access this to decrement a pending read. Writer processes will access this
      * to determine if a buffer slot can be overwritten.
      */
-    pendingReads = (int *)createSharedMemory(PENDING_READS_NAME, SHM_BUFFER_SIZE);
+    pendingReads = (int *)createSharedMemory(PENDING_READS_NAME, rwConfig->ring.slots * sizeof(int));
 
-    if (argc >= MIN_NUM_CLARGS)
+    /*
+     * Create shared memory for the slot sequence numbers.
+     *
+     * Writer processes record which item of the stream each slot holds. Reader processes use this to
+     * determine whether the slot they are up to has been written since they last read it.
+     */
+    sequence = (int *)createSharedMemory(SLOT_SEQUENCE_NAME, rwConfig->ring.slots * sizeof(int));
+
+    /*
+     * Create shared memory for the slot stamps.
+     *
+     * Writer processes record who published the item in each slot, and when. The journal reader records
+     * these alongside each item.
+     */
+    writerIds = (int *)createSharedMemory(SLOT_WRITER_NAME, rwConfig->ring.slots * sizeof(int));
+    createSharedMemory(SLOT_TIME_NAME, rwConfig->ring.slots * sizeof(long long));
+
+    /*
+     * Create shared memory for the arena.
+     *
+     * With --arena, writer processes copy each item's payload here, and the data_buffer says where. Reader
+     * processes forward payloads straight from it.
+     */
+    if (config.arenaSize)
     {
-        /* Overwrite the file that we are writing to. */
-        simWriteClear();
-        initializeDefaultValueArray(data_buffer, SHM_BUFFER_SIZE, -1);
-        initializeDefaultValueArray(pendingReads, SHM_BUFFER_SIZE, 0);
-        config = readCommandLineArguments(argv);
-        *rwConfig = createRWConfig(config);
-
-        readers = (pid_t *)malloc(config.readerCount * sizeof(pid_t));
-        writers = (pid_t *)malloc(config.writerCount * sizeof(pid_t));
-
-        /* Start the threads. */
-        startReaders(readers, rwConfig);
-        startWriters(writers, rwConfig);
-
-        /* Wait for all threads to join the main thread of execution. */
-        processes = config.readerCount + config.writerCount;
-        while (processes--)
-        {
-            printf("Waiting for termination of process #%d / %d total.\n", processes,
-                config.readerCount + config.writerCount);
-            wait(&status);
-            printf("Process terminated with code=%d\n", status);
-            sCode = status || sCode;
+        createSharedMemory(ARENA_NAME, config.arenaSize);
+    }
+
+    /*
+     * Create shared memory for the block summaries.
+     *
+     * With --filter, writer processes summarise each block of items as they publish it. Filtering reader
+     * processes skip the items of a block that none of them pass without reading them.
+     */
+    if (config.filterCount)
+    {
+        clearBlockSummaries((BlockSummary *)createSharedMemory(BLOCK_SUMMARY_NAME,
+            BLOCK_SUMMARY_COUNT(rwConfig) * sizeof(BlockSummary)), BLOCK_SUMMARY_COUNT(rwConfig));
+    }
+
+    /*
+     * Create shared memory for the range checksums.
+     *
+     * With --verify, writer processes add each item they publish to the checksum of its range, and of the
+     * whole stream. Verifying reader processes check theirs against them.
+     */
+    if (config.verify)
+    {
+        clearRangeChecksums((RangeChecksum *)createSharedMemory(RANGE_CHECKSUM_NAME,
+            CHECKSUM_RANGES * sizeof(RangeChecksum)), &rwConfig->published);
+    }
+
+    initializeDefaultValueArray(data_buffer, rwConfig->ring.slots, -1);
+    initializeDefaultValueArray(pendingReads, rwConfig->ring.slots, 0);
+    initializeDefaultValueArray(sequence, rwConfig->ring.slots, SEQUENCE_NONE);
+    initializeDefaultValueArray(writerIds, rwConfig->ring.slots, -1);
+    host->pendingReads = pendingReads;
+    host->sequence = sequence;
+
+    /*
+     * Create shared memory for the reader latencies.
+     *
+     * Each reader process records into its own histogram. They are merged once every reader has
+     * exited. New shared memory is zeroed, and a zeroed histogram is empty.
+     */
+    host->latencies = (Histogram *)createSharedMemory(READER_LATENCY_NAME, config.readerCount * sizeof(Histogram));
+
+    /*
+     * Create shared memory for the reader positions.
+     *
+     * Each reader process advances its own position. Writer processes read them to find readers that
+     * have fallen behind, and the spill file's space is released once every reader, and the journal
+     * reader, has read it. New shared memory is zeroed, so every reader starts attached at the start
+     * of the stream. When not recording, the journal reader's entry is marked detached. Consumer group
+     * members hold no claim until they claim an item, and the slots readers may attach to hold none until
+     * a reader attaches.
+     */
+    readerStates = (ReaderState *)createSharedMemory(READER_STATE_NAME, READER_STATE_SIZE(config));
+    host->readerStates = readerStates;
+    readerStates[config.readerCount].detached = config.journalName == NULL;
+    for (i = config.readerCount + 1; i < READER_STATE_COUNT(config); i++)
+    {
+        readerStates[i].detached = true;
+    }
+
+    /*
+     * Create shared memory for the worker statistics.
+     *
+     * Each reader and writer process stores its live counters here. sds-top attaches to it read-only
+     * to monitor the run.
+     */
+    host->stats = (StatsRegion *)createSharedMemory(WORKER_STATS_NAME,
+        statsRegionSize(config.readerCount, config.writerCount));
+    initializeStatsRegion(host->stats, config.readerCount, config.writerCount, config.capacity);
+
+}
+
+/*
+ * Starts the processes serving a buffer, inserting each kind of worker process into the passed arrays.
+ * The readers of a stream that fans out are its relays, each forked to keep the write end of the pipe to
+ * its buffer. The writer of a relay's buffer is forked to keep the read end.
+ */
+void startBuffer(ChannelHost *host, pid_t *bufferReaders, pid_t *bufferWriters, pid_t *bufferMembers)
+{
+    RWConfig *rwConfig = host->rwConfig;
+    ProgramConfig *config = &rwConfig->pConfig;
+    int relayId;
+
+    /* Every worker of the buffer inherits the key to its segments. */
+    nameSegments(config->instanceName, config->channelName);
+    host->readers = bufferReaders;
+    host->writers = bufferWriters;
+    host->members = bufferMembers;
+    host->restarts = 0;
+    host->readerProcesses = 0;
+
+    if (config->relayCount)
+    {
+        for (relayId = 0; relayId < config->relayCount; relayId++)
+        {
+            keepRelayPipe(relayPipes[relayId][1]);
+            host->readerProcesses += createProcesses(&bufferReaders[relayId], 1, &reader);
         }
-        clearMemory();
+        keepRelayPipe(-1);
     }
     else
     {
-        sCode = ERROR_TOO_FEW_ARGS || sCode;
+        host->readerProcesses = startReaders(bufferReaders, rwConfig);
+    }
+    host->workers += host->readerProcesses;
+
+    host->workers += startJournalReader(&host->journal, rwConfig);
+    host->workers += startMembers(bufferMembers, rwConfig);
+
+    keepRelayPipe(config->inputName == NULL ? rwConfig->source.fd : -1);
+    host->writerProcesses = startWriters(bufferWriters, rwConfig);
+    host->workers += host->writerProcesses;
+    host->liveWriters = host->writerProcesses;
+    keepRelayPipe(-1);
+
+    host->started = true;
+}
+
+/*
+ * Creates the shared memory of a channel and starts the processes serving it. channel is NULL for the
+ * unnamed channel of a run that hosts no others. Each kind of worker process is inserted into the passed
+ * arrays; channelRelays holds every relay process, then the writer process of every relay's buffer.
+ *
+ * A channel that fans out is read by its relays rather than its readers. Each relay forwards the stream
+ * down a pipe to the writer of its own buffer, which serves the relay's share of the readers, so writers
+ * to the channel's buffer wait on no more than the relays however many readers there are.
+ *
+ * Returns a status code:
+ *   ERROR_OPENING_RELAY:
+ *     The pipe to a relay's buffer could not be created.
+ *   ERROR_OPENING_SPILL:
+ *     The channel's spill file could not be created.
+ *   ERROR_OPENING_SOURCE:
+ *     The channel's input source could not be opened.
+ *   0:
+ *     No errors were encountered.
+ */
+int openChannel(ChannelHost *host, ProgramConfig config, Channel *channel, pid_t *channelReaders,
+    pid_t *channelWriters, pid_t *channelMembers, pid_t *channelRelays)
+{
+    int sCode = 0, relayId, readerCount;
+    ChannelHost *relayHosts = NULL;
+
+    if (channel != NULL)
+    {
+        applyChannel(&config, channel);
+    }
+    readerCount = config.readerCount;
+
+    /*
+     * Create the buffer of every relay, reading from the pipe the relay forwards the stream down.
+     */
+    if (config.relayCount)
+    {
+        relayHosts = (ChannelHost *)malloc(config.relayCount * sizeof(ChannelHost));
+        for (relayId = 0; relayId < config.relayCount; relayId++)
+        {
+            if (pipe(relayPipes[relayId]))
+            {
+                printf("Error: Could not create the pipe to relay %d\n", relayId);
+                sCode = ERROR_OPENING_RELAY;
+                relayPipes[relayId][0] = relayPipes[relayId][1] = -1;
+            }
+            relayPipeCount++;
+            createBuffer(&relayHosts[relayId], relayConfig(&config, relayId, relayHosts[relayId].name));
+            openSpill(&relayHosts[relayId].rwConfig->spill, NULL);
+            attachInputSource(&relayHosts[relayId].rwConfig->source, relayPipes[relayId][0]);
+        }
+
+        /* The relays are the readers of the channel's own buffer. They do not pause between items, and
+         * the channel's members are numbered after every relay's readers. */
+        config.sinkBase += config.readerCount - config.relayCount;
+        config.readerCount = config.relayCount;
+        config.readerSleepTime = 0;
+    }
+
+    createBuffer(host, config);
+    host->relays = relayHosts;
+
+    /*
+     * Open the input source before forking, so that every writer inherits the same file descriptor
+     * and reads through the buffer in the shared RWConfig. The spill file is mapped before forking for
+     * the same reason.
+     */
+    if (sCode)
+    {
+        /* A relay's pipe is missing; start nothing. */
+    }
+    else if (openSpill(&host->rwConfig->spill, config.spillName))
+    {
+        printf("Error: Could not create spill file %s\n", config.spillName);
+        sCode = ERROR_OPENING_SPILL;
+    }
+    else if (!openInputSource(&host->rwConfig->source, config.inputName, config.replaySpeed))
+    {
+        /* Start the processes, the relays' buffers first. */
+        for (relayId = 0; relayId < config.relayCount; relayId++)
+        {
+            startBuffer(&relayHosts[relayId], &channelReaders[relayId * readerCount / config.relayCount],
+                &channelRelays[config.relayCount + relayId], NULL);
+            host->workers += relayHosts[relayId].workers;
+        }
+        startBuffer(host, config.relayCount ? channelRelays : channelReaders, channelWriters, channelMembers);
+    }
+    else
+    {
+        printf("Error: Could not open input source %s\n", config.inputName);
+        sCode = ERROR_OPENING_SOURCE;
+        closeSpill(&host->rwConfig->spill, config.spillName);
+    }
+
+    /* Every process that uses the relays' pipes has its own end of them by now. */
+    closeRelayPipes();
+
+    return sCode;
+}
+
+/*
+ * Reports on a channel, and on its relays, once their worker processes have exited, then closes their
+ * shared memory.
+ */
+void closeChannel(ChannelHost *host)
+{
+    ProgramConfig *config = &host->rwConfig->pConfig;
+    int relayId;
+
+    nameSegments(config->instanceName, config->channelName);
+    if (host->started)
+    {
+        /* Every worker has finished. Let any attached sds-top print its last sample and stop. */
+        STATS_STORE(host->stats->finished, 1);
+
+        reportLatency(host->latencies, config->readerCount);
+        closeSpill(&host->rwConfig->spill, config->spillName);
+
+        /* The pipe a relay's buffer reads from was closed as soon as its processes were forked. */
+        if (config->inputName != NULL)
+        {
+            closeInputSource(&host->rwConfig->source);
+        }
     }
 
     /*
@@ -211,6 +842,529 @@ int main(int argc, char **argv)
     closeSharedMemory(SHARED_FILE_BUFFER_NAME);
     closeSharedMemory(SHARED_CONFIG_NAME);
     closeSharedMemory(PENDING_READS_NAME);
+    closeSharedMemory(SLOT_SEQUENCE_NAME);
+    closeSharedMemory(SLOT_WRITER_NAME);
+    closeSharedMemory(SLOT_TIME_NAME);
+    closeSharedMemory(READER_LATENCY_NAME);
+    closeSharedMemory(WORKER_STATS_NAME);
+    closeSharedMemory(READER_STATE_NAME);
+    if (config->arenaSize)
+    {
+        closeSharedMemory(ARENA_NAME);
+    }
+    if (config->filterCount)
+    {
+        closeSharedMemory(BLOCK_SUMMARY_NAME);
+    }
+    if (config->verify)
+    {
+        closeSharedMemory(RANGE_CHECKSUM_NAME);
+    }
+
+    for (relayId = 0; host->relays != NULL && relayId < config->relayCount; relayId++)
+    {
+        closeChannel(&host->relays[relayId]);
+    }
+    free(host->relays);
+}
+
+/*
+ * Wakes every worker of a buffer that is waiting for a slot or for an item, so that each checks again
+ * what it was waiting for.
+ */
+static void wakeWorkers(RWConfig *rwConfig)
+{
+    lockMutex(&rwConfig->fullWaitersMutex);
+    while (rwConfig->fullWaiters > 0)
+    {
+        sem_post(&rwConfig->fullCond);
+        rwConfig->fullWaiters--;
+    }
+    pthread_mutex_unlock(&rwConfig->fullWaitersMutex);
+
+    lockMutex(&rwConfig->emptyWaitersMutex);
+    while (rwConfig->emptyWaiters > 0)
+    {
+        sem_post(&rwConfig->emptyCond);
+        rwConfig->emptyWaiters--;
+    }
+    pthread_mutex_unlock(&rwConfig->emptyWaitersMutex);
+}
+
+/*
+ * Detaches a consumer group once none of its members are left, giving up its claim on every item it had
+ * yet to claim, which it loses.
+ *
+ * Must be called with rwConfig->rpMutex held.
+ */
+static void detachGroup(ChannelHost *host, int groupId)
+{
+    RWConfig *rwConfig = host->rwConfig;
+    ProgramConfig *config = &rwConfig->pConfig;
+    GroupState *group = &rwConfig->groups[groupId];
+    int memberId, slot;
+
+    for (memberId = 0; memberId < config->memberCount; memberId++)
+    {
+        if (memberGroup(config, memberId) == groupId &&
+            host->readerStates[config->readerCount + 1 + memberId].pid != PID_EXITED)
+        {
+            return;
+        }
+    }
+
+    for (slot = 0; slot < rwConfig->ring.slots; slot++)
+    {
+        if (host->sequence[slot] >= group->cursor)
+        {
+            host->pendingReads[slot]--;
+        }
+    }
+    printf("Error: Every member of consumer group %d died. Detaching it from item #%d.\n", groupId,
+        group->cursor);
+    group->lost += rwConfig->writes - group->cursor;
+    group->detached = true;
+    rwConfig->consumers--;
+}
+
+/*
+ * Records that a reader process, the journal reader or a consumer group member of a buffer has exited.
+ * The positions of the readers it hosted are among the count positions from first, found by the process
+ * recorded against them; one that died before taking its identifiers is given the next block of them
+ * from nextId, as many as a process hosts, which no other process will now take.
+ *
+ * Each reader of a process that died is detached, giving up its claim on every item it had not read, and
+ * the process no longer counts among the active readers. A member that died gives up the item it had
+ * claimed, which its group loses, and a group none of whose members are left is detached. The buffer's
+ * waiting workers are then woken, since they may have been waiting for the dead reader.
+ */
+static void readerExited(ChannelHost *host, int first, int count, int block, int *nextId, pid_t pid,
+    bool died)
+{
+    RWConfig *rwConfig = host->rwConfig;
+    ProgramConfig *config = &rwConfig->pConfig;
+    ReaderState *state;
+    int i, memberId, slot, exitedCount = 0, *exited = (int *)malloc(count * sizeof(int));
+
+    lockMutex(&rwConfig->rcMutex);
+    for (i = 0; i < count; i++)
+    {
+        if (host->readerStates[first + i].pid == pid)
+        {
+            exited[exitedCount++] = first + i;
+        }
+    }
+    for (i = exitedCount ? 0 : workerBlock(count, block, *nextId); i > 0; i--)
+    {
+        exited[exitedCount++] = first + (*nextId)++;
+    }
+    for (i = 0; i < exitedCount; i++)
+    {
+        state = &host->readerStates[exited[i]];
+        state->pid = PID_EXITED;
+        if (state->reading)
+        {
+            state->reading = false;
+            if (!--rwConfig->activeReaders)
+            {
+                wakeRwWaiters(rwConfig);
+            }
+        }
+    }
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+
+    if (!exitedCount || !died)
+    {
+        free(exited);
+        return;
+    }
+
+    lockMutex(&rwConfig->rpMutex);
+    for (i = 0; i < exitedCount; i++)
+    {
+        state = &host->readerStates[exited[i]];
+        if (first <= config->readerCount)
+        {
+            if (!state->detached)
+            {
+                printf("Error: Reader process %d died. Detaching reader %d from item #%d.\n", pid,
+                    first ? JOURNAL_READER_ID : exited[i], state->cursor);
+                detachReader(rwConfig, state, host->pendingReads, host->sequence);
+            }
+            continue;
+        }
+
+        memberId = exited[i] - first;
+        if (!state->detached)
+        {
+            printf("Error: Member process %d died. Its group lost item #%d.\n", pid, state->cursor);
+            slot = ringSlot(&rwConfig->ring, state->cursor);
+            if (host->sequence[slot] == state->cursor)
+            {
+                host->pendingReads[slot]--;
+            }
+            rwConfig->groups[memberGroup(config, memberId)].lost++;
+            state->detached = true;
+        }
+        if (!rwConfig->groups[memberGroup(config, memberId)].detached)
+        {
+            detachGroup(host, memberGroup(config, memberId));
+        }
+    }
+    pthread_mutex_unlock(&rwConfig->rpMutex);
+    free(exited);
+
+    wakeWorkers(rwConfig);
+}
+
+/*
+ * Records that a writer of a buffer has exited. A writer that died holding the buffer against readers
+ * gives it back, and another writer is started in its place: it publishes any item the dead writer had
+ * read from the source but not finished publishing, and carries on from the source. A relay's buffer cannot be given a new writer,
+ * since only the dead writer held the pipe from the relay, and no more than MAX_WRITER_RESTARTS are
+ * started for any buffer. Once no writer is left, the stream is ended, so that the readers finish with
+ * what was published.
+ *
+ * Returns the writer process started in place of the dead one, or 0 if none was.
+ */
+static pid_t writerExited(ChannelHost *host, int writerIdx, pid_t pid, bool died)
+{
+    RWConfig *rwConfig = host->rwConfig;
+    ProgramConfig *config = &rwConfig->pConfig;
+
+    host->liveWriters--;
+    if (!died)
+    {
+        return 0;
+    }
+
+    lockMutex(&rwConfig->rcMutex);
+    if (rwConfig->rwWriter == pid)
+    {
+        rwConfig->rwWriter = 0;
+        wakeRwWaiters(rwConfig);
+    }
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+
+    if (config->inputName != NULL && host->restarts < MAX_WRITER_RESTARTS && !rwConfig->eof)
+    {
+        printf("Error: Writer process %d died. Starting another in its place.\n", pid);
+        fflush(stdout);
+        nameSegments(config->instanceName, config->channelName);
+        createProcesses(&host->writers[writerIdx], 1, &writer);
+        host->restarts++;
+        host->liveWriters++;
+
+        return host->writers[writerIdx];
+    }
+
+    if (!host->liveWriters && !rwConfig->eof)
+    {
+        printf("Error: Writer process %d died, and no writer is left. Ending the stream.\n", pid);
+        lockWriters(rwConfig, host->pendingReads, host->sequence);
+        lockMutex(&rwConfig->rpMutex);
+        if (rwConfig->unpublished.holding)
+        {
+            printf("Error: Item #%d was read from the source, but no writer is left to publish it.\n",
+                rwConfig->unpublished.sequence);
+            rwConfig->unpublished.holding = false;
+            rwConfig->lostWrites++;
+        }
+        rwConfig->eof = true;
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+        pthread_mutex_unlock(&rwConfig->writeMutex);
+        wakeWorkers(rwConfig);
+    }
+
+    return 0;
+}
+
+/*
+ * Records that a worker process of a buffer has exited, and recovers the buffer from it if it died
+ * rather than exiting normally.
+ *
+ * Returns the worker process started in place of the dead one, or 0 if none was.
+ */
+pid_t workerExited(ChannelHost *host, pid_t pid, bool died)
+{
+    ProgramConfig *config = &host->rwConfig->pConfig;
+    int i, journalId = 0;
+
+    for (i = 0; i < host->writerProcesses; i++)
+    {
+        if (host->writers[i] == pid)
+        {
+            return writerExited(host, i, pid, died);
+        }
+    }
+
+    for (i = 0; i < config->memberCount; i++)
+    {
+        if (host->members[i] == pid)
+        {
+            readerExited(host, config->readerCount + 1, config->memberCount, 1, &host->rwConfig->nextMemberId,
+                pid, died);
+            return 0;
+        }
+    }
+
+    if (config->journalName != NULL && host->journal == pid)
+    {
+        readerExited(host, config->readerCount, 1, 1, &journalId, pid, died);
+    }
+    else
+    {
+        readerExited(host, 0, config->readerCount, config->relayCount ? 1 : config->threadsPerProcess,
+            &host->rwConfig->nextReaderId, pid, died);
+    }
+
+    return 0;
+}
+
+/*
+ * The worker processes the parent is waiting for, each watched through a pidfd, and the buffer each
+ * serves. A worker that could not be given a pidfd is polled instead, and one that has been reaped has
+ * its pid cleared.
+ */
+typedef struct Watchlist
+{
+    struct pollfd *pidfds;
+    pid_t *pids;
+    ChannelHost **hosts;
+    int count;
+    int capacity;
+    int unwatched;
+} Watchlist;
+
+/*
+ * Adds a worker process of a buffer to the watchlist.
+ */
+static void watchWorker(Watchlist *watchlist, ChannelHost *host, pid_t pid)
+{
+    if (watchlist->count == watchlist->capacity)
+    {
+        watchlist->capacity = watchlist->capacity ? 2 * watchlist->capacity : 64;
+        watchlist->pidfds = (struct pollfd *)realloc(watchlist->pidfds,
+            watchlist->capacity * sizeof(struct pollfd));
+        watchlist->pids = (pid_t *)realloc(watchlist->pids, watchlist->capacity * sizeof(pid_t));
+        watchlist->hosts = (ChannelHost **)realloc(watchlist->hosts, watchlist->capacity * sizeof(ChannelHost *));
+    }
+
+    watchlist->pidfds[watchlist->count].fd = pidfd_open(pid, 0);
+    watchlist->pidfds[watchlist->count].events = POLLIN;
+    watchlist->pidfds[watchlist->count].revents = 0;
+    watchlist->pids[watchlist->count] = pid;
+    watchlist->hosts[watchlist->count] = host;
+    if (watchlist->pidfds[watchlist->count].fd < 0)
+    {
+        printf("Error: Could not watch process %d, polling it instead.\n", pid);
+        watchlist->unwatched++;
+    }
+    watchlist->count++;
+}
+
+/*
+ * Adds every worker process of a buffer, and of its relays' buffers, to the watchlist.
+ */
+static void watchBuffer(Watchlist *watchlist, ChannelHost *host)
+{
+    ProgramConfig *config = &host->rwConfig->pConfig;
+    int i;
+
+    if (!host->started)
+    {
+        return;
+    }
+
+    for (i = 0; i < host->readerProcesses; i++)
+    {
+        watchWorker(watchlist, host, host->readers[i]);
+    }
+    if (config->journalName != NULL)
+    {
+        watchWorker(watchlist, host, host->journal);
+    }
+    for (i = 0; i < config->memberCount; i++)
+    {
+        watchWorker(watchlist, host, host->members[i]);
+    }
+    for (i = 0; i < host->writerProcesses; i++)
+    {
+        watchWorker(watchlist, host, host->writers[i]);
+    }
+    for (i = 0; host->relays != NULL && i < config->relayCount; i++)
+    {
+        watchBuffer(watchlist, &host->relays[i]);
+    }
+}
+
+/*
+ * Reaps a worker process of the watchlist that has terminated with the given status, and watches its
+ * replacement if the parent starts one.
+ *
+ * Returns the number of processes added to the watchlist.
+ */
+static int reapWorker(Watchlist *watchlist, int i, int status)
+{
+    ChannelHost *host = watchlist->hosts[i];
+    pid_t pid = watchlist->pids[i], replacement;
+
+    printf("Process terminated with code=%d\n", status);
+    if (watchlist->pidfds[i].fd >= 0)
+    {
+        close(watchlist->pidfds[i].fd);
+        watchlist->pidfds[i].fd = -1;
+    }
+    else
+    {
+        watchlist->unwatched--;
+    }
+    watchlist->pids[i] = 0;
+
+    replacement = workerExited(host, pid, status != 0);
+    if (replacement > 0)
+    {
+        watchWorker(watchlist, host, replacement);
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Waits for every worker process of the given channels to terminate.
+ *
+ * Each worker is watched through a pidfd, so that the parent hears of any of them exiting as soon as it
+ * does, whichever channel it serves. A worker that dies rather than exiting normally, killed or crashing,
+ * would otherwise leave the rest of its buffer waiting for it forever: the locks it held are recovered by
+ * the next process to take them, and the parent gives up its claims and replaces it where it can, so that
+ * the run carries on without it. Where no pidfd could be opened for a worker, the parent polls it with a
+ * nonblocking waitpid every UNWATCHED_POLL_MS instead.
+ *
+ * Returns nonzero if any worker did not exit normally.
+ */
+int superviseWorkers(ChannelHost *hosts, int hostCount)
+{
+    Watchlist watchlist = { NULL, NULL, NULL, 0, 0, 0 };
+    int sCode = 0, status, remaining, i;
+
+    for (i = 0; i < hostCount; i++)
+    {
+        watchBuffer(&watchlist, &hosts[i]);
+    }
+
+    remaining = watchlist.count;
+    while (remaining)
+    {
+        printf("Waiting for termination of process #%d / %d total.\n", remaining - 1, watchlist.count);
+        if (poll(watchlist.pidfds, watchlist.count, watchlist.unwatched ? UNWATCHED_POLL_MS : -1) < 0)
+        {
+            continue;
+        }
+
+        for (i = 0; i < watchlist.count; i++)
+        {
+            if (!watchlist.pids[i])
+            {
+                continue;
+            }
+            if (watchlist.pidfds[i].fd >= 0)
+            {
+                if (!watchlist.pidfds[i].revents)
+                {
+                    continue;
+                }
+                waitpid(watchlist.pids[i], &status, 0);
+            }
+            else if (waitpid(watchlist.pids[i], &status, WNOHANG) == 0)
+            {
+                continue;
+            }
+
+            sCode = status || sCode;
+            remaining += reapWorker(&watchlist, i, status) - 1;
+        }
+    }
+
+    free(watchlist.pidfds);
+    free(watchlist.pids);
+    free(watchlist.hosts);
+
+    return sCode;
+}
+
+/*
+ * Entry point for the program.
+ */
+int main(int argc, char **argv)
+{
+    int sCode = 0, channelCount, i;
+
+    /*
+     * The program's command-line configuration.
+     */
+    ProgramConfig config;
+
+    /* The channels the run hosts, and the shared memory of each. */
+    Channel *channels;
+    ChannelHost *hosts;
+
+    if (argc >= MIN_NUM_CLARGS)
+    {
+        /* Overwrite the file that we are writing to. */
+        simWriteClear();
+        config = readCommandLineArguments(argc, argv);
+
+        /* A subscriber reads several channels at once, which only the threads solution supports. */
+        if (config.subscriberCount)
+        {
+            printf("Error: --subscribe is only supported by the threads solution.\n");
+            return ERROR_UNSUPPORTED_OPTION;
+        }
+
+        channels = (Channel *)malloc(MAX_CHANNELS * sizeof(Channel));
+        channelCount = readChannels(channels, &config);
+        hosts = (ChannelHost *)malloc(channelCount * sizeof(ChannelHost));
+
+        readers = (pid_t *)malloc(channelCount * config.readerCount * sizeof(pid_t));
+        writers = (pid_t *)malloc(channelCount * config.writerCount * sizeof(pid_t));
+        members = (pid_t *)malloc(channelCount * config.memberCount * sizeof(pid_t));
+        relays = (pid_t *)malloc(channelCount * 2 * config.relayCount * sizeof(pid_t));
+
+        /* A sink consumer that goes away should close that reader's sink, not end the reader. */
+        signal(SIGPIPE, SIG_IGN);
+
+        if (config.daemonName != NULL)
+        {
+            /* A daemon runs one job after another through a single buffer, until told to stop. */
+            channelCount = 0;
+            sCode = runDaemon(&config) || sCode;
+        }
+
+        /* Start every channel before waiting for any of them, so that they run side by side. */
+        for (i = 0; i < channelCount; i++)
+        {
+            sCode = openChannel(&hosts[i], config, config.channelCount ? &channels[i] : NULL,
+                &readers[i * config.readerCount], &writers[i * config.writerCount],
+                &members[i * config.memberCount], &relays[i * 2 * config.relayCount]) || sCode;
+        }
+
+        /* Wait for all processes to terminate, recovering from any that die. */
+        sCode = superviseWorkers(hosts, channelCount) || sCode;
+
+        for (i = 0; i < channelCount; i++)
+        {
+            closeChannel(&hosts[i]);
+        }
+
+        clearMemory();
+        free(hosts);
+        free(channels);
+    }
+    else
+    {
+        sCode = ERROR_TOO_FEW_ARGS || sCode;
+    }
 
     printStatus(sCode);
 
@@ -3,8 +3,13 @@
 
 #include <stdlib.h>
 #include <sys/wait.h>
+#include <signal.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/pidfd.h>
 
 #include "shared.h"
+#include "channel.h"
 #include "reader.h"
 #include "writer.h"
 
@@ -15,5 +20,68 @@
 #define ERROR_TOO_FEW_ARGS (-1)
 #define ERROR_INCORRECT_READS (-487313)
 #define ERROR_INCORRECT_WRITES (-487315)
+#define ERROR_OPENING_SOURCE (-487317)
+#define ERROR_OPENING_SPILL (-487319)
+#define ERROR_OPENING_RELAY (-487321)
+#define ERROR_UNSUPPORTED_OPTION (-487323)
+
+/* The most writers started in place of writers of a buffer that died. */
+#define MAX_WRITER_RESTARTS (8)
+
+/* How often, in milliseconds, the parent polls a worker it could not open a pidfd for. */
+#define UNWATCHED_POLL_MS (100)
+
+/* The longest name given to the buffer of a relay. */
+#define RELAY_NAME_SIZE (CHANNEL_NAME_SIZE + 16)
+
+/*
+ * The shared memory of one channel, or of one of its relays, that the parent process keeps hold of while
+ * the workers run.
+ */
+typedef struct ChannelHost
+{
+    /* The name of a relay's buffer. */
+    char name[RELAY_NAME_SIZE];
+
+    /* The channel's RWConfig, reader latencies and worker statistics. */
+    RWConfig *rwConfig;
+    Histogram *latencies;
+    StatsRegion *stats;
+
+    /* The channel's pending reads, slot sequence numbers and reader positions, through which the parent
+     * gives up the claims of a worker that died. */
+    int *pendingReads;
+    int *sequence;
+    ReaderState *readerStates;
+
+    /* With fan-out, the shared memory of each relay's buffer, or NULL. */
+    struct ChannelHost *relays;
+
+    /* The reader, writer and consumer group member processes, and the journal reader process, when
+     * recording. */
+    pid_t *readers;
+    pid_t *writers;
+    pid_t *members;
+    pid_t journal;
+
+    /* The number of reader and writer processes started, each hosting one or more readers or writers. */
+    int readerProcesses;
+    int writerProcesses;
+
+    /* The number of writer processes still running, and the number started in place of ones that died. */
+    int liveWriters;
+    int restarts;
+
+    /* Whether the channel's worker processes were started, and how many. They are not if its source or
+     * spill file failed to open. */
+    bool started;
+    int workers;
+} ChannelHost;
+
+int createProcesses(pid_t *array, int num, void (*callback) (void));
+void createBuffer(ChannelHost *host, ProgramConfig config);
+void closeChannel(ChannelHost *host);
+void reportLatency(Histogram *latencies, int readerCount);
+pid_t workerExited(ChannelHost *host, pid_t pid, bool died);
 
 #endif /* ifndef MAIN_H */
@@ -0,0 +1,135 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+/* The end of the socket to the daemon that a pool worker process was forked to keep, or -1. */
+static int poolSocket = -1;
+
+/*
+ * Sets the end of a socket to the daemon that processes forked from now on keep. Every other process is
+ * forked with -1.
+ */
+void keepPoolSocket(int fd)
+{
+    poolSocket = fd;
+}
+
+/*
+ * Returns the end of the socket to the daemon this process was forked to keep, or -1.
+ */
+int keptPoolSocket()
+{
+    return poolSocket;
+}
+
+/*
+ * Hands a job to the pool worker process at the other end of the socket fd, passing it the descriptor
+ * sourceFd as well unless it is -1. The worker is given its own descriptor for the same open file, so it
+ * shares the file offset with every other worker handed it, as if it had been inherited.
+ *
+ * Returns 0 on success, or -1 if the worker could not be reached.
+ */
+int sendPoolJob(int fd, PoolJob *job, int sourceFd)
+{
+    struct msghdr message;
+    struct iovec iov;
+    struct cmsghdr *header;
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    memset(&message, 0, sizeof(message));
+    iov.iov_base = job;
+    iov.iov_len = sizeof(PoolJob);
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+
+    if (sourceFd >= 0)
+    {
+        memset(&control, 0, sizeof(control));
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+        header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(header), &sourceFd, sizeof(int));
+    }
+
+    return sendmsg(fd, &message, 0) == sizeof(PoolJob) ? 0 : -1;
+}
+
+/*
+ * Waits for the daemon to hand this pool worker process its next job. A descriptor handed along with the
+ * job is moved to sourceFd, the number every worker reads the job's input source through, or closed if
+ * sourceFd is -1.
+ *
+ * Returns false once the daemon has stopped instead.
+ */
+bool awaitPoolJob(PoolJob *job, int sourceFd)
+{
+    struct msghdr message;
+    struct iovec iov;
+    struct cmsghdr *header;
+    int received;
+    union
+    {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    memset(&message, 0, sizeof(message));
+    iov.iov_base = job;
+    iov.iov_len = sizeof(PoolJob);
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    if (recvmsg(poolSocket, &message, 0) != sizeof(PoolJob))
+    {
+        return false;
+    }
+
+    header = CMSG_FIRSTHDR(&message);
+    if (header != NULL && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+    {
+        memcpy(&received, CMSG_DATA(header), sizeof(int));
+        if (sourceFd >= 0)
+        {
+            dup2(received, sourceFd);
+        }
+        close(received);
+    }
+
+    return true;
+}
+
+/*
+ * Tells the daemon that this pool worker process has finished its part of the job, having read or
+ * published count items.
+ */
+void finishPoolJob(int count)
+{
+    send(poolSocket, &count, sizeof(int), 0);
+}
+
+/*
+ * Lets go of the input source of a job that has finished, leaving sourceFd open on /dev/null so that the
+ * number stays taken for the next job's source.
+ */
+void releasePoolSource(int sourceFd)
+{
+    int fd = open("/dev/null", O_RDONLY);
+
+    if (fd >= 0 && fd != sourceFd)
+    {
+        dup2(fd, sourceFd);
+        close(fd);
+    }
+}
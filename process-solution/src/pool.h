@@ -0,0 +1,36 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+
+/* The longest job request a daemon accepts, including the newline. */
+#define DAEMON_REQUEST_SIZE (4096)
+
+/*
+ * A job a daemon hands to every worker process of its pool, over the socket the worker was forked with.
+ * Writers are handed the job's input source along with it. Each worker replies with the number of items
+ * it read or published once it has finished its part.
+ */
+typedef struct PoolJob
+{
+    /* The number of the job, from 1. */
+    int job;
+
+    /* The number of readers and writers taking part. Workers whose identifiers are not below these sit
+     * the job out. */
+    int readers;
+    int writers;
+
+    /* The output sink each reader taking part forwards its stream to, or an empty string for none. */
+    char sinkName[DAEMON_REQUEST_SIZE];
+} PoolJob;
+
+void keepPoolSocket(int fd);
+int keptPoolSocket();
+
+int sendPoolJob(int fd, PoolJob *job, int sourceFd);
+bool awaitPoolJob(PoolJob *job, int sourceFd);
+void finishPoolJob(int count);
+void releasePoolSource(int sourceFd);
+
+#endif /* ifndef POOL_H */
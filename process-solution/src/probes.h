@@ -0,0 +1,41 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+/*
+ * Statically defined tracepoints, for bpftrace and perf, e.g.
+ *     bpftrace -e 'usdt:./bin/sds:sds:consume { @[arg2] = count(); }'
+ *
+ * Every probe carries, in order: the item's sequence number, the buffer slot index and the worker's
+ * identifier. Reader and writer identifiers are counted separately; the journal reader is reader -1, and
+ * consumer group members are numbered after the readers.
+ * Where a worker has no item in hand (waiting, exiting), the sequence number is the next one it expects.
+ *
+ *   sds:slot_claim          a writer has a free slot to publish into
+ *   sds:publish             a writer has published an item
+ *   sds:consume             a reader has read an item
+ *   sds:reader_wait_begin   a reader found no item to read and is going to sleep
+ *   sds:reader_wait_end     a reader has an item to read, or the stream has ended, after sleeping
+ *   sds:writer_wait_begin   a writer found no free slot and is going to sleep
+ *   sds:writer_wait_end     a writer has a free slot after sleeping
+ *   sds:reader_exit         a reader has finished; the sequence number is the number of items it read
+ *   sds:writer_exit         a writer has finished; the sequence number is the number of items it wrote,
+ *                           and the slot index is -1
+ *
+ * Each probe is a single nop plus an ELF note, so an unattached probe costs nothing. They are built with
+ * sys/sdt.h (systemtap-sdt-dev) when it is available, or else on x86-64 with the stand-in in usdt.h.
+ * Elsewhere the build fails rather than lose them unnoticed; -DSDS_NO_PROBES builds without them.
+ */
+
+#if defined(SDS_NO_PROBES)
+#define SDS_PROBE(name, sequence, slot, workerId) do { } while (0)
+#elif defined(__has_include) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SDS_PROBE(name, sequence, slot, workerId) DTRACE_PROBE3(sds, name, sequence, slot, workerId)
+#elif defined(__x86_64__)
+#include "usdt.h"
+#define SDS_PROBE(name, sequence, slot, workerId) USDT_PROBE3(sds, name, sequence, slot, workerId)
+#else
+#error "The probes need sys/sdt.h (systemtap-sdt-dev) on this platform; build with -DSDS_NO_PROBES to go without."
+#endif
+
+#endif /* ifndef PROBES_H */
@@ -1,137 +1,1310 @@
+/* For gettid(). */
+#define _GNU_SOURCE
+
 #include "reader.h"
 
 /*
- * Reader process callback.
+ * Increment the number of readers currently reading. Since multiple readers may perform this
+ * simultaneously, it must be constrained by a mutex lock. If a writer holds the buffer, then wait for it
+ * to finish, giving up the mutex lock while waiting. This also ensures that writers do not attempt to
+ * write while the buffer is being read from.
  *
- * Reads all items from a buffer, or waits if the buffer doesn't have anything to read.
+ * The reader's state records that it is counted in the same step, so that the count can be corrected if
+ * it dies.
  */
-void reader()
+static void startReading(RWConfig *rwConfig, ReaderState *state)
 {
-    int sCode = 0, status, *data, reads = 0, *cache = NULL, idx = 0, value, *pendingReads;
+    lockMutex(&rwConfig->rcMutex);
+    while (rwConfig->rwWriter)
+    {
+        /* Wait for the writer to finish. */
+        rwConfig->rwWaiters++;
+        pthread_mutex_unlock(&rwConfig->rcMutex);
+        sem_wait(&rwConfig->rwCond);
+        lockMutex(&rwConfig->rcMutex);
+    }
+    rwConfig->activeReaders++;
+    state->reading = true;
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+}
 
-    /* Open shared memory to the shared semaphore states. */
-    RWConfig *rwConfig = (RWConfig *)openSharedMemory(SHARED_CONFIG_NAME, SHARED_CONFIG_SIZE);
+/*
+ * Decrement the number of readers currently reading. Since multiple readers may perform this
+ * simultaneously, we must first request a mutex lock. If this reader is the final reader to read
+ * from the buffer, then wake any writers waiting for it, and hence enable them to write again.
+ */
+static void stopReading(RWConfig *rwConfig, ReaderState *state)
+{
+    lockMutex(&rwConfig->rcMutex);
+    state->reading = false;
+    rwConfig->activeReaders--;
+    if (!rwConfig->activeReaders)
+    {
+        wakeRwWaiters(rwConfig);
+    }
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+}
 
+/*
+ * Opens a reader process's view of a buffer, mapping each of the buffer's shared memory segments that
+ * readers use. The process counts itself among the active readers through each reader's own position
+ * until a leader is set.
+ */
+static void openLocalBuffer(RWConfig *rwConfig, LocalBuffer *local)
+{
     /* Open shared memory to the data_buffer. */
-    data = (int *)openSharedMemory(SHARED_FILE_BUFFER_NAME, SHM_BUFFER_SIZE);
+    local->data = (int *)openSharedMemory(SHARED_FILE_BUFFER_NAME, SHARED_FILE_BUFFER_SIZE(rwConfig));
+
+    /* Open shared memory to the arena, if the items' payloads are kept in one. */
+    local->arena = rwConfig->arena.size ? (char *)openSharedMemory(ARENA_NAME, rwConfig->arena.size) : NULL;
+
+    /* Open shared memory to the block summaries, if any reader filters. */
+    local->summaries = rwConfig->pConfig.filterCount ? (BlockSummary *)openSharedMemory(BLOCK_SUMMARY_NAME,
+        BLOCK_SUMMARY_COUNT(rwConfig) * sizeof(BlockSummary)) : NULL;
+
+    /* Open shared memory to the range checksums, if readers verify what they read. */
+    local->checksums = rwConfig->pConfig.verify ? (RangeChecksum *)openSharedMemory(RANGE_CHECKSUM_NAME,
+        CHECKSUM_RANGES * sizeof(RangeChecksum)) : NULL;
 
     /* Open shared memory to the pending reads - number of reads for each buffer slot. */
-    pendingReads = (int *)openSharedMemory(PENDING_READS_NAME, SHM_BUFFER_SIZE);
+    local->pendingReads = (int *)openSharedMemory(PENDING_READS_NAME, rwConfig->ring.slots * sizeof(int));
+
+    /* Open shared memory to the slot sequence numbers - which item each buffer slot holds. */
+    local->sequence = (int *)openSharedMemory(SLOT_SEQUENCE_NAME, rwConfig->ring.slots * sizeof(int));
+
+    /* Open shared memory to the slot stamps - who published each item, and when. */
+    local->writerIds = (int *)openSharedMemory(SLOT_WRITER_NAME, rwConfig->ring.slots * sizeof(int));
+    local->publishTimes = (long long *)openSharedMemory(SLOT_TIME_NAME,
+        rwConfig->ring.slots * sizeof(long long));
+
+    /* Open shared memory to the reader positions - used to find what every reader has read. */
+    local->readerStates = (ReaderState *)openSharedMemory(READER_STATE_NAME,
+        READER_STATE_SIZE(rwConfig->pConfig));
+
+    local->leader = NULL;
+    local->localReaders = 0;
+    pthread_mutex_init(&local->gateMutex, NULL);
+}
 
-    /* The cache stores the value that we saw at this position last time it was read. If we encounter a
-     * value that hasn't changed, then we should not read it but instead wait for writers to write.
-     * This is used to work around the possibility that a single reader attempts to read more than one
-     * set of values from the buffer before the writer can replace them. */
-    cache = (int *)malloc(SHM_BUFFER_SIZE * sizeof(int));
+/*
+ * Counts a reader of this process as reading. Only the first of a process's reader threads to start
+ * reading counts the process among the active readers, through its leader's position; the rest find it
+ * already counted.
+ */
+static void startLocalReading(RWConfig *rwConfig, LocalBuffer *local, ReaderState *state)
+{
+    if (local->leader == NULL)
+    {
+        startReading(rwConfig, state);
+        return;
+    }
 
-    /* Initialize the cache entries to -2. */
-    initializeDefaultValueArray(cache, SHM_BUFFER_SIZE, -2);
+    pthread_mutex_lock(&local->gateMutex);
+    if (!local->localReaders)
+    {
+        startReading(rwConfig, local->leader);
+    }
+    local->localReaders++;
+    pthread_mutex_unlock(&local->gateMutex);
+}
 
-    while (reads < NUM_ELEMENTS_DATA_FILE)
+/*
+ * Counts a reader of this process as no longer reading. The last of a process's reader threads to stop
+ * takes the process out of the active readers again.
+ */
+static void stopLocalReading(RWConfig *rwConfig, LocalBuffer *local, ReaderState *state)
+{
+    if (local->leader == NULL)
     {
-        /* Ensure that we aren't reading the same data. If we are, then the writers have not yet
-         * written to this slot. Wait until a writer does before continuing.
+        stopReading(rwConfig, state);
+        return;
+    }
+
+    pthread_mutex_lock(&local->gateMutex);
+    local->localReaders--;
+    if (!local->localReaders)
+    {
+        stopReading(rwConfig, local->leader);
+    }
+    pthread_mutex_unlock(&local->gateMutex);
+}
+
+/*
+ * Returns true if the reader must skip ahead or stop rather than wait for the item it is up to: a writer
+ * has released it for falling behind, or, in overwrite mode, a writer has overwritten the item before it
+ * was read. A reader that was overwritten is moved to the newest item.
+ *
+ * Must be called with rwConfig->rpMutex held.
+ */
+static bool readerSkipped(RWConfig *rwConfig, ReaderState *state, int *sequence, int reads, int idx)
+{
+    if (rwConfig->pConfig.overwrite && sequence[idx] > reads)
+    {
+        state->cursor = rwConfig->writes - 1;
+    }
+
+    return state->detached || state->cursor != reads;
+}
+
+/*
+ * Skips the items of its block a filtering reader is up to, reads, if the block's summary shows that none
+ * of the items published so far passes the reader's filter. The reader gives up its claim on each slot it
+ * skips without reading it. The sum of the hashes of the items of the block up to the one skipped to is
+ * stored in blockHash, for a verifying reader to check the items it skips by.
+ *
+ * Returns the sequence number of the item the reader skipped to, or reads if it skipped nothing.
+ */
+static int skipFilteredItems(RWConfig *rwConfig, LocalBuffer *local, ReaderState *state, ReaderFilter *filter,
+    int reads, unsigned long long *blockHash)
+{
+    int block = reads / FILTER_BLOCK_ITEMS, skipTo, i;
+    bool skip;
+    BlockSummary *summary = &local->summaries[block % BLOCK_SUMMARY_COUNT(rwConfig)];
+
+    lockMutex(&rwConfig->rpMutex);
+    skipTo = filterSkipsTo(filter, summary, block);
+    *blockHash = summary->hash;
+    skip = !state->detached && state->cursor == reads && skipTo > reads;
+
+    /* Every item skipped must still be in its slot: not moved to the spill file, nor overwritten. */
+    for (i = reads; i < skipTo && skip; i++)
+    {
+        skip = !spillHolds(&rwConfig->spill, i) && local->sequence[ringSlot(&rwConfig->ring, i)] == i;
+    }
+    for (i = reads; i < skipTo && skip; i++)
+    {
+        local->pendingReads[ringSlot(&rwConfig->ring, i)]--;
+    }
+    if (skip)
+    {
+        state->cursor = skipTo;
+    }
+    pthread_mutex_unlock(&rwConfig->rpMutex);
+
+    if (!skip)
+    {
+        return reads;
+    }
+
+    /* Wake up any writers waiting for the slots we gave up. */
+    lockMutex(&rwConfig->fullWaitersMutex);
+    while (rwConfig->fullWaiters > 0)
+    {
+        sem_post(&rwConfig->fullCond);
+        rwConfig->fullWaiters--;
+    }
+    pthread_mutex_unlock(&rwConfig->fullWaitersMutex);
+
+    return skipTo;
+}
+
+/*
+ * Reads all items from a buffer, from the one the reader is up to, or waits if the buffer doesn't have
+ * anything to read. Each item is forwarded to the sink and, if journal is not NULL, appended to the
+ * journal. If latency is not NULL, the time each item spent in the buffer is recorded in it. Progress and
+ * waits are published to stats, and traced as reader id.
+ *
+ * The reader's position is kept in state, through which writers may release the reader for falling
+ * behind, and through which it may be detached on request. A detached reader stops; a reader made to catch up, or that was overwritten, skips to the item
+ * it was moved to. The buffer is read through the reader process's view of it, local. A reader that has fallen behind items moved to the spill file reads them from there.
+ *
+ * If aggregate is not NULL, the reader's operators are run over each value read, and their results kept
+ * in it. If subscription is not NULL, only the values that pass its filter are forwarded or aggregated,
+ * and the items of a block that none of them pass are skipped without being read. If verifier is not
+ * NULL, every item read or skipped is checked against what the writers published, and the check is
+ * finished once the reader stops.
+ *
+ * Returns the number of items read.
+ */
+static int readStream(RWConfig *rwConfig, LocalBuffer *local, int id, ReaderState *state, OutputSink *sink,
+    Journal *journal, Histogram *latency, WorkerStats *stats, Aggregate *aggregate, Subscription *subscription,
+    StreamVerifier *verifier)
+{
+    int *data, first = state->cursor, reads = first, idx = 0, value, *pendingReads, *sequence, *writerIds, lost = 0,
+        skipTo, writerId, *item, itemFields = rwConfig->pConfig.itemFields, stride = itemStride(itemFields),
+        fields[MAX_ITEM_FIELDS];
+    long long *publishTimes, waitStart, publishTime;
+    unsigned long long blockHash;
+    ArenaDescriptor *descriptor;
+    char *payload = NULL;
+    bool done = false, released, spilled, passes, overwrite = rwConfig->pConfig.overwrite, overwritten;
+    ReaderState *readerStates;
+    SpillRecord record;
+
+    data = local->data;
+    pendingReads = local->pendingReads;
+    sequence = local->sequence;
+    writerIds = local->writerIds;
+    publishTimes = local->publishTimes;
+    readerStates = local->readerStates;
+
+    while (!done)
+    {
+        /* A filtering reader skips what has been published of its block if none of it passes. */
+        if (subscription != NULL && (skipTo = skipFilteredItems(rwConfig, local, state, subscription->filter,
+            reads, &blockHash)) > reads)
+        {
+            if (rwConfig->pConfig.trace)
+            {
+                printf("Reader %d skipped items #%d to #%d, none of which pass its filter.\n", id, reads,
+                    skipTo - 1);
+            }
+            subscription->filtered += skipTo - reads;
+            subscription->skipped += skipTo - reads;
+            if (verifier != NULL && skipItems(verifier, reads, skipTo, blockHash))
+            {
+                lockMutex(&rwConfig->rpMutex);
+                checkRange(verifier, local->checksums);
+                pthread_mutex_unlock(&rwConfig->rpMutex);
+            }
+            reads = skipTo;
+            STATS_STORE(stats->items, reads - first - lost);
+            STATS_STORE(stats->cursor, reads);
+            STATS_STORE(stats->lag, STATS_LOAD(rwConfig->writes) - reads);
+            continue;
+        }
+
+        /* Ensure that we aren't reading the same data. The item we want next has sequence number reads;
+         * if the slot holds any other sequence, the writers have not yet written to this slot. Wait until
+         * a writer does before continuing. This is used to work around the possibility that a single
+         * reader attempts to read more than one set of values from the buffer before the writer can
+         * replace them.
          *
-         * We could also be checking if the number of pending readers isn't 0, but it's guaranteed not to be 0
+         * Stop once the writers have reported end-of-stream and we have read every item they wrote.
+         *
+         * Also stop waiting if we must skip ahead, or if the item has been moved to the spill file.
          */
-        sem_wait(&rwConfig->rpSem);
-        while (cache[idx] == data[idx] || !pendingReads[idx])
+        waitStart = 0;
+        spilled = false;
+        lockMutex(&rwConfig->rpMutex);
+        idx = ringSlot(&rwConfig->ring, reads);
+        while (!(released = readerSkipped(rwConfig, state, sequence, reads, idx)) &&
+            !(spilled = spillHolds(&rwConfig->spill, reads)) && sequence[idx] != reads &&
+            !(rwConfig->eof && reads >= rwConfig->writes))
         {
             /*
-             * Repeatedly unlock the pending reads semaphore until we are certain that we can continue.
-             *
-             * That is, wait until there exists new data in data[idx].
+             * We have reached the end of the span of slots available to us. This is the point to write
+             * out anything buffered for the sink, rather than once per item. Release the mutex while
+             * doing so, so that writers are not held up by the sink, and check again afterwards.
              */
-            sem_post(&rwConfig->rpSem);
+            if (sinkHasPending(sink))
+            {
+                pthread_mutex_unlock(&rwConfig->rpMutex);
+                flushOutputSink(sink);
+                lockMutex(&rwConfig->rpMutex);
+                idx = ringSlot(&rwConfig->ring, reads);
+                continue;
+            }
 
             /*
              * Ensure that no other processes can change emptyWaiters while we are attempting to increment it.
              *
              * We need this to ensure writers sem_post emptyCond often enough to allow all readers a chance to
-             * check. Otherwise, we may eventually run out of writers to write.
+             * check. Otherwise, we may eventually run out of writers to write. We count ourselves as a
+             * waiter before releasing the pending reads mutex, so that a writer that publishes after we
+             * checked is guaranteed to see us and wake us.
              *
-             * After incrementing, put the process to sleep until awoken by a reader's sem_post.
+             * Then repeatedly unlock the pending reads mutex until we are certain that we can continue.
+             * That is, wait until there exists new data in data[idx].
+             *
+             * After releasing, put the process to sleep until awoken by a writer's sem_post.
              */
-            sem_wait(&rwConfig->emptyWaitersSem);
+            lockMutex(&rwConfig->emptyWaitersMutex);
             rwConfig->emptyWaiters++;
-            sem_post(&rwConfig->emptyWaitersSem);
+            pthread_mutex_unlock(&rwConfig->emptyWaitersMutex);
+            pthread_mutex_unlock(&rwConfig->rpMutex);
+            if (!waitStart)
+            {
+                waitStart = readClockNs();
+                STATS_STORE(stats->waits, stats->waits + 1);
+                SDS_PROBE(reader_wait_begin, reads, idx, id);
+            }
             sem_wait(&rwConfig->emptyCond);
+            STATS_STORE(stats->wakeups, stats->wakeups + 1);
 
-            sem_wait(&rwConfig->rpSem);
+            /* A writer may have begun a new generation of the buffer, in which the item is to go. */
+            lockMutex(&rwConfig->rpMutex);
+            idx = ringSlot(&rwConfig->ring, reads);
         }
-        sem_post(&rwConfig->rpSem);
+        done = released ? state->detached : !spilled && sequence[idx] != reads;
+        skipTo = released ? state->cursor : reads;
 
         /*
-         * Increment the number of readers currently reading. Since multiple readers may perform this
-         * simultaneously, it must be constrained by a mutex lock. If this reader happens to be the first
-         * reader to increment the count, then wait for the writer to finish by requesting the rwMutex.
-         * This also ensures that writers do not attempt to write while the buffer is being read from.
+         * A spilled item is copied out while we hold the mutex, since writers append to the spill file
+         * and release its space under it. Once we pass the end of a segment, or of everything spilled,
+         * release whatever every reader has now read.
          */
-        sem_wait(&rwConfig->rcSem);
-        if (!rwConfig->activeReaders)
+        if (spilled)
+        {
+            record = *readSpillRecord(&rwConfig->spill, reads);
+            state->cursor = reads + 1;
+            if ((reads + 1 - rwConfig->spill.base) % SPILL_SEGMENT_RECORDS == 0 ||
+                reads + 1 == rwConfig->spill.end)
+            {
+                reclaimSpill(&rwConfig->spill, oldestUnread(rwConfig, readerStates));
+            }
+        }
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+
+        if (waitStart)
+        {
+            STATS_STORE(stats->waitNs, stats->waitNs + readClockNs() - waitStart);
+            SDS_PROBE(reader_wait_end, reads, idx, id);
+        }
+
+        if (released)
+        {
+            /*
+             * A writer found us holding up its slot after falling too far behind and gave up our claim on
+             * every item we had not read, or, in overwrite mode, the writers lapped us. If we have been
+             * detached we must stop; otherwise we pick up from the item we were moved to.
+             */
+            if (done && state->dismissed)
+            {
+                printf("Reader %d was detached on request before item #%d.\n", id, reads);
+            }
+            else if (done)
+            {
+                printf("Error: Reader %d fell behind and was detached, losing every item from #%d.\n", id,
+                    reads);
+            }
+            else if (rwConfig->pConfig.overwrite)
+            {
+                printf("Reader %d was lapped by the writers and skipped items #%d to #%d.\n", id, reads,
+                    skipTo - 1);
+            }
+            else
+            {
+                printf("Error: Reader %d fell behind and lost items #%d to #%d.\n", id, reads, skipTo - 1);
+            }
+
+            if (!done && verifier != NULL)
+            {
+                missItems(verifier, reads, skipTo);
+            }
+            if (!done)
+            {
+                lost += skipTo - reads;
+                reads = skipTo;
+                STATS_STORE(stats->lost, lost);
+                STATS_STORE(stats->cursor, reads);
+            }
+            continue;
+        }
+
+        if (done)
         {
-            /* Wait for any writers to finish. */
-            sem_wait(&rwConfig->rwSem);
+            break;
         }
-        rwConfig->activeReaders++;
-        sem_post(&rwConfig->rcSem);
 
-        value = data[idx];
+        if (spilled)
+        {
+            value = record.value;
+            item = &value;
+            writerId = record.writerId;
+            publishTime = record.publishTime;
+        }
+        else if (overwrite)
+        {
+            /*
+             * In overwrite mode, writers never wait for readers, and readers do not hold them off: the item
+             * is copied out, then checked to still be in its slot, as with a seqlock. A writer marks the
+             * slot SEQUENCE_WRITING before overwriting it, so a copy it tore is never taken for the item.
+             * If the item was overwritten, go back and skip ahead. Otherwise our claim on it is given up as
+             * it is checked, as it is read from the copy.
+             */
+            memcpy(fields, &data[idx * stride], itemFields * sizeof(int));
+            writerId = writerIds[idx];
+            publishTime = publishTimes[idx];
+
+            lockMutex(&rwConfig->rpMutex);
+            overwritten = sequence[idx] != reads;
+            if (!overwritten && !state->detached && state->cursor == reads)
+            {
+                pendingReads[idx]--;
+                state->cursor = reads + 1;
+            }
+            pthread_mutex_unlock(&rwConfig->rpMutex);
+
+            if (overwritten)
+            {
+                continue;
+            }
+            item = fields;
+            value = *item;
+        }
+        else
+        {
+            /* Make room in the sink for the item before we start reading, so that a full buffer is written
+             * out while the writers can still write. A payload's length is taken from its descriptor, which
+             * is ours as the slot is; should a writer reuse the slot first, the item is not read anyway. */
+            reserveSinkSpace(sink, local->arena != NULL ? ((ArenaDescriptor *)data)[idx].length + 1 :
+                itemFields * SINK_ITEM_MAX_BYTES);
+            startLocalReading(rwConfig, local, state);
+
+            /* With a spill file, a writer may have moved the item there after we checked for it, and
+             * before we started reading. Go back and read it from there. */
+            if (sequence[idx] != reads)
+            {
+                stopLocalReading(rwConfig, local, state);
+                continue;
+            }
+
+            /* The item is read in place: the slot is ours until we give up our claim on it below. So is an
+             * item's payload in the arena, which writers only reuse once every claim before it is given up.
+             * Its value is its length. */
+            if (local->arena != NULL)
+            {
+                descriptor = &((ArenaDescriptor *)data)[idx];
+                payload = local->arena + descriptor->position % rwConfig->arena.size;
+                value = descriptor->length;
+                item = &value;
+            }
+            else
+            {
+                item = &data[idx * stride];
+                value = *item;
+            }
+            writerId = writerIds[idx];
+            publishTime = publishTimes[idx];
+        }
+
+        if (latency != NULL)
+        {
+            recordHistogramValue(latency, readClockNs() - publishTime);
+        }
+        if (journal != NULL)
+        {
+            appendJournalRecord(journal, reads, writerId, publishTime, value);
+        }
+
+        /* Every item read is checked, whether or not it passes the reader's filter, a payload as the bytes
+         * forwarded. Once the last item of a range is read, the writers have published every item of it,
+         * and its checksum is compared. */
+        if (verifier != NULL && (payload != NULL ? verifyItem(verifier, reads, payload, value) :
+            verifyItem(verifier, reads, item, itemFields * sizeof(int))))
+        {
+            lockMutex(&rwConfig->rpMutex);
+            checkRange(verifier, local->checksums);
+            pthread_mutex_unlock(&rwConfig->rpMutex);
+        }
+
+        /* An item that does not pass the reader's filter is still read, and our claim on it given up, but
+         * it goes no further. */
+        passes = subscription == NULL || filterPasses(subscription->filter, value);
+        if (!passes)
+        {
+            subscription->filtered++;
+        }
+        else if (aggregate != NULL)
+        {
+            aggregateValue(aggregate, value);
+        }
+        SDS_PROBE(consume, reads, idx, id);
         reads++;
-        printf("Read value #%d/%d (%d) from data buffer index %d.\n", reads, NUM_ELEMENTS_DATA_FILE,
-            value, idx);
+        STATS_STORE(stats->items, reads - first - lost);
+        STATS_STORE(stats->cursor, reads);
+        STATS_STORE(stats->lag, STATS_LOAD(rwConfig->writes) - reads);
+        if (rwConfig->pConfig.trace && spilled)
+        {
+            printf("Read value #%d (%d) from the spill file.\n", reads, value);
+        }
+        else if (rwConfig->pConfig.trace)
+        {
+            printf("Read value #%d (%d) from data buffer index %d.\n", reads, value, idx);
+        }
+        if (passes && payload != NULL)
+        {
+            writeSinkBytes(sink, payload, value);
+        }
+        else if (passes && itemFields == 1)
+        {
+            writeSinkItem(sink, value);
+        }
+        else if (passes)
+        {
+            writeSinkRecord(sink, item, itemFields);
+        }
 
-        
-        /*
-         * Assign the value to cache so that we can detect full cycles.
-         */
-        cache[idx] = value;
+        if (!spilled && !overwrite)
+        {
+            /* Request a mutex lock to avoid synchronisation issues of pending read counts. If a writer
+             * released us while we were reading, it has already given up our claim on this slot. If a
+             * writer moved the item to the spill file while we were reading, the slot holds no claims. */
+            lockMutex(&rwConfig->rpMutex);
+            if (!state->detached && state->cursor == reads - 1)
+            {
+                if (sequence[idx] == reads - 1)
+                {
+                    pendingReads[idx]--;
+                }
+                state->cursor = reads;
+            }
+            pthread_mutex_unlock(&rwConfig->rpMutex);
 
-        /* Request a mutex lock to avoid synchronisation issues of pending read counts. */
-        sem_wait(&rwConfig->rpSem);
-        pendingReads[idx]--;
-        sem_post(&rwConfig->rpSem);
+            stopLocalReading(rwConfig, local, state);
 
-        idx = (idx + 1) % SHM_BUFFER_SIZE;
+            /*
+             * Wake up any writers that went to sleep because there were no empty buffers to write to.
+             *
+             * This relies on the fullWaiters being synchronised correctly. As such, we need a mutex
+             * to provide mutual exclusion.
+             */
+            lockMutex(&rwConfig->fullWaitersMutex);
+            while (rwConfig->fullWaiters > 0)
+            {
+                sem_post(&rwConfig->fullCond);
+                rwConfig->fullWaiters--;
+            }
+            pthread_mutex_unlock(&rwConfig->fullWaitersMutex);
+        }
 
         /*
-         * Decrement the number of readers currently reading. Since multiple readers may perform this
-         * simultaneously, we must first request a mutex lock. If this reader is the final reader to read
-         * from the buffer, then unlock the write mutex and hence enable writers to write again.
+         * All this reading has made me tired. Time for a well-earned nap.
          */
-        sem_wait(&rwConfig->rcSem);
-        rwConfig->activeReaders--;
-        if (!rwConfig->activeReaders)
+        sleep(rwConfig->pConfig.readerSleepTime);
+    }
+
+    SDS_PROBE(reader_exit, reads - first - lost, idx, id);
+
+    /* The writers have published the whole stream by now, unless we were detached part way. */
+    if (verifier != NULL)
+    {
+        lockMutex(&rwConfig->rpMutex);
+        finishVerifier(verifier, local->checksums, &rwConfig->published, reads);
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+    }
+
+    return reads - first - lost;
+}
+
+/*
+ * Readies the subscription of the reader numbered reader, if it filters what it reads.
+ *
+ * Returns subscription, or NULL if the reader has no filter.
+ */
+static Subscription *openSubscription(RWConfig *rwConfig, int reader, Subscription *subscription)
+{
+    subscription->filter = findReaderFilter(rwConfig->pConfig.filters, rwConfig->pConfig.filterCount, reader);
+    subscription->filtered = 0;
+    subscription->skipped = 0;
+
+    return subscription->filter != NULL ? subscription : NULL;
+}
+
+/*
+ * Runs a reader's operators over the last of the values it read, and reports their results as those of
+ * reader id.
+ */
+static void reportAggregate(int id, Aggregate *aggregate)
+{
+    char report[AGGREGATE_REPORT_SIZE];
+
+    flushAggregate(aggregate);
+    formatAggregate(aggregate, report, sizeof(report));
+    printf("Reader %d aggregated %lld values: %s\n", id, aggregate->items, report);
+    simWriteAggregate("reader", id, aggregate);
+}
+
+/*
+ * Reports whether the stream a reader read matches the one published, as that of the given type of
+ * reader, numbered id, once its check is finished. Items the writers read from the source but died before
+ * publishing are missing from both, so they are reported as well.
+ */
+static void reportVerification(RWConfig *rwConfig, char *type, int id, StreamVerifier *verifier)
+{
+    char report[VERIFICATION_REPORT_SIZE];
+
+    formatVerification(verifier, report, sizeof(report));
+    if (verifierDiverged(verifier))
+    {
+        printf("Error: %s %d read a stream that diverged from the one published: %s\n",
+            !strcmp(type, "relay") ? "Relay" : "Reader", id, report);
+    }
+    else
+    {
+        printf("%s %d verified the stream it read: %s\n", !strcmp(type, "relay") ? "Relay" : "Reader", id, report);
+    }
+    if (rwConfig->lostWrites)
+    {
+        printf("Error: %s %d read a stream missing %d items that writers read from the source but died before "
+            "publishing.\n", !strcmp(type, "relay") ? "Relay" : "Reader", id, rwConfig->lostWrites);
+    }
+    simWriteVerification(type, id, verifier);
+}
+
+/*
+ * Reader thread callback.
+ *
+ * Reads all items from a buffer as one of the readers a reader process hosts, forwarding them to the
+ * reader's output sink, or down the pipe to the buffer of the relay the process is.
+ */
+static void *readerThread(void *vpThread)
+{
+    ReaderThread *thread = (ReaderThread *)vpThread;
+    RWConfig *rwConfig = thread->rwConfig;
+    OutputSink sink;
+    Aggregate aggregate;
+    Subscription subscription, *filtering = NULL;
+    StreamVerifier verifier;
+
+    if (keptRelayPipe() >= 0)
+    {
+        attachOutputSink(&sink, keptRelayPipe());
+    }
+    else if (openOutputSink(&sink, thread->sinkName, rwConfig->pConfig.sinkBase + thread->id))
+    {
+        printf("Error: Could not open output sink for reader %d.\n", rwConfig->pConfig.sinkBase + thread->id);
+    }
+
+    /* Relays leave the operators and filters to the readers they serve, though they verify what they read
+     * as readers do. */
+    initializeAggregate(&aggregate, &rwConfig->pConfig.aggregate);
+    if (keptRelayPipe() < 0)
+    {
+        filtering = openSubscription(rwConfig, rwConfig->pConfig.sinkBase + thread->id, &subscription);
+    }
+    openVerifier(&verifier, selectChecksumKernel(), 0);
+    thread->reads = readStream(rwConfig, thread->local, thread->id,
+        &thread->local->readerStates[thread->id], &sink, NULL, thread->latency, thread->stats,
+        rwConfig->pConfig.aggregate.count && keptRelayPipe() < 0 ? &aggregate : NULL, filtering,
+        rwConfig->pConfig.verify ? &verifier : NULL);
+
+    /*
+     * Save the write count to file. A process hosting several readers reports each by its thread.
+     */
+    simWriteFinish(keptRelayPipe() >= 0 ? "relay" : "reader", "reading", "from", gettid(), thread->reads);
+    if (filtering != NULL)
+    {
+        printf("Reader %d filtered out %d of %d items, skipping %d of them unread.\n",
+            rwConfig->pConfig.sinkBase + thread->id, subscription.filtered, thread->reads, subscription.skipped);
+    }
+    if (rwConfig->pConfig.aggregate.count && keptRelayPipe() < 0)
+    {
+        reportAggregate(rwConfig->pConfig.sinkBase + thread->id, &aggregate);
+    }
+    if (rwConfig->pConfig.verify)
+    {
+        reportVerification(rwConfig, keptRelayPipe() >= 0 ? "relay" : "reader",
+            keptRelayPipe() >= 0 ? thread->id : rwConfig->pConfig.sinkBase + thread->id, &verifier);
+    }
+
+    closeOutputSink(&sink);
+
+    return NULL;
+}
+
+/*
+ * Reader process callback.
+ *
+ * Reads all items from a buffer, forwarding them to this reader's output sink. The readers of a stream
+ * that fans out are its relays, which forward the stream down the pipe they were forked with instead, a
+ * span of items at a time, to be published again to their own buffers.
+ *
+ * With --threads M, the process hosts the next M readers as threads of its own, sharing its mappings of
+ * the buffer and counting among the active readers once for all of them. A relay hosts only itself.
+ */
+void reader()
+{
+    int sCode = 0, first, count, i;
+    LocalBuffer local;
+    ReaderThread *threads;
+    Histogram *latencies;
+    StatsRegion *stats;
+
+    /* Open shared memory to the shared semaphore states. */
+    RWConfig *rwConfig = (RWConfig *)openSharedMemory(SHARED_CONFIG_NAME, SHARED_CONFIG_SIZE);
+
+    /* Open shared memory to the reader latencies. Each reader only records into its own histogram, so no
+     * locking is needed. */
+    latencies = (Histogram *)openSharedMemory(READER_LATENCY_NAME,
+        rwConfig->pConfig.readerCount * sizeof(Histogram));
+
+    /* Open shared memory to the worker statistics. Each reader only stores to its own counters. */
+    stats = (StatsRegion *)openSharedMemory(WORKER_STATS_NAME,
+        statsRegionSize(rwConfig->pConfig.readerCount, rwConfig->pConfig.writerCount));
+
+    /* Open shared memory to the buffer and the reader positions, once for every reader this process hosts. */
+    openLocalBuffer(rwConfig, &local);
+
+    /* Take the next block of reader identifiers, recording this process against each so that the parent
+     * can release the readers' claims should it die. */
+    lockMutex(&rwConfig->rcMutex);
+    first = rwConfig->nextReaderId;
+    count = workerBlock(rwConfig->pConfig.readerCount,
+        keptRelayPipe() >= 0 ? 1 : rwConfig->pConfig.threadsPerProcess, first);
+    for (i = 0; i < count; i++)
+    {
+        local.readerStates[first + i].pid = getpid();
+    }
+    rwConfig->nextReaderId += count;
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+    if (count > 1)
+    {
+        local.leader = &local.readerStates[first];
+    }
+
+    threads = (ReaderThread *)malloc(count * sizeof(ReaderThread));
+    for (i = 0; i < count; i++)
+    {
+        threads[i].rwConfig = rwConfig;
+        threads[i].local = &local;
+        threads[i].id = first + i;
+        threads[i].latency = &latencies[first + i];
+        threads[i].stats = readerStats(stats, first + i);
+        threads[i].sinkName = rwConfig->pConfig.sinkName;
+    }
+
+    /* A process hosting a single reader reads on its own thread. */
+    if (count == 1)
+    {
+        readerThread(&threads[0]);
+    }
+    else
+    {
+        for (i = 0; i < count; i++)
+        {
+            pthread_create(&threads[i].thread, NULL, &readerThread, &threads[i]);
+        }
+        for (i = 0; i < count; i++)
         {
-            sem_post(&rwConfig->rwSem);
+            pthread_join(threads[i].thread, NULL);
         }
-        sem_post(&rwConfig->rcSem);
+    }
+    free(threads);
+
+    exit(sCode);
+}
+
+/*
+ * Pool reader process callback.
+ *
+ * Maps the buffer and takes a reader identifier once, then reads the stream of every job the daemon hands
+ * it that it takes part in, forwarding it to the job's output sink, until the daemon stops. It reports
+ * how many items it read in each job, none for a job it sat out.
+ */
+void poolReader()
+{
+    LocalBuffer local;
+    ReaderThread thread;
+    PoolJob job;
+    Histogram *latencies;
+    StatsRegion *stats;
+    RWConfig *rwConfig = (RWConfig *)openSharedMemory(SHARED_CONFIG_NAME, SHARED_CONFIG_SIZE);
+
+    latencies = (Histogram *)openSharedMemory(READER_LATENCY_NAME,
+        rwConfig->pConfig.readerCount * sizeof(Histogram));
+    stats = (StatsRegion *)openSharedMemory(WORKER_STATS_NAME,
+        statsRegionSize(rwConfig->pConfig.readerCount, rwConfig->pConfig.writerCount));
+    openLocalBuffer(rwConfig, &local);
+
+    /* Take a reader identifier for every job to come, recording this process against it so that the
+     * daemon can release the reader's claims should it die. */
+    lockMutex(&rwConfig->rcMutex);
+    thread.id = rwConfig->nextReaderId++;
+    local.readerStates[thread.id].pid = getpid();
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+
+    thread.rwConfig = rwConfig;
+    thread.local = &local;
+    thread.latency = &latencies[thread.id];
+    thread.stats = readerStats(stats, thread.id);
+
+    while (awaitPoolJob(&job, -1))
+    {
+        thread.reads = 0;
+        if (thread.id < job.readers)
+        {
+            thread.sinkName = job.sinkName[0] ? job.sinkName : NULL;
+            readerThread(&thread);
+        }
+        finishPoolJob(thread.reads);
+    }
 
+    exit(0);
+}
+
+/*
+ * Journal reader process callback.
+ *
+ * Reads all items from a buffer like any other reader, recording each with its sequence number, writer
+ * and publish time in the journal named on the command line.
+ */
+void journalReader()
+{
+    int sCode = 0, reads;
+    OutputSink sink;
+    Journal journal;
+    LocalBuffer local;
+
+    /* The journal reader is not one of the readers in the statistics region. Its counters are private. */
+    WorkerStats stats = { 0 };
+
+    /* Open shared memory to the shared semaphore states. */
+    RWConfig *rwConfig = (RWConfig *)openSharedMemory(SHARED_CONFIG_NAME, SHARED_CONFIG_SIZE);
+
+    /* Open shared memory to the buffer and the reader positions. The journal reader's position follows
+     * every reader's. */
+    openLocalBuffer(rwConfig, &local);
+
+    /* The journal reader has no output sink. It must still read every item, even if the journal could
+     * not be created, because writers wait for it. */
+    openOutputSink(&sink, NULL, 0);
+    if (openJournal(&journal, rwConfig->pConfig.journalName))
+    {
+        printf("Error: Could not create journal %s.\n", rwConfig->pConfig.journalName);
+    }
+
+    /* Record this process against the journal reader's position, as readers do. */
+    local.readerStates[rwConfig->pConfig.readerCount].pid = getpid();
+
+    reads = readStream(rwConfig, &local, JOURNAL_READER_ID, &local.readerStates[rwConfig->pConfig.readerCount],
+        &sink, &journal, NULL, &stats, NULL, NULL, NULL);
+
+    simWriteFinish("journal", "recording", "from", getpid(), reads);
+
+    closeJournal(&journal);
+
+    exit(sCode);
+}
+
+/*
+ * Consumes items on behalf of a consumer group, or waits if the group has claimed every item published.
+ * Each item the member claims is forwarded to the sink; the group's other members never see it. Progress
+ * and waits are published to stats, and traced as reader id.
+ *
+ * The member's claim is kept in state while it reads the item, so that the item is not released from the
+ * spill file under it. In overwrite mode, a group that was lapped skips to the newest item.
+ *
+ * Returns the number of items consumed by this member.
+ */
+static int consumeGroup(RWConfig *rwConfig, int id, GroupState *group, ReaderState *state, OutputSink *sink,
+    WorkerStats *stats)
+{
+    int *data, consumed = 0, claimed, idx, value, *pendingReads, *sequence, itemFields = rwConfig->pConfig.itemFields,
+        stride = itemStride(itemFields), fields[MAX_ITEM_FIELDS];
+    long long waitStart;
+    bool done = false, spilled, overwritten;
+    ArenaDescriptor *descriptor;
+    char *arena = NULL, *payload = NULL;
+    ReaderState *readerStates;
+    SpillRecord record;
+
+    /* Open shared memory to the data_buffer, the pending reads and the slot sequence numbers. */
+    data = (int *)openSharedMemory(SHARED_FILE_BUFFER_NAME, SHARED_FILE_BUFFER_SIZE(rwConfig));
+    pendingReads = (int *)openSharedMemory(PENDING_READS_NAME, rwConfig->ring.slots * sizeof(int));
+    sequence = (int *)openSharedMemory(SLOT_SEQUENCE_NAME, rwConfig->ring.slots * sizeof(int));
+
+    /* Open shared memory to the reader positions - used to find what every reader has read. */
+    readerStates = (ReaderState *)openSharedMemory(READER_STATE_NAME, READER_STATE_SIZE(rwConfig->pConfig));
+
+    /* Open shared memory to the arena, and make room to copy a payload out of it. */
+    if (rwConfig->arena.size)
+    {
+        arena = (char *)openSharedMemory(ARENA_NAME, rwConfig->arena.size);
+        payload = (char *)malloc(SOURCE_BUFFER_SIZE);
+    }
+
+    while (!done)
+    {
         /*
-         * Wake up any writers that went to sleep because there were no empty buffers to write to.
+         * Wait until the item the group is up to has been published, or moved to the spill file, then
+         * claim it. Every waiting member is woken for the same item; the first to take the mutex
+         * claims it, and the rest wait for the next.
          *
-         * This relies on the fullWaiters being synchronised correctly. As such, we need a semaphore
-         * to provide mutual exclusion.
+         * Stop once the writers have reported end-of-stream and the group has claimed every item.
          */
-        sem_wait(&rwConfig->fullWaitersSem);
-        while (rwConfig->fullWaiters > 0)
+        waitStart = 0;
+        lockMutex(&rwConfig->rpMutex);
+        idx = ringSlot(&rwConfig->ring, group->cursor);
+        while (!(spilled = spillHolds(&rwConfig->spill, group->cursor)) && sequence[idx] != group->cursor &&
+            !(rwConfig->eof && group->cursor >= rwConfig->writes))
+        {
+            if (rwConfig->pConfig.overwrite && sequence[idx] > group->cursor)
+            {
+                if (rwConfig->pConfig.trace)
+                {
+                    printf("Member %d was lapped by the writers and skipped items #%d to #%d.\n", id,
+                        group->cursor, rwConfig->writes - 2);
+                }
+                group->lost += rwConfig->writes - 1 - group->cursor;
+                group->cursor = rwConfig->writes - 1;
+                idx = ringSlot(&rwConfig->ring, group->cursor);
+                continue;
+            }
+
+            /* Write out anything buffered for the sink before going to sleep, as readers do. */
+            if (sinkHasPending(sink))
+            {
+                pthread_mutex_unlock(&rwConfig->rpMutex);
+                flushOutputSink(sink);
+                lockMutex(&rwConfig->rpMutex);
+                idx = ringSlot(&rwConfig->ring, group->cursor);
+                continue;
+            }
+
+            /* Count ourselves as a waiter before releasing the pending reads mutex, as readers do. */
+            lockMutex(&rwConfig->emptyWaitersMutex);
+            rwConfig->emptyWaiters++;
+            pthread_mutex_unlock(&rwConfig->emptyWaitersMutex);
+            pthread_mutex_unlock(&rwConfig->rpMutex);
+            if (!waitStart)
+            {
+                waitStart = readClockNs();
+                STATS_STORE(stats->waits, stats->waits + 1);
+                SDS_PROBE(reader_wait_begin, group->cursor, idx, id);
+            }
+            sem_wait(&rwConfig->emptyCond);
+            STATS_STORE(stats->wakeups, stats->wakeups + 1);
+
+            lockMutex(&rwConfig->rpMutex);
+            idx = ringSlot(&rwConfig->ring, group->cursor);
+        }
+        claimed = group->cursor;
+        done = !spilled && sequence[idx] != claimed;
+        if (!done)
         {
-            sem_post(&rwConfig->fullCond);
-            rwConfig->fullWaiters--;
+            group->cursor++;
+            state->cursor = claimed;
+            state->detached = false;
         }
-        sem_post(&rwConfig->fullWaitersSem);
 
-        /*
-         * All this reading has made me tired. Time for a well-earned nap.
-         */
+        /* A spilled item is copied out while we hold the mutex, as readers do. */
+        if (spilled)
+        {
+            record = *readSpillRecord(&rwConfig->spill, claimed);
+            state->detached = true;
+            group->consumed++;
+            if ((claimed + 1 - rwConfig->spill.base) % SPILL_SEGMENT_RECORDS == 0 ||
+                claimed + 1 == rwConfig->spill.end)
+            {
+                reclaimSpill(&rwConfig->spill, oldestUnread(rwConfig, readerStates));
+            }
+        }
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+
+        if (waitStart)
+        {
+            STATS_STORE(stats->waitNs, stats->waitNs + readClockNs() - waitStart);
+            SDS_PROBE(reader_wait_end, claimed, idx, id);
+        }
+
+        if (done)
+        {
+            break;
+        }
+
+        if (!spilled)
+        {
+            /* In overwrite mode the item is copied out without holding off the writers, which mark a slot
+             * before overwriting it; the claim is checked below as it is given up, as readers do. */
+            if (!rwConfig->pConfig.overwrite)
+            {
+                startReading(rwConfig, state);
+            }
+
+            /* The group's claim is given up before the item is forwarded, so a larger item is copied out, as
+             * is a payload from the arena. */
+            if (arena != NULL)
+            {
+                descriptor = &((ArenaDescriptor *)data)[idx];
+                value = descriptor->length;
+                memcpy(payload, arena + descriptor->position % rwConfig->arena.size, value);
+            }
+            else
+            {
+                value = data[idx * stride];
+            }
+            if (itemFields > 1)
+            {
+                memcpy(fields, &data[idx * stride], itemFields * sizeof(int));
+            }
+
+            /* Give up the group's claim on the slot. A writer may have overwritten the item, or moved it to
+             * the spill file, after we claimed it and before we started reading; then the slot holds no
+             * claim, and the item is lost or read from the spill file instead. */
+            overwritten = false;
+            lockMutex(&rwConfig->rpMutex);
+            if (sequence[idx] == claimed)
+            {
+                pendingReads[idx]--;
+                group->consumed++;
+            }
+            else if (spillHolds(&rwConfig->spill, claimed))
+            {
+                value = readSpillRecord(&rwConfig->spill, claimed)->value;
+                spilled = true;
+                group->consumed++;
+            }
+            else
+            {
+                group->lost++;
+                overwritten = true;
+            }
+            state->detached = true;
+            pthread_mutex_unlock(&rwConfig->rpMutex);
+
+            if (!rwConfig->pConfig.overwrite)
+            {
+                stopReading(rwConfig, state);
+            }
+
+            /* Wake up any writers that went to sleep because there were no empty buffers to write to. */
+            lockMutex(&rwConfig->fullWaitersMutex);
+            while (rwConfig->fullWaiters > 0)
+            {
+                sem_post(&rwConfig->fullCond);
+                rwConfig->fullWaiters--;
+            }
+            pthread_mutex_unlock(&rwConfig->fullWaitersMutex);
+
+            if (overwritten)
+            {
+                if (rwConfig->pConfig.trace)
+                {
+                    printf("Member %d lost item #%d, which the writers overwrote.\n", id, claimed);
+                }
+                continue;
+            }
+        }
+        else
+        {
+            value = record.value;
+        }
+
+        if (rwConfig->pConfig.trace && spilled)
+        {
+            printf("Member %d consumed value #%d (%d) from the spill file.\n", id, claimed, value);
+        }
+        else if (rwConfig->pConfig.trace)
+        {
+            printf("Member %d consumed value #%d (%d) from data buffer index %d.\n", id, claimed, value, idx);
+        }
+        if (payload != NULL)
+        {
+            writeSinkBytes(sink, payload, value);
+        }
+        else if (itemFields == 1)
+        {
+            writeSinkItem(sink, value);
+        }
+        else
+        {
+            writeSinkRecord(sink, fields, itemFields);
+        }
+        SDS_PROBE(consume, claimed, idx, id);
+        consumed++;
+        STATS_STORE(stats->items, consumed);
+        STATS_STORE(stats->cursor, claimed + 1);
+
         sleep(rwConfig->pConfig.readerSleepTime);
     }
-    free(cache);
+
+    SDS_PROBE(reader_exit, consumed, idx, id);
+    free(payload);
+
+    return consumed;
+}
+
+/*
+ * Consumer group member process callback.
+ *
+ * Shares the items of the stream with the other members of its group, forwarding each item it consumes
+ * to its own output sink. Members are numbered after the readers.
+ */
+void groupMember()
+{
+    int sCode = 0, consumed, memberId, id;
+    OutputSink sink;
+    ReaderState *readerStates;
+
+    /* Members are not among the readers in the statistics region. Their counters are private. */
+    WorkerStats stats = { 0 };
+
+    /* Open shared memory to the shared semaphore states. */
+    RWConfig *rwConfig = (RWConfig *)openSharedMemory(SHARED_CONFIG_NAME, SHARED_CONFIG_SIZE);
+
+    /* Open shared memory to the reader positions. Each member's claim follows the journal reader's. */
+    readerStates = (ReaderState *)openSharedMemory(READER_STATE_NAME, READER_STATE_SIZE(rwConfig->pConfig));
+
+    /* Take the next member identifier, recording this process against it as readers do, and open this
+     * member's output sink. */
+    lockMutex(&rwConfig->rcMutex);
+    memberId = rwConfig->nextMemberId++;
+    readerStates[rwConfig->pConfig.readerCount + 1 + memberId].pid = getpid();
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+    id = rwConfig->pConfig.readerCount + memberId;
+    if (openOutputSink(&sink, rwConfig->pConfig.sinkName, rwConfig->pConfig.sinkBase + id))
+    {
+        printf("Error: Could not open output sink for member %d.\n", id);
+    }
+
+    consumed = consumeGroup(rwConfig, id, &rwConfig->groups[memberGroup(&rwConfig->pConfig, memberId)],
+        &readerStates[rwConfig->pConfig.readerCount + 1 + memberId], &sink, &stats);
+
+    simWriteFinish("member", "consuming", "from", getpid(), consumed);
+
+    closeOutputSink(&sink);
+
+    exit(sCode);
+}
+
+/*
+ * Attaches a reader to a running stream, in the first slot for attaching readers that no other reader
+ * holds, and reads the stream from the item with sequence number start, as attachReader() allows. The
+ * reader forwards each item to the output sink sinkName, numbered after the consumer group members, until
+ * the stream ends or the reader is detached, then gives up its slot. The run's own sink name lives in its
+ * memory rather than in the shared memory, so it is given again.
+ *
+ * Returns 0 on success, or -1 if every slot is held.
+ */
+int attachedReader(RWConfig *rwConfig, int start, char *sinkName)
+{
+    int *pendingReads, *sequence, slot, id = 0, first = 0, reads;
+    ProgramConfig *pConfig = &rwConfig->pConfig;
+    ReaderState *readerStates, *state = NULL;
+    OutputSink sink;
+    LocalBuffer local;
+    Aggregate aggregate;
+    Subscription subscription, *filtering;
+    StreamVerifier verifier;
+
+    /* Attached readers are not among the readers in the statistics region. Their counters are private. */
+    WorkerStats stats = { 0 };
+
+    /* Open shared memory to the buffer, the pending reads, the slot sequence numbers and the reader
+     * positions. */
+    openLocalBuffer(rwConfig, &local);
+    pendingReads = local.pendingReads;
+    sequence = local.sequence;
+    readerStates = local.readerStates;
 
     /*
-     * Save the write count to file.
+     * Take a free slot and claim the items we will read. Writers are held off while we do, so that no item
+     * is part way through being published: it would be given a claim for us whether or not we read it.
      */
+    lockWriters(rwConfig, pendingReads, sequence);
+    lockMutex(&rwConfig->rpMutex);
+    for (slot = 0; slot < pConfig->attachCount; slot++)
+    {
+        id = pConfig->readerCount + pConfig->memberCount + slot;
+        if (!readerStates[READER_STATE_INDEX(*pConfig, id)].held)
+        {
+            state = &readerStates[READER_STATE_INDEX(*pConfig, id)];
+            state->held = true;
+            first = attachReader(rwConfig, state, pendingReads, sequence, start);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&rwConfig->rpMutex);
+    pthread_mutex_unlock(&rwConfig->writeMutex);
+
+    if (state == NULL)
+    {
+        printf("Error: Every one of the %d slots for attaching readers is held.\n", pConfig->attachCount);
+        return -1;
+    }
+    printf("Reader %d attached from item #%d.\n", id, first);
+
+    if (openOutputSink(&sink, sinkName, pConfig->sinkBase + id))
+    {
+        printf("Error: Could not open output sink for reader %d.\n", pConfig->sinkBase + id);
+    }
+
+    initializeAggregate(&aggregate, &pConfig->aggregate);
+    filtering = openSubscription(rwConfig, pConfig->sinkBase + id, &subscription);
+    openVerifier(&verifier, selectChecksumKernel(), first);
+    reads = readStream(rwConfig, &local, id, state, &sink, NULL, NULL, &stats,
+        pConfig->aggregate.count ? &aggregate : NULL, filtering, pConfig->verify ? &verifier : NULL);
+
     simWriteFinish("reader", "reading", "from", getpid(), reads);
+    if (filtering != NULL)
+    {
+        printf("Reader %d filtered out %d of %d items, skipping %d of them unread.\n", pConfig->sinkBase + id,
+            subscription.filtered, reads, subscription.skipped);
+    }
+    if (pConfig->aggregate.count)
+    {
+        reportAggregate(pConfig->sinkBase + id, &aggregate);
+    }
+    if (pConfig->verify)
+    {
+        reportVerification(rwConfig, "reader", pConfig->sinkBase + id, &verifier);
+    }
 
-    exit(sCode);
+    closeOutputSink(&sink);
+
+    /* Give up the slot. A reader that read to the end of the stream holds no claims, but writers would
+     * still count it among the readers of anything published. */
+    lockMutex(&rwConfig->rpMutex);
+    if (!state->detached)
+    {
+        detachReader(rwConfig, state, pendingReads, sequence);
+    }
+    state->held = false;
+    pthread_mutex_unlock(&rwConfig->rpMutex);
+
+    return 0;
+}
+
+/*
+ * Detaches the reader with the given identifier from a running stream on request, whether it was started
+ * with the run or attached since. Its claim on every item it has not yet read is given up at once, so
+ * writers stop waiting for it even before it notices and stops.
+ *
+ * Returns 0 on success, or -1 if no such reader is attached.
+ */
+int dismissReader(RWConfig *rwConfig, int id)
+{
+    int *pendingReads, *sequence, sCode = 0;
+    ProgramConfig *pConfig = &rwConfig->pConfig;
+    ReaderState *readerStates, *state;
+
+    /* Consumer group members share their claims with their group, so cannot be detached on their own. */
+    if (id < 0 || (id >= pConfig->readerCount && id < pConfig->readerCount + pConfig->memberCount) ||
+        id >= pConfig->readerCount + pConfig->memberCount + pConfig->attachCount)
+    {
+        printf("Error: There is no reader %d to detach.\n", id);
+        return -1;
+    }
+
+    /* Open shared memory to the pending reads, the slot sequence numbers and the reader positions. */
+    pendingReads = (int *)openSharedMemory(PENDING_READS_NAME, rwConfig->ring.slots * sizeof(int));
+    sequence = (int *)openSharedMemory(SLOT_SEQUENCE_NAME, rwConfig->ring.slots * sizeof(int));
+    readerStates = (ReaderState *)openSharedMemory(READER_STATE_NAME, READER_STATE_SIZE(*pConfig));
+
+    lockMutex(&rwConfig->rpMutex);
+    state = &readerStates[READER_STATE_INDEX(*pConfig, id)];
+    if (state->detached)
+    {
+        printf("Error: Reader %d is not attached.\n", id);
+        sCode = -1;
+    }
+    else
+    {
+        detachReader(rwConfig, state, pendingReads, sequence);
+        state->dismissed = true;
+        printf("Detached reader %d before item #%d.\n", id, state->cursor);
+    }
+    pthread_mutex_unlock(&rwConfig->rpMutex);
+
+    /* Wake up any writers that were waiting for the reader, and the reader itself if it was waiting for
+     * an item, so that it notices. */
+    lockMutex(&rwConfig->fullWaitersMutex);
+    while (rwConfig->fullWaiters > 0)
+    {
+        sem_post(&rwConfig->fullCond);
+        rwConfig->fullWaiters--;
+    }
+    pthread_mutex_unlock(&rwConfig->fullWaitersMutex);
+
+    lockMutex(&rwConfig->emptyWaitersMutex);
+    while (rwConfig->emptyWaiters > 0)
+    {
+        sem_post(&rwConfig->emptyCond);
+        rwConfig->emptyWaiters--;
+    }
+    pthread_mutex_unlock(&rwConfig->emptyWaitersMutex);
+
+    return sCode;
 }
@@ -7,11 +7,85 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "shared.h"
+#include "channel.h"
+#include "pool.h"
 
 #include "simwrite.h"
 
+/*
+ * A reader process's own view of a buffer: its mappings of the buffer's shared memory, opened once for
+ * every reader thread the process hosts, and the private state those threads share.
+ *
+ * A process that hosts several readers counts itself among the buffer's active readers once, however
+ * many of its threads are reading: the first of them to start reading takes the process's place through
+ * the position of its first reader, the leader, and the last to stop gives it up. The threads only
+ * contend with each other on the private gateMutex, not on the shared rcMutex and rwCond.
+ */
+typedef struct LocalBuffer
+{
+    int *data;
+    char *arena;
+    BlockSummary *summaries;
+    RangeChecksum *checksums;
+    int *pendingReads;
+    int *sequence;
+    int *writerIds;
+    long long *publishTimes;
+    ReaderState *readerStates;
+
+    /* The position through which the process counts among the active readers, or NULL for a process that
+     * hosts a single reader, which counts itself through its own. */
+    ReaderState *leader;
+
+    /* The number of the process's threads that are reading. Bound to gateMutex. */
+    int localReaders;
+    pthread_mutex_t gateMutex;
+} LocalBuffer;
+
+/*
+ * A reader's filter, which an item's value must pass to be forwarded, and how many items did not pass,
+ * and how many of those were skipped without being read.
+ */
+typedef struct Subscription
+{
+    ReaderFilter *filter;
+    int filtered;
+    int skipped;
+} Subscription;
+
+/*
+ * One of the readers a reader process hosts, and what it read.
+ */
+typedef struct ReaderThread
+{
+    pthread_t thread;
+    RWConfig *rwConfig;
+    LocalBuffer *local;
+    int id;
+    Histogram *latency;
+    WorkerStats *stats;
+    int reads;
+
+    /* The output sink the reader forwards its stream to, or NULL for none. */
+    char *sinkName;
+} ReaderThread;
+
 void reader();
 
+/* Reads the stream of each job a daemon hands it, as a reader of the daemon's pool. */
+void poolReader();
+
+/* Reads like reader(), recording the stream to a journal. */
+void journalReader();
+
+/* Shares the stream with the other members of its consumer group. */
+void groupMember();
+
+/* Attaches a reader to a running stream, and detaches one early. */
+int attachedReader(RWConfig *rwConfig, int start, char *sinkName);
+int dismissReader(RWConfig *rwConfig, int id);
+
 #endif /* ifndef READER_H */
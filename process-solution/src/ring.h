@@ -0,0 +1,160 @@
+#ifndef RING_H
+#define RING_H
+
+/* For bool. */
+#include <stdbool.h>
+
+/* An elastic buffer doubles once this many buffers' worth of consecutive publishes have found it full. */
+#define RING_GROW_TURNS (1)
+
+/* An elastic buffer halves once this many buffers' worth of consecutive publishes have found at most a
+ * quarter of it unread. */
+#define RING_SHRINK_TURNS (4)
+
+/*
+ * A run of buffer slots that holds every item published from a given sequence number until the next
+ * generation begins.
+ */
+typedef struct RingGeneration
+{
+    /* The index of the generation's first slot, and its number of slots. */
+    int base;
+    int capacity;
+
+    /* 2^64 / capacity, rounded up, by which a sequence number's offset into the generation is reduced to
+     * its slot with two multiplications rather than a division. */
+    unsigned long long reciprocal;
+
+    /* The sequence number of the first item published to this generation. Readers that reach it move
+     * from the previous generation to this one. */
+    int start;
+} RingGeneration;
+
+/*
+ * The layout of the buffer's slots.
+ *
+ * A fixed buffer is a single generation that never changes. An elastic buffer has two banks of
+ * maxCapacity slots; writers publish to a generation in one bank while readers finish the previous
+ * generation in the other. A new generation only begins once every reader has reached the current one,
+ * so the bank it takes holds nothing left to read. Bound to rpMutex, and to writeMutex for writers.
+ */
+typedef struct Ring
+{
+    /* The generation writers publish to, and the one before it. */
+    RingGeneration current;
+    RingGeneration previous;
+
+    /* The smallest and largest capacity a generation may have. Equal for a fixed buffer. */
+    int minCapacity;
+    int maxCapacity;
+
+    /* The number of slots to allocate for every per-slot array. */
+    int slots;
+
+    /* The number of consecutive publishes that found the buffer full, and that found it mostly empty. */
+    int fullPublishes;
+    int idlePublishes;
+} Ring;
+
+/*
+ * Returns the reciprocal ringSlot reduces offsets into a generation of capacity slots with.
+ */
+static inline unsigned long long ringReciprocal(int capacity)
+{
+    return ~0ULL / (unsigned)capacity + 1;
+}
+
+/*
+ * Returns true if the buffer may grow and shrink.
+ */
+static inline bool ringIsElastic(Ring *ring)
+{
+    return ring->maxCapacity > ring->minCapacity;
+}
+
+/*
+ * Lays out a buffer of capacity slots that may grow to maxCapacity slots, a power-of-two multiple of
+ * capacity. With a maxCapacity of capacity or less, the buffer is fixed.
+ */
+static inline void initializeRing(Ring *ring, int capacity, int maxCapacity)
+{
+    ring->minCapacity = capacity;
+    ring->maxCapacity = capacity;
+    while (ring->maxCapacity * 2 <= maxCapacity)
+    {
+        ring->maxCapacity *= 2;
+    }
+    ring->slots = ringIsElastic(ring) ? 2 * ring->maxCapacity : capacity;
+
+    ring->current.base = 0;
+    ring->current.capacity = capacity;
+    ring->current.reciprocal = ringReciprocal(capacity);
+    ring->current.start = 0;
+    ring->previous = ring->current;
+
+    ring->fullPublishes = 0;
+    ring->idlePublishes = 0;
+}
+
+/*
+ * Records whether the writer about to publish the item with the given sequence number found the buffer
+ * full, and how many published items the slowest reader has yet to read. If the buffer has been full for
+ * long enough it doubles, and if it has been mostly empty for long enough it halves, by beginning a new
+ * generation at this item in the other bank. drained tells whether every reader has reached the current
+ * generation; until then, the buffer keeps its size.
+ *
+ * Returns true if a new generation began.
+ */
+static inline bool adjustRing(Ring *ring, int sequence, bool full, int unread, bool drained)
+{
+    int capacity = ring->current.capacity;
+
+    ring->fullPublishes = full ? ring->fullPublishes + 1 : 0;
+    ring->idlePublishes = unread <= capacity / 4 ? ring->idlePublishes + 1 : 0;
+
+    if (!drained)
+    {
+        return false;
+    }
+
+    if (ring->fullPublishes >= RING_GROW_TURNS * capacity && capacity < ring->maxCapacity)
+    {
+        capacity *= 2;
+    }
+    else if (ring->idlePublishes >= RING_SHRINK_TURNS * capacity && capacity > ring->minCapacity)
+    {
+        capacity /= 2;
+    }
+    else
+    {
+        return false;
+    }
+
+    ring->previous = ring->current;
+    ring->current.base = ring->previous.base ? 0 : ring->maxCapacity;
+    ring->current.capacity = capacity;
+    ring->current.reciprocal = ringReciprocal(capacity);
+    ring->current.start = sequence;
+    ring->fullPublishes = 0;
+    ring->idlePublishes = 0;
+
+    return true;
+}
+
+/*
+ * Returns the index of the slot that holds, or will hold, the item with the given sequence number.
+ *
+ * Every reader and writer calls this once per item, so it is always inlined into them, and finds the slot
+ * without a division or a branch on the generation's size. The low 64 bits of reciprocal * offset are the
+ * fraction offset / capacity, and the high 64 bits of that fraction times capacity are the remainder,
+ * which is exact for every 32-bit offset and capacity.
+ */
+__attribute__((always_inline)) static inline int ringSlot(Ring *ring, int sequence)
+{
+    RingGeneration *generation = sequence >= ring->current.start ? &ring->current : &ring->previous;
+    unsigned long long fraction = generation->reciprocal * (unsigned)(sequence - generation->start);
+
+    return generation->base + (int)(((unsigned __int128)fraction * (unsigned)generation->capacity) >> 64);
+}
+
+#endif /* ifndef RING_H */
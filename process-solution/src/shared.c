@@ -1,11 +1,14 @@
+#include <errno.h>
+
 #include "shared.h"
+#include "channel.h"
 
 /*
- * Opens shared memory.
+ * Opens shared memory. The segment is looked up under the name given by segmentName().
  */
 void *openSharedMemory(char *name, int size)
 {
-    int fd = shm_open(name, O_RDWR, 0666);
+    int fd = shm_open(segmentName(name), O_RDWR, 0666);
     void *ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 
     return ptr;
@@ -19,7 +22,7 @@ void *openSharedMemory(char *name, int size)
  */
 int closeSharedMemory(char *name)
 {
-    return shm_unlink(name);
+    return shm_unlink(segmentName(name));
 }
 
 /*
@@ -43,8 +46,12 @@ void initializeDefaultValueArray(int *array, int size, int dVal)
 RWConfig createRWConfig(ProgramConfig pConfig)
 {
     RWConfig config;
+    pthread_mutexattr_t attributes;
+    int i;
 
-    /* Writers need to know the next buffer position to write to. */
+    /* Writers need to know the next buffer position to write to. An elastic buffer starts at its
+     * smallest. */
+    initializeRing(&config.ring, pConfig.capacity, pConfig.maxCapacity);
     config.idxWrite = 0;
 
     /* Readers & Writers need to know how long to sleep for. Encapsulate the information within the RWConfig. */
@@ -53,6 +60,19 @@ RWConfig createRWConfig(ProgramConfig pConfig)
     /* Initialize the number of readers reading from the buffer. Note that we don't need a corresponding
      * value for writers, because there can only be one. */
     config.activeReaders = 0;
+    config.nextReaderId = 0;
+    config.nextWriterId = 0;
+    config.nextMemberId = 0;
+    config.consumers = pConfig.readerCount + (pConfig.journalName != NULL) + pConfig.groupCount;
+
+    /* Every consumer group starts at the start of the stream. */
+    for (i = 0; i < pConfig.groupCount; i++)
+    {
+        config.groups[i].cursor = 0;
+        config.groups[i].consumed = 0;
+        config.groups[i].lost = 0;
+        config.groups[i].detached = false;
+    }
 
     /* Initialize the number of writes. This will be used to determine when all values have been written. */
     config.writes = 0;
@@ -63,14 +83,239 @@ RWConfig createRWConfig(ProgramConfig pConfig)
     sem_init(&config.emptyCond, 1, 0);
     sem_init(&config.fullCond, 1, 0);
 
-    sem_init(&config.emptyWaitersSem, 1, 1);
-    sem_init(&config.fullWaitersSem, 1, 1);
+    /* The mutexes are shared between processes, and robust, so that a worker dying while holding one does
+     * not leave every other worker waiting for it. */
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+
+    pthread_mutex_init(&config.emptyWaitersMutex, &attributes);
+    pthread_mutex_init(&config.fullWaitersMutex, &attributes);
+
+    pthread_mutex_init(&config.writeMutex, &attributes);
+    pthread_mutex_init(&config.rpMutex, &attributes);
+    pthread_mutex_init(&config.rcMutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
 
-    sem_init(&config.writeSem, 1, 1);
-    sem_init(&config.rpSem, 1, 1);
-    sem_init(&config.rcSem, 1, 1);
-    sem_init(&config.rwSem, 1, 1);
+    sem_init(&config.rwCond, 1, 0);
+    config.rwWriter = 0;
+    config.rwWaiters = 0;
+    config.unpublished.holding = false;
+    config.lostWrites = 0;
+
+    /* With an arena, every payload starts at the beginning of the stream. */
+    initializeArena(&config.arena, pConfig.arenaSize);
 
     return config;
 }
 
+/*
+ * Returns the sequence number of the oldest item that some attached reader, the journal reader or a
+ * consumer group has not yet read. A group has not read the items it has yet to claim, nor those its
+ * members are still reading.
+ *
+ * Must be called with rwConfig->rpMutex held.
+ */
+int oldestUnread(RWConfig *rwConfig, ReaderState *readerStates)
+{
+    ProgramConfig *pConfig = &rwConfig->pConfig;
+    int i, oldest = rwConfig->writes;
+
+    for (i = 0; i < READER_STATE_COUNT(*pConfig); i++)
+    {
+        if (!readerStates[i].detached && readerStates[i].cursor < oldest)
+        {
+            oldest = readerStates[i].cursor;
+        }
+    }
+    for (i = 0; i < pConfig->groupCount; i++)
+    {
+        if (!rwConfig->groups[i].detached && rwConfig->groups[i].cursor < oldest)
+        {
+            oldest = rwConfig->groups[i].cursor;
+        }
+    }
+
+    return oldest;
+}
+
+/*
+ * Locks one of the mutexes in the RWConfig. If the worker that held it died, the mutex is made usable
+ * again. Whatever the worker left part way through under it is at most one item's worth of counts, and the
+ * parent releases the worker's claims once it sees the worker die.
+ */
+void lockMutex(pthread_mutex_t *mutex)
+{
+    if (pthread_mutex_lock(mutex) == EOWNERDEAD)
+    {
+        printf("Error: A worker died holding a lock. Recovering the lock.\n");
+        pthread_mutex_consistent(mutex);
+    }
+}
+
+/*
+ * Locks rwConfig->writeMutex. If the writer that held it died holding an item it had read from the source,
+ * the item is taken back and left for the next writer to publish: an item is only published once its
+ * slot's sequence number is set, so no reader can have seen it. Its slot is reset, in case the writer had
+ * already given it claims, and the arena space reserved for its payload is given back.
+ */
+void lockWriters(RWConfig *rwConfig, int *pendingReads, int *sequence)
+{
+    UnpublishedItem *item = &rwConfig->unpublished;
+    int slot;
+
+    if (pthread_mutex_lock(&rwConfig->writeMutex) == EOWNERDEAD)
+    {
+        lockMutex(&rwConfig->rpMutex);
+        slot = ringSlot(&rwConfig->ring, item->sequence);
+        if (item->holding && (rwConfig->writes == item->sequence ||
+            (sequence[slot] != item->sequence && !spillHolds(&rwConfig->spill, item->sequence))))
+        {
+            printf("Error: A writer died publishing item #%d. Publishing it again.\n", item->sequence);
+            if (rwConfig->writes != item->sequence)
+            {
+                pendingReads[slot] = 0;
+                sequence[slot] = SEQUENCE_NONE;
+            }
+            rwConfig->writes = item->sequence;
+            rwConfig->arena.head = item->arenaHead;
+        }
+        else
+        {
+            item->holding = false;
+        }
+        rwConfig->idxWrite = ringSlot(&rwConfig->ring, rwConfig->writes);
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+
+        pthread_mutex_consistent(&rwConfig->writeMutex);
+    }
+}
+
+/*
+ * Wakes every reader and writer waiting for the buffer to be given back, so that each checks again
+ * whether it can take it.
+ *
+ * Must be called with rwConfig->rcMutex held.
+ */
+void wakeRwWaiters(RWConfig *rwConfig)
+{
+    while (rwConfig->rwWaiters > 0)
+    {
+        sem_post(&rwConfig->rwCond);
+        rwConfig->rwWaiters--;
+    }
+}
+
+/*
+ * Attaches a reader to a running stream from the item with sequence number start, so that writers wait
+ * for it from then on. A reader can only start from an item still in the buffer and still held by some
+ * other reader, since an item nobody holds may already be being overwritten; an earlier start is moved
+ * forward to the oldest such item. A start past the newest item, or a negative one, starts the reader at
+ * the next item published.
+ *
+ * Must be called with rwConfig->writeMutex and rwConfig->rpMutex held, so that no item is part way through
+ * being published.
+ *
+ * Returns the sequence number of the first item the reader will read.
+ */
+int attachReader(RWConfig *rwConfig, ReaderState *state, int *pendingReads, int *sequence, int start)
+{
+    int first = rwConfig->writes, slot;
+
+    if (start < 0)
+    {
+        start = first;
+    }
+
+    /* Claim every item the reader will read that is already in the buffer, newest first. */
+    while (first > start && sequence[slot = ringSlot(&rwConfig->ring, first - 1)] == first - 1 &&
+        pendingReads[slot] > 0)
+    {
+        pendingReads[slot]++;
+        first--;
+    }
+
+    state->cursor = first;
+    state->detached = false;
+    state->dismissed = false;
+    rwConfig->consumers++;
+
+    return first;
+}
+
+/*
+ * Gives up a reader's claim on every item it has not yet read, so that writers no longer wait for it to
+ * read them.
+ *
+ * Must be called with rwConfig->rpMutex held.
+ */
+void releaseReader(RWConfig *rwConfig, ReaderState *state, int *pendingReads, int *sequence)
+{
+    int slot;
+
+    for (slot = 0; slot < rwConfig->ring.slots; slot++)
+    {
+        if (sequence[slot] >= state->cursor)
+        {
+            pendingReads[slot]--;
+        }
+    }
+}
+
+/*
+ * Detaches a reader from the stream: gives up its claims, and stops writers counting it among the
+ * readers of each item published from now on. The reader stops once it notices.
+ *
+ * Must be called with rwConfig->rpMutex held. An item part way through being published is given a claim
+ * for each reader still attached once it is, so writeMutex is not needed.
+ */
+void detachReader(RWConfig *rwConfig, ReaderState *state, int *pendingReads, int *sequence)
+{
+    releaseReader(rwConfig, state, pendingReads, sequence);
+    state->detached = true;
+    rwConfig->consumers--;
+}
+
+/*
+ * Returns the consumer group of the member with the given identifier.
+ */
+int memberGroup(ProgramConfig *pConfig, int memberId)
+{
+    int group = 0;
+
+    while (memberId >= pConfig->groupSizes[group])
+    {
+        memberId -= pConfig->groupSizes[group++];
+    }
+
+    return group;
+}
+
+/*
+ * Returns the number of ints from the start of one slot of a buffer to the next, for items of the given
+ * number of fields. An item of a single field takes a single int; a larger one is padded to whole cache
+ * lines.
+ */
+int itemStride(int itemFields)
+{
+    int lineInts = ITEM_ALIGNMENT / sizeof(int);
+
+    return itemFields == 1 ? 1 : (itemFields + lineInts - 1) / lineInts * lineInts;
+}
+
+/*
+ * Returns the number of processes that host count workers of one kind, threads to a process.
+ */
+int workerProcesses(int count, int threads)
+{
+    return (count + threads - 1) / threads;
+}
+
+/*
+ * Returns the number of workers of one kind that the next process to start hosts, out of count workers
+ * hosted threads to a process, given that the workers before next have been taken by other processes.
+ */
+int workerBlock(int count, int threads, int next)
+{
+    return next >= count ? 0 : (count - next < threads ? count - next : threads);
+}
@@ -9,6 +9,21 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+
+#include "source.h"
+#include "sink.h"
+#include "journal.h"
+#include "clock.h"
+#include "histogram.h"
+#include "stats.h"
+#include "probes.h"
+#include "spill.h"
+#include "ring.h"
+#include "arena.h"
+#include "aggregate.h"
+#include "filter.h"
+#include "integrity.h"
 
 /* Name of the file containing data to be read from the filesystem. */
 #define SHARED_FILE_NAME "shared_data"
@@ -16,11 +31,73 @@
 /* Name of the shared memory region. */
 #define SHARED_FILE_BUFFER_NAME "data_buffer"
 
+/* Size of the shared memory region, given the RWConfig: every slot, each itemStride() ints long, or each
+ * an ArenaDescriptor with an arena. Slots of more than one int start on a cache line of their own, since
+ * the region is page-aligned. */
+#define SHARED_FILE_BUFFER_SIZE(rwConfig) \
+    ((rwConfig)->arena.size ? (rwConfig)->ring.slots * sizeof(ArenaDescriptor) : \
+        (rwConfig)->ring.slots * itemStride((rwConfig)->pConfig.itemFields) * sizeof(int))
+
+/* Name of the shared memory region for the arena.
+ * With --arena, this shared memory region holds the payload of every item in the buffer, which the slots
+ * of the buffer locate with an ArenaDescriptor. */
+#define ARENA_NAME "arena"
+
 /* Name of the shared memory region for pending reads.
  * This shared memory region will store an array of integers that describe how many reads are
  * pending for a particular buffer slot. */
 #define PENDING_READS_NAME "pending_reads"
 
+/* Name of the shared memory region for slot sequence numbers.
+ * This shared memory region will store an array of integers holding the sequence number of the item
+ * in each buffer slot. */
+#define SLOT_SEQUENCE_NAME "slot_sequence"
+
+/* Names of the shared memory regions for slot stamps.
+ * These shared memory regions store the identifier of the writer that published the item in each buffer
+ * slot (an array of integers), and the time it was published (an array of long longs). */
+#define SLOT_WRITER_NAME "slot_writer"
+#define SLOT_TIME_NAME "slot_time"
+
+/* Name of the shared memory region for block summaries.
+ * With --filter, this shared memory region will store the BLOCK_SUMMARY_COUNT most recent summaries that
+ * writers keep of each block of FILTER_BLOCK_ITEMS items published, which filtering readers skip blocks
+ * by: enough to cover every item the buffer can hold. */
+#define BLOCK_SUMMARY_NAME "block_summary"
+#define BLOCK_SUMMARY_COUNT(rwConfig) ((rwConfig)->ring.slots / FILTER_BLOCK_ITEMS + 2)
+
+/* Name of the shared memory region for range checksums.
+ * With --verify, this shared memory region will store the checksums writers keep of the CHECKSUM_RANGES
+ * most recent ranges of items published, which verifying readers check theirs against. */
+#define RANGE_CHECKSUM_NAME "range_checksum"
+
+/* Name of the shared memory region for reader latencies.
+ * This shared memory region will store one Histogram per reader, indexed by reader identifier, of the
+ * publish-to-consume latency of every item that reader read. */
+#define READER_LATENCY_NAME "reader_latency"
+
+/* Name of the shared memory region for reader positions.
+ * This shared memory region will store one ReaderState per reader, indexed by reader identifier, followed
+ * by that of the journal reader, then the claim of every consumer group member, indexed by member
+ * identifier, then one for each slot a reader may attach to while the run is going. Writers use it to find
+ * and release readers that have fallen behind, though never the journal reader or a member. When not
+ * recording, the journal reader's entry is marked detached, as is every slot no reader has attached to. */
+#define READER_STATE_NAME "reader_state"
+
+/* Number of entries in the shared memory region for reader positions, and its size, given the
+ * ProgramConfig. */
+#define READER_STATE_COUNT(pConfig) ((pConfig).readerCount + 1 + (pConfig).memberCount + (pConfig).attachCount)
+#define READER_STATE_SIZE(pConfig) (READER_STATE_COUNT(pConfig) * sizeof(ReaderState))
+
+/* The entry in the reader positions of the reader with the given identifier. Readers that attach while
+ * the run is going are numbered after the consumer group members, whose identifiers follow the readers'
+ * but whose entries follow the journal reader's. */
+#define READER_STATE_INDEX(pConfig, id) ((id) < (pConfig).readerCount ? (id) : (id) + 1)
+
+/* Name of the shared memory region for live worker statistics.
+ * This shared memory region will store a StatsRegion, which sds-top attaches to read-only. */
+#define WORKER_STATS_NAME "worker_stats"
+
 /* Simulator output filename. */
 #define SHARED_FILE_SIM_OUT_NAME "sim_out"
 
@@ -40,6 +117,115 @@
 /* The number of elements in the shared_data file. */
 #define NUM_ELEMENTS_DATA_FILE (100)
 
+/* The sequence number of a slot that has never been written to. */
+#define SEQUENCE_NONE (-1)
+
+/* The sequence number of a slot whose item has been moved to the spill file. */
+#define SEQUENCE_SPILLED (-2)
+
+/* The sequence number of a slot a writer is overwriting, in overwrite mode. */
+#define SEQUENCE_WRITING (-3)
+
+/* The identifier the journal reader is traced with. It is not counted among the readers. */
+#define JOURNAL_READER_ID (-1)
+
+/* What happens to a reader that falls further behind than the lag limit: it is detached, so writers stop
+ * waiting for it and it stops reading; or it catches up, skipping every item it has not yet read. */
+#define LAG_POLICY_DETACH (0)
+#define LAG_POLICY_CATCH_UP (1)
+
+/* The most consumer groups a run can have. */
+#define MAX_CONSUMER_GROUPS (8)
+
+/* The most channels a run can host. */
+#define MAX_CHANNELS (32)
+
+/* The most relays a stream can fan out through. */
+#define MAX_RELAYS (64)
+
+/* The largest item --item-size allows, in bytes, and the most integer fields it holds. */
+#define MAX_ITEM_SIZE (256)
+#define MAX_ITEM_FIELDS (MAX_ITEM_SIZE / 4)
+
+/* The smallest arena --arena allows, in bytes: room for two of the longest payloads, which are the
+ * longest lines an input source reads. */
+#define ARENA_MIN_SIZE (2 * SOURCE_BUFFER_SIZE)
+
+/* The alignment of the slots of a buffer whose items hold more than one field: a cache line, so that
+ * publishing and consuming an item copies whole lines. */
+#define ITEM_ALIGNMENT (64)
+
+/* The process identifier recorded for a reader whose process has exited. */
+#define PID_EXITED (-1)
+
+/*
+ * A reader's position in the stream, as seen by the writers. Bound to rpMutex.
+ *
+ * A consumer group member uses one to hold the item it has claimed while it reads it: the cursor is that
+ * item, and the member is marked detached whenever it holds no claim.
+ */
+typedef struct ReaderState
+{
+    /* The sequence number of the next item the reader will read. A writer moves this forward when it
+     * makes the reader catch up. */
+    int cursor;
+
+    /* Set by a writer that detached the reader. */
+    bool detached;
+
+    /* Set along with detached when the reader was detached on request rather than for falling behind. */
+    bool dismissed;
+
+    /* Whether a reader has attached to this slot while the run is going. Only used by those slots. */
+    bool held;
+
+    /* The process reading from this position: 0 until one takes it, and PID_EXITED once that process has
+     * exited. Bound to rcMutex. */
+    pid_t pid;
+
+    /* Whether the reader is counted among the active readers. Bound to rcMutex. */
+    bool reading;
+} ReaderState;
+
+/*
+ * The progress of a consumer group. Each item goes to exactly one of the group's members, so the group
+ * as a whole holds a single claim on each slot, like one reader. Bound to rpMutex.
+ */
+typedef struct GroupState
+{
+    /* The sequence number of the next item for a member to claim. */
+    int cursor;
+
+    /* The number of items the group's members have consumed, and the number the group lost because the
+     * writers overwrote them before a member claimed them. */
+    int consumed;
+    int lost;
+
+    /* Set once every member of the group has died, so that writers stop waiting for the group. */
+    bool detached;
+} GroupState;
+
+/*
+ * The item a writer has read from the input source but not yet published. It is kept in the RWConfig
+ * rather than by the writer, so that if the writer dies part way through publishing it, the next writer
+ * publishes it in its place rather than reading on from the source. Bound to writeMutex.
+ */
+typedef struct UnpublishedItem
+{
+    /* Whether a writer holds an item, and the sequence number it is published with. */
+    bool holding;
+    int sequence;
+
+    /* The item's fields, or with an arena its payload's length and the payload, which lies in the input
+     * source's buffer until the next item is read. */
+    int value;
+    int fields[MAX_ITEM_FIELDS];
+    char *payload;
+
+    /* The arena's head before the item's payload was reserved, so that the reservation can be undone. */
+    long long arenaHead;
+} UnpublishedItem;
+
 /*
  * Struct to store the command-line configuration for the program.
  */
@@ -57,6 +243,106 @@ typedef struct ProgramConfig
     /* How long each writer should sleep for once it is done writing an element to the buffer. */
     int writerSleepTime;
 
+    /* The input source writers read from: a file name, "-", "fifo:PATH" or "unix:PATH". */
+    char *inputName;
+
+    /* The output sink each reader forwards its stream to: NULL, "file:PATH", "fifo:PATH" or "unix:PATH". */
+    char *sinkName;
+
+    /* The journal file to record the published stream to, or NULL to not record. */
+    char *journalName;
+
+    /* How fast a journal source is replayed relative to the recorded times; 0 replays without pacing. */
+    double replaySpeed;
+
+    /* A reader holding up a writer is lagging if it is at least this many items behind, or if the item
+     * it has not read has been in the buffer for at least this many nanoseconds. 0 disables each limit;
+     * with both disabled, writers wait for every reader. */
+    int maxLagItems;
+    long long maxLagNs;
+
+    /* What happens to a lagging reader: LAG_POLICY_DETACH or LAG_POLICY_CATCH_UP. */
+    int lagPolicy;
+
+    /* Whether writers overwrite the oldest item rather than wait for every reader to read it. Readers
+     * that are lapped skip to the newest item. */
+    bool overwrite;
+
+    /* The file writers move unread items to when the buffer is full, rather than wait, or NULL to wait. */
+    char *spillName;
+
+    /* The number of slots in the buffer, and the smallest an elastic buffer shrinks to. */
+    int capacity;
+
+    /* The most slots an elastic buffer may grow to under a sustained backlog, or 0 for a buffer fixed at
+     * capacity slots. */
+    int maxCapacity;
+
+    /* The number of consumer groups, and the number of members in each. Members are numbered from 0
+     * across every group in turn. */
+    int groupCount;
+    int groupSizes[MAX_CONSUMER_GROUPS];
+    int memberCount;
+
+    /* The channels the run hosts, each given as NAME[:SIZE]=SOURCE, or none to host a single unnamed
+     * channel read from inputName. */
+    int channelCount;
+    char *channelSpecs[MAX_CHANNELS];
+
+    /* The number of slots readers may attach to while the run is going. */
+    int attachCount;
+
+    /* The number of relays the stream fans out through, or 0 for readers to read it directly. Each relay
+     * reads the stream like a reader, and publishes it again to a buffer of its own that serves its
+     * share of the readers. */
+    int relayCount;
+
+    /* The number added to the identifiers of this buffer's readers and members to number their sinks. The
+     * buffer of a relay serves readers after the first; a stream that fans out numbers its members after
+     * the readers of every relay. */
+    int sinkBase;
+
+    /* The name of the channel this configuration is for, or NULL for the unnamed channel. */
+    char *channelName;
+
+    /* The name that keys this run's shared memory segments apart from other runs', or NULL. */
+    char *instanceName;
+
+    /* The control socket a daemon accepts jobs on, or NULL to run a single stream and exit. */
+    char *daemonName;
+
+    /* The number of subscribers asked for with --subscribe. Only the threads solution hosts subscribers,
+     * so a run asked for any fails rather than run without them. */
+    int subscriberCount;
+
+    /* The number of integer fields in each item, 1 unless set by --item-size. The first is the item's
+     * value, which traces show; the source gives each item's fields in turn. */
+    int itemFields;
+
+    /* The number of readers, and of writers, each reader or writer process hosts as threads of its own.
+     * Relays, the journal reader and consumer group members always have a process each. */
+    int threadsPerProcess;
+
+    /* The number of bytes in the arena that holds each item's payload, or 0 to publish items as integers.
+     * With an arena, each item is a line of the source, and its value is the line's length. */
+    int arenaSize;
+
+    /* The operators every reader runs over the values it reads, as given by --aggregate; a pipeline of
+     * none unless set. */
+    AggregatePipeline aggregate;
+
+    /* The filters readers subscribe with, as given by --filter. A reader without one reads every item. */
+    int filterCount;
+    ReaderFilter filters[MAX_FILTERS];
+
+    /* Whether writers checksum the stream they publish, and readers the stream they read, to check that
+     * each reader read exactly what was published. */
+    bool verify;
+
+    /* Whether readers, writers and consumer group members print a line for each item they handle. Off
+     * with --no-trace, and with --verify, whose runs are meant to be long. */
+    bool trace;
+
 } ProgramConfig;
 
 /*
@@ -71,6 +357,10 @@ typedef struct RWConfig
     /* The buffer index writers are currently writing to. */
     int idxWrite;
 
+    /* Which slots hold which items. Writers begin a new generation of an elastic buffer as the backlog
+     * grows or shrinks, and readers detect the handoff by the sequence number it begins at. */
+    Ring ring;
+
     /* The program's command-line configuration. */
     ProgramConfig pConfig;
 
@@ -78,23 +368,49 @@ typedef struct RWConfig
      * readers are reading. */
     int activeReaders;
 
-    /* The number of writes performed. This is used by writers to determine when to terminate. */
+    /* The identifier the next reader to start will take. Readers use their identifier to name their
+     * output sink. Bound to rcMutex. */
+    int nextReaderId;
+
+    /* The identifier the next writer to start will take. Bound to writeMutex. */
+    int nextWriterId;
+
+    /* The identifier the next consumer group member to start will take. Bound to rcMutex. */
+    int nextMemberId;
+
+    /* The progress of every consumer group. */
+    GroupState groups[MAX_CONSUMER_GROUPS];
+
+    /* The number of readers that must read each slot before it can be overwritten: every reader, plus
+     * the journal reader when recording, plus one for each consumer group. */
+    int consumers;
+
+    /* The number of writes performed. Once eof is set, this is the number of items readers must read. */
     int writes;
 
+    /* Set by the writer that finds the input source exhausted. This is used by writers and readers to
+     * determine when to terminate. */
+    bool eof;
+
     /* The number of readers waiting for a new buffer entry to read. */
     int emptyWaiters;
 
     /* The number of writers waiting for an empty buffer entry to write to. */
     int fullWaiters;
 
-    /* Semaphore used to ensure mutual exclusion for emptyWaiters. */
-    sem_t emptyWaitersSem;
+    /*
+     * The mutexes below are robust: if a worker dies holding one, the next process to lock it is told so,
+     * rather than waiting forever. lockMutex() and lockWriters() recover it.
+     */
+
+    /* Mutex used to ensure mutual exclusion for emptyWaiters. */
+    pthread_mutex_t emptyWaitersMutex;
 
-    /* Semaphore used to ensure mutual exclusion for fullWaiters. */
-    sem_t fullWaitersSem;
+    /* Mutex used to ensure mutual exclusion for fullWaiters. */
+    pthread_mutex_t fullWaitersMutex;
 
-    /* Semaphore used to ensure mutual exclusion for activeReaders. */
-    sem_t rcSem;
+    /* Mutex used to ensure mutual exclusion for activeReaders. */
+    pthread_mutex_t rcMutex;
 
     /* Semaphore used to suspend readers until a buffer entry is written. */
     sem_t emptyCond;
@@ -102,14 +418,44 @@ typedef struct RWConfig
     /* Semaphore used to suspend writers until a buffer entry is free. */
     sem_t fullCond;
 
-    /* Semaphore used to ensure mutual exclusion of writers. */
-    sem_t writeSem;
+    /* Mutex used to ensure mutual exclusion of writers. */
+    pthread_mutex_t writeMutex;
 
-    /* Semaphore used to ensure mutual exclusion of pendingReads. */
-    sem_t rpSem;
+    /* Mutex used to ensure mutual exclusion of pendingReads. */
+    pthread_mutex_t rpMutex;
     
-    /* Semaphore used to block readers if a writer is active, or block writers if a reader is active. */
-    sem_t rwSem;
+    /* The writer process holding the buffer against readers, or 0 if none is. Readers hold it against
+     * writers while activeReaders is not 0. Both are only changed with rcMutex held, in the same step as
+     * the buffer is taken or given back, so that the parent can always give back the buffer for a worker
+     * that died holding it. */
+    pid_t rwWriter;
+
+    /* The number of readers and writers waiting for the buffer to be given back. Bound to rcMutex. */
+    int rwWaiters;
+
+    /* Semaphore used to suspend readers while a writer holds the buffer, and writers while readers do. */
+    sem_t rwCond;
+
+    /* The input stream that writers read from. */
+    InputSource source;
+
+    /* The item the writer publishing next has read from the source. */
+    UnpublishedItem unpublished;
+
+    /* The number of items writers read from the source but died before publishing, when no writer was
+     * left to publish them. Verifying readers report them. Bound to rpMutex. */
+    int lostWrites;
+
+    /* Items moved out of the buffer before every reader had read them. The file is mapped before the
+     * readers and writers are forked, so the mapping is shared by all of them. Bound to rpMutex. */
+    Spill spill;
+
+    /* Where the payloads of the items in the buffer lie in the arena, when there is one. */
+    Arena arena;
+
+    /* With --verify, the checksum of the whole stream published, which verifying readers check theirs
+     * against. Bound to rpMutex, as are the range checksums. */
+    StreamChecksum published;
 } RWConfig;
 
 /* Creates the RWConfig, encapsulating the command line configuration. */
@@ -118,6 +464,31 @@ RWConfig createRWConfig(ProgramConfig);
 /* Initializes an array with a default value. */
 void initializeDefaultValueArray(int *array, int length, int value);
 
+/* Finds the oldest item some reader has yet to read. */
+int oldestUnread(RWConfig *rwConfig, ReaderState *readerStates);
+
+/* Locks a mutex in the RWConfig, recovering it from a worker that died holding it. */
+void lockMutex(pthread_mutex_t *mutex);
+void lockWriters(RWConfig *rwConfig, int *pendingReads, int *sequence);
+
+/* Wakes every reader and writer waiting for the buffer to be given back. */
+void wakeRwWaiters(RWConfig *rwConfig);
+
+/* Attaches a reader to a running stream, and detaches one early. */
+int attachReader(RWConfig *rwConfig, ReaderState *state, int *pendingReads, int *sequence, int start);
+void releaseReader(RWConfig *rwConfig, ReaderState *state, int *pendingReads, int *sequence);
+void detachReader(RWConfig *rwConfig, ReaderState *state, int *pendingReads, int *sequence);
+
+/* Finds the consumer group a member belongs to. */
+int memberGroup(ProgramConfig *pConfig, int memberId);
+
+/* Finds the number of ints from the start of one slot of the buffer to the next. */
+int itemStride(int itemFields);
+
+/* Finds how many processes host a kind of worker, and how many workers the next of them hosts. */
+int workerProcesses(int count, int threads);
+int workerBlock(int count, int threads, int next);
+
 /* Opens a shared memory segment. */
 void *openSharedMemory(char *name, int size);
 int closeSharedMemory(char *name);
@@ -62,3 +62,95 @@ int simWriteClear()
 
     return sCode;
 }
+
+/*
+ * Writes to file the distribution of publish-to-consume latencies seen by the readers.
+ */
+int simWriteLatency(Histogram *latency)
+{
+    int sCode = 0;
+    FILE *fPtr = fopen(SHARED_FILE_SIM_OUT_NAME, "a");
+    if (fPtr)
+    {
+        if (fprintf(fPtr, "Publish-to-consume latency over %lld reads (ns): p50=%lld p99=%lld p99.9=%lld max=%lld.\n",
+            latency->total, histogramPercentile(latency, 50), histogramPercentile(latency, 99),
+            histogramPercentile(latency, 99.9), latency->max) < 0)
+        {
+            sCode = ERROR_WRITING_FILE;
+        }
+
+        if (fclose(fPtr))
+        {
+            sCode = ERROR_CLOSING_FILE;
+        }
+    }
+    else
+    {
+        sCode = ERROR_OPENING_FILE;
+    }
+
+    return sCode;
+}
+
+/*
+ * Writes to file the results of the operators a reader ran over the values it read.
+ */
+int simWriteAggregate(char *type, int id, Aggregate *aggregate)
+{
+    int sCode = 0;
+    char report[AGGREGATE_REPORT_SIZE];
+    FILE *fPtr = fopen(SHARED_FILE_SIM_OUT_NAME, "a");
+
+    formatAggregate(aggregate, report, sizeof(report));
+    if (fPtr)
+    {
+        if (fprintf(fPtr, "%s-%d aggregated %lld pieces of data with %s kernels: %s.\n", type, id, aggregate->items,
+            aggregate->kernels->name, report) < 0)
+        {
+            sCode = ERROR_WRITING_FILE;
+        }
+
+        if (fclose(fPtr))
+        {
+            sCode = ERROR_CLOSING_FILE;
+        }
+    }
+    else
+    {
+        sCode = ERROR_OPENING_FILE;
+    }
+
+    return sCode;
+}
+
+/*
+ * Writes to file the outcome of a reader's check of the stream it read against the one published.
+ */
+int simWriteVerification(char *type, int id, StreamVerifier *verifier)
+{
+    int sCode = 0;
+    char report[VERIFICATION_REPORT_SIZE];
+    FILE *fPtr = fopen(SHARED_FILE_SIM_OUT_NAME, "a");
+
+    formatVerification(verifier, report, sizeof(report));
+    if (fPtr)
+    {
+        if (fprintf(fPtr, "%s-%d %s %d pieces of data with %s CRC32C: %s.\n", type, id,
+            verifierDiverged(verifier) ? "diverged over" : "verified", verifier->stream.items,
+            verifier->kernel->name, report) < 0)
+        {
+            sCode = ERROR_WRITING_FILE;
+        }
+
+        if (fclose(fPtr))
+        {
+            sCode = ERROR_CLOSING_FILE;
+        }
+    }
+    else
+    {
+        sCode = ERROR_OPENING_FILE;
+    }
+
+    return sCode;
+}
@@ -11,5 +11,8 @@
 
 int simWriteFinish(char *type, char *action, char *dest, int id, int val);
 int simWriteClear();
+int simWriteLatency(Histogram *latency);
+int simWriteAggregate(char *type, int id, Aggregate *aggregate);
+int simWriteVerification(char *type, int id, StreamVerifier *verifier);
 
 #endif /* ifndef SIMWRITE_H */
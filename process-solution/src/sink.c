@@ -0,0 +1,225 @@
+#include "sink.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Connects to a consumer listening on a Unix-domain socket at path.
+ *
+ * Returns the connected socket, or -1 if the connection could not be made.
+ */
+static int connectUnixSocket(char *path)
+{
+    int fd;
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    return fd;
+}
+
+/*
+ * Opens a named pipe for writing, creating it first if it does not exist.
+ *
+ * Opening blocks until a consumer opens the other end.
+ */
+static int openFifo(char *path)
+{
+    if (mkfifo(path, 0666) && errno != EEXIST)
+    {
+        return -1;
+    }
+
+    return open(path, O_WRONLY);
+}
+
+/*
+ * Opens the output sink for a reader, as described by name:
+ *   NULL         no sink; values are discarded,
+ *   "file:PATH"  the file PATH.<readerId>,
+ *   "fifo:PATH"  the named pipe PATH.<readerId>,
+ *   "unix:PATH"  a connection to the Unix-domain socket PATH.
+ *
+ * Returns 0 on success, or -1 if the sink could not be opened.
+ */
+int openOutputSink(OutputSink *sink, char *name, int readerId)
+{
+    char path[4096];
+
+    sink->fd = -1;
+    sink->used = 0;
+
+    if (name == NULL)
+    {
+        return 0;
+    }
+
+    if (!strncmp(name, SINK_FILE_PREFIX, strlen(SINK_FILE_PREFIX)))
+    {
+        snprintf(path, sizeof(path), "%s.%d", name + strlen(SINK_FILE_PREFIX), readerId);
+        sink->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    }
+    else if (!strncmp(name, SINK_FIFO_PREFIX, strlen(SINK_FIFO_PREFIX)))
+    {
+        snprintf(path, sizeof(path), "%s.%d", name + strlen(SINK_FIFO_PREFIX), readerId);
+        sink->fd = openFifo(path);
+    }
+    else if (!strncmp(name, SINK_UNIX_PREFIX, strlen(SINK_UNIX_PREFIX)))
+    {
+        sink->fd = connectUnixSocket(name + strlen(SINK_UNIX_PREFIX));
+    }
+
+    return sink->fd < 0 ? -1 : 0;
+}
+
+/*
+ * Writes to a file descriptor that is already open, such as the write end of a pipe. The sink takes over
+ * the descriptor, and closes it when it is closed.
+ */
+void attachOutputSink(OutputSink *sink, int fd)
+{
+    sink->fd = fd;
+    sink->used = 0;
+}
+
+/*
+ * Appends a value to the sink. The buffer is only written out if it has no room for the value.
+ */
+void writeSinkItem(OutputSink *sink, int value)
+{
+    if (sink->fd < 0)
+    {
+        return;
+    }
+
+    if (sink->used > SINK_BUFFER_SIZE - SINK_ITEM_MAX_BYTES)
+    {
+        flushOutputSink(sink);
+    }
+
+    sink->used += snprintf(sink->buffer + sink->used, SINK_ITEM_MAX_BYTES, "%d\n", value);
+}
+
+/*
+ * Appends an item of count integer fields to the sink, on a line of its own with its fields separated by
+ * spaces. The buffer is only written out if it has no room for the item.
+ */
+void writeSinkRecord(OutputSink *sink, int *fields, int count)
+{
+    int i;
+
+    if (sink->fd < 0)
+    {
+        return;
+    }
+
+    if (sink->used > SINK_BUFFER_SIZE - count * SINK_ITEM_MAX_BYTES)
+    {
+        flushOutputSink(sink);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        sink->used += snprintf(sink->buffer + sink->used, SINK_ITEM_MAX_BYTES, i + 1 < count ? "%d " : "%d\n",
+            fields[i]);
+    }
+}
+
+/*
+ * Appends length bytes to the sink, followed by a newline. The buffer is only written out if it has no
+ * room for them; bytes may come straight from shared memory, since they are copied before returning.
+ */
+void writeSinkBytes(OutputSink *sink, char *bytes, int length)
+{
+    if (sink->fd >= 0 && sink->used > SINK_BUFFER_SIZE - length - 1)
+    {
+        flushOutputSink(sink);
+    }
+
+    /* The consumer may have gone away while the buffer was written. */
+    if (sink->fd < 0 || length >= SINK_BUFFER_SIZE)
+    {
+        return;
+    }
+
+    memcpy(sink->buffer + sink->used, bytes, length);
+    sink->buffer[sink->used + length] = '\n';
+    sink->used += length + 1;
+}
+
+/*
+ * Makes room in the buffer for bytes more bytes, writing it out first if it has not. Readers call this
+ * before they start reading an item, so that writing the buffer out never happens while they hold the
+ * writers off; the checks in the functions that append are then never reached.
+ */
+void reserveSinkSpace(OutputSink *sink, int bytes)
+{
+    if (sink->fd >= 0 && sink->used > SINK_BUFFER_SIZE - bytes)
+    {
+        flushOutputSink(sink);
+    }
+}
+
+/*
+ * Returns true if the sink holds items that have not yet been written.
+ */
+bool sinkHasPending(OutputSink *sink)
+{
+    return sink->fd >= 0 && sink->used > 0;
+}
+
+/*
+ * Writes every buffered item to the sink.
+ *
+ * If the consumer has gone away, the sink is closed and later items are discarded; the reader itself
+ * carries on so that the writers are not held up.
+ */
+void flushOutputSink(OutputSink *sink)
+{
+    int written = 0;
+    ssize_t count;
+
+    while (sink->fd >= 0 && written < sink->used)
+    {
+        count = write(sink->fd, sink->buffer + written, sink->used - written);
+        if (count > 0)
+        {
+            written += count;
+        }
+        else if (count < 0 && errno != EINTR)
+        {
+            close(sink->fd);
+            sink->fd = -1;
+        }
+    }
+
+    sink->used = 0;
+}
+
+/*
+ * Writes any buffered items and closes the sink.
+ */
+void closeOutputSink(OutputSink *sink)
+{
+    flushOutputSink(sink);
+    if (sink->fd >= 0)
+    {
+        close(sink->fd);
+        sink->fd = -1;
+    }
+}
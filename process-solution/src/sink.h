@@ -0,0 +1,53 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdbool.h>
+
+/* Prefix selecting a per-reader output file, e.g. file:/tmp/out writes /tmp/out.0, /tmp/out.1, ... */
+#define SINK_FILE_PREFIX "file:"
+
+/* Prefix selecting a per-reader named pipe, e.g. fifo:/tmp/out opens /tmp/out.0, /tmp/out.1, ... The
+ * pipes are created if they do not exist. */
+#define SINK_FIFO_PREFIX "fifo:"
+
+/* Prefix selecting a Unix-domain socket, e.g. unix:/tmp/out.sock. Each reader opens its own connection
+ * to the listening consumer. */
+#define SINK_UNIX_PREFIX "unix:"
+
+/* The number of bytes a reader buffers before it must write them to its sink. */
+#define SINK_BUFFER_SIZE (65536)
+
+/* The most bytes a single formatted item can take, including the newline. */
+#define SINK_ITEM_MAX_BYTES (16)
+
+/*
+ * A reader's output stream.
+ *
+ * Items are formatted into the buffer and written with a single system call once the buffer fills, or
+ * when the reader reaches the end of the span of slots that are available to it. Reading an item never
+ * performs a system call by itself, and a full buffer is written out before the reader starts reading the
+ * next item rather than while it reads it.
+ */
+typedef struct OutputSink
+{
+    /* The file descriptor being written to, or -1 if the reader has no sink. */
+    int fd;
+
+    /* The number of bytes in the buffer that have not yet been written. */
+    int used;
+
+    /* Formatted items waiting to be written. */
+    char buffer[SINK_BUFFER_SIZE];
+} OutputSink;
+
+int openOutputSink(OutputSink *sink, char *name, int readerId);
+void attachOutputSink(OutputSink *sink, int fd);
+void writeSinkItem(OutputSink *sink, int value);
+void writeSinkRecord(OutputSink *sink, int *fields, int count);
+void writeSinkBytes(OutputSink *sink, char *bytes, int length);
+void reserveSinkSpace(OutputSink *sink, int bytes);
+bool sinkHasPending(OutputSink *sink);
+void flushOutputSink(OutputSink *sink);
+void closeOutputSink(OutputSink *sink);
+
+#endif /* ifndef SINK_H */
@@ -0,0 +1,120 @@
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Returns the size in bytes of a statistics region for the given number of workers.
+ */
+long long statsRegionSize(int readerCount, int writerCount)
+{
+    return sizeof(StatsRegion) + (long long)(readerCount + writerCount) * sizeof(WorkerStats);
+}
+
+/*
+ * Zeroes every counter in a statistics region and records its shape.
+ */
+void initializeStatsRegion(StatsRegion *stats, int readerCount, int writerCount, int capacity)
+{
+    memset(stats, 0, statsRegionSize(readerCount, writerCount));
+    stats->readerCount = readerCount;
+    stats->writerCount = writerCount;
+    stats->capacity = capacity;
+}
+
+/*
+ * Returns the counters of the reader with the given identifier.
+ */
+WorkerStats *readerStats(StatsRegion *stats, int readerId)
+{
+    return &stats->workers[readerId];
+}
+
+/*
+ * Returns the counters of the writer with the given identifier.
+ */
+WorkerStats *writerStats(StatsRegion *stats, int writerId)
+{
+    return &stats->workers[stats->readerCount + writerId];
+}
+
+/*
+ * Sums the counters of every worker.
+ */
+static void sumStats(StatsRegion *stats, StatsTotals *totals)
+{
+    int i;
+
+    memset(totals, 0, sizeof(StatsTotals));
+    for (i = 0; i < stats->readerCount; i++)
+    {
+        totals->read += STATS_LOAD(stats->workers[i].items);
+        totals->readerWaits += STATS_LOAD(stats->workers[i].waits);
+    }
+    for (i = 0; i < stats->writerCount; i++)
+    {
+        totals->published += STATS_LOAD(writerStats(stats, i)->items);
+        totals->writerWaits += STATS_LOAD(writerStats(stats, i)->waits);
+        totals->evictions += STATS_LOAD(writerStats(stats, i)->evictions);
+    }
+}
+
+/*
+ * Prints a single line describing the run since the previous sample: publish and read throughput, the
+ * lag of the slowest reader, how many slots hold unread items, and how often workers waited. The line is
+ * prefixed with the channel's name, unless it is NULL. The current totals are then saved in previous for
+ * the next sample.
+ */
+void printStatsSample(FILE *fPtr, StatsRegion *stats, StatsTotals *previous, char *channelName)
+{
+    long long cursor, slowestCursor = 0, lag;
+    int i, slowest = -1, capacity = STATS_LOAD(stats->capacity);
+    StatsTotals totals;
+
+    sumStats(stats, &totals);
+
+    for (i = 0; i < stats->readerCount; i++)
+    {
+        cursor = STATS_LOAD(stats->workers[i].cursor);
+        if (slowest < 0 || cursor < slowestCursor)
+        {
+            slowest = i;
+            slowestCursor = cursor;
+        }
+    }
+
+    if (channelName != NULL)
+    {
+        fprintf(fPtr, "%s: ", channelName);
+    }
+    fprintf(fPtr, "published %lld/s, read %lld/s", (totals.published - previous->published) / STATS_INTERVAL,
+        (totals.read - previous->read) / STATS_INTERVAL);
+    if (slowest >= 0)
+    {
+        lag = totals.published - slowestCursor;
+        fprintf(fPtr, ", slowest reader %d lag %lld, occupancy %lld/%d", slowest, lag,
+            lag < capacity ? lag : (long long)capacity, capacity);
+    }
+    fprintf(fPtr, ", reader waits %lld/s, writer waits %lld/s, lagging readers released %lld\n",
+        (totals.readerWaits - previous->readerWaits) / STATS_INTERVAL,
+        (totals.writerWaits - previous->writerWaits) / STATS_INTERVAL, totals.evictions);
+    fflush(fPtr);
+
+    *previous = totals;
+}
+
+/*
+ * Prints a sample of the statistics of a channel every STATS_INTERVAL seconds until the run finishes.
+ */
+void monitorStats(FILE *fPtr, StatsRegion *stats, char *channelName)
+{
+    StatsTotals previous;
+
+    memset(&previous, 0, sizeof(StatsTotals));
+    while (!STATS_LOAD(stats->finished))
+    {
+        sleep(STATS_INTERVAL);
+        printStatsSample(fPtr, stats, &previous, channelName);
+    }
+}
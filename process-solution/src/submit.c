@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "daemon.h"
+
+/*
+ * Entry point for sds-submit.
+ *
+ * Submits a job to a daemon started with --daemon SOCKET, waits for it to finish, and prints the daemon's
+ * report:
+ *     ./bin/sds-submit SOCKET SOURCE [READERS [WRITERS [SINK]]]
+ * "./bin/sds-submit SOCKET stop" stops the daemon instead.
+ *
+ * Returns 0 if the job completed without errors, or 1 otherwise.
+ */
+int main(int argc, char **argv)
+{
+    char request[DAEMON_REQUEST_SIZE], reply[DAEMON_REQUEST_SIZE];
+    struct sockaddr_un addr;
+    int fd, idx, length = 0;
+    ssize_t count;
+    bool failed = false;
+
+    if (argc < 3)
+    {
+        printf("Usage: %s SOCKET SOURCE [READERS [WRITERS [SINK]]]\n", argv[0]);
+        return 1;
+    }
+
+    /* A request is the arguments after the socket, on a line of their own. */
+    request[0] = '\0';
+    for (idx = 2; idx < argc; idx++)
+    {
+        length += snprintf(request + length, sizeof(request) - length, "%s%s", argv[idx],
+            idx + 1 < argc ? " " : "\n");
+        if (length >= (int)sizeof(request))
+        {
+            printf("Error: The request is longer than %d bytes.\n", DAEMON_REQUEST_SIZE - 1);
+            return 1;
+        }
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, argv[1], sizeof(addr.sun_path) - 1);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+    {
+        printf("Error: Could not connect to %s; is the daemon running?\n", argv[1]);
+        return 1;
+    }
+
+    if (write(fd, request, length) != length)
+    {
+        printf("Error: Could not submit the job to %s.\n", argv[1]);
+        close(fd);
+        return 1;
+    }
+
+    /* The daemon replies once the job has finished, then closes the connection. */
+    while ((count = read(fd, reply, sizeof(reply) - 1)) > 0)
+    {
+        reply[count] = '\0';
+        failed = failed || strstr(reply, "Error:") != NULL;
+        fputs(reply, stdout);
+    }
+    close(fd);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shared.h"
+#include "channel.h"
+#include "stats.h"
+
+/*
+ * Opens the worker statistics of a running sds read-only, waiting for the run to create them.
+ *
+ * The region is mapped without write access, so the monitor cannot disturb the workers it watches.
+ *
+ * Returns the mapped region.
+ */
+static StatsRegion *attachStats()
+{
+    int fd;
+    struct stat info;
+    void *ptr;
+
+    while ((fd = shm_open(segmentName(WORKER_STATS_NAME), O_RDONLY, 0)) < 0 || fstat(fd, &info) || info.st_size <
+        (off_t)sizeof(StatsRegion))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        sleep(STATS_INTERVAL);
+    }
+
+    ptr = mmap(0, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    return ptr == MAP_FAILED ? NULL : (StatsRegion *)ptr;
+}
+
+/*
+ * Entry point for sds-top.
+ *
+ * Attaches to the worker statistics of a running sds and prints a sample every STATS_INTERVAL seconds
+ * until the run finishes. "--name NAME" and "--channel CHANNEL" pick the run and the channel to watch,
+ * as given to sds.
+ */
+int main(int argc, char **argv)
+{
+    StatsRegion *stats;
+    char *instanceName = NULL, *channelName = NULL;
+    int idx;
+
+    for (idx = 1; idx + 1 < argc; idx += 2)
+    {
+        if (!strcmp(argv[idx], "--name"))
+        {
+            instanceName = argv[idx + 1];
+        }
+        else if (!strcmp(argv[idx], "--channel"))
+        {
+            channelName = argv[idx + 1];
+        }
+    }
+    nameSegments(instanceName, channelName);
+
+    stats = attachStats();
+    if (stats == NULL)
+    {
+        printf("Error: Could not map %s.\n", segmentName(WORKER_STATS_NAME));
+        return 1;
+    }
+
+    monitorStats(stdout, stats, channelName);
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef USDT_H
+#define USDT_H
+
+/*
+ * A minimal stand-in for sys/sdt.h, for x86-64 builds without systemtap-sdt-dev.
+ *
+ * A probe is a nop, whose address is recorded in an ELF note in the .note.stapsdt section along with the
+ * provider and probe names and where to find each argument, in the format bpftrace, perf and gdb read
+ * from sys/sdt.h's probes. Arguments are integers of up to 8 bytes; each is described by its size,
+ * negative if it is signed, and the register, memory operand or constant the compiler kept it in.
+ */
+
+/* The size of an argument as the note describes it: negative for a signed type. */
+#define USDT_ARG_SIZE(arg) ((__typeof__(arg))-1 < 1 ? -(int)sizeof(arg) : (int)sizeof(arg))
+
+#define USDT_PROBE3(provider, name, arg1, arg2, arg3) \
+    __asm__ __volatile__( \
+        "990: nop\n" \
+        ".pushsection .note.stapsdt,\"\",\"note\"\n" \
+        ".balign 4\n" \
+        ".4byte 992f-991f, 994f-993f, 3\n" \
+        "991: .asciz \"stapsdt\"\n" \
+        "992: .balign 4\n" \
+        "993: .8byte 990b\n" \
+        ".8byte _.stapsdt.base\n" \
+        ".8byte 0\n" \
+        ".asciz \"" #provider "\"\n" \
+        ".asciz \"" #name "\"\n" \
+        ".asciz \"%c3@%0 %c4@%1 %c5@%2\"\n" \
+        "994: .balign 4\n" \
+        ".popsection\n" \
+        ".ifndef _.stapsdt.base\n" \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+        ".weak _.stapsdt.base\n" \
+        ".hidden _.stapsdt.base\n" \
+        "_.stapsdt.base: .space 1\n" \
+        ".size _.stapsdt.base, 1\n" \
+        ".popsection\n" \
+        ".endif\n" \
+        : \
+        : "nor"(arg1), "nor"(arg2), "nor"(arg3), "n"(USDT_ARG_SIZE(arg1)), "n"(USDT_ARG_SIZE(arg2)), \
+          "n"(USDT_ARG_SIZE(arg3)))
+
+#endif /* ifndef USDT_H */
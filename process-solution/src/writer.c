@@ -1,40 +1,210 @@
+/* For gettid(). */
+#define _GNU_SOURCE
+
 #include "writer.h"
 
 /*
- * Reads a single data item from the file.
+ * Holds the buffer against readers while this writer publishes an item. If readers are reading, then wait
+ * for the last of them to finish, giving up the mutex lock on the count of readers while waiting.
+ *
+ * The writer is recorded as holding the buffer in the same step as it takes it, so that the parent can
+ * give the buffer back if the writer dies.
  */
-static int readNextDataItem(RWConfig *rwConfig)
+static void startWriting(RWConfig *rwConfig)
 {
-    int rRemaining = rwConfig->writes + 1, val;
-    FILE *fPtrSharedData = fopen(SHARED_FILE_NAME, "r");
+    lockMutex(&rwConfig->rcMutex);
+    while (rwConfig->activeReaders || rwConfig->rwWriter)
+    {
+        rwConfig->rwWaiters++;
+        pthread_mutex_unlock(&rwConfig->rcMutex);
+        sem_wait(&rwConfig->rwCond);
+        lockMutex(&rwConfig->rcMutex);
+    }
+    rwConfig->rwWriter = getpid();
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+}
 
-    /*
-     * Since processes do not share resources such as files, we need to consume the integers that other
-     * writers have already read from the file.
-     */
-    while (rRemaining--)
+/*
+ * Gives the buffer back to readers once this writer has published its item, waking any waiting for it.
+ */
+static void stopWriting(RWConfig *rwConfig)
+{
+    lockMutex(&rwConfig->rcMutex);
+    rwConfig->rwWriter = 0;
+    wakeRwWaiters(rwConfig);
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+}
+
+/*
+ * Releases every reader that is holding up the slot at idx and has fallen further behind than the lag
+ * limits allow. The slot is rwConfig->idxWrite, or with an arena the slot of the oldest item whose payload
+ * the next one would overwrite; either way it holds the oldest item a writer waits on, so a reader holds
+ * it up if it has not yet read that item. A released reader no longer holds any slot: it is either
+ * detached, or made to catch up to the next item published.
+ *
+ * Must be called with rwConfig->writeMutex and rwConfig->rpMutex held.
+ *
+ * Returns the number of readers released.
+ */
+static int releaseLaggingReaders(RWConfig *rwConfig, ReaderState *readerStates, int *pendingReads,
+    int *sequence, long long *publishTimes, int idx)
+{
+    ProgramConfig *pConfig = &rwConfig->pConfig;
+    ReaderState *state;
+    int i, released = 0, oldest = sequence[idx];
+    long long age = readClockNs() - publishTimes[idx];
+
+    /* Readers that attached while the run is going are released like any other reader, though the
+     * journal reader and the consumer group members in between are not. */
+    for (i = 0; i < READER_STATE_COUNT(*pConfig); i++)
     {
-        fscanf(fPtrSharedData, "%d", &val);
+        state = &readerStates[i];
+        if ((i >= pConfig->readerCount && i < READER_STATE_INDEX(*pConfig, pConfig->readerCount +
+            pConfig->memberCount)) || state->detached || state->cursor > oldest ||
+            !((pConfig->maxLagItems && rwConfig->writes - state->cursor >= pConfig->maxLagItems) ||
+            (pConfig->maxLagNs && age >= pConfig->maxLagNs)))
+        {
+            continue;
+        }
+
+        /* Give up the reader's claim on every item it has not yet read. */
+        if (pConfig->lagPolicy == LAG_POLICY_DETACH)
+        {
+            detachReader(rwConfig, state, pendingReads, sequence);
+        }
+        else
+        {
+            releaseReader(rwConfig, state, pendingReads, sequence);
+            state->cursor = rwConfig->writes;
+        }
+        released++;
     }
 
-    fclose(fPtrSharedData);
-    return val;
+    return released;
 }
 
 /*
- * Writes to a shared memory buffer the values read from a file.
+ * Moves the item in the slot at rwConfig->idxWrite to the spill file, so that the slot can be written
+ * without waiting for the readers that have not yet read it. They will read it from the spill file.
+ *
+ * Must be called with rwConfig->writeMutex and rwConfig->rpMutex held.
+ *
+ * Returns false if spilling is disabled or the spill file is full.
  */
-void writer()
+static bool spillOldestItem(RWConfig *rwConfig, int *data, int *pendingReads, int *sequence, int *writerIds,
+    long long *publishTimes)
 {
-    RWConfig *rwConfig = NULL;
-    int value, *data = NULL, selfWrites = 0, *pendingReads;
-    bool done = false;
+    int idx = rwConfig->idxWrite;
+
+    if (!appendSpillRecord(&rwConfig->spill, sequence[idx], writerIds[idx], publishTimes[idx], data[idx]))
+    {
+        return false;
+    }
 
-    data = (int *)openSharedMemory(SHARED_FILE_BUFFER_NAME, SHM_BUFFER_SIZE);
+    pendingReads[idx] = 0;
+    sequence[idx] = SEQUENCE_SPILLED;
 
-    rwConfig = (RWConfig *)openSharedMemory(SHARED_CONFIG_NAME, SHARED_CONFIG_SIZE);
+    return true;
+}
+
+/*
+ * Moves the arena's tail up to the payload of the oldest item some consumer still holds a claim on, or to
+ * its head if none does. Claims are given up as items are read, so the slots and the arena free up
+ * together. Every item before the previous generation of an elastic buffer has been read by everyone.
+ *
+ * Must be called with rwConfig->writeMutex and rwConfig->rpMutex held.
+ */
+static void reclaimArena(RWConfig *rwConfig, ArenaDescriptor *descriptors, int *pendingReads, int *sequence)
+{
+    Arena *arena = &rwConfig->arena;
+    int tail = arena->tailSequence, slot = 0;
+
+    tail = tail > rwConfig->ring.previous.start ? tail : rwConfig->ring.previous.start;
+    while (tail < rwConfig->writes && (sequence[slot = ringSlot(&rwConfig->ring, tail)] != tail ||
+        !pendingReads[slot]))
+    {
+        tail++;
+    }
 
-    pendingReads = openSharedMemory(PENDING_READS_NAME, SHM_BUFFER_SIZE);
+    arena->tailSequence = tail;
+    arena->tail = tail < rwConfig->writes ? descriptors[slot].position : arena->head;
+}
+
+/*
+ * Returns true if the arena has no room for a payload of length bytes until consumers read more of the
+ * items before it, or false if it does or there is no arena.
+ *
+ * Must be called with rwConfig->writeMutex and rwConfig->rpMutex held.
+ */
+static bool arenaFull(RWConfig *rwConfig, ArenaDescriptor *descriptors, int *pendingReads, int *sequence,
+    int length)
+{
+    if (!rwConfig->arena.size)
+    {
+        return false;
+    }
+
+    reclaimArena(rwConfig, descriptors, pendingReads, sequence);
+
+    return !arenaHasRoom(&rwConfig->arena, length);
+}
+
+/*
+ * Grows an elastic buffer that writers keep finding full, or shrinks one that readers keep up with, before
+ * the next item is published. The new generation begins with that item, in the bank the previous
+ * generation used; readers finish the current generation first, then follow the writers into the new one.
+ *
+ * Must be called with rwConfig->writeMutex and rwConfig->rpMutex held.
+ */
+static void resizeRing(RWConfig *rwConfig, ReaderState *readerStates, int *pendingReads, StatsRegion *stats)
+{
+    int oldest;
+
+    if (!ringIsElastic(&rwConfig->ring))
+    {
+        return;
+    }
+
+    oldest = oldestUnread(rwConfig, readerStates);
+    if (adjustRing(&rwConfig->ring, rwConfig->writes, pendingReads[rwConfig->idxWrite] != 0,
+        rwConfig->writes - oldest, oldest >= rwConfig->ring.current.start))
+    {
+        rwConfig->idxWrite = rwConfig->ring.current.base;
+        STATS_STORE(stats->capacity, rwConfig->ring.current.capacity);
+        printf("Resized the buffer to %d slots from item #%d.\n", rwConfig->ring.current.capacity,
+            rwConfig->writes);
+    }
+}
+
+/*
+ * Writer thread callback.
+ *
+ * Writes to a shared memory buffer the values read from a file, as one of the writers a writer process
+ * hosts.
+ */
+static void *writerThread(void *vpThread)
+{
+    WriterThread *thread = (WriterThread *)vpThread;
+    RWConfig *rwConfig = thread->rwConfig;
+    LocalWriters *local = thread->local;
+    int value, *data = local->data, selfWrites = 0, *pendingReads = local->pendingReads,
+        *sequence = local->sequence, *writerIds = local->writerIds, id = thread->id, released,
+        stride = itemStride(rwConfig->pConfig.itemFields), i, waitIdx;
+    ArenaDescriptor *descriptors = (ArenaDescriptor *)data;
+    UnpublishedItem *unpublished;
+    char *payload = NULL;
+    long long position;
+    _Alignas(ITEM_ALIGNMENT) int fields[MAX_ITEM_FIELDS] = { 0 };
+    long long *publishTimes = local->publishTimes, waitStart;
+    unsigned long long hash = 0;
+    bool done = false, hasValue, lagLimited;
+    StatsRegion *statsRegion = local->statsRegion;
+    WorkerStats *stats = thread->stats;
+    ReaderState *readerStates = local->readerStates;
+    struct timespec deadline;
+    const ChecksumKernel *kernel = local->checksums != NULL ? selectChecksumKernel() : NULL;
+
+    lagLimited = rwConfig->pConfig.maxLagItems || rwConfig->pConfig.maxLagNs;
 
     while (!done)
     {
@@ -42,15 +212,59 @@ void writer()
          * issues may occur and writers may overwrite to the buffer.
          *
          * We cannot simply write
-         *     while (rwConfig->writes < NUM_ELEMENTS_DATA_FILE) ...
+         *     while (!rwConfig->eof) ...
          * because:
          * 1. We need to acquire a mutex lock in order to prevent synchronisation issues of rwConfig->writes.
          * 2. Each writer must be able to cooperate, i.e. a writer may release the mutex lock after each
          *    write, not only after it is completely exhausted the total write count.
          */
 
-        /* Only allow one writer to read/write to the writer count simultaneously. */
-        sem_wait(&rwConfig->writeSem);
+        /* Only allow one writer to read/write to the writer count simultaneously. The writers of this
+         * process take turns first, so that only one of them at a time contends with other processes. */
+        pthread_mutex_lock(&local->writeMutex);
+        lockWriters(rwConfig, pendingReads, sequence);
+
+        /*
+         * Read the next value from the input source. The source is shared by all writers and is
+         * synchronised by rwConfig->writeMutex. It is read before holding the buffer against readers, so
+         * that they are not held up while a slow producer fills the pipe or socket.
+         *
+         * An item a writer died holding is published first, in place of the next from the source.
+         */
+        unpublished = &rwConfig->unpublished;
+        if (unpublished->holding)
+        {
+            hasValue = true;
+            value = unpublished->value;
+            payload = unpublished->payload;
+            memcpy(fields, unpublished->fields, rwConfig->pConfig.itemFields * sizeof(int));
+        }
+        else
+        {
+            hasValue = !rwConfig->eof && (rwConfig->arena.size ?
+                readNextSourceLine(&rwConfig->source, &payload, &value) :
+                readNextSourceItem(&rwConfig->source, &value));
+
+            /* An item of more than one field takes the values that follow for the rest of its fields. A
+             * source that ends part way through an item leaves the rest of them zero. */
+            for (i = 1; hasValue && i < rwConfig->pConfig.itemFields; i++)
+            {
+                if (!readNextSourceItem(&rwConfig->source, &fields[i]))
+                {
+                    fields[i] = 0;
+                }
+            }
+
+            if (hasValue)
+            {
+                unpublished->sequence = rwConfig->writes;
+                unpublished->value = value;
+                unpublished->payload = payload;
+                memcpy(unpublished->fields, fields, rwConfig->pConfig.itemFields * sizeof(int));
+                unpublished->arenaHead = rwConfig->arena.head;
+                unpublished->holding = true;
+            }
+        }
 
         /*
          * It's possible that the writer encounters a buffer that has not been fully read. In this case,
@@ -61,104 +275,375 @@ void writer()
          * readers will only wait if they cannot read the buffer slot they are up to, but this condition
          * only occurs if all buffer slots have been fully read; the conditions for waiting are mutually
          * exclusive, so no deadlock can occur.
+         *
+         * In overwrite mode, never wait: the oldest item is overwritten, and readers that had not read it
+         * skip ahead.
+         *
+         * An elastic buffer first grows if writers keep finding it full, or shrinks if it is mostly empty.
+         *
+         * With an arena, the item's payload also needs room in it, which is freed as the items before it
+         * are read, so we wait for both.
          */
-        sem_wait(&rwConfig->rpSem);
-        while (pendingReads[rwConfig->idxWrite])
+        waitStart = 0;
+        lockMutex(&rwConfig->rpMutex);
+        if (hasValue)
+        {
+            resizeRing(rwConfig, readerStates, pendingReads, statsRegion);
+        }
+        while (hasValue && !rwConfig->pConfig.overwrite && (pendingReads[rwConfig->idxWrite] ||
+            arenaFull(rwConfig, descriptors, pendingReads, sequence, value)))
         {
             /*
              * We cannot write because a reader is waiting to read this. Wait until a reader reports that
              * it has finished reading, and check again.
              *
-             * On each wait, we need to release the mutex for the pending reads, because otherwise the
-             * readers will be stuck in a deadlock trying to acquire this mutex lock.
-             */
-            sem_post(&rwConfig->rpSem);
-
-            /*
              * Ensure that no other processes can change fullWaiters while we are attempting to increment it.
              *
              * We need this to ensure readers sem_post fullCond often enough to allow all writers a chance to
-             * check. Otherwise, we may eventually run out of readers to read, causing a deadlock.
+             * check. Otherwise, we may eventually run out of readers to read, causing a deadlock. We count
+             * ourselves as a waiter before releasing the pending reads mutex, so that a reader that
+             * decrements pendingReads after we checked it is guaranteed to see us and wake us.
+             *
+             * On each wait, we need to release the mutex for the pending reads, because otherwise the
+             * readers will be stuck in a deadlock trying to acquire this mutex lock.
+             *
+             * After releasing, put the process to sleep until awoken by a reader's sem_post.
              *
-             * After incrementing, put the process to sleep until awoken by a writer's sem_post.
+             * With a spill file, move the item to it rather than wait; we only wait once it is full.
+             *
+             * If the readers holding us up have fallen too far behind, stop waiting for them instead. With
+             * a time limit, wake when the item in the slot reaches it, to check again.
              */
-            sem_wait(&rwConfig->fullWaitersSem);
+            if (spillOldestItem(rwConfig, data, pendingReads, sequence, writerIds, publishTimes))
+            {
+                continue;
+            }
+
+            waitIdx = pendingReads[rwConfig->idxWrite] ? rwConfig->idxWrite :
+                ringSlot(&rwConfig->ring, rwConfig->arena.tailSequence);
+            if (lagLimited)
+            {
+                released = releaseLaggingReaders(rwConfig, readerStates, pendingReads, sequence, publishTimes,
+                    waitIdx);
+                if (released)
+                {
+                    STATS_STORE(stats->evictions, stats->evictions + released);
+                    continue;
+                }
+            }
+
+            lockMutex(&rwConfig->fullWaitersMutex);
             rwConfig->fullWaiters++;
-            sem_post(&rwConfig->fullWaitersSem);
-            sem_wait(&rwConfig->fullCond);
+            pthread_mutex_unlock(&rwConfig->fullWaitersMutex);
+            pthread_mutex_unlock(&rwConfig->rpMutex);
+            if (!waitStart)
+            {
+                waitStart = readClockNs();
+                STATS_STORE(stats->waits, stats->waits + 1);
+                SDS_PROBE(writer_wait_begin, rwConfig->writes, rwConfig->idxWrite, id);
+            }
+            if (rwConfig->pConfig.maxLagNs)
+            {
+                readDeadline(&deadline, publishTimes[waitIdx] + rwConfig->pConfig.maxLagNs);
+                sem_timedwait(&rwConfig->fullCond, &deadline);
+            }
+            else
+            {
+                sem_wait(&rwConfig->fullCond);
+            }
+            STATS_STORE(stats->wakeups, stats->wakeups + 1);
 
-            sem_wait(&rwConfig->rpSem);
+            lockMutex(&rwConfig->rpMutex);
         }
-        sem_post(&rwConfig->rpSem);
 
-        sem_wait(&rwConfig->rwSem);
+        /* In overwrite mode, the slot is marked as being written before it is overwritten, since readers
+         * copy items out without holding us off; see readStream(). */
+        if (hasValue && rwConfig->pConfig.overwrite)
+        {
+            sequence[rwConfig->idxWrite] = SEQUENCE_WRITING;
+        }
+        pthread_mutex_unlock(&rwConfig->rpMutex);
 
-        if (rwConfig->writes < NUM_ELEMENTS_DATA_FILE)
+        if (waitStart)
         {
+            STATS_STORE(stats->waitNs, stats->waitNs + readClockNs() - waitStart);
+            SDS_PROBE(writer_wait_end, rwConfig->writes, rwConfig->idxWrite, id);
+        }
+        if (hasValue)
+        {
+            SDS_PROBE(slot_claim, rwConfig->writes, rwConfig->idxWrite, id);
+        }
 
-            /* Read value from file. */
-            value = readNextDataItem(rwConfig);
+        /* In overwrite mode, writers never wait for readers, so they do not hold the buffer against them
+         * either. */
+        if (!rwConfig->pConfig.overwrite)
+        {
+            startWriting(rwConfig);
+        }
 
+        if (hasValue)
+        {
             /*
              * Place value in buffer. Since only one writer can be executing in its critical section
              * simultaneously, rwConfig->idxWrite is guaranteed to be synchronised, as only writers
              * access this value. Variables rwConfig->writes, selfWrites must also be updated; these are
              * also synchronised for the same reason. 
              */
-            data[rwConfig->idxWrite] = value;
+            if (rwConfig->arena.size)
+            {
+                /* The payload is copied straight from the source's buffer into the arena, and the slot
+                 * only says where it lies. */
+                position = reserveArena(&rwConfig->arena, value);
+                memcpy(local->arena + position % rwConfig->arena.size, payload, value);
+                descriptors[rwConfig->idxWrite].position = position;
+                descriptors[rwConfig->idxWrite].length = value;
+            }
+            else if (stride == 1)
+            {
+                data[rwConfig->idxWrite] = value;
+            }
+            else
+            {
+                fields[0] = value;
+                memcpy(&data[rwConfig->idxWrite * stride], fields, stride * sizeof(int));
+            }
+            writerIds[rwConfig->idxWrite] = id;
+            publishTimes[rwConfig->idxWrite] = readClockNs();
             rwConfig->writes++;
             selfWrites++;
-            printf("Write #%d/%d (%d) to data buffer index %d\n", selfWrites, rwConfig->writes, value,
-                rwConfig->idxWrite);
+            STATS_STORE(stats->items, selfWrites);
+            STATS_STORE(stats->cursor, rwConfig->writes);
+            if (rwConfig->pConfig.trace)
+            {
+                printf("Write #%d/%d (%d) to data buffer index %d\n", selfWrites, rwConfig->writes, value,
+                    rwConfig->idxWrite);
+            }
+
+            /* With --verify, the item is hashed with its sequence number before taking rpMutex, so that
+             * only the sum is added while holding it. A payload is hashed as the bytes readers forward. */
+            if (kernel != NULL && rwConfig->arena.size)
+            {
+                hash = hashItem(kernel, rwConfig->writes - 1, payload, value);
+            }
+            else if (kernel != NULL)
+            {
+                hash = hashItem(kernel, rwConfig->writes - 1, stride == 1 ? &value : fields,
+                    rwConfig->pConfig.itemFields * sizeof(int));
+            }
 
             /*
              * Reset the pending reads to ensure readers can begin reading again. We still have the mutex
              * lock rwConfig->rpMutex, so we can do this.
              *
              * On resetting, release the mutex lock. We don't need to change pendingReads again.
+             *
+             * Filtering readers skip whole blocks by their summaries, so the item is added to its block's
+             * summary as it is published. Likewise, verifying readers check their checksums against the
+             * writers', so the item is added to those of its range and of the whole stream.
              */
-            sem_wait(&rwConfig->rpSem);
-            pendingReads[rwConfig->idxWrite] = rwConfig->pConfig.readerCount;
-            sem_post(&rwConfig->rpSem);
+            lockMutex(&rwConfig->rpMutex);
+            pendingReads[rwConfig->idxWrite] = rwConfig->consumers;
+            sequence[rwConfig->idxWrite] = rwConfig->writes - 1;
+            if (local->summaries != NULL)
+            {
+                summarizeItem(local->summaries, BLOCK_SUMMARY_COUNT(rwConfig), rwConfig->writes - 1, value,
+                    hash);
+            }
+            if (local->checksums != NULL)
+            {
+                addItemChecksum(local->checksums, &rwConfig->published, rwConfig->writes - 1, hash);
+            }
+            pthread_mutex_unlock(&rwConfig->rpMutex);
+            unpublished->holding = false;
+            SDS_PROBE(publish, rwConfig->writes - 1, rwConfig->idxWrite, id);
 
             /*
              * Writers must progress to the next buffer slot. This is bound to rwConfig->writeMutex, which
              * ensures that only one writer will ever access rwConfig->idxWrite is accessed simultaneously.
              */
-            rwConfig->idxWrite = (rwConfig->idxWrite + 1) % SHM_BUFFER_SIZE;
-
+            rwConfig->idxWrite = ringSlot(&rwConfig->ring, rwConfig->writes);
+        }
+        else if (!rwConfig->eof)
+        {
+            /*
+             * The input source is exhausted. Propagate end-of-stream to the readers: rwConfig->writes is
+             * now the total number of items, and readers stop once they have read that many.
+             */
+            lockMutex(&rwConfig->rpMutex);
+            rwConfig->eof = true;
+            pthread_mutex_unlock(&rwConfig->rpMutex);
+        }
+        if (!rwConfig->pConfig.overwrite)
+        {
+            stopWriting(rwConfig);
         }
-        sem_post(&rwConfig->rwSem);
 
         /* If we've reached the end, signal that we are done. */
-        done = !(rwConfig->writes < NUM_ELEMENTS_DATA_FILE);
-        sem_post(&rwConfig->writeSem);
+        done = rwConfig->eof;
+        pthread_mutex_unlock(&rwConfig->writeMutex);
+        pthread_mutex_unlock(&local->writeMutex);
 
         /*
          * If any readers were waiting because their buffers were empty (fully read), then we need to
          * wake them up.
          *
-         * This relies on the emptyWaiters being synchronised correctly. As such, we need a semaphore
+         * This relies on the emptyWaiters being synchronised correctly. As such, we need a mutex
          * to provide mutual exclusion.
          */
-        sem_wait(&rwConfig->emptyWaitersSem);
+        lockMutex(&rwConfig->emptyWaitersMutex);
         while (rwConfig->emptyWaiters > 0)
         {
             sem_post(&rwConfig->emptyCond);
             rwConfig->emptyWaiters--;
         }
-        sem_post(&rwConfig->emptyWaitersSem);
+        pthread_mutex_unlock(&rwConfig->emptyWaitersMutex);
 
         /* Per specification: sleep after writing and updating the counter. */
         sleep(rwConfig->pConfig.writerSleepTime);
     }
 
+    SDS_PROBE(writer_exit, selfWrites, -1, id);
+
     /*
      * Write the number of writes to file.
      *
-     * Per discussion with Soh: For multithreading solution, use thread ID instead of process ID.
+     * Per discussion with Soh: For multithreading solution, use thread ID instead of process ID. A process
+     * hosting several writers reports each by its thread.
      */
-    simWriteFinish("writer", "writing", "to", getpid(), selfWrites);
+    simWriteFinish("writer", "writing", "to", gettid(), selfWrites);
+    thread->writes = selfWrites;
+
+    return NULL;
+}
+
+/*
+ * Opens a writer process's view of a buffer, mapping each of the buffer's shared memory segments that
+ * writers use.
+ */
+static void openLocalWriters(RWConfig *rwConfig, LocalWriters *local)
+{
+    local->data = (int *)openSharedMemory(SHARED_FILE_BUFFER_NAME, SHARED_FILE_BUFFER_SIZE(rwConfig));
+
+    local->arena = rwConfig->arena.size ? (char *)openSharedMemory(ARENA_NAME, rwConfig->arena.size) : NULL;
+
+    local->summaries = rwConfig->pConfig.filterCount ? (BlockSummary *)openSharedMemory(BLOCK_SUMMARY_NAME,
+        BLOCK_SUMMARY_COUNT(rwConfig) * sizeof(BlockSummary)) : NULL;
+
+    local->checksums = rwConfig->pConfig.verify ? (RangeChecksum *)openSharedMemory(RANGE_CHECKSUM_NAME,
+        CHECKSUM_RANGES * sizeof(RangeChecksum)) : NULL;
+
+    local->pendingReads = openSharedMemory(PENDING_READS_NAME, rwConfig->ring.slots * sizeof(int));
+
+    local->sequence = (int *)openSharedMemory(SLOT_SEQUENCE_NAME, rwConfig->ring.slots * sizeof(int));
+
+    local->writerIds = (int *)openSharedMemory(SLOT_WRITER_NAME, rwConfig->ring.slots * sizeof(int));
+
+    local->publishTimes = (long long *)openSharedMemory(SLOT_TIME_NAME, rwConfig->ring.slots * sizeof(long long));
+
+    local->readerStates = (ReaderState *)openSharedMemory(READER_STATE_NAME, READER_STATE_SIZE(rwConfig->pConfig));
+
+    /* Open shared memory to the worker statistics. Each writer only stores to its own counters. */
+    local->statsRegion = (StatsRegion *)openSharedMemory(WORKER_STATS_NAME,
+        statsRegionSize(rwConfig->pConfig.readerCount, rwConfig->pConfig.writerCount));
+
+    pthread_mutex_init(&local->writeMutex, NULL);
+}
+
+/*
+ * Writer process callback.
+ *
+ * Writes to a shared memory buffer the values read from a file. With --threads M, the process hosts the
+ * next M writers as threads of its own, sharing its mappings of the buffer. A writer started in place of
+ * a process that died hosts a single writer.
+ */
+void writer()
+{
+    RWConfig *rwConfig = NULL;
+    LocalWriters local;
+    WriterThread *threads;
+    int first, count, i;
+
+    rwConfig = (RWConfig *)openSharedMemory(SHARED_CONFIG_NAME, SHARED_CONFIG_SIZE);
+
+    openLocalWriters(rwConfig, &local);
+
+    /* Take the next block of writer identifiers. Published items are stamped with them. */
+    lockWriters(rwConfig, local.pendingReads, local.sequence);
+    first = rwConfig->nextWriterId;
+    count = workerBlock(rwConfig->pConfig.writerCount, rwConfig->pConfig.threadsPerProcess, first);
+    count = count ? count : 1;
+    rwConfig->nextWriterId += count;
+    pthread_mutex_unlock(&rwConfig->writeMutex);
+
+    threads = (WriterThread *)malloc(count * sizeof(WriterThread));
+    for (i = 0; i < count; i++)
+    {
+        threads[i].rwConfig = rwConfig;
+        threads[i].local = &local;
+        threads[i].id = first + i;
+        memset(&threads[i].replacementStats, 0, sizeof(WorkerStats));
+        threads[i].stats = first + i < rwConfig->pConfig.writerCount ?
+            writerStats(local.statsRegion, first + i) : &threads[i].replacementStats;
+    }
+
+    /* A process hosting a single writer writes on its own thread. */
+    if (count == 1)
+    {
+        writerThread(&threads[0]);
+    }
+    else
+    {
+        for (i = 0; i < count; i++)
+        {
+            pthread_create(&threads[i].thread, NULL, &writerThread, &threads[i]);
+        }
+        for (i = 0; i < count; i++)
+        {
+            pthread_join(threads[i].thread, NULL);
+        }
+    }
+    free(threads);
+
+    exit(0);
+}
+
+/*
+ * Pool writer process callback.
+ *
+ * Maps the buffer and takes a writer identifier once, then publishes the stream of every job the daemon
+ * hands it that it takes part in, until the daemon stops. The daemon hands each writer the job's input
+ * source along with the job, which it reads through the descriptor number the shared source names, and
+ * lets go of once the job is done. It reports how many items it published in each job, none for a job it
+ * sat out.
+ */
+void poolWriter()
+{
+    LocalWriters local;
+    WriterThread thread;
+    PoolJob job;
+    RWConfig *rwConfig = (RWConfig *)openSharedMemory(SHARED_CONFIG_NAME, SHARED_CONFIG_SIZE);
+
+    openLocalWriters(rwConfig, &local);
+
+    /* Take a writer identifier for every job to come. Published items are stamped with it. */
+    lockWriters(rwConfig, local.pendingReads, local.sequence);
+    thread.id = rwConfig->nextWriterId++;
+    pthread_mutex_unlock(&rwConfig->writeMutex);
+
+    thread.rwConfig = rwConfig;
+    thread.local = &local;
+    thread.stats = writerStats(local.statsRegion, thread.id);
+
+    while (awaitPoolJob(&job, rwConfig->source.fd))
+    {
+        thread.writes = 0;
+        if (thread.id < job.writers)
+        {
+            writerThread(&thread);
+        }
+        releasePoolSource(rwConfig->source.fd);
+        finishPoolJob(thread.writes);
+    }
 
     exit(0);
 }
@@ -4,9 +4,46 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "shared.h"
 #include "simwrite.h"
+#include "pool.h"
+
+/*
+ * A writer process's own view of a buffer: its mappings of the buffer's shared memory, opened once for
+ * every writer thread the process hosts, and the private lock those threads take in turn before the
+ * shared writeMutex, so that only one thread of each process contends on it.
+ */
+typedef struct LocalWriters
+{
+    int *data;
+    char *arena;
+    BlockSummary *summaries;
+    RangeChecksum *checksums;
+    int *pendingReads;
+    int *sequence;
+    int *writerIds;
+    long long *publishTimes;
+    ReaderState *readerStates;
+    StatsRegion *statsRegion;
+    pthread_mutex_t writeMutex;
+} LocalWriters;
+
+/*
+ * One of the writers a writer process hosts, and what it published. A writer started in place of one
+ * that died is numbered after the others, and its counters are private.
+ */
+typedef struct WriterThread
+{
+    pthread_t thread;
+    RWConfig *rwConfig;
+    LocalWriters *local;
+    int id;
+    WorkerStats *stats;
+    WorkerStats replacementStats;
+    int writes;
+} WriterThread;
 
 /*
  * Performs a writer's responsibilities:
@@ -16,4 +53,7 @@
  */
 void writer();
 
+/* Publishes the stream of each job a daemon hands it, as a writer of the daemon's pool. */
+void poolWriter();
+
 #endif /* ifndef WRITER_H */
@@ -0,0 +1,413 @@
+#include "aggregate.h"
+
+#include <immintrin.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Scalar kernels, for machines without AVX2, and for the values left over once a vector kernel has run
+ * over every whole vector of a block.
+ */
+static void sumScalar(int *values, int count, AggregateOp *op, long long *result)
+{
+    long long sum = 0;
+    int i;
+
+    (void)op;
+
+    for (i = 0; i < count; i++)
+    {
+        sum += values[i];
+    }
+    *result += sum;
+}
+
+static void minScalar(int *values, int count, AggregateOp *op, long long *result)
+{
+    int i;
+
+    (void)op;
+
+    for (i = 0; i < count; i++)
+    {
+        *result = values[i] < *result ? values[i] : *result;
+    }
+}
+
+static void maxScalar(int *values, int count, AggregateOp *op, long long *result)
+{
+    int i;
+
+    (void)op;
+
+    for (i = 0; i < count; i++)
+    {
+        *result = values[i] > *result ? values[i] : *result;
+    }
+}
+
+static void countScalar(int *values, int count, AggregateOp *op, long long *result)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        *result += values[i] >= op->low && values[i] <= op->high;
+    }
+}
+
+static void xorScalar(int *values, int count, AggregateOp *op, long long *result)
+{
+    int i;
+
+    (void)op;
+
+    for (i = 0; i < count; i++)
+    {
+        *result ^= (unsigned int)values[i];
+    }
+}
+
+/*
+ * AVX2 kernels. Each runs over whole vectors of 8 values, widening to 64 bits where a sum could overflow,
+ * then hands what is left to the scalar kernel.
+ */
+__attribute__((target("avx2")))
+static void sumAvx2(int *values, int count, AggregateOp *op, long long *result)
+{
+    __m256i sums = _mm256_setzero_si256();
+    long long lanes[4];
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        sums = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(_mm_loadu_si128((__m128i *)&values[i])));
+        sums = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(_mm_loadu_si128((__m128i *)&values[i + 4])));
+    }
+    _mm256_storeu_si256((__m256i *)lanes, sums);
+    *result += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    sumScalar(&values[i], count - i, op, result);
+}
+
+__attribute__((target("avx2")))
+static void minAvx2(int *values, int count, AggregateOp *op, long long *result)
+{
+    __m256i mins = _mm256_set1_epi32((int)*result);
+    int lanes[8], i;
+
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        mins = _mm256_min_epi32(mins, _mm256_loadu_si256((__m256i *)&values[i]));
+    }
+    _mm256_storeu_si256((__m256i *)lanes, mins);
+
+    minScalar(lanes, 8, op, result);
+    minScalar(&values[i], count - i, op, result);
+}
+
+__attribute__((target("avx2")))
+static void maxAvx2(int *values, int count, AggregateOp *op, long long *result)
+{
+    __m256i maxes = _mm256_set1_epi32((int)*result);
+    int lanes[8], i;
+
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        maxes = _mm256_max_epi32(maxes, _mm256_loadu_si256((__m256i *)&values[i]));
+    }
+    _mm256_storeu_si256((__m256i *)lanes, maxes);
+
+    maxScalar(lanes, 8, op, result);
+    maxScalar(&values[i], count - i, op, result);
+}
+
+__attribute__((target("avx2")))
+static void countAvx2(int *values, int count, AggregateOp *op, long long *result)
+{
+    __m256i low = _mm256_set1_epi32(op->low), high = _mm256_set1_epi32(op->high), vector, outside;
+    int i;
+
+    /* AVX2 only compares for greater than, so count the values that lie outside the range instead. */
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        vector = _mm256_loadu_si256((__m256i *)&values[i]);
+        outside = _mm256_or_si256(_mm256_cmpgt_epi32(low, vector), _mm256_cmpgt_epi32(vector, high));
+        *result += 8 - __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(outside)));
+    }
+
+    countScalar(&values[i], count - i, op, result);
+}
+
+__attribute__((target("avx2")))
+static void xorAvx2(int *values, int count, AggregateOp *op, long long *result)
+{
+    __m256i xors = _mm256_setzero_si256();
+    int lanes[8], i;
+
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        xors = _mm256_xor_si256(xors, _mm256_loadu_si256((__m256i *)&values[i]));
+    }
+    _mm256_storeu_si256((__m256i *)lanes, xors);
+
+    xorScalar(lanes, 8, op, result);
+    xorScalar(&values[i], count - i, op, result);
+}
+
+/*
+ * AVX-512 kernels, over whole vectors of 16 values.
+ */
+__attribute__((target("avx512f")))
+static void sumAvx512(int *values, int count, AggregateOp *op, long long *result)
+{
+    __m512i sums = _mm512_setzero_si512();
+    int i;
+
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        sums = _mm512_add_epi64(sums, _mm512_cvtepi32_epi64(_mm256_loadu_si256((__m256i *)&values[i])));
+        sums = _mm512_add_epi64(sums, _mm512_cvtepi32_epi64(_mm256_loadu_si256((__m256i *)&values[i + 8])));
+    }
+    *result += _mm512_reduce_add_epi64(sums);
+
+    sumScalar(&values[i], count - i, op, result);
+}
+
+__attribute__((target("avx512f")))
+static void minAvx512(int *values, int count, AggregateOp *op, long long *result)
+{
+    __m512i mins = _mm512_set1_epi32((int)*result);
+    int i;
+
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        mins = _mm512_min_epi32(mins, _mm512_loadu_si512(&values[i]));
+    }
+    *result = _mm512_reduce_min_epi32(mins);
+
+    minScalar(&values[i], count - i, op, result);
+}
+
+__attribute__((target("avx512f")))
+static void maxAvx512(int *values, int count, AggregateOp *op, long long *result)
+{
+    __m512i maxes = _mm512_set1_epi32((int)*result);
+    int i;
+
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        maxes = _mm512_max_epi32(maxes, _mm512_loadu_si512(&values[i]));
+    }
+    *result = _mm512_reduce_max_epi32(maxes);
+
+    maxScalar(&values[i], count - i, op, result);
+}
+
+__attribute__((target("avx512f")))
+static void countAvx512(int *values, int count, AggregateOp *op, long long *result)
+{
+    __m512i low = _mm512_set1_epi32(op->low), high = _mm512_set1_epi32(op->high), vector;
+    int i;
+
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        vector = _mm512_loadu_si512(&values[i]);
+        *result += __builtin_popcount(_mm512_cmpge_epi32_mask(vector, low) & _mm512_cmple_epi32_mask(vector, high));
+    }
+
+    countScalar(&values[i], count - i, op, result);
+}
+
+__attribute__((target("avx512f")))
+static void xorAvx512(int *values, int count, AggregateOp *op, long long *result)
+{
+    __m512i xors = _mm512_setzero_si512();
+    int lanes[16], i;
+
+    for (i = 0; i + 16 <= count; i += 16)
+    {
+        xors = _mm512_xor_si512(xors, _mm512_loadu_si512(&values[i]));
+    }
+    _mm512_storeu_si512(lanes, xors);
+
+    xorScalar(lanes, 16, op, result);
+    xorScalar(&values[i], count - i, op, result);
+}
+
+static const AggregateKernels scalarKernels = {
+    "scalar", { &sumScalar, &minScalar, &maxScalar, &countScalar, &xorScalar }
+};
+
+static const AggregateKernels avx2Kernels = {
+    "avx2", { &sumAvx2, &minAvx2, &maxAvx2, &countAvx2, &xorAvx2 }
+};
+
+static const AggregateKernels avx512Kernels = {
+    "avx512", { &sumAvx512, &minAvx512, &maxAvx512, &countAvx512, &xorAvx512 }
+};
+
+/*
+ * Returns the kernels for the widest instruction set the machine supports.
+ */
+static const AggregateKernels *selectKernels(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return &avx512Kernels;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return &avx2Kernels;
+    }
+
+    return &scalarKernels;
+}
+
+/*
+ * Reads a pipeline of operators from spec, a comma-separated list of:
+ *   sum             the sum of the values,
+ *   min, max        the smallest and largest value,
+ *   count:LOW:HIGH  the number of values from LOW to HIGH inclusive,
+ *   xor             the exclusive or of the values, a checksum that ignores their order.
+ *
+ * Returns 0 on success, or -1 if spec is malformed or holds more than AGGREGATE_MAX_OPS operators.
+ */
+int parseAggregatePipeline(AggregatePipeline *pipeline, char *spec)
+{
+    AggregateOp *op;
+    int length;
+
+    pipeline->count = 0;
+    while (*spec)
+    {
+        if (pipeline->count == AGGREGATE_MAX_OPS)
+        {
+            pipeline->count = 0;
+            return -1;
+        }
+        op = &pipeline->ops[pipeline->count++];
+        op->low = 0;
+        op->high = 0;
+
+        length = strcspn(spec, ",");
+        if (length == 3 && !strncmp(spec, "sum", 3))
+        {
+            op->kind = AGGREGATE_SUM;
+        }
+        else if (length == 3 && !strncmp(spec, "min", 3))
+        {
+            op->kind = AGGREGATE_MIN;
+        }
+        else if (length == 3 && !strncmp(spec, "max", 3))
+        {
+            op->kind = AGGREGATE_MAX;
+        }
+        else if (length == 3 && !strncmp(spec, "xor", 3))
+        {
+            op->kind = AGGREGATE_XOR;
+        }
+        else if (sscanf(spec, "count:%d:%d", &op->low, &op->high) == 2 && op->low <= op->high)
+        {
+            op->kind = AGGREGATE_COUNT;
+        }
+        else
+        {
+            pipeline->count = 0;
+            return -1;
+        }
+
+        spec += spec[length] ? length + 1 : length;
+    }
+
+    return pipeline->count ? 0 : -1;
+}
+
+/*
+ * Readies a reader to run pipeline over the values it reads, from the start of the stream.
+ */
+void initializeAggregate(Aggregate *aggregate, AggregatePipeline *pipeline)
+{
+    int i;
+
+    aggregate->pipeline = pipeline;
+    aggregate->kernels = selectKernels();
+    aggregate->items = 0;
+    aggregate->used = 0;
+    for (i = 0; i < pipeline->count; i++)
+    {
+        aggregate->results[i] = pipeline->ops[i].kind == AGGREGATE_MIN ? INT_MAX :
+            pipeline->ops[i].kind == AGGREGATE_MAX ? INT_MIN : 0;
+    }
+}
+
+/*
+ * Runs every operator of a reader's pipeline over the values it has collected.
+ */
+void flushAggregate(Aggregate *aggregate)
+{
+    AggregateOp *op;
+    int i;
+
+    for (i = 0; i < aggregate->pipeline->count; i++)
+    {
+        op = &aggregate->pipeline->ops[i];
+        aggregate->kernels->kernels[op->kind](aggregate->block, aggregate->used, op, &aggregate->results[i]);
+    }
+    aggregate->items += aggregate->used;
+    aggregate->used = 0;
+}
+
+/*
+ * Collects a value a reader has read, running its pipeline once a block of them has been collected.
+ */
+void aggregateValue(Aggregate *aggregate, int value)
+{
+    aggregate->block[aggregate->used++] = value;
+    if (aggregate->used == AGGREGATE_BLOCK_ITEMS)
+    {
+        flushAggregate(aggregate);
+    }
+}
+
+/*
+ * Formats the results of a reader's pipeline into report, e.g.
+ *     sum=5050 min=1 max=100 count[1,10]=10 xor=0x64
+ * The smallest and largest of no values are reported as none.
+ */
+void formatAggregate(Aggregate *aggregate, char *report, int size)
+{
+    AggregateOp *op;
+    int i, length = 0;
+
+    report[0] = '\0';
+    for (i = 0; i < aggregate->pipeline->count && length < size; i++)
+    {
+        op = &aggregate->pipeline->ops[i];
+        if (op->kind == AGGREGATE_SUM)
+        {
+            length += snprintf(report + length, size - length, "%ssum=%lld", i ? " " : "", aggregate->results[i]);
+        }
+        else if (op->kind == AGGREGATE_COUNT)
+        {
+            length += snprintf(report + length, size - length, "%scount[%d,%d]=%lld", i ? " " : "", op->low,
+                op->high, aggregate->results[i]);
+        }
+        else if (op->kind == AGGREGATE_XOR)
+        {
+            length += snprintf(report + length, size - length, "%sxor=0x%llx", i ? " " : "", aggregate->results[i]);
+        }
+        else if (aggregate->items)
+        {
+            length += snprintf(report + length, size - length, "%s%s=%lld", i ? " " : "",
+                op->kind == AGGREGATE_MIN ? "min" : "max", aggregate->results[i]);
+        }
+        else
+        {
+            length += snprintf(report + length, size - length, "%s%s=none", i ? " " : "",
+                op->kind == AGGREGATE_MIN ? "min" : "max");
+        }
+    }
+}
@@ -0,0 +1,192 @@
+#include "autoscale.h"
+
+/*
+ * Returns whether a buffer has writers or consumer group members for the autoscaler to park: it was asked
+ * for, and some kind of worker runs more than its minimum.
+ */
+bool autoscaled(ProgramConfig *pConfig)
+{
+    int i;
+    bool parkable = pConfig->writerCount > pConfig->minWriters;
+
+    for (i = 0; i < pConfig->groupCount; i++)
+    {
+        parkable = parkable || pConfig->groupSizes[i] > pConfig->minMembers;
+    }
+
+    return pConfig->autoscale && parkable;
+}
+
+/*
+ * Sums the counters of every reader and writer of a buffer into now.
+ */
+static void sampleWorkers(StatsRegion *stats, AutoscaleState *now)
+{
+    WorkerStats *worker;
+    int i;
+
+    now->published = 0;
+    now->read = 0;
+    now->writerWaits = 0;
+    now->readerWaits = 0;
+    for (i = 0; i < stats->readerCount; i++)
+    {
+        worker = readerStats(stats, i);
+        now->read += STATS_LOAD(worker->items);
+        now->readerWaits += STATS_LOAD(worker->waits);
+    }
+    for (i = 0; i < stats->writerCount; i++)
+    {
+        worker = writerStats(stats, i);
+        now->published += STATS_LOAD(worker->items);
+        now->writerWaits += STATS_LOAD(worker->waits);
+    }
+}
+
+/*
+ * Parks or unparks a writer given what the autoscaler saw over the last interval, with the buffer's
+ * occupancy at unread of capacity slots. Writers waiting on a full buffer are more than the readers can
+ * keep up with, so once they have kept finding it full, one is parked. Consumers that keep waiting on a
+ * nearly empty buffer while no writer waits are short of items, so one writer is unparked.
+ *
+ * Must be called with rwConfig->parkMutex held.
+ *
+ * Returns true if a writer was unparked.
+ */
+static bool scaleWriters(RWConfig *rwConfig, AutoscaleState *state, AutoscaleState *now, int unread,
+    int capacity, bool starved)
+{
+    ProgramConfig *pConfig = rwConfig->pConfig;
+    int minWriters = pConfig->minWriters < 1 ? 1 : pConfig->minWriters;
+    bool unparked = false;
+
+    state->fullSamples = now->writerWaits > state->writerWaits && unread >= capacity * 3 / 4 ?
+        state->fullSamples + 1 : 0;
+    state->starvedSamples = starved && now->writerWaits == state->writerWaits && unread <= capacity / 4 ?
+        state->starvedSamples + 1 : 0;
+
+    if (state->starvedSamples >= AUTOSCALE_UNPARK_SAMPLES && rwConfig->activeWriters < pConfig->writerCount)
+    {
+        rwConfig->activeWriters++;
+        state->starvedSamples = 0;
+        unparked = true;
+    }
+    else if (state->fullSamples >= AUTOSCALE_PARK_SAMPLES && rwConfig->activeWriters > minWriters)
+    {
+        rwConfig->activeWriters--;
+        state->fullSamples = 0;
+    }
+    else
+    {
+        return false;
+    }
+
+    printf("Autoscaler: %d of %d writers active; %lld items/s published, %lld read, buffer %d/%d full.\n",
+        rwConfig->activeWriters, pConfig->writerCount,
+        (now->published - state->published) * 1000 / AUTOSCALE_INTERVAL_MS,
+        (now->read - state->read) * 1000 / AUTOSCALE_INTERVAL_MS, unread, capacity);
+
+    return unparked;
+}
+
+/*
+ * Parks or unparks a member of consumer group groupId, with backlog items published that the group has
+ * yet to claim, out of a buffer of capacity slots. A group that stays half a buffer behind has one member
+ * unparked; one that has kept up with every item for a while has one parked.
+ *
+ * Must be called with rwConfig->parkMutex held.
+ *
+ * Returns true if a member was unparked.
+ */
+static bool scaleMembers(RWConfig *rwConfig, AutoscaleState *state, int groupId, int backlog, int capacity)
+{
+    ProgramConfig *pConfig = rwConfig->pConfig;
+    GroupState *group = &rwConfig->groups[groupId];
+    int minMembers = pConfig->minMembers < 1 ? 1 : pConfig->minMembers;
+    bool unparked = false;
+
+    state->idleSamples[groupId] = backlog <= 1 ? state->idleSamples[groupId] + 1 : 0;
+    state->behindSamples[groupId] = backlog >= capacity / 2 ? state->behindSamples[groupId] + 1 : 0;
+
+    if (state->behindSamples[groupId] >= AUTOSCALE_UNPARK_SAMPLES &&
+        group->activeMembers < pConfig->groupSizes[groupId])
+    {
+        group->activeMembers++;
+        state->behindSamples[groupId] = 0;
+        unparked = true;
+    }
+    else if (state->idleSamples[groupId] >= AUTOSCALE_PARK_SAMPLES && group->activeMembers > minMembers)
+    {
+        group->activeMembers--;
+        state->idleSamples[groupId] = 0;
+    }
+    else
+    {
+        return false;
+    }
+
+    printf("Autoscaler: %d of %d members of group %d active; %d items waiting to be claimed.\n",
+        group->activeMembers, pConfig->groupSizes[groupId], groupId, backlog);
+
+    return unparked;
+}
+
+/*
+ * Autoscaler thread callback.
+ *
+ * Samples a buffer every AUTOSCALE_INTERVAL_MS until the run finishes: its occupancy, each consumer
+ * group's backlog, and the throughput and waits of its readers and writers. From these it parks writers
+ * and consumer group members that the load leaves idle, down to the configured minimum, and unparks them
+ * as the backlog builds again. Workers only park between items, holding no claim, so the stream keeps
+ * its order.
+ */
+void *autoscaler(void *vpConfig)
+{
+    RWConfig *rwConfig = (RWConfig *)vpConfig;
+    ProgramConfig *pConfig = rwConfig->pConfig;
+    AutoscaleState state = { 0 }, now;
+    int unread, capacity, backlog[MAX_CONSUMER_GROUPS], i;
+    bool starved, unparked;
+
+    while (!STATS_LOAD(rwConfig->stats->finished))
+    {
+        usleep(AUTOSCALE_INTERVAL_MS * 1000);
+        sampleWorkers(rwConfig->stats, &now);
+
+        pthread_mutex_lock(&rwConfig->rpMutex);
+        unread = rwConfig->writes - oldestUnread(rwConfig);
+        capacity = rwConfig->ring.current.capacity;
+        for (i = 0; i < pConfig->groupCount; i++)
+        {
+            backlog[i] = rwConfig->writes - rwConfig->groups[i].cursor;
+        }
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+
+        /* Consumers are short of items if a reader waited, or a group had none left to claim. */
+        starved = now.readerWaits > state.readerWaits;
+        for (i = 0; i < pConfig->groupCount; i++)
+        {
+            starved = starved || !backlog[i];
+        }
+
+        pthread_mutex_lock(&rwConfig->parkMutex);
+        unparked = scaleWriters(rwConfig, &state, &now, unread, capacity, starved);
+        for (i = 0; i < pConfig->groupCount; i++)
+        {
+            unparked = scaleMembers(rwConfig, &state, i, backlog[i], capacity) || unparked;
+        }
+        if (unparked)
+        {
+            pthread_cond_broadcast(&rwConfig->parkCond);
+            resumeParkedWriters(rwConfig);
+        }
+        pthread_mutex_unlock(&rwConfig->parkMutex);
+
+        state.published = now.published;
+        state.read = now.read;
+        state.writerWaits = now.writerWaits;
+        state.readerWaits = now.readerWaits;
+    }
+
+    return NULL;
+}
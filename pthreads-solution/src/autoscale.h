@@ -0,0 +1,40 @@
+#ifndef AUTOSCALE_H
+#define AUTOSCALE_H
+
+#include "shared.h"
+
+/* The number of milliseconds between samples taken by the autoscaler. */
+#define AUTOSCALE_INTERVAL_MS (100)
+
+/* The number of samples in a row that must find workers idle before one is parked, and short of work
+ * before one is unparked. Unparking takes fewer, so that a burst is met quickly. */
+#define AUTOSCALE_PARK_SAMPLES (5)
+#define AUTOSCALE_UNPARK_SAMPLES (2)
+
+/*
+ * What the autoscaler saw at its previous sample of a buffer, and how long each kind of worker has looked
+ * idle since.
+ */
+typedef struct AutoscaleState
+{
+    /* The items published by all writers and read by all readers, and the waits of each. */
+    long long published;
+    long long read;
+    long long writerWaits;
+    long long readerWaits;
+
+    /* The samples in a row that found the writers waiting on a full buffer, and that found consumers
+     * waiting on a nearly empty one while no writer waited. */
+    int fullSamples;
+    int starvedSamples;
+
+    /* The samples in a row that found each consumer group with nothing left to claim, and half a buffer
+     * or more behind. */
+    int idleSamples[MAX_CONSUMER_GROUPS];
+    int behindSamples[MAX_CONSUMER_GROUPS];
+} AutoscaleState;
+
+bool autoscaled(ProgramConfig *pConfig);
+void *autoscaler(void *vpConfig);
+
+#endif /* ifndef AUTOSCALE_H */
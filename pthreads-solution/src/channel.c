@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "channel.h"
+
+/*
+ * Reads a channel from a specification of the form NAME[:SIZE]=SOURCE. Without a SIZE, the channel's buffer
+ * has SHM_BUFFER_SIZE slots. NAME may not contain '/', since it becomes part of file names.
+ *
+ * Returns 0 on success, or -1 if the specification is malformed.
+ */
+int readChannel(Channel *channel, char *spec)
+{
+    char *source = strchr(spec, '='), *size = strchr(spec, ':');
+    int nameLength;
+
+    if (source == NULL || (size != NULL && size > source))
+    {
+        return -1;
+    }
+
+    nameLength = (size != NULL ? size : source) - spec;
+    if (nameLength <= 0 || nameLength >= CHANNEL_NAME_SIZE || memchr(spec, '/', nameLength) != NULL)
+    {
+        return -1;
+    }
+    memcpy(channel->name, spec, nameLength);
+    channel->name[nameLength] = '\0';
+
+    channel->capacity = SHM_BUFFER_SIZE;
+    if (size != NULL && (sscanf(size + 1, "%d", &channel->capacity) != 1 || channel->capacity <= 0))
+    {
+        return -1;
+    }
+
+    channel->inputName = source + 1;
+    channel->subscribers = 0;
+
+    return 0;
+}
+
+/*
+ * Derives a channel's file name from the name given for the run, by appending ".NAME". Leaves the file
+ * name NULL if none was given.
+ */
+static char *channelFileName(char *path, char *runName, char *channelName)
+{
+    if (runName == NULL)
+    {
+        return NULL;
+    }
+    snprintf(path, CHANNEL_PATH_SIZE, "%s.%s", runName, channelName);
+
+    return path;
+}
+
+/*
+ * Turns the configuration of a run into that of one of its channels.
+ */
+void applyChannel(ProgramConfig *config, Channel *channel)
+{
+    config->channelName = channel->name;
+    config->inputName = channel->inputName;
+    config->capacity = channel->capacity;
+    config->sinkName = channelFileName(channel->sinkName, config->sinkName, channel->name);
+    config->journalName = channelFileName(channel->journalName, config->journalName, channel->name);
+    config->spillName = channelFileName(channel->spillName, config->spillName, channel->name);
+}
+
+/*
+ * Reads the channels a subscriber reads from a specification of the form NAME,NAME..., naming one or more of
+ * the run's channels, each at most once.
+ *
+ * Returns 0 on success, or -1 if the specification names a channel the run does not host, or one twice.
+ */
+int readSubscription(Subscription *subscription, char *spec, Channel *channels, int channelCount)
+{
+    char *name = spec, *end;
+    int length, i, j;
+
+    subscription->channelCount = 0;
+    while (*name != '\0')
+    {
+        end = strchr(name, ',');
+        length = end != NULL ? end - name : (int)strlen(name);
+        for (i = 0; i < channelCount && (strncmp(channels[i].name, name, length) || channels[i].name[length]); i++)
+        {
+        }
+        for (j = 0; j < subscription->channelCount && subscription->channels[j] != i; j++)
+        {
+        }
+        if (i == channelCount || j < subscription->channelCount)
+        {
+            return -1;
+        }
+        subscription->channels[subscription->channelCount++] = i;
+        name = end != NULL ? end + 1 : name + length;
+    }
+
+    return subscription->channelCount ? 0 : -1;
+}
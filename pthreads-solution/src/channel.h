@@ -0,0 +1,49 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "shared.h"
+
+/* The longest channel name, and the longest file name derived from one. */
+#define CHANNEL_NAME_SIZE (64)
+#define CHANNEL_PATH_SIZE (4096)
+
+/*
+ * One of the independent streams hosted by a run, parsed from a "--channel NAME[:SIZE]=SOURCE" option.
+ *
+ * Each channel has a buffer of its own, read from its own source. The files named by the sink, journal and
+ * spill options are kept apart by appending ".NAME" to each, so a channel's files live alongside the
+ * others'.
+ */
+typedef struct Channel
+{
+    /* The name the channel is keyed by. */
+    char name[CHANNEL_NAME_SIZE];
+
+    /* The input source writers read from, and the number of slots in the buffer. */
+    char *inputName;
+    int capacity;
+
+    /* The channel's own sink, journal and spill names, derived from the run's. */
+    char sinkName[CHANNEL_PATH_SIZE];
+    char journalName[CHANNEL_PATH_SIZE];
+    char spillName[CHANNEL_PATH_SIZE];
+
+    /* The number of subscribers that read the channel alongside its own readers. */
+    int subscribers;
+} Channel;
+
+/*
+ * The channels read by a subscriber, parsed from a "--subscribe NAME,NAME..." option, as indices into the
+ * run's channels.
+ */
+typedef struct Subscription
+{
+    int channels[MAX_CHANNELS];
+    int channelCount;
+} Subscription;
+
+int readChannel(Channel *channel, char *spec);
+void applyChannel(ProgramConfig *config, Channel *channel);
+int readSubscription(Subscription *subscription, char *spec, Channel *channels, int channelCount);
+
+#endif /* ifndef CHANNEL_H */
@@ -0,0 +1,35 @@
+#include "clock.h"
+
+#include <time.h>
+
+/*
+ * Returns the time in nanoseconds on the system's monotonic clock. Times read by different threads and
+ * processes on the same machine are comparable.
+ */
+long long readClockNs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/*
+ * Converts a time from readClockNs() into an absolute deadline on the realtime clock, as taken by
+ * pthread_cond_timedwait() and sem_timedwait().
+ */
+void readDeadline(struct timespec *deadline, long long time)
+{
+    long long ns;
+
+    clock_gettime(CLOCK_REALTIME, deadline);
+    ns = deadline->tv_nsec + time - readClockNs();
+    deadline->tv_sec += ns / 1000000000LL;
+    deadline->tv_nsec = ns % 1000000000LL;
+    if (deadline->tv_nsec < 0)
+    {
+        deadline->tv_sec--;
+        deadline->tv_nsec += 1000000000LL;
+    }
+}
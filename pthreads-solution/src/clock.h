@@ -0,0 +1,10 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+/* For struct timespec. */
+#include <time.h>
+
+long long readClockNs(void);
+void readDeadline(struct timespec *deadline, long long time);
+
+#endif /* ifndef CLOCK_H */
@@ -0,0 +1,336 @@
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "main.h"
+
+/*
+ * Waits for the job after the one numbered *job to start, and records its number in *job.
+ *
+ * Returns false once the pool is closing instead.
+ */
+static bool awaitJob(WorkerPool *pool, int *job)
+{
+    bool closing;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->job == *job && !pool->closing)
+    {
+        pthread_cond_wait(&pool->jobCond, &pool->mutex);
+    }
+    *job = pool->job;
+    closing = pool->closing;
+    pthread_mutex_unlock(&pool->mutex);
+
+    return !closing;
+}
+
+/*
+ * Records that a worker of the current job has finished, having read reads items or published writes
+ * items, and wakes the daemon once every worker has.
+ */
+static void finishJob(WorkerPool *pool, int reads, int writes)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->reads += reads;
+    pool->writes += writes;
+    if (!--pool->running)
+    {
+        pthread_cond_signal(&pool->doneCond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/*
+ * Pool reader thread callback.
+ *
+ * Takes the next reader identifier, then reads the stream of every job it takes part in until the pool
+ * closes.
+ */
+static void *poolReader(void *vpPool)
+{
+    WorkerPool *pool = (WorkerPool *)vpPool;
+    RWConfig *rwConfig = pool->rwConfig;
+    int id, job = 0;
+
+    pthread_mutex_lock(&rwConfig->rcMutex);
+    id = rwConfig->nextReaderId++;
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+
+    while (awaitJob(pool, &job))
+    {
+        if (id < pool->jobReaders)
+        {
+            finishJob(pool, runReader(rwConfig, id), 0);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Pool writer thread callback.
+ *
+ * Takes the next writer identifier, then publishes the stream of every job it takes part in until the
+ * pool closes.
+ */
+static void *poolWriter(void *vpPool)
+{
+    WorkerPool *pool = (WorkerPool *)vpPool;
+    RWConfig *rwConfig = pool->rwConfig;
+    int id, job = 0;
+
+    pthread_mutex_lock(&rwConfig->writeMutex);
+    id = rwConfig->nextWriterId++;
+    pthread_mutex_unlock(&rwConfig->writeMutex);
+
+    while (awaitJob(pool, &job))
+    {
+        if (id < pool->jobWriters)
+        {
+            finishJob(pool, 0, runWriter(rwConfig, id));
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Listens for job submissions on a Unix-domain socket at path, replacing any socket left behind by a
+ * previous daemon.
+ *
+ * Returns the listening socket, or -1 if it could not be created.
+ */
+static int openControlSocket(char *path)
+{
+    int listener;
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener >= 0)
+    {
+        unlink(path);
+        if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) || listen(listener, DAEMON_BACKLOG))
+        {
+            close(listener);
+            listener = -1;
+        }
+    }
+
+    return listener;
+}
+
+/*
+ * Reads a single line of request from a client into request, without its newline.
+ *
+ * Returns false if the client closed the connection before sending anything.
+ */
+static bool readRequest(int fd, char *request)
+{
+    int length = 0;
+    ssize_t count = 1;
+
+    while (length < DAEMON_REQUEST_SIZE - 1 && count > 0 && memchr(request, '\n', length) == NULL)
+    {
+        count = read(fd, request + length, DAEMON_REQUEST_SIZE - 1 - length);
+        length += count > 0 ? count : 0;
+    }
+    request[length] = '\0';
+    request[strcspn(request, "\r\n")] = '\0';
+
+    return length > 0;
+}
+
+/*
+ * Runs a job through the pool and reports how it went to the client. A request has the form
+ * SOURCE [READERS [WRITERS [SINK]]]: the input source to publish, how many of the pool's readers and
+ * writers take part, by default all of them, and the output sink each reader forwards its stream to, by
+ * default the one the daemon was started with.
+ *
+ * The buffer is reset in place and the pool's threads are woken, so nothing is created for the job but
+ * its input source and sinks.
+ *
+ * Returns a status code:
+ *   ERROR_OPENING_SOURCE:
+ *     The request was malformed, or its input source could not be opened.
+ *   ERROR_INCORRECT_READS:
+ *     A reader failed to read every item published.
+ *   ERROR_INCORRECT_WRITES:
+ *     The writers failed to publish every item between them.
+ *   0:
+ *     No errors were encountered.
+ */
+static int runJob(WorkerPool *pool, int fd, char *request, char *sinkName)
+{
+    RWConfig *rwConfig = pool->rwConfig;
+    ProgramConfig *pConfig = rwConfig->pConfig;
+    int sCode = 0, fields, readers = pConfig->readerCount, writers = pConfig->writerCount, i;
+    long long start = readClockNs();
+
+    fields = sscanf(request, "%4095s %d %d %4095s", pool->source, &readers, &writers, pool->sink);
+    if (fields < 1 || readers < 1 || readers > pConfig->readerCount || writers < 1 ||
+        writers > pConfig->writerCount)
+    {
+        dprintf(fd, "Error: Expected SOURCE [READERS [WRITERS [SINK]]], with 1 to %d readers and 1 to %d "
+            "writers.\n", pConfig->readerCount, pConfig->writerCount);
+        return ERROR_OPENING_SOURCE;
+    }
+
+    resetRWConfig(rwConfig, readers);
+    if (openInputSource(&rwConfig->source, pool->source, pConfig->replaySpeed))
+    {
+        dprintf(fd, "Error: Could not open input source %s.\n", pool->source);
+        attachInputSource(&rwConfig->source, -1);
+        return ERROR_OPENING_SOURCE;
+    }
+    pConfig->inputName = pool->source;
+    pConfig->sinkName = fields == 4 ? pool->sink : sinkName;
+
+    /* Start the job, and wait for every worker taking part to finish it. */
+    pthread_mutex_lock(&pool->mutex);
+    pool->jobReaders = readers;
+    pool->jobWriters = writers;
+    pool->running = readers + writers;
+    pool->reads = 0;
+    pool->writes = 0;
+    pool->job++;
+    pthread_cond_broadcast(&pool->jobCond);
+    while (pool->running)
+    {
+        pthread_cond_wait(&pool->doneCond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    closeInputSource(&rwConfig->source);
+    attachInputSource(&rwConfig->source, -1);
+    reportLatency(rwConfig);
+    fflush(rwConfig->fPtrSimOut);
+
+    /* Check the job as a run is checked once its threads are joined. */
+    if (pool->writes != rwConfig->writes)
+    {
+        sCode = ERROR_INCORRECT_WRITES;
+        dprintf(fd, "Error: Incorrect number of total writes: %d\n", pool->writes);
+    }
+    for (i = 0; i < readers; i++)
+    {
+        if (!rwConfig->readerStates[i].detached && rwConfig->readerStates[i].cursor != rwConfig->writes)
+        {
+            sCode = ERROR_INCORRECT_READS || sCode;
+            dprintf(fd, "Error: Incorrect number of reads: %d\n", rwConfig->readerStates[i].cursor);
+        }
+    }
+
+    dprintf(fd, "Job %d: published %d items and read %d in %lld ns.\n", pool->job, rwConfig->writes,
+        pool->reads, readClockNs() - start);
+
+    return sCode;
+}
+
+/*
+ * Runs as a daemon: creates a single buffer and starts its reader and writer threads once, then runs the
+ * jobs submitted on the control socket named by config->daemonName back to back, through the same
+ * buffer and threads, until a client submits DAEMON_STOP_REQUEST.
+ *
+ * The pool holds config->readerCount readers and config->writerCount writers. Channels, fan-out,
+ * consumer groups, recording, spilling and live statistics are not supported by the daemon.
+ *
+ * Returns the status code of the first error encountered, or 0 if there were none.
+ */
+int runDaemon(ProgramConfig *config, FILE *fPtrSimOut)
+{
+    WorkerPool pool;
+    ProgramConfig *pConfig = (ProgramConfig *)malloc(sizeof(ProgramConfig));
+    char request[DAEMON_REQUEST_SIZE];
+    int sCode = 0, listener, fd;
+    void **retValues;
+    bool stopping = false;
+
+    /* The buffer's configuration is the daemon's own, which its RWConfig frees. Jobs name their own
+     * input source. */
+    *pConfig = *config;
+    if (pConfig->channelCount || pConfig->relayCount || pConfig->groupCount || pConfig->journalName != NULL ||
+        pConfig->spillName != NULL || pConfig->top || pConfig->executorCount)
+    {
+        printf("Error: Ignoring --channel, --fan-out, --group, --record, --spill, --top and --executors with "
+            "--daemon.\n");
+    }
+    pConfig->inputName = NULL;
+    pConfig->channelCount = 0;
+    pConfig->relayCount = 0;
+    pConfig->groupCount = 0;
+    pConfig->memberCount = 0;
+    pConfig->journalName = NULL;
+    pConfig->spillName = NULL;
+    pConfig->top = false;
+    pConfig->executorCount = 0;
+
+    listener = openControlSocket(config->daemonName);
+    if (listener < 0)
+    {
+        printf("Error: Could not listen on control socket %s\n", config->daemonName);
+        free(pConfig);
+        return ERROR_OPENING_SOURCE;
+    }
+
+    /* Create the buffer and start every thread before the first job, and never again. */
+    pool.rwConfig = createRWConfig(pConfig, fPtrSimOut);
+    pool.readers = (pthread_t *)malloc(pConfig->readerCount * sizeof(pthread_t));
+    pool.writers = (pthread_t *)malloc(pConfig->writerCount * sizeof(pthread_t));
+    retValues = (void **)malloc((pConfig->readerCount + pConfig->writerCount) * sizeof(void *));
+    pthread_mutex_init(&pool.mutex, NULL);
+    pthread_cond_init(&pool.jobCond, NULL);
+    pthread_cond_init(&pool.doneCond, NULL);
+    pool.job = 0;
+    pool.closing = false;
+    createThreads(pool.readers, pConfig->readerCount, &poolReader, &pool);
+    createThreads(pool.writers, pConfig->writerCount, &poolWriter, &pool);
+    printf("Daemon listening on %s with %d readers and %d writers.\n", config->daemonName,
+        pConfig->readerCount, pConfig->writerCount);
+
+    while (!stopping)
+    {
+        fd = accept(listener, NULL, NULL);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        if (!readRequest(fd, request))
+        {
+            /* The client left without submitting anything. */
+        }
+        else if (!strcmp(request, DAEMON_STOP_REQUEST))
+        {
+            dprintf(fd, "Stopping after %d jobs.\n", pool.job);
+            stopping = true;
+        }
+        else
+        {
+            sCode = runJob(&pool, fd, request, config->sinkName) || sCode;
+        }
+        close(fd);
+    }
+
+    close(listener);
+    unlink(config->daemonName);
+
+    /* Let every thread exit, then free the buffer. */
+    pthread_mutex_lock(&pool.mutex);
+    pool.closing = true;
+    pthread_cond_broadcast(&pool.jobCond);
+    pthread_mutex_unlock(&pool.mutex);
+    joinThreads(pool.readers, pConfig->readerCount, retValues);
+    joinThreads(pool.writers, pConfig->writerCount, retValues);
+
+    free(pool.readers);
+    free(pool.writers);
+    free(retValues);
+    freeRWConfig(pool.rwConfig);
+
+    return sCode;
+}
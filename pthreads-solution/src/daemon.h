@@ -0,0 +1,63 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "shared.h"
+#include "reader.h"
+#include "writer.h"
+
+/* The longest job request a daemon accepts, including the newline. */
+#define DAEMON_REQUEST_SIZE (4096)
+
+/* The request that stops a daemon once the job before it has finished. */
+#define DAEMON_STOP_REQUEST "stop"
+
+/* The most connections waiting to submit a job while another runs. */
+#define DAEMON_BACKLOG (16)
+
+/*
+ * The reader and writer threads a daemon keeps running between jobs, and the job they are running.
+ *
+ * Each thread takes its identifier once, then waits for a job. A job names how many of the readers and
+ * writers take part; the rest sit it out and wait for the next.
+ */
+typedef struct WorkerPool
+{
+    /* The buffer every job is carried through. */
+    RWConfig *rwConfig;
+
+    /* The pool's threads. */
+    pthread_t *readers;
+    pthread_t *writers;
+
+    /* Guards every field below. jobCond is signalled when a job starts or the pool closes, and doneCond
+     * when the last worker of a job finishes. */
+    pthread_mutex_t mutex;
+    pthread_cond_t jobCond;
+    pthread_cond_t doneCond;
+
+    /* The number of the current job, from 1; 0 before the first. */
+    int job;
+
+    /* The number of readers and writers taking part in the current job. */
+    int jobReaders;
+    int jobWriters;
+
+    /* The number of workers of the current job still running. */
+    int running;
+
+    /* The items read by all readers, and published by all writers, in the current job. */
+    int reads;
+    int writes;
+
+    /* The input source of the current job, and the output sink it names, if any. The buffer's
+     * configuration points to them while the job runs, and they are kept until the next. */
+    char source[DAEMON_REQUEST_SIZE];
+    char sink[DAEMON_REQUEST_SIZE];
+
+    /* Set once the daemon stops; every thread then exits. */
+    bool closing;
+} WorkerPool;
+
+int runDaemon(ProgramConfig *config, FILE *fPtrSimOut);
+
+#endif /* ifndef DAEMON_H */
@@ -0,0 +1,222 @@
+#include "executor.h"
+
+/*
+ * Readies an executor with no tasks. Its thread is started on runExecutor() once its tasks are added.
+ */
+void initializeExecutor(Executor *executor)
+{
+    executor->head = NULL;
+    executor->tail = NULL;
+    executor->tasks = 0;
+    executor->timers = NULL;
+    pthread_mutex_init(&executor->mutex, NULL);
+    pthread_cond_init(&executor->readyCond, NULL);
+}
+
+/*
+ * Gives a task to an executor, ready to take its first step.
+ */
+void addTask(Executor *executor, Task *task, TaskStep step, void *context)
+{
+    task->step = step;
+    task->context = context;
+    task->executor = executor;
+    task->timed = false;
+
+    pthread_mutex_lock(&executor->mutex);
+    executor->tasks++;
+    pthread_mutex_unlock(&executor->mutex);
+
+    scheduleTask(task);
+}
+
+/*
+ * Clears a task's timer, if it is set.
+ *
+ * Must be called with the executor's mutex held.
+ */
+static void clearTaskTimer(Executor *executor, Task *task)
+{
+    Task **link;
+
+    if (!task->timed)
+    {
+        return;
+    }
+
+    for (link = &executor->timers; *link != task; link = &(*link)->nextTimer)
+    {
+    }
+    *link = task->nextTimer;
+    task->timed = false;
+}
+
+/*
+ * Queues a task to take its next step on its executor, waking the executor if it is asleep. This is how a
+ * suspended task is resumed, and may be called from any thread. A timer the task set no longer expires.
+ */
+void scheduleTask(Task *task)
+{
+    Executor *executor = task->executor;
+
+    pthread_mutex_lock(&executor->mutex);
+    clearTaskTimer(executor, task);
+    task->next = NULL;
+    if (executor->tail != NULL)
+    {
+        executor->tail->next = task;
+    }
+    else
+    {
+        executor->head = task;
+    }
+    executor->tail = task;
+    pthread_cond_signal(&executor->readyCond);
+    pthread_mutex_unlock(&executor->mutex);
+}
+
+/*
+ * Sets a timer for a task about to suspend itself, as a thread would wait with a timeout: once the clock
+ * reaches expiry, its executor calls timeout on it, unless the task is scheduled first. Setting the timer
+ * again moves it.
+ *
+ * Must be called from the task's own step, so that the timer cannot expire before the task has
+ * suspended.
+ */
+void setTaskTimer(Task *task, long long expiry, TaskTimeout timeout)
+{
+    Executor *executor = task->executor;
+
+    pthread_mutex_lock(&executor->mutex);
+    if (!task->timed)
+    {
+        task->nextTimer = executor->timers;
+        executor->timers = task;
+        task->timed = true;
+    }
+    task->expiry = expiry;
+    task->timeout = timeout;
+    pthread_mutex_unlock(&executor->mutex);
+}
+
+/*
+ * Takes every task whose timer has expired off an executor's timers, and returns them linked through
+ * nextTimer. Otherwise stores in earliest when the next timer expires.
+ *
+ * Must be called with the executor's mutex held.
+ */
+static Task *takeExpiredTimers(Executor *executor, long long *earliest)
+{
+    Task **link = &executor->timers, *task, *expired = NULL;
+    long long now = readClockNs();
+
+    *earliest = 0;
+    while ((task = *link) != NULL)
+    {
+        if (task->expiry > now)
+        {
+            *earliest = !*earliest || task->expiry < *earliest ? task->expiry : *earliest;
+            link = &task->nextTimer;
+            continue;
+        }
+        *link = task->nextTimer;
+        task->timed = false;
+        task->nextTimer = expired;
+        expired = task;
+    }
+
+    return expired;
+}
+
+/*
+ * Takes the oldest ready task off an executor's queue, first waiting for one to become ready. The timeout
+ * of any task whose timer expires meanwhile is called, without holding the executor's mutex, since it
+ * schedules the task.
+ *
+ * Returns NULL once every task has finished instead.
+ */
+static Task *nextReadyTask(Executor *executor)
+{
+    Task *task, *expired, *next;
+    long long earliest;
+    struct timespec deadline;
+
+    pthread_mutex_lock(&executor->mutex);
+    while (executor->timers != NULL || (executor->head == NULL && executor->tasks))
+    {
+        expired = takeExpiredTimers(executor, &earliest);
+        if (expired != NULL)
+        {
+            pthread_mutex_unlock(&executor->mutex);
+            for (; expired != NULL; expired = next)
+            {
+                next = expired->nextTimer;
+                expired->timeout(expired);
+            }
+            pthread_mutex_lock(&executor->mutex);
+            continue;
+        }
+        if (executor->head != NULL || !executor->tasks)
+        {
+            break;
+        }
+
+        if (earliest)
+        {
+            readDeadline(&deadline, earliest);
+            pthread_cond_timedwait(&executor->readyCond, &executor->mutex, &deadline);
+        }
+        else
+        {
+            pthread_cond_wait(&executor->readyCond, &executor->mutex);
+        }
+    }
+    task = executor->head;
+    if (task != NULL)
+    {
+        executor->head = task->next;
+        executor->tail = executor->head != NULL ? executor->tail : NULL;
+    }
+    pthread_mutex_unlock(&executor->mutex);
+
+    return task;
+}
+
+/*
+ * Executor thread callback.
+ *
+ * Runs a step of each ready task in turn until every task has finished. A task that yields goes to the
+ * back of the queue; one that is suspended waits off the queue until it is scheduled again.
+ */
+void *runExecutor(void *vpExecutor)
+{
+    Executor *executor = (Executor *)vpExecutor;
+    Task *task;
+    int status;
+
+    while ((task = nextReadyTask(executor)) != NULL)
+    {
+        status = task->step(task);
+        if (status == TASK_YIELD)
+        {
+            scheduleTask(task);
+        }
+        else if (status == TASK_DONE)
+        {
+            pthread_mutex_lock(&executor->mutex);
+            executor->tasks--;
+            pthread_mutex_unlock(&executor->mutex);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Frees the resources of an executor whose thread has finished.
+ */
+void destroyExecutor(Executor *executor)
+{
+    pthread_mutex_destroy(&executor->mutex);
+    pthread_cond_destroy(&executor->readyCond);
+}
@@ -0,0 +1,101 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+/* For pthread_* */
+#include <pthread.h>
+
+/* For NULL. */
+#include <stdlib.h>
+
+/* For bool etc. */
+#include <stdbool.h>
+
+/* For readClockNs() etc. */
+#include "clock.h"
+
+/* What a task's step tells the executor running it: the task has finished, and is never run again; it
+ * has suspended itself until something schedules it again; or it has more to do straight away, and runs
+ * again once the other ready tasks have had a turn. */
+#define TASK_DONE (0)
+#define TASK_PENDING (1)
+#define TASK_YIELD (2)
+
+/* The most items a reader or writer task reads or publishes in a single step before it yields to the other
+ * tasks of its executor. */
+#define TASK_STEP_ITEMS (64)
+
+struct Task;
+struct Executor;
+
+/*
+ * Runs a task until it finishes, must wait, or has had its turn. Returns TASK_DONE, TASK_PENDING or
+ * TASK_YIELD.
+ */
+typedef int (*TaskStep)(struct Task *task);
+
+/*
+ * Called on a suspended task's executor once the task's timer expires, to resume the task if whatever it
+ * waits on has not already.
+ */
+typedef void (*TaskTimeout)(struct Task *task);
+
+/*
+ * A unit of work that an executor runs a step at a time, in place of a thread of its own. A task that
+ * would block suspends itself instead, by returning TASK_PENDING once it has arranged for whatever it
+ * waits on to schedule it again.
+ *
+ * A task only ever runs on the executor it was added to, so its steps never run concurrently.
+ */
+typedef struct Task
+{
+    TaskStep step;
+
+    /* What the task works on, passed to it through the task. */
+    void *context;
+
+    /* The executor the task runs on. */
+    struct Executor *executor;
+
+    /* The next task in the executor's ready queue, or in whatever list the task is suspended on. A task
+     * is in at most one of them at a time. */
+    struct Task *next;
+
+    /* A suspended task may also set a timer: when it expires, timeout is called on the task, unless the
+     * task is scheduled first. The next task with a timer set on the executor, whether this one's timer is
+     * set, and when it expires, from readClockNs(). Bound to the executor's mutex. */
+    struct Task *nextTimer;
+    bool timed;
+    long long expiry;
+    TaskTimeout timeout;
+} Task;
+
+/*
+ * A thread that runs many tasks, a step at a time, in the order they become ready. It sleeps while none
+ * is ready, and finishes once every task it was given has.
+ */
+typedef struct Executor
+{
+    /* The ready queue, oldest first. Bound to mutex. */
+    Task *head;
+    Task *tail;
+
+    /* The number of tasks that have not yet finished. Bound to mutex. */
+    int tasks;
+
+    /* The suspended tasks with a timer set, in no particular order. Bound to mutex. */
+    Task *timers;
+
+    pthread_mutex_t mutex;
+
+    /* Signalled when a task becomes ready. */
+    pthread_cond_t readyCond;
+} Executor;
+
+void initializeExecutor(Executor *executor);
+void addTask(Executor *executor, Task *task, TaskStep step, void *context);
+void scheduleTask(Task *task);
+void setTaskTimer(Task *task, long long expiry, TaskTimeout timeout);
+void *runExecutor(void *vpExecutor);
+void destroyExecutor(Executor *executor);
+
+#endif /* ifndef EXECUTOR_H */
@@ -0,0 +1,158 @@
+#include "filter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Reads a reader's filter from spec, of the form [N=]PREDICATE, where N is the number of the reader's
+ * sink and PREDICATE is one of:
+ *   range:LOW:HIGH  values from LOW to HIGH inclusive,
+ *   bits:MASK       values with any bit of MASK set; MASK may be given in hex, e.g. 0x80000000.
+ * Without N, the filter is for every reader without one of its own.
+ *
+ * Returns 0 on success, or -1 if spec is malformed.
+ */
+int parseReaderFilter(ReaderFilter *filter, char *spec)
+{
+    char *predicate = strchr(spec, '='), *end;
+    int length = 0;
+
+    filter->reader = FILTER_ALL_READERS;
+    if (predicate != NULL)
+    {
+        if (sscanf(spec, "%d=%n", &filter->reader, &length) != 1 || spec + length != predicate + 1 ||
+            filter->reader < 0)
+        {
+            return -1;
+        }
+        spec = predicate + 1;
+    }
+
+    length = 0;
+    if (sscanf(spec, "range:%d:%d%n", &filter->low, &filter->high, &length) == 2 && !spec[length] &&
+        filter->low <= filter->high)
+    {
+        filter->kind = FILTER_RANGE;
+        return 0;
+    }
+    if (!strncmp(spec, "bits:", 5))
+    {
+        filter->mask = (unsigned int)strtoul(spec + 5, &end, 0);
+        if (end == spec + 5 || *end || !filter->mask)
+        {
+            return -1;
+        }
+        filter->kind = FILTER_BITS;
+        return 0;
+    }
+
+    return -1;
+}
+
+/*
+ * Returns the filter of the reader numbered reader among count filters: the last given for it, or failing
+ * that, the last given for every reader. Returns NULL if the reader has none.
+ */
+ReaderFilter *findReaderFilter(ReaderFilter *filters, int count, int reader)
+{
+    ReaderFilter *found = NULL;
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (filters[i].reader == reader ||
+            (filters[i].reader == FILTER_ALL_READERS && (found == NULL || found->reader != reader)))
+        {
+            found = &filters[i];
+        }
+    }
+
+    return found;
+}
+
+/*
+ * Returns true if value passes a reader's filter.
+ */
+bool filterPasses(ReaderFilter *filter, int value)
+{
+    if (filter->kind == FILTER_RANGE)
+    {
+        return value >= filter->low && value <= filter->high;
+    }
+
+    return ((unsigned int)value & filter->mask) != 0;
+}
+
+/*
+ * Returns the sequence number of the first item of block not yet published if summary shows that none of
+ * the items of block published so far passes a reader's filter, so that the reader can skip up to it
+ * without reading any of them. Returns BLOCK_NONE otherwise.
+ */
+int filterSkipsTo(ReaderFilter *filter, BlockSummary *summary, int block)
+{
+    bool excluded;
+
+    if (summary->block != block)
+    {
+        return BLOCK_NONE;
+    }
+    if (filter->kind == FILTER_RANGE)
+    {
+        excluded = summary->max < filter->low || summary->min > filter->high;
+    }
+    else
+    {
+        excluded = !(summary->bits & filter->mask);
+    }
+
+    return excluded ? block * FILTER_BLOCK_ITEMS + summary->items : BLOCK_NONE;
+}
+
+/*
+ * Readies count summaries to summarise the blocks of a stream from its start.
+ */
+void clearBlockSummaries(BlockSummary *summaries, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        summaries[i].block = BLOCK_NONE;
+        summaries[i].items = 0;
+    }
+}
+
+/*
+ * Adds an item just published, with the given sequence number, value and hash (0 unless verifying), to the
+ * summary of its block. The count summaries are reused in turn, each holding every count-th block, and a
+ * block's summary begins again with its first item.
+ *
+ * A summary only covers the items of its block from the first without a gap, so an item left out, say by
+ * a writer that died part way through publishing it, leaves the rest of its block unsummarised rather
+ * than let readers skip it.
+ */
+void summarizeItem(BlockSummary *summaries, int count, int sequence, int value, unsigned long long hash)
+{
+    int block = sequence / FILTER_BLOCK_ITEMS;
+    BlockSummary *summary = &summaries[block % count];
+
+    if (summary->block != block)
+    {
+        summary->block = block;
+        summary->items = 0;
+        summary->min = value;
+        summary->max = value;
+        summary->bits = 0;
+        summary->hash = 0;
+    }
+    if (sequence != block * FILTER_BLOCK_ITEMS + summary->items)
+    {
+        return;
+    }
+    summary->items++;
+    summary->min = value < summary->min ? value : summary->min;
+    summary->max = value > summary->max ? value : summary->max;
+    summary->bits |= (unsigned int)value;
+    summary->hash += hash;
+}
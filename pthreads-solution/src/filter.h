@@ -0,0 +1,72 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+/* For bool etc. */
+#include <stdbool.h>
+
+/* The kinds of filter a reader can subscribe with: values from low to high inclusive, or values with any
+ * of the bits of a mask set. */
+#define FILTER_RANGE (0)
+#define FILTER_BITS (1)
+
+/* The most filters that can be given. */
+#define MAX_FILTERS (64)
+
+/* A filter given without a reader number applies to every reader without one of its own. */
+#define FILTER_ALL_READERS (-1)
+
+/* The number of consecutive items writers summarise together. A filtering reader skips every item of its
+ * block published so far at once, if the block's summary shows that none of them passes. */
+#define FILTER_BLOCK_ITEMS (16)
+
+/* The block number of a summary that holds no block. */
+#define BLOCK_NONE (-1)
+
+/*
+ * A reader's subscription: only the values that pass are forwarded to its sink.
+ */
+typedef struct ReaderFilter
+{
+    /* The reader the filter is for, numbered as its sink is, or FILTER_ALL_READERS. */
+    int reader;
+
+    /* FILTER_RANGE or FILTER_BITS. */
+    int kind;
+
+    /* The range of a range filter. */
+    int low;
+    int high;
+
+    /* The mask of a bits filter. */
+    unsigned int mask;
+} ReaderFilter;
+
+/*
+ * A summary of the values of a block of consecutive items, kept by writers as they publish.
+ */
+typedef struct BlockSummary
+{
+    /* The block summarised, numbered by the sequence number of its first item over FILTER_BLOCK_ITEMS, or
+     * BLOCK_NONE. */
+    int block;
+
+    /* The number of items of the block published so far. */
+    int items;
+
+    /* The smallest and largest value, and every bit set in any value. */
+    int min;
+    int max;
+    unsigned int bits;
+
+    /* With --verify, the sum of the hashes of the items, so that readers can check the items they skip. */
+    unsigned long long hash;
+} BlockSummary;
+
+int parseReaderFilter(ReaderFilter *filter, char *spec);
+ReaderFilter *findReaderFilter(ReaderFilter *filters, int count, int reader);
+bool filterPasses(ReaderFilter *filter, int value);
+int filterSkipsTo(ReaderFilter *filter, BlockSummary *summary, int block);
+void clearBlockSummaries(BlockSummary *summaries, int count);
+void summarizeItem(BlockSummary *summaries, int count, int sequence, int value, unsigned long long hash);
+
+#endif /* ifndef FILTER_H */
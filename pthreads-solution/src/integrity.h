@@ -0,0 +1,112 @@
+#ifndef INTEGRITY_H
+#define INTEGRITY_H
+
+/* For bool etc. */
+#include <stdbool.h>
+
+/* For FILTER_BLOCK_ITEMS. */
+#include "filter.h"
+
+/* The number of consecutive items whose checksum writers keep apart from the rest, so that a reader whose
+ * stream diverges from what was published can tell where. */
+#define CHECKSUM_RANGE_ITEMS (1024)
+
+/* The number of ranges writers keep the checksums of, reused in turn. A reader that falls further behind
+ * than this cannot check the ranges it is behind on, only its whole stream. */
+#define CHECKSUM_RANGES (1024)
+
+/* The range number of a checksum that holds no range. */
+#define RANGE_NONE (-1)
+
+/* The most bytes the outcome of a verification takes once formatted, including the terminator. */
+#define VERIFICATION_REPORT_SIZE (256)
+
+/* Folds size bytes into a CRC32C. */
+typedef unsigned int (*Crc32cKernel)(unsigned int crc, const unsigned char *bytes, int size);
+
+/*
+ * The CRC32C kernel for an instruction set.
+ */
+typedef struct ChecksumKernel
+{
+    /* The instruction set, as reported with the outcome of a verification. */
+    char *name;
+
+    Crc32cKernel crc;
+} ChecksumKernel;
+
+/*
+ * A checksum of a run of items: how many there are, and the sum of the hashes of each item with its
+ * sequence number. Since each item is hashed with its place in the stream, the sum tells the same items in
+ * a different order apart, yet writers can add the items they publish in any order.
+ */
+typedef struct StreamChecksum
+{
+    int items;
+    unsigned long long hash;
+} StreamChecksum;
+
+/*
+ * The checksum of the items of a range published so far, kept by writers as they publish.
+ */
+typedef struct RangeChecksum
+{
+    /* The range, numbered by the sequence number of its first item over CHECKSUM_RANGE_ITEMS, or
+     * RANGE_NONE. */
+    int range;
+
+    StreamChecksum sum;
+} RangeChecksum;
+
+/*
+ * A reader's check of the stream it reads against the one the writers published.
+ *
+ * Each item read is added to the checksum of its range, which is compared with the writers' once the
+ * reader has read the last item of the range. The checksum of every item read is compared with the
+ * writers' once the stream ends.
+ */
+typedef struct StreamVerifier
+{
+    const ChecksumKernel *kernel;
+
+    /* The checksum of every item read, and whether they are every item of the stream from its start. */
+    StreamChecksum stream;
+    bool whole;
+
+    /* The checksum of the stream the writers published, once it has ended. */
+    StreamChecksum published;
+
+    /* The range of the next item to read, the checksum of the items of it read so far, and whether any of
+     * the items before them in the range was missed. */
+    int range;
+    StreamChecksum current;
+    bool broken;
+
+    /* The filter block of the last item read, and the checksum of the items of it read or skipped, from
+     * its first without a gap, so that the items of the block a filtering reader skips can be checked
+     * against the block's summary. */
+    int block;
+    StreamChecksum blockSum;
+
+    /* The number of ranges that matched the writers', that could not be checked, and that diverged from
+     * the writers', and the first of those, or RANGE_NONE. */
+    int matched;
+    int unchecked;
+    int diverged;
+    int firstDiverged;
+} StreamVerifier;
+
+const ChecksumKernel *selectChecksumKernel(void);
+unsigned long long hashItem(const ChecksumKernel *kernel, int sequence, const void *item, int size);
+void clearRangeChecksums(RangeChecksum *ranges, StreamChecksum *published);
+void addItemChecksum(RangeChecksum *ranges, StreamChecksum *published, int sequence, unsigned long long hash);
+void openVerifier(StreamVerifier *verifier, const ChecksumKernel *kernel, int start);
+bool verifyItem(StreamVerifier *verifier, int sequence, const void *item, int size);
+void missItems(StreamVerifier *verifier, int from, int to);
+bool skipItems(StreamVerifier *verifier, int from, int to, unsigned long long blockHash);
+void checkRange(StreamVerifier *verifier, RangeChecksum *ranges);
+void finishVerifier(StreamVerifier *verifier, RangeChecksum *ranges, StreamChecksum *published, int end);
+bool verifierDiverged(StreamVerifier *verifier);
+void formatVerification(StreamVerifier *verifier, char *report, int size);
+
+#endif /* ifndef INTEGRITY_H */
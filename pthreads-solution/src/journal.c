@@ -0,0 +1,154 @@
+#include "journal.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Returns the size in bytes of a journal file holding the given number of records.
+ */
+static long long journalBytes(long long records)
+{
+    return sizeof(JournalHeader) + records * sizeof(JournalRecord);
+}
+
+/*
+ * Allocates room for another JOURNAL_GROW_RECORDS records and remaps the file.
+ *
+ * Returns 0 on success, or -1 if the file could not be grown; the journal is then closed.
+ */
+static int growJournal(Journal *journal)
+{
+    long long capacity = journal->capacity + JOURNAL_GROW_RECORDS;
+
+    if (journal->header != NULL)
+    {
+        munmap(journal->header, journalBytes(journal->capacity));
+        journal->header = NULL;
+    }
+
+    /* Reserve the blocks now, rather than faulting them in one page at a time as records are written. */
+    if (!posix_fallocate(journal->fd, 0, journalBytes(capacity)))
+    {
+        journal->header = (JournalHeader *)mmap(0, journalBytes(capacity), PROT_READ | PROT_WRITE,
+            MAP_SHARED, journal->fd, 0);
+    }
+
+    if (journal->header == NULL || journal->header == MAP_FAILED)
+    {
+        journal->header = NULL;
+        close(journal->fd);
+        journal->fd = -1;
+        return -1;
+    }
+
+    journal->capacity = capacity;
+    return 0;
+}
+
+/*
+ * Creates an empty journal at path, replacing any existing file.
+ *
+ * Returns 0 on success, or -1 if the journal could not be created.
+ */
+int openJournal(Journal *journal, char *path)
+{
+    journal->header = NULL;
+    journal->capacity = 0;
+    journal->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+
+    if (journal->fd < 0 || growJournal(journal))
+    {
+        return -1;
+    }
+
+    memcpy(journal->header->magic, JOURNAL_MAGIC, sizeof(journal->header->magic));
+    journal->header->records = 0;
+
+    return 0;
+}
+
+/*
+ * Appends a published item to the journal.
+ */
+void appendJournalRecord(Journal *journal, int sequence, int writerId, long long publishTime, int value)
+{
+    JournalRecord *record;
+
+    if (journal->fd < 0 || (journal->header->records == journal->capacity && growJournal(journal)))
+    {
+        return;
+    }
+
+    record = (JournalRecord *)(journal->header + 1) + journal->header->records;
+    record->publishTime = publishTime;
+    record->sequence = sequence;
+    record->writerId = writerId;
+    record->value = value;
+    record->reserved = 0;
+
+    journal->header->records++;
+}
+
+/*
+ * Unmaps the journal and trims the file to the records written.
+ */
+void closeJournal(Journal *journal)
+{
+    long long records;
+
+    if (journal->fd < 0)
+    {
+        return;
+    }
+
+    records = journal->header->records;
+    munmap(journal->header, journalBytes(journal->capacity));
+    ftruncate(journal->fd, journalBytes(records));
+    close(journal->fd);
+    journal->fd = -1;
+}
+
+/*
+ * Maps an existing journal read-only, for replay.
+ *
+ * Returns the mapped header, which the records follow, or NULL if path is not a journal. On success,
+ * records holds the number of complete records and mappedBytes the size of the mapping.
+ */
+JournalHeader *mapJournal(char *path, long long *records, long long *mappedBytes)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    JournalHeader *header = NULL;
+
+    if (fd >= 0 && !fstat(fd, &info) && info.st_size >= (long long)sizeof(JournalHeader))
+    {
+        header = (JournalHeader *)mmap(0, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (header == MAP_FAILED || memcmp(header->magic, JOURNAL_MAGIC, sizeof(header->magic)))
+        {
+            if (header != MAP_FAILED)
+            {
+                munmap(header, info.st_size);
+            }
+            header = NULL;
+        }
+        else
+        {
+            *mappedBytes = info.st_size;
+            *records = (info.st_size - sizeof(JournalHeader)) / sizeof(JournalRecord);
+            if (header->records < *records)
+            {
+                *records = header->records;
+            }
+        }
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    return header;
+}
@@ -23,12 +23,121 @@ int startWriters(pthread_t *array, RWConfig *config)
     return createThreads(array, config->pConfig->writerCount, &writer, config);
 }
 
+/*
+ * Returns the number of a buffer's readers that it runs itself: every reader but the subscribers, which run
+ * on executors of their own.
+ */
+int ownReaderCount(ProgramConfig *pConfig)
+{
+    return pConfig->readerCount - pConfig->subscriberCount;
+}
+
 /*
  * Starts a set of reader threads, inserting each reader thread into the passed array.
  */
 int startReaders(pthread_t *array, RWConfig *config)
 {
-    return createThreads(array, config->pConfig->readerCount, &reader, config);
+    return createThreads(array, ownReaderCount(config->pConfig), &reader, config);
+}
+
+/*
+ * Returns the number of threads that run a buffer's own readers: one for each reader, or with executors,
+ * one for each executor, which run the buffer's writers too, though never more executors than readers and
+ * writers.
+ */
+int readerThreadCount(ProgramConfig *pConfig)
+{
+    int tasks = ownReaderCount(pConfig) + pConfig->writerCount;
+
+    if (!pConfig->executorCount)
+    {
+        return ownReaderCount(pConfig);
+    }
+
+    return pConfig->executorCount < tasks ? pConfig->executorCount : tasks;
+}
+
+/*
+ * Starts a set of executor threads, inserting each into the passed array, and shares a buffer's readers,
+ * then its writers, out between them as tasks, in turn.
+ */
+int startWorkerTasks(pthread_t *array, ChannelHost *host)
+{
+    RWConfig *rwConfig = host->rwConfig;
+    int count = readerThreadCount(rwConfig->pConfig), readers = ownReaderCount(rwConfig->pConfig), created = 0,
+        id;
+
+    host->executors = (Executor *)malloc(count * sizeof(Executor));
+    host->readerTasks = (ReaderTask *)malloc(rwConfig->pConfig->readerCount * sizeof(ReaderTask));
+    host->writerTasks = (WriterTask *)malloc(rwConfig->pConfig->writerCount * sizeof(WriterTask));
+    for (id = 0; id < count; id++)
+    {
+        initializeExecutor(&host->executors[id]);
+    }
+
+    /* Every task is added before its executor starts, so that no executor finishes before it has all of
+     * its tasks. */
+    for (id = 0; id < readers; id++)
+    {
+        addReaderTask(rwConfig, id, &host->readerTasks[id], &host->executors[id % count]);
+    }
+    rwConfig->nextReaderId = readers;
+    for (id = 0; id < rwConfig->pConfig->writerCount; id++)
+    {
+        addWriterTask(rwConfig, id, &host->writerTasks[id], &host->executors[(readers + id) % count]);
+    }
+    rwConfig->nextWriterId = rwConfig->pConfig->writerCount;
+
+    while (created < count && !pthread_create(&array[created], NULL, &runExecutor, &host->executors[created]))
+    {
+        created++;
+    }
+
+    return created;
+}
+
+/*
+ * Starts the members of every consumer group, inserting each member thread into the passed array.
+ */
+int startMembers(pthread_t *array, RWConfig *config)
+{
+    return createThreads(array, config->pConfig->memberCount, &groupMember, config);
+}
+
+/*
+ * Monitor thread callback. Prints live statistics for a channel to stderr until the run finishes.
+ */
+static void *monitor(void *vpConfig)
+{
+    RWConfig *rwConfig = (RWConfig *)vpConfig;
+
+    monitorStats(stderr, rwConfig->stats, rwConfig->pConfig->channelName);
+
+    return NULL;
+}
+
+/*
+ * Starts the monitor thread if live statistics were requested.
+ */
+int startMonitor(pthread_t *thread, RWConfig *config)
+{
+    return config->pConfig->top ? createThreads(thread, 1, &monitor, config) : 0;
+}
+
+/*
+ * Starts the autoscaler thread if the buffer has workers for it to park.
+ */
+int startAutoscaler(pthread_t *thread, RWConfig *config)
+{
+    return autoscaled(config->pConfig) ? createThreads(thread, 1, &autoscaler, config) : 0;
+}
+
+/*
+ * Starts the journal reader thread if the stream is being recorded.
+ */
+int startJournalReader(pthread_t *thread, RWConfig *config)
+{
+    return config->pConfig->journalName != NULL ? createThreads(thread, 1, &journalReader, config) : 0;
 }
 
 /*
@@ -42,6 +151,34 @@ int readInt(char *str)
     return value;
 }
 
+/*
+ * Reads a floating point number from a string.
+ */
+double readDouble(char *str)
+{
+    double value = 0;
+    sscanf(str, "%lf", &value);
+
+    return value;
+}
+
+/*
+ * Reads the value of an optional argument. If argv[*idx] is the option named name and is followed by a
+ * value, advances *idx past both and returns the value. Otherwise returns NULL.
+ */
+char *readOption(int argc, char **argv, int *idx, char *name)
+{
+    char *value = NULL;
+
+    if (*idx + 1 < argc && !strcmp(argv[*idx], name))
+    {
+        value = argv[*idx + 1];
+        *idx += 2;
+    }
+
+    return value;
+}
+
 /*
  * Joins an array of threads of length count.
  *
@@ -62,7 +199,28 @@ void joinThreads(pthread_t *threads, int count, void **retValues)
 }
 
 /*
- * Joins an array of writer threads of length count.
+ * Checks that between them, a buffer's writers wrote every item in the input stream, sum in total.
+ *
+ * Returns a status code:
+ *   ERROR_INCORRECT_WRITES:
+ *     The writers failed to write the correct number of times in total.
+ *   0:
+ *     No errors were encountered.
+ */
+static int checkWrites(int sum, RWConfig *config)
+{
+    if (sum != config->writes)
+    {
+        printf("Error: Incorrect number of total writes: %d\n", sum);
+        return ERROR_INCORRECT_WRITES;
+    }
+
+    return 0;
+}
+
+/*
+ * Joins an array of writer threads of length count. Between them, the writers should have written every
+ * item in the input stream.
  *
  * Returns a status code:
  *   ERROR_INCORRECT_WRITES:
@@ -70,7 +228,7 @@ void joinThreads(pthread_t *threads, int count, void **retValues)
  *   0:
  *     No errors were encountered.
  */
-int joinWriterThreads(pthread_t *threads, int count)
+int joinWriterThreads(pthread_t *threads, int count, RWConfig *config)
 {
     int i, sCode = 0, sum = 0, **retValues = (int **)malloc(count * sizeof(int *));
 
@@ -82,18 +240,34 @@ int joinWriterThreads(pthread_t *threads, int count)
         free(retValues[i]);
     }
 
-    if (sum != NUM_ELEMENTS_DATA_FILE)
-    {
-        sCode = ERROR_INCORRECT_WRITES;
-        printf("Error: Incorrect number of total writes: %d\n", sum);
-    }
+    sCode = checkWrites(sum, config);
     free(retValues);
 
     return sCode;
 }
 
 /*
- * Joins an array of reader threads of length count.
+ * Checks an array of writer tasks of length count once the executors running them have been joined.
+ * Between them, the writers should have written every item in the input stream.
+ *
+ * Returns a status code as joinWriterThreads() does.
+ */
+int joinWriterTasks(WriterTask *tasks, int count, RWConfig *config)
+{
+    int i, sum = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        sum += tasks[i].cursor.writes;
+    }
+
+    return checkWrites(sum, config);
+}
+
+/*
+ * Joins an array of threadCount threads running count readers, whose positions are given by states. Each
+ * reader should have reached the end of the input stream, whether by reading every item or by skipping
+ * some it lost by falling behind. A reader that was detached may have stopped anywhere.
  *
  * Returns a status code:
  *   ERROR_INCORRECT_READS:
@@ -101,23 +275,62 @@ int joinWriterThreads(pthread_t *threads, int count)
  *  0:
  *    No errors were encountered.
  */
-int joinReaderThreads(pthread_t *threads, int count)
+int joinReaderThreads(pthread_t *threads, int threadCount, ReaderState *states, int count, RWConfig *config)
 {
-    int i, sCode = 0, **retValues = (int **)malloc(count * sizeof(int *));
+    int i, sCode = 0, **retValues = (int **)malloc(threadCount * sizeof(int *));
 
-    joinThreads(threads, count, (void **)retValues);
+    joinThreads(threads, threadCount, (void **)retValues);
+    for (i = 0; i < threadCount; i++)
+    {
+        free(retValues[i]);
+    }
 
+    /* Readers take their identifiers as they start, so a thread's position in the array is not its
+     * identifier. Check each reader's position by identifier instead. */
     for (i = 0; i < count; i++)
     {
-        if (*retValues[i] != NUM_ELEMENTS_DATA_FILE)
+        if (!states[i].detached && states[i].cursor != config->writes)
         {
             sCode = ERROR_INCORRECT_READS || sCode;
-            printf("Error: Incorrect number of reads: %d\n", *retValues[i]);
+            printf("Error: Incorrect number of reads: %d\n", states[i].cursor);
         }
+    }
+    free(retValues);
+
+    return sCode;
+}
+
+/*
+ * Joins the member threads of every consumer group. Between its members, each group should have consumed
+ * every item in the input stream, bar any it lost to being overwritten.
+ *
+ * Returns a status code:
+ *   ERROR_INCORRECT_READS:
+ *     At least one group failed to consume every item.
+ *  0:
+ *    No errors were encountered.
+ */
+int joinMemberThreads(pthread_t *threads, int count, RWConfig *config)
+{
+    int i, sCode = 0, **retValues = (int **)malloc(count * sizeof(int *));
+
+    joinThreads(threads, count, (void **)retValues);
+    for (i = 0; i < count; i++)
+    {
         free(retValues[i]);
     }
     free(retValues);
 
+    for (i = 0; i < config->pConfig->groupCount; i++)
+    {
+        if (config->groups[i].cursor != config->writes ||
+            config->groups[i].consumed + config->groups[i].lost != config->writes)
+        {
+            sCode = ERROR_INCORRECT_READS || sCode;
+            printf("Error: Incorrect number of items consumed by group %d: %d\n", i, config->groups[i].consumed);
+        }
+    }
+
     return sCode;
 }
 
@@ -143,9 +356,10 @@ void printStatus(int sCode)
  * The returned structure will contain values that may be needed for the functioning of the program,
  * but in an encapsulating struct.
  */
-ProgramConfig *readCommandLineArguments(char **argv)
+ProgramConfig *readCommandLineArguments(int argc, char **argv)
 {
     ProgramConfig *config = (ProgramConfig *)malloc(sizeof(ProgramConfig));
+    char *value;
 
     /* Skip program name. */
     int idx = 1;
@@ -159,41 +373,627 @@ ProgramConfig *readCommandLineArguments(char **argv)
     /* Read the number of ms to sleep for writers. */
     config->writerSleepTime = readInt(argv[idx++]);
 
+    /* Read the optional arguments. Anything that is not an option names the input source, which defaults
+     * to the shared_data file. */
+    config->inputName = SHARED_FILE_NAME;
+    config->sinkName = NULL;
+    config->journalName = NULL;
+    config->replaySpeed = 1;
+    config->top = false;
+    config->maxLagItems = 0;
+    config->maxLagNs = 0;
+    config->lagPolicy = LAG_POLICY_DETACH;
+    config->overwrite = false;
+    config->spillName = NULL;
+    config->capacity = SHM_BUFFER_SIZE;
+    config->maxCapacity = 0;
+    config->groupCount = 0;
+    config->memberCount = 0;
+    config->channelCount = 0;
+    config->subscriptionCount = 0;
+    config->subscriberCount = 0;
+    config->channelName = NULL;
+    config->relayCount = 0;
+    config->sinkBase = 0;
+    config->itemFields = 1;
+    config->daemonName = NULL;
+    config->autoscale = false;
+    config->minWriters = 1;
+    config->minMembers = 1;
+    config->executorCount = 0;
+    config->aggregate.count = 0;
+    config->filterCount = 0;
+    config->verify = false;
+    config->trace = true;
+    while (idx < argc)
+    {
+        if (!strcmp(argv[idx], "--top"))
+        {
+            config->top = true;
+            idx++;
+        }
+        else if (!strcmp(argv[idx], "--autoscale"))
+        {
+            config->autoscale = true;
+            idx++;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--min-writers")))
+        {
+            config->minWriters = readInt(value);
+        }
+        else if ((value = readOption(argc, argv, &idx, "--min-members")))
+        {
+            config->minMembers = readInt(value);
+        }
+        else if (!strcmp(argv[idx], "--overwrite"))
+        {
+            config->overwrite = true;
+            idx++;
+        }
+        else if (!strcmp(argv[idx], "--verify"))
+        {
+            config->verify = true;
+            config->trace = false;
+            idx++;
+        }
+        else if (!strcmp(argv[idx], "--no-trace"))
+        {
+            config->trace = false;
+            idx++;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--sink")))
+        {
+            config->sinkName = value;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--record")))
+        {
+            config->journalName = value;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--replay-speed")))
+        {
+            config->replaySpeed = readDouble(value);
+        }
+        else if ((value = readOption(argc, argv, &idx, "--spill")))
+        {
+            config->spillName = value;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--item-size")))
+        {
+            if (readInt(value) >= (int)sizeof(int) && readInt(value) <= MAX_ITEM_SIZE && !(readInt(value) % sizeof(int)))
+            {
+                config->itemFields = readInt(value) / sizeof(int);
+            }
+            else
+            {
+                printf("Error: Ignoring item size of %s bytes; a multiple of %d bytes, at most %d.\n", value,
+                    (int)sizeof(int), MAX_ITEM_SIZE);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--executors")))
+        {
+            if (readInt(value) > 0)
+            {
+                config->executorCount = readInt(value);
+            }
+            else
+            {
+                printf("Error: Ignoring %s executors; at least one.\n", value);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--aggregate")))
+        {
+            if (parseAggregatePipeline(&config->aggregate, value))
+            {
+                printf("Error: Ignoring aggregate %s; expected up to %d of sum, min, max, count:LOW:HIGH and xor, "
+                    "separated by commas.\n", value, AGGREGATE_MAX_OPS);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--filter")))
+        {
+            if (config->filterCount < MAX_FILTERS && !parseReaderFilter(&config->filters[config->filterCount], value))
+            {
+                config->filterCount++;
+            }
+            else
+            {
+                printf("Error: Ignoring filter %s; expected [N=]range:LOW:HIGH or [N=]bits:MASK, at most %d filters.\n",
+                    value, MAX_FILTERS);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--elastic")))
+        {
+            config->maxCapacity = readInt(value);
+        }
+        else if ((value = readOption(argc, argv, &idx, "--group")))
+        {
+            if (config->groupCount < MAX_CONSUMER_GROUPS && readInt(value) > 0)
+            {
+                config->groupSizes[config->groupCount++] = readInt(value);
+                config->memberCount += readInt(value);
+            }
+            else
+            {
+                printf("Error: Ignoring consumer group of %s members; at most %d groups of at least one member.\n",
+                    value, MAX_CONSUMER_GROUPS);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--channel")))
+        {
+            if (config->channelCount < MAX_CHANNELS)
+            {
+                config->channelSpecs[config->channelCount++] = value;
+            }
+            else
+            {
+                printf("Error: Ignoring channel %s; at most %d channels.\n", value, MAX_CHANNELS);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--subscribe")))
+        {
+            if (config->subscriptionCount < MAX_SUBSCRIBERS)
+            {
+                config->subscriptionSpecs[config->subscriptionCount++] = value;
+            }
+            else
+            {
+                printf("Error: Ignoring subscription %s; at most %d subscribers.\n", value, MAX_SUBSCRIBERS);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--fan-out")))
+        {
+            if (readInt(value) > 0 && readInt(value) <= MAX_RELAYS && readInt(value) <= config->readerCount)
+            {
+                config->relayCount = readInt(value);
+            }
+            else
+            {
+                printf("Error: Ignoring fan-out of %s; between 1 and %d relays, and no more than the readers.\n",
+                    value, MAX_RELAYS);
+            }
+        }
+        else if ((value = readOption(argc, argv, &idx, "--daemon")))
+        {
+            config->daemonName = value;
+        }
+        else if ((value = readOption(argc, argv, &idx, "--max-lag")))
+        {
+            config->maxLagItems = readInt(value);
+        }
+        else if ((value = readOption(argc, argv, &idx, "--max-lag-ms")))
+        {
+            config->maxLagNs = (long long)(readDouble(value) * 1000000);
+        }
+        else if ((value = readOption(argc, argv, &idx, "--lag-policy")))
+        {
+            config->lagPolicy = strcmp(value, "catch-up") ? LAG_POLICY_DETACH : LAG_POLICY_CATCH_UP;
+        }
+        else
+        {
+            config->inputName = argv[idx++];
+        }
+    }
+
+    /* The journal and the spill file hold a single field of each item. */
+    if (config->itemFields > 1 && (config->journalName != NULL || config->spillName != NULL))
+    {
+        printf("Error: Ignoring --record and --spill with items of more than %d bytes.\n", (int)sizeof(int));
+        config->journalName = NULL;
+        config->spillName = NULL;
+    }
+
     return config;
 }
 
 /*
- * Entry point for the program.
+ * Reads the channels the run hosts into the passed array. A run given no channels hosts a single unnamed
+ * channel. Channels that are malformed, or named the same as an earlier channel, are ignored.
+ *
+ * Returns the number of channels read.
  */
-int main(int argc, char **argv)
+int readChannels(Channel *channels, ProgramConfig *config)
 {
-    int sCode = 0;
-    ProgramConfig *config;
+    int i, j, count = 0;
 
-    RWConfig *rwConfig;
+    for (i = 0; i < config->channelCount; i++)
+    {
+        if (readChannel(&channels[count], config->channelSpecs[i]))
+        {
+            printf("Error: Ignoring channel %s; expected NAME[:SIZE]=SOURCE.\n", config->channelSpecs[i]);
+            continue;
+        }
+        for (j = 0; j < count && strcmp(channels[j].name, channels[count].name); j++)
+        {
+        }
+        if (j < count)
+        {
+            printf("Error: Ignoring channel %s; the name is already taken.\n", config->channelSpecs[i]);
+            continue;
+        }
+        count++;
+    }
 
-    /* Reader & Writer threads. */
-    pthread_t *readers = NULL;
-    pthread_t *writers = NULL;
+    return config->channelCount ? count : 1;
+}
 
-    if (argc >= MIN_NUM_CLARGS)
+/*
+ * Reads the channels each subscriber reads into the passed array, and counts each subscriber among the
+ * readers of every channel it reads. Subscriptions that name a channel the run does not host, or one
+ * twice, are ignored, as are all of them in a run that hosts no channels.
+ *
+ * Returns the number of subscriptions read.
+ */
+int readSubscriptions(Subscription *subscriptions, ProgramConfig *config, Channel *channels, int channelCount)
+{
+    int i, j, count = 0;
+
+    for (i = 0; i < config->subscriptionCount; i++)
+    {
+        if (!config->channelCount || readSubscription(&subscriptions[count], config->subscriptionSpecs[i],
+            channels, channelCount))
+        {
+            printf("Error: Ignoring subscription %s; expected NAME,NAME... naming channels given by --channel.\n",
+                config->subscriptionSpecs[i]);
+            continue;
+        }
+        for (j = 0; j < subscriptions[count].channelCount; j++)
+        {
+            channels[subscriptions[count].channels[j]].subscribers++;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+/*
+ * Derives the configuration of the buffer of one of the relays of a stream that fans out. The relays share
+ * out the stream's readers as evenly as they can, in order. Recording, spilling and consumer groups stay
+ * with the stream's own buffer, and the relay publishes to its buffer without pausing.
+ */
+ProgramConfig *relayConfig(ProgramConfig *config, int relayId, char *name)
+{
+    ProgramConfig *relay = (ProgramConfig *)malloc(sizeof(ProgramConfig));
+    int first = relayId * config->readerCount / config->relayCount;
+
+    *relay = *config;
+    relay->readerCount = (relayId + 1) * config->readerCount / config->relayCount - first;
+    relay->sinkBase = config->sinkBase + first;
+    relay->writerCount = 1;
+    relay->writerSleepTime = 0;
+    relay->inputName = NULL;
+    relay->journalName = NULL;
+    relay->spillName = NULL;
+    relay->groupCount = 0;
+    relay->memberCount = 0;
+    relay->relayCount = 0;
+
+    /* Name the relay's buffer after the channel, so that its statistics can be told apart. */
+    snprintf(name, RELAY_NAME_SIZE, "%s%srelay%d", config->channelName != NULL ? config->channelName : "",
+        config->channelName != NULL ? "." : "", relayId);
+    relay->channelName = name;
+
+    return relay;
+}
+
+/*
+ * Creates a buffer for the given configuration, which it frees with the buffer. Its threads are started
+ * by startBuffer().
+ */
+void createBuffer(ChannelHost *host, ProgramConfig *pConfig, FILE *fPtrSimOut)
+{
+    host->readers = (pthread_t *)malloc(readerThreadCount(pConfig) * sizeof(pthread_t));
+    host->writers = (pthread_t *)malloc(pConfig->writerCount * sizeof(pthread_t));
+    host->members = (pthread_t *)malloc(pConfig->memberCount * sizeof(pthread_t));
+    host->rwConfig = createRWConfig(pConfig, fPtrSimOut);
+    host->executors = NULL;
+    host->readerTasks = NULL;
+    host->writerTasks = NULL;
+    host->relays = NULL;
+    host->started = false;
+}
+
+/*
+ * Starts the threads serving a buffer.
+ */
+void startBuffer(ChannelHost *host)
+{
+    if (host->rwConfig->pConfig->executorCount)
     {
-        config = readCommandLineArguments(argv);
+        startWorkerTasks(host->readers, host);
+    }
+    else
+    {
+        startReaders(host->readers, host->rwConfig);
+    }
+    startJournalReader(&host->journal, host->rwConfig);
+    startMembers(host->members, host->rwConfig);
+    if (!host->rwConfig->pConfig->executorCount)
+    {
+        startWriters(host->writers, host->rwConfig);
+    }
+    startMonitor(&host->top, host->rwConfig);
+    startAutoscaler(&host->autoscaler, host->rwConfig);
+    host->started = true;
+}
 
-        readers = (pthread_t *)malloc(config->readerCount * sizeof(pthread_t));
-        writers = (pthread_t *)malloc(config->writerCount * sizeof(pthread_t));
+/*
+ * Creates the buffer of a channel and starts the threads serving it. channel is NULL for the unnamed
+ * channel of a run that hosts no others.
+ *
+ * A channel that fans out is read by its relays rather than its readers. Each relay forwards the stream
+ * down a pipe to a writer of its own buffer, which serves the relay's share of the readers, so writers to
+ * the channel's buffer wait on no more than the relays however many readers there are.
+ *
+ * Returns a status code:
+ *   ERROR_OPENING_RELAY:
+ *     The pipe to a relay's buffer could not be created.
+ *   ERROR_OPENING_SPILL:
+ *     The channel's spill file could not be created.
+ *   ERROR_OPENING_SOURCE:
+ *     The channel's input source could not be opened.
+ *   0:
+ *     No errors were encountered.
+ */
+int openChannel(ChannelHost *host, ProgramConfig *config, Channel *channel, FILE *fPtrSimOut)
+{
+    int sCode = 0, relayId, fds[2], *relayFds = NULL;
+    ProgramConfig *pConfig = (ProgramConfig *)malloc(sizeof(ProgramConfig));
+    ChannelHost *relays = NULL;
 
-        rwConfig = createRWConfig(config);
+    /* Each channel has a configuration of its own, which its RWConfig frees. */
+    *pConfig = *config;
+    if (channel != NULL)
+    {
+        applyChannel(pConfig, channel);
+    }
 
-        /* Start the threads. */
-        startReaders(readers, rwConfig);
-        startWriters(writers, rwConfig);
+    /*
+     * Start the buffer of every relay first. Its writer waits on the relay's pipe until the relay starts
+     * forwarding the stream, and stops once the relay closes it.
+     */
+    if (pConfig->relayCount)
+    {
+        relays = (ChannelHost *)malloc(pConfig->relayCount * sizeof(ChannelHost));
+        relayFds = (int *)malloc(pConfig->relayCount * sizeof(int));
+        for (relayId = 0; relayId < pConfig->relayCount; relayId++)
+        {
+            if (pipe(fds))
+            {
+                printf("Error: Could not create the pipe to relay %d\n", relayId);
+                sCode = ERROR_OPENING_RELAY;
+                fds[0] = fds[1] = -1;
+            }
+            createBuffer(&relays[relayId], relayConfig(pConfig, relayId, relays[relayId].name), fPtrSimOut);
+            attachInputSource(&relays[relayId].rwConfig->source, fds[0]);
+            relayFds[relayId] = fds[1];
+            startBuffer(&relays[relayId]);
+        }
+
+        /* The relays are the readers of the channel's own buffer. They do not pause between items, and
+         * the channel's members are numbered after every relay's readers. */
+        pConfig->sinkBase += pConfig->readerCount - pConfig->relayCount;
+        pConfig->readerCount = pConfig->relayCount;
+        pConfig->readerSleepTime = 0;
+    }
 
-        /* Wait for all threads to join the main thread of execution. */
-        sCode = joinReaderThreads(readers, config->readerCount) || sCode;
-        sCode = joinWriterThreads(writers, config->writerCount) || sCode;
+    /* Subscribers read the channel's own buffer, after its readers or relays. */
+    if (channel != NULL)
+    {
+        pConfig->subscriberCount = channel->subscribers;
+        pConfig->readerCount += channel->subscribers;
+    }
+
+    createBuffer(host, pConfig, fPtrSimOut);
+    host->rwConfig->relayFds = relayFds;
+    host->relays = relays;
 
-        freeRWConfig(rwConfig);
+    if (pConfig->spillName != NULL && host->rwConfig->spill.fd < 0)
+    {
+        printf("Error: Could not create spill file %s\n", pConfig->spillName);
+        sCode = ERROR_OPENING_SPILL;
+    }
+    else if (host->rwConfig->source.fd < 0)
+    {
+        printf("Error: Could not open input source %s\n", pConfig->inputName);
+        sCode = ERROR_OPENING_SOURCE;
+    }
+    else
+    {
+        startBuffer(host);
+    }
+
+    /* Without relays to forward it, end the stream to every relay's buffer. */
+    for (relayId = 0; !host->started && relayId < pConfig->relayCount; relayId++)
+    {
+        if (relayFds[relayId] >= 0)
+        {
+            close(relayFds[relayId]);
+        }
+    }
+
+    return sCode;
+}
+
+/*
+ * Waits for the threads serving a channel, and those of its relays, to finish, then frees its buffers.
+ *
+ * Returns the status code of the first error encountered while joining, or 0 if there were none.
+ */
+int closeChannel(ChannelHost *host)
+{
+    int sCode = 0, relayId, i;
+    RWConfig *rwConfig = host->rwConfig;
+    ProgramConfig *config = rwConfig->pConfig;
+
+    if (host->started)
+    {
+        /* Wait for all threads to join the main thread of execution. The journal reader reads like
+         * any other reader. */
+        sCode = joinReaderThreads(host->readers, readerThreadCount(config), rwConfig->readerStates,
+            config->readerCount, rwConfig) || sCode;
+        if (config->journalName != NULL)
+        {
+            sCode = joinReaderThreads(&host->journal, 1, &rwConfig->readerStates[config->readerCount], 1,
+                rwConfig) || sCode;
+        }
+        sCode = joinMemberThreads(host->members, config->memberCount, rwConfig) || sCode;
+        if (host->writerTasks != NULL)
+        {
+            sCode = joinWriterTasks(host->writerTasks, config->writerCount, rwConfig) || sCode;
+        }
+        else
+        {
+            sCode = joinWriterThreads(host->writers, config->writerCount, rwConfig) || sCode;
+        }
+
+        /* Every worker has finished. Let the monitor print its last sample and stop. */
+        STATS_STORE(rwConfig->stats->finished, 1);
+        if (config->top)
+        {
+            pthread_join(host->top, NULL);
+        }
+        if (autoscaled(config))
+        {
+            pthread_join(host->autoscaler, NULL);
+        }
+
+        reportLatency(rwConfig);
+    }
+
+    /* The relays have closed their pipes, so their buffers' writers reach the end of the stream. */
+    for (relayId = 0; host->relays != NULL && relayId < config->relayCount; relayId++)
+    {
+        sCode = closeChannel(&host->relays[relayId]) || sCode;
+    }
+    free(host->relays);
+
+    /* Every executor has finished its reader and writer tasks. */
+    for (i = 0; host->executors != NULL && i < readerThreadCount(config); i++)
+    {
+        destroyExecutor(&host->executors[i]);
+    }
+    free(host->executors);
+    free(host->readerTasks);
+    free(host->writerTasks);
+
+    freeRWConfig(rwConfig);
+    free(host->readers);
+    free(host->writers);
+    free(host->members);
+
+    return sCode;
+}
+
+/*
+ * Starts a thread for each subscriber, inserting each into the passed array, once every channel has been
+ * opened. Each subscriber reads every channel it subscribed to that was started, as the next of the
+ * readers counted after the channel's own.
+ */
+void startSubscribers(pthread_t *array, Subscriber *subscribers, Subscription *subscriptions, int count,
+    ChannelHost *hosts, int channelCount, char *sinkName)
+{
+    int nextIds[MAX_CHANNELS], i, j, channel;
+
+    for (i = 0; i < channelCount; i++)
+    {
+        nextIds[i] = ownReaderCount(hosts[i].rwConfig->pConfig);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        openSubscriber(&subscribers[i], i, sinkName, subscriptions[i].channelCount);
+        for (j = 0; j < subscriptions[i].channelCount; j++)
+        {
+            channel = subscriptions[i].channels[j];
+            if (hosts[channel].started)
+            {
+                addSubscriberTask(&subscribers[i], hosts[channel].rwConfig, nextIds[channel]++);
+            }
+        }
+        pthread_create(&array[i], NULL, &runExecutor, &subscribers[i].executor);
+    }
+}
+
+/*
+ * Waits for every subscriber to read each channel it subscribed to, then frees them.
+ */
+void joinSubscribers(pthread_t *threads, Subscriber *subscribers, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        pthread_join(threads[i], NULL);
+        closeSubscriber(&subscribers[i]);
+    }
+}
+
+/*
+ * Entry point for the program.
+ */
+int main(int argc, char **argv)
+{
+    int sCode = 0, channelCount, subscriptionCount, i;
+    ProgramConfig *config;
+    FILE *fPtrSimOut;
+
+    /* The channels the run hosts, and the buffer and threads of each. */
+    Channel *channels;
+    ChannelHost *hosts;
+
+    /* The subscribers reading several channels at once, and the thread of each. */
+    Subscription *subscriptions;
+    Subscriber *subscribers;
+    pthread_t *subscriberThreads;
+
+    if (argc >= MIN_NUM_CLARGS)
+    {
+        config = readCommandLineArguments(argc, argv);
+
+        channels = (Channel *)malloc(MAX_CHANNELS * sizeof(Channel));
+        channelCount = readChannels(channels, config);
+        hosts = (ChannelHost *)malloc(channelCount * sizeof(ChannelHost));
+        subscriptions = (Subscription *)malloc(MAX_SUBSCRIBERS * sizeof(Subscription));
+        subscriptionCount = readSubscriptions(subscriptions, config, channels, channelCount);
+        subscribers = (Subscriber *)malloc(subscriptionCount * sizeof(Subscriber));
+        subscriberThreads = (pthread_t *)malloc(subscriptionCount * sizeof(pthread_t));
+
+        /* A sink consumer that goes away should close that reader's sink, not end the program. */
+        signal(SIGPIPE, SIG_IGN);
+
+        /* Every channel shares the sim_out file. Start every channel before waiting for any of them, so
+         * that they run side by side. */
+        fPtrSimOut = fopen(SHARED_FILE_SIM_OUT_NAME, "w");
+        if (config->daemonName != NULL)
+        {
+            /* A daemon runs one job after another through a single buffer, until told to stop. */
+            channelCount = 0;
+            subscriptionCount = 0;
+            sCode = runDaemon(config, fPtrSimOut) || sCode;
+        }
+        for (i = 0; i < channelCount; i++)
+        {
+            sCode = openChannel(&hosts[i], config, config->channelCount ? &channels[i] : NULL, fPtrSimOut) ||
+                sCode;
+        }
+
+        /* Subscribers are counted among the readers of every channel they read, so they must finish before
+         * any channel's readers are checked. */
+        startSubscribers(subscriberThreads, subscribers, subscriptions, subscriptionCount, hosts, channelCount,
+            config->sinkName);
+        joinSubscribers(subscriberThreads, subscribers, subscriptionCount);
+        for (i = 0; i < channelCount; i++)
+        {
+            sCode = closeChannel(&hosts[i]) || sCode;
+        }
+        fclose(fPtrSimOut);
+
+        free(subscriberThreads);
+        free(subscribers);
+        free(subscriptions);
+        free(hosts);
+        free(channels);
+        free(config);
     }
     else
     {
@@ -202,7 +1002,5 @@ int main(int argc, char **argv)
 
     printStatus(sCode);
 
-    free(readers);
-    free(writers);
     return sCode;
 }
@@ -1,9 +1,18 @@
 #ifndef MAIN_H
 #define MAIN_H
 
+/* For signal() */
+#include <signal.h>
+
+/* For strcmp() */
+#include <string.h>
+
 #include "shared.h"
+#include "channel.h"
 #include "reader.h"
 #include "writer.h"
+#include "daemon.h"
+#include "autoscale.h"
 
 /* Constants */
 #define MIN_NUM_CLARGS (4)
@@ -12,5 +21,52 @@
 #define ERROR_TOO_FEW_ARGS (-1)
 #define ERROR_INCORRECT_READS (-487313)
 #define ERROR_INCORRECT_WRITES (-487315)
+#define ERROR_OPENING_SOURCE (-487317)
+#define ERROR_OPENING_SPILL (-487319)
+#define ERROR_OPENING_RELAY (-487321)
+
+/* The longest name given to the buffer of a relay. */
+#define RELAY_NAME_SIZE (CHANNEL_NAME_SIZE + 16)
+
+/*
+ * The buffer of one channel, or of one of its relays, and the threads serving it.
+ */
+typedef struct ChannelHost
+{
+    /* The name of a relay's buffer. */
+    char name[RELAY_NAME_SIZE];
+
+    RWConfig *rwConfig;
+
+    /* Reader & Writer threads. With executors, the reader threads are the executors, which run the
+     * reader and writer tasks, and there are no writer threads. */
+    pthread_t *readers;
+    pthread_t *writers;
+    Executor *executors;
+    ReaderTask *readerTasks;
+    WriterTask *writerTasks;
+
+    /* Consumer group member threads. */
+    pthread_t *members;
+
+    /* The journal reader thread, when recording. */
+    pthread_t journal;
+
+    /* The live statistics thread, when requested. */
+    pthread_t top;
+
+    /* The autoscaler thread, when requested. */
+    pthread_t autoscaler;
+
+    /* With fan-out, the buffer of each relay and the threads serving it, or NULL. */
+    struct ChannelHost *relays;
+
+    /* Whether the channel's threads were started. They are not if its source or spill file failed to
+     * open. */
+    bool started;
+} ChannelHost;
+
+int createThreads(pthread_t *array, int num, void *(*callback) (void *), void *arg);
+void joinThreads(pthread_t *threads, int count, void **retValues);
 
 #endif /* ifndef MAIN_H */
@@ -1,95 +1,1044 @@
+#include <string.h>
+
 #include "reader.h"
 
 /*
- * Reader thread callback.
+ * Increment the number of readers currently reading. Since multiple readers may perform this
+ * simultaneously, it must be constrained by a mutex lock. If this reader happens to be the first
+ * reader to increment the count, then wait for the writer to finish by requesting the rwMutex.
+ * This also ensures that writers do not attempt to write while the buffer is being read from.
+ */
+static void startReading(RWConfig *rwConfig)
+{
+    pthread_mutex_lock(&rwConfig->rcMutex);
+    if (!rwConfig->activeReaders)
+    {
+        /* Wait for any writers to finish. */
+        pthread_mutex_lock(&rwConfig->rwMutex);
+    }
+    rwConfig->activeReaders++;
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+}
+
+/*
+ * Decrement the number of readers currently reading. Since multiple readers may perform this
+ * simultaneously, we must first request a mutex lock. If this reader is the final reader to read
+ * from the buffer, then unlock the write mutex and hence enable writers to write again.
+ */
+static void stopReading(RWConfig *rwConfig)
+{
+    pthread_mutex_lock(&rwConfig->rcMutex);
+    rwConfig->activeReaders--;
+    if (!rwConfig->activeReaders)
+    {
+        pthread_mutex_unlock(&rwConfig->rwMutex);
+    }
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+}
+
+/*
+ * Returns true if the reader must skip ahead or stop rather than wait for the item it is up to: a writer
+ * has released it for falling behind, or, in overwrite mode, a writer has overwritten the item before it
+ * was read. A reader that was overwritten is moved to the newest item.
  *
- * Reads all items from a buffer, or waits if the buffer doesn't have anything to read.
+ * Must be called with rwConfig->rpMutex held.
  */
-void *reader(void *vpConfig)
+static bool readerSkipped(RWConfig *rwConfig, ReaderState *state, int reads, int idx)
 {
-    RWConfig *rwConfig = (RWConfig *)vpConfig;
-    int reads = 0, *cache, *data = rwConfig->data, idx = 0, value;
+    if (rwConfig->pConfig->overwrite && rwConfig->sequence[idx] > reads)
+    {
+        state->cursor = rwConfig->writes - 1;
+    }
 
-    /* The cache stores the value that we saw at this position last time it was read. If we encounter a
-     * value that hasn't changed, then we should not read it but instead wait for writers to write.
-     * This is used to work around the possibility that a single reader attempts to read more than one
-     * set of values from the buffer before the writer can replace them. */
-    cache = createDefaultValueArray(SHM_BUFFER_SIZE, -2);
+    return state->detached || state->cursor != reads;
+}
 
-    /* Current read position in the circular queue. */
-    while (reads < NUM_ELEMENTS_DATA_FILE)
+/*
+ * Readies a reader's cursor at the start of the stream. Each item is forwarded to the sink and, if journal
+ * is not NULL, appended to the journal. If latency is not NULL, the time each item spent in the buffer is
+ * recorded in it. Progress and waits are published to stats, and traced as reader id. The reader's
+ * position is kept in state, through which writers may release it for falling behind.
+ */
+static void openReadCursor(ReadCursor *cursor, int id, ReaderState *state, OutputSink *sink, Journal *journal,
+    Histogram *latency, WorkerStats *stats)
+{
+    cursor->id = id;
+    cursor->state = state;
+    cursor->sink = sink;
+    cursor->journal = journal;
+    cursor->latency = latency;
+    cursor->stats = stats;
+    cursor->aggregate = NULL;
+    cursor->filter = NULL;
+    cursor->filtered = 0;
+    cursor->skipped = 0;
+    cursor->verifier = NULL;
+    cursor->tag = NULL;
+    cursor->reads = 0;
+    cursor->lost = 0;
+    cursor->idx = 0;
+    cursor->waitStart = 0;
+}
+
+/*
+ * Skips the items of its block a filtering reader is up to, if the block's summary shows that none of the
+ * items published so far passes the reader's filter. The reader gives up its claim on each slot it skips
+ * without reading it. A verifying reader checks the items it skips by the hashes the summary sums.
+ *
+ * Returns true if any item was skipped.
+ */
+static bool skipFilteredItems(RWConfig *rwConfig, ReadCursor *cursor)
+{
+    int reads = cursor->reads, block = reads / FILTER_BLOCK_ITEMS, skipTo, idx, i;
+    unsigned long long blockHash;
+    bool skip;
+    BlockSummary *summary = &rwConfig->summaries[block % rwConfig->summaryCount];
+    ReaderState *state = cursor->state;
+    WorkerStats *stats = cursor->stats;
+
+    pthread_mutex_lock(&rwConfig->rpMutex);
+    skipTo = filterSkipsTo(cursor->filter, summary, block);
+    blockHash = summary->hash;
+    skip = !state->detached && state->cursor == reads && skipTo > reads;
+
+    /* Every item skipped must still be in its slot: not moved to the spill file, nor overwritten. */
+    for (i = reads; i < skipTo && skip; i++)
+    {
+        skip = !spillHolds(&rwConfig->spill, i) && rwConfig->sequence[ringSlot(&rwConfig->ring, i)] == i;
+    }
+    for (i = reads; i < skipTo && skip; i++)
+    {
+        idx = ringSlot(&rwConfig->ring, i);
+        rwConfig->pendingReads[idx]--;
+        cursor->idx = idx;
+    }
+    if (skip)
+    {
+        state->cursor = skipTo;
+    }
+    pthread_mutex_unlock(&rwConfig->rpMutex);
+
+    if (!skip)
+    {
+        return false;
+    }
+
+    if (rwConfig->pConfig->trace)
+    {
+        printf("Reader %d skipped items #%d to #%d, none of which pass its filter.\n", cursor->id, reads,
+            skipTo - 1);
+    }
+    if (cursor->verifier != NULL && skipItems(cursor->verifier, reads, skipTo, blockHash))
     {
-        /* Ensure that we aren't reading the same data. If we are, then the writers have not yet
-         * written to this slot. Wait until a writer does before continuing.
-         *
-         * We could also be checking if the number of pending readers isn't 0, but it's guaranteed not to be 0
-         */
         pthread_mutex_lock(&rwConfig->rpMutex);
-        while (cache[idx] == data[idx] || !rwConfig->pendingReads[idx])
-        {
-            pthread_cond_wait(&rwConfig->emptyCond, &rwConfig->rpMutex);
-        }
+        checkRange(cursor->verifier, rwConfig->checksums);
         pthread_mutex_unlock(&rwConfig->rpMutex);
+    }
+    cursor->reads = skipTo;
+    cursor->filtered += skipTo - reads;
+    cursor->skipped += skipTo - reads;
+    STATS_STORE(stats->items, cursor->reads - cursor->lost);
+    STATS_STORE(stats->cursor, cursor->reads);
+    STATS_STORE(stats->lag, STATS_LOAD(rwConfig->writes) - cursor->reads);
+
+    /* Wake up any writers waiting for the slots we gave up, and resume any writer tasks. */
+    pthread_cond_signal(&rwConfig->fullCond);
+    resumeWaitingWriters(rwConfig);
+
+    return true;
+}
+
+/*
+ * Reads the item a reader is up to, or waits if the buffer doesn't have it yet.
+ *
+ * A detached reader stops; a reader made to catch up, or that was overwritten, skips to the item it was
+ * moved to. A reader that has fallen behind items moved to the spill file reads them from there.
+ *
+ * A reader hosted by an executor passes its task, and rather than wait, suspends it: the task is added to
+ * rwConfig->waitingTasks, for the next writer to publish an item or end the stream to schedule again. It
+ * then calls again to check for the item from the top, as a thread does when it is woken.
+ *
+ * Returns READ_MORE once the reader has read or skipped items, and should read again; READ_PENDING once
+ * the task has been suspended; or READ_DONE once the reader has read every item, or been detached.
+ */
+static int readNextItem(RWConfig *rwConfig, ReadCursor *cursor, Task *task)
+{
+    int reads = cursor->reads, *data = rwConfig->data, idx, value, skipTo, writerId, *item,
+        itemFields = rwConfig->pConfig->itemFields, id = cursor->id, fields[MAX_ITEM_FIELDS];
+    long long publishTime;
+    bool done, released, spilled = false, overwrite = rwConfig->pConfig->overwrite, overwritten;
+    ReaderState *state = cursor->state;
+    OutputSink *sink = cursor->sink;
+    WorkerStats *stats = cursor->stats;
+    SpillRecord record;
 
+    /* A filtering reader skips what has been published of its block if none of it passes. */
+    if (cursor->filter != NULL && skipFilteredItems(rwConfig, cursor))
+    {
+        return READ_MORE;
+    }
+
+    /* Ensure that we aren't reading the same data. The item we want next has sequence number reads; if the
+     * slot holds any other sequence, the writers have not yet written to this slot. Wait until a writer
+     * does before continuing. This is used to work around the possibility that a single reader attempts
+     * to read more than one set of values from the buffer before the writer can replace them.
+     *
+     * Stop once the writers have reported end-of-stream and we have read every item they wrote.
+     *
+     * Also stop waiting if we must skip ahead, or if the item has been moved to the spill file.
+     */
+    pthread_mutex_lock(&rwConfig->rpMutex);
+    idx = ringSlot(&rwConfig->ring, reads);
+    while (!(released = readerSkipped(rwConfig, state, reads, idx)) &&
+        !(spilled = spillHolds(&rwConfig->spill, reads)) && rwConfig->sequence[idx] != reads &&
+        !(rwConfig->eof && reads >= rwConfig->writes))
+    {
         /*
-         * Increment the number of readers currently reading. Since multiple readers may perform this
-         * simultaneously, it must be constrained by a mutex lock. If this reader happens to be the first
-         * reader to increment the count, then wait for the writer to finish by requesting the rwMutex.
-         * This also ensures that writers do not attempt to write while the buffer is being read from.
+         * We have reached the end of the span of slots available to us. This is the point to write out
+         * anything buffered for the sink, rather than once per item. Release the mutex while doing so, so
+         * that writers are not held up by the sink, and check again afterwards.
          */
-        pthread_mutex_lock(&rwConfig->rcMutex);
-        if (!rwConfig->activeReaders)
+        if (sinkHasPending(sink))
         {
-            /* Wait for any writers to finish. */
-            pthread_mutex_lock(&rwConfig->rwMutex);
+            pthread_mutex_unlock(&rwConfig->rpMutex);
+            flushOutputSink(sink);
+            pthread_mutex_lock(&rwConfig->rpMutex);
+            idx = ringSlot(&rwConfig->ring, reads);
+            continue;
         }
-        rwConfig->activeReaders++;
-        pthread_mutex_unlock(&rwConfig->rcMutex);
 
-        value = data[idx];
-        cache[idx] = value;
-        printf("Read value #%d (%d) from data buffer index %d.\n", reads, value, idx);
-        reads++;
+        if (!cursor->waitStart)
+        {
+            cursor->waitStart = readClockNs();
+            STATS_STORE(stats->waits, stats->waits + 1);
+            SDS_PROBE(reader_wait_begin, reads, idx, id);
+        }
 
-        /* Request a mutex lock to avoid synchronisation issues of pending read counts. */
-        pthread_mutex_lock(&rwConfig->rpMutex);
-        rwConfig->pendingReads[idx]--;
-        pthread_mutex_unlock(&rwConfig->rpMutex);
+        /* A task must not hold up its executor's thread, which runs other readers. We are added to the
+         * waiting tasks before releasing the mutex, so that a writer that publishes after we checked is
+         * guaranteed to see us and resume us. */
+        if (task != NULL)
+        {
+            task->next = rwConfig->waitingTasks;
+            rwConfig->waitingTasks = task;
+            pthread_mutex_unlock(&rwConfig->rpMutex);
+            cursor->idx = idx;
+            return READ_PENDING;
+        }
+        pthread_cond_wait(&rwConfig->emptyCond, &rwConfig->rpMutex);
+        STATS_STORE(stats->wakeups, stats->wakeups + 1);
+
+        /* A writer may have begun a new generation of the buffer, in which the item is to go. */
+        idx = ringSlot(&rwConfig->ring, reads);
+    }
+    done = released ? state->detached : !spilled && rwConfig->sequence[idx] != reads;
+    skipTo = released ? state->cursor : reads;
+    cursor->idx = idx;
+
+    /*
+     * A spilled item is copied out while we hold the mutex, since writers append to the spill file and
+     * release its space under it. Once we pass the end of a segment, or of everything spilled, release
+     * whatever every reader has now read.
+     */
+    if (spilled)
+    {
+        record = *readSpillRecord(&rwConfig->spill, reads);
+        state->cursor = reads + 1;
+        if ((reads + 1 - rwConfig->spill.base) % SPILL_SEGMENT_RECORDS == 0 ||
+            reads + 1 == rwConfig->spill.end)
+        {
+            reclaimSpill(&rwConfig->spill, oldestUnread(rwConfig));
+        }
+    }
+    pthread_mutex_unlock(&rwConfig->rpMutex);
 
-        idx = (idx + 1) % SHM_BUFFER_SIZE;
+    if (cursor->waitStart)
+    {
+        STATS_STORE(stats->waitNs, stats->waitNs + readClockNs() - cursor->waitStart);
+        SDS_PROBE(reader_wait_end, reads, idx, id);
+        cursor->waitStart = 0;
+    }
 
+    if (released)
+    {
         /*
-         * Decrement the number of readers currently reading. Since multiple readers may perform this
-         * simultaneously, we must first request a mutex lock. If this reader is the final reader to read
-         * from the buffer, then unlock the write mutex and hence enable writers to write again.
+         * A writer found us holding up its slot after falling too far behind and gave up our claim on
+         * every item we had not read, or, in overwrite mode, the writers lapped us. If we have been
+         * detached we must stop; otherwise we pick up from the item we were moved to.
          */
-        pthread_mutex_lock(&rwConfig->rcMutex);
-        rwConfig->activeReaders--;
-        if (!rwConfig->activeReaders)
+        if (done)
+        {
+            printf("Error: Reader %d fell behind and was detached, losing every item from #%d.\n", id, reads);
+        }
+        else if (rwConfig->pConfig->overwrite)
+        {
+            printf("Reader %d was lapped by the writers and skipped items #%d to #%d.\n", id, reads,
+                skipTo - 1);
+        }
+        else
         {
-            pthread_mutex_unlock(&rwConfig->rwMutex);
+            printf("Error: Reader %d fell behind and lost items #%d to #%d.\n", id, reads, skipTo - 1);
         }
-        pthread_mutex_unlock(&rwConfig->rcMutex);
 
+        if (done)
+        {
+            return READ_DONE;
+        }
+        if (cursor->verifier != NULL)
+        {
+            missItems(cursor->verifier, reads, skipTo);
+        }
+        cursor->lost += skipTo - reads;
+        cursor->reads = skipTo;
+        STATS_STORE(stats->lost, cursor->lost);
+        STATS_STORE(stats->cursor, cursor->reads);
+        return READ_MORE;
+    }
+
+    if (done)
+    {
+        return READ_DONE;
+    }
+
+    if (spilled)
+    {
+        value = record.value;
+        item = &value;
+        writerId = record.writerId;
+        publishTime = record.publishTime;
+    }
+    else if (overwrite)
+    {
         /*
-         * Wake up any writers that went to sleep because there were no empty buffers to write to.
+         * In overwrite mode, writers never wait for readers, and readers do not hold them off: the item is
+         * copied out, then checked to still be in its slot, as with a seqlock. A writer marks the slot
+         * SEQUENCE_WRITING before overwriting it, so a copy it tore is never taken for the item. If the
+         * item was overwritten, go back and skip ahead. Otherwise our claim on it is given up as it is
+         * checked, as it is read from the copy.
          */
-        pthread_cond_signal(&rwConfig->fullCond);
+        memcpy(fields, &data[idx * rwConfig->stride], itemFields * sizeof(int));
+        writerId = rwConfig->writerIds[idx];
+        publishTime = rwConfig->publishTimes[idx];
+
+        pthread_mutex_lock(&rwConfig->rpMutex);
+        overwritten = rwConfig->sequence[idx] != reads;
+        if (!overwritten && !state->detached && state->cursor == reads)
+        {
+            rwConfig->pendingReads[idx]--;
+            state->cursor = reads + 1;
+        }
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+
+        if (overwritten)
+        {
+            return READ_MORE;
+        }
+        item = fields;
+        value = *item;
+    }
+    else
+    {
+        /* Make room in the sink for the item before we start reading, so that a full buffer is written out
+         * while the writers can still write. */
+        reserveSinkSpace(sink, itemFields * SINK_ITEM_MAX_BYTES + (cursor->tag != NULL ? SINK_TAG_MAX_BYTES : 0));
+        startReading(rwConfig);
+
+        /* With a spill file, a writer may have moved the item there after we checked for it, and before
+         * we started reading. Go back and read it from there. */
+        if (rwConfig->sequence[idx] != reads)
+        {
+            stopReading(rwConfig);
+            return READ_MORE;
+        }
+
+        /* The item is read in place: the slot is ours until we give up our claim on it below. */
+        item = &data[idx * rwConfig->stride];
+        value = *item;
+        writerId = rwConfig->writerIds[idx];
+        publishTime = rwConfig->publishTimes[idx];
+    }
+
+    if (cursor->latency != NULL)
+    {
+        recordHistogramValue(cursor->latency, readClockNs() - publishTime);
+    }
+    if (rwConfig->pConfig->trace && spilled)
+    {
+        printf("Read value #%d (%d) from the spill file.\n", reads, value);
+    }
+    else if (rwConfig->pConfig->trace)
+    {
+        printf("Read value #%d (%d) from data buffer index %d.\n", reads, value, idx);
+    }
+    if (cursor->filter != NULL && !filterPasses(cursor->filter, value))
+    {
+        /* The item is still read, and our claim on it given up, but it goes no further. */
+        cursor->filtered++;
+    }
+    else
+    {
+        if (cursor->tag != NULL)
+        {
+            writeSinkTag(sink, cursor->tag);
+        }
+        if (itemFields == 1)
+        {
+            writeSinkItem(sink, value);
+        }
+        else
+        {
+            writeSinkRecord(sink, item, itemFields);
+        }
+        if (cursor->aggregate != NULL)
+        {
+            aggregateValue(cursor->aggregate, value);
+        }
+    }
+    if (cursor->journal != NULL)
+    {
+        appendJournalRecord(cursor->journal, reads, writerId, publishTime, value);
+    }
+
+    /* Every item read is checked, whether or not it passes the reader's filter. Once the last item of a
+     * range is read, the writers have published every item of it, and its checksum is compared. */
+    if (cursor->verifier != NULL && verifyItem(cursor->verifier, reads, item, itemFields * sizeof(int)))
+    {
+        pthread_mutex_lock(&rwConfig->rpMutex);
+        checkRange(cursor->verifier, rwConfig->checksums);
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+    }
+    SDS_PROBE(consume, reads, idx, id);
+    reads++;
+    cursor->reads = reads;
+    STATS_STORE(stats->items, reads - cursor->lost);
+    STATS_STORE(stats->cursor, reads);
+    STATS_STORE(stats->lag, STATS_LOAD(rwConfig->writes) - reads);
+
+    if (!spilled && !overwrite)
+    {
+        /* Request a mutex lock to avoid synchronisation issues of pending read counts. If a writer
+         * released us while we were reading, it has already given up our claim on this slot. If a writer
+         * moved the item to the spill file while we were reading, the slot holds no claims. */
+        pthread_mutex_lock(&rwConfig->rpMutex);
+        if (!state->detached && state->cursor == reads - 1)
+        {
+            if (rwConfig->sequence[idx] == reads - 1)
+            {
+                rwConfig->pendingReads[idx]--;
+            }
+            state->cursor = reads;
+        }
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+
+        stopReading(rwConfig);
 
         /*
-         * All this reading has made me tired. Time for a well-earned nap.
+         * Wake up any writers that went to sleep because there were no empty buffers to write to, and
+         * resume any writer tasks suspended for the same reason.
          */
+        pthread_cond_signal(&rwConfig->fullCond);
+        resumeWaitingWriters(rwConfig);
+    }
+
+    /*
+     * All this reading has made me tired. Time for a well-earned nap. Even a nap of no time costs a
+     * system call and the timer's slack, which a task pays for every reader on its executor's thread.
+     */
+    if (rwConfig->pConfig->readerSleepTime)
+    {
         sleep(rwConfig->pConfig->readerSleepTime);
     }
 
+    return READ_MORE;
+}
+
+/*
+ * Reads all items from a buffer through a reader's cursor, waiting whenever the buffer doesn't have
+ * anything to read.
+ *
+ * Returns the number of items read.
+ */
+static int readStream(RWConfig *rwConfig, ReadCursor *cursor)
+{
+    while (readNextItem(rwConfig, cursor, NULL) != READ_DONE)
+    {
+    }
+
+    SDS_PROBE(reader_exit, cursor->reads - cursor->lost, cursor->idx, cursor->id);
+
+    return cursor->reads - cursor->lost;
+}
+
+/*
+ * Opens the output sink of reader id, and readies its cursor on it. The readers of a stream that fans out
+ * are its relays, which forward the stream down their pipes instead, a span of items at a time, to be
+ * published again to their own buffers.
+ *
+ * With --aggregate, the reader runs its operators over each value read, keeping their results in
+ * aggregate. With --filter, it forwards only the values that pass its filter, if it has one. Relays leave
+ * both to the readers they serve. With --verify, readers and relays alike check what they read against
+ * what was published, keeping their checksums in verifier.
+ */
+static void openReader(RWConfig *rwConfig, int id, ReadCursor *cursor, OutputSink *sink, Aggregate *aggregate,
+    StreamVerifier *verifier)
+{
+    if (rwConfig->relayFds != NULL)
+    {
+        attachOutputSink(sink, rwConfig->relayFds[id]);
+    }
+    else if (openOutputSink(sink, rwConfig->pConfig->sinkName, rwConfig->pConfig->sinkBase + id))
+    {
+        printf("Error: Could not open output sink for reader %d.\n", rwConfig->pConfig->sinkBase + id);
+    }
+
+    openReadCursor(cursor, id, &rwConfig->readerStates[id], sink, NULL, &rwConfig->latencies[id],
+        readerStats(rwConfig->stats, id));
+    if (rwConfig->pConfig->aggregate.count && rwConfig->relayFds == NULL)
+    {
+        initializeAggregate(aggregate, &rwConfig->pConfig->aggregate);
+        cursor->aggregate = aggregate;
+    }
+    if (rwConfig->relayFds == NULL)
+    {
+        cursor->filter = findReaderFilter(rwConfig->pConfig->filters, rwConfig->pConfig->filterCount,
+            rwConfig->pConfig->sinkBase + id);
+    }
+    if (rwConfig->checksums != NULL)
+    {
+        openVerifier(verifier, selectChecksumKernel(), 0);
+        cursor->verifier = verifier;
+    }
+}
+
+/*
+ * Finishes a reader's check of what it read against what was published, and reports the outcome, naming
+ * the reader as label (in the log) and type (in the sim_out file) with number.
+ */
+static void reportVerification(RWConfig *rwConfig, ReadCursor *cursor, char *label, char *type, int number)
+{
+    StreamVerifier *verifier = cursor->verifier;
+    char outcome[VERIFICATION_REPORT_SIZE];
+
+    /* The writers have published the whole stream by now, unless we were detached part way. */
+    pthread_mutex_lock(&rwConfig->rpMutex);
+    finishVerifier(verifier, rwConfig->checksums, &rwConfig->published, cursor->reads);
+    pthread_mutex_unlock(&rwConfig->rpMutex);
+
+    formatVerification(verifier, outcome, sizeof(outcome));
+    if (verifierDiverged(verifier))
+    {
+        printf("Error: %s %d read a stream that diverged from the one published: %s\n", label, number, outcome);
+    }
+    else
+    {
+        printf("%s %d verified the stream it read: %s\n", label, number, outcome);
+    }
+    simWriteVerification(rwConfig->fPtrSimOut, type, number, verifier);
+}
+
+/*
+ * Saves the number of items a reader read to file, along with the results of any operators it ran, and
+ * closes its output sink. A filtering reader reports how many items did not pass, and a verifying reader
+ * whether what it read matches what was published.
+ */
+static void finishReader(RWConfig *rwConfig, ReadCursor *cursor, int reads)
+{
+    Aggregate *aggregate = cursor->aggregate;
+    char report[AGGREGATE_REPORT_SIZE];
+    char *type = rwConfig->relayFds != NULL ? "relay" : "reader";
+    int number = rwConfig->relayFds != NULL ? cursor->id : rwConfig->pConfig->sinkBase + cursor->id;
+
     /*
-     * Save the write count to file.
-     *
      * Per discussion with Soh: use thread ID (pthread_self()) instead of process ID for multithreading
-     * solution.
+     * solution. A reader task is reported by its executor's thread.
      */
-    simWriteFinish(rwConfig->fPtrSimOut, "reader", "reading", "from", pthread_self(), reads);
+    simWriteFinish(rwConfig->fPtrSimOut, type, "reading", "from", pthread_self(), reads);
+
+    if (cursor->filter != NULL)
+    {
+        printf("Reader %d filtered out %d of %d items, skipping %d of them unread.\n",
+            rwConfig->pConfig->sinkBase + cursor->id, cursor->filtered, reads, cursor->skipped);
+    }
+    if (aggregate != NULL)
+    {
+        flushAggregate(aggregate);
+        formatAggregate(aggregate, report, sizeof(report));
+        printf("Reader %d aggregated %lld values: %s\n", rwConfig->pConfig->sinkBase + cursor->id, aggregate->items,
+            report);
+        simWriteAggregate(rwConfig->fPtrSimOut, "reader", rwConfig->pConfig->sinkBase + cursor->id, aggregate);
+    }
+    if (cursor->verifier != NULL)
+    {
+        reportVerification(rwConfig, cursor, rwConfig->relayFds != NULL ? "Relay" : "Reader", type, number);
+    }
+
+    closeOutputSink(cursor->sink);
+}
+
+/*
+ * Reads all items from a buffer as reader id, forwarding them to this reader's output sink.
+ *
+ * Returns the number of items read.
+ */
+int runReader(RWConfig *rwConfig, int id)
+{
+    int reads;
+    ReadCursor cursor;
+    OutputSink sink;
+    Aggregate aggregate;
+    StreamVerifier verifier;
+
+    openReader(rwConfig, id, &cursor, &sink, &aggregate, &verifier);
+    reads = readStream(rwConfig, &cursor);
+    finishReader(rwConfig, &cursor, reads);
+
+    return reads;
+}
+
+/*
+ * Reports how many items a subscriber read from the channel read by one of its tasks, and whether they
+ * match what was published. Once the subscriber's last task finishes, saves the number of items it read
+ * from every channel to file, and closes its output sink.
+ */
+static void finishSubscription(RWConfig *rwConfig, ReaderTask *readerTask, int reads)
+{
+    Subscriber *subscriber = readerTask->subscriber;
+    ReadCursor *cursor = &readerTask->cursor;
+
+    printf("Subscriber %d read %d items from channel %s.\n", subscriber->id, reads, cursor->tag);
+    if (cursor->verifier != NULL)
+    {
+        reportVerification(rwConfig, cursor, "Subscriber", "subscriber", subscriber->id);
+    }
+
+    /* Every task runs on the subscriber's executor, so none of them finishes at the same time as another. */
+    subscriber->reads += reads;
+    if (!--subscriber->open)
+    {
+        simWriteFinish(rwConfig->fPtrSimOut, "subscriber", "reading", "from", pthread_self(), subscriber->reads);
+        closeOutputSink(&subscriber->sink);
+    }
+}
+
+/*
+ * Reader task step.
+ *
+ * Reads up to TASK_STEP_ITEMS items, then yields to the executor's other tasks. Suspends the task while
+ * the buffer doesn't have the next item, rather than wait.
+ */
+static int stepReaderTask(Task *task)
+{
+    ReaderTask *readerTask = (ReaderTask *)task->context;
+    ReadCursor *cursor = &readerTask->cursor;
+    int status = READ_MORE, i;
+
+    /* Being resumed is a wakeup, as for a thread. */
+    if (readerTask->suspended)
+    {
+        STATS_STORE(cursor->stats->wakeups, cursor->stats->wakeups + 1);
+        readerTask->suspended = false;
+    }
+
+    for (i = 0; i < TASK_STEP_ITEMS && status == READ_MORE; i++)
+    {
+        status = readNextItem(readerTask->rwConfig, cursor, task);
+    }
+
+    if (status == READ_PENDING)
+    {
+        readerTask->suspended = true;
+        return TASK_PENDING;
+    }
+    if (status == READ_MORE)
+    {
+        return TASK_YIELD;
+    }
+
+    SDS_PROBE(reader_exit, cursor->reads - cursor->lost, cursor->idx, cursor->id);
+    if (readerTask->subscriber != NULL)
+    {
+        finishSubscription(readerTask->rwConfig, readerTask, cursor->reads - cursor->lost);
+    }
+    else
+    {
+        finishReader(readerTask->rwConfig, cursor, cursor->reads - cursor->lost);
+    }
+
+    return TASK_DONE;
+}
+
+/*
+ * Readies reader id to run as a task of executor, rather than on a thread of its own, and gives it to the
+ * executor.
+ */
+void addReaderTask(RWConfig *rwConfig, int id, ReaderTask *readerTask, Executor *executor)
+{
+    readerTask->rwConfig = rwConfig;
+    readerTask->suspended = false;
+    readerTask->subscriber = NULL;
+    openReader(rwConfig, id, &readerTask->cursor, &readerTask->sink, &readerTask->aggregate,
+        &readerTask->verifier);
+    addTask(executor, &readerTask->task, &stepReaderTask, readerTask);
+}
+
+/*
+ * Readies a subscriber to read channelCount channels, forwarding the items of all of them to its output
+ * sink, numbered id. Its tasks are added by addSubscriberTask(), and its executor is then started on
+ * runExecutor().
+ */
+void openSubscriber(Subscriber *subscriber, int id, char *sinkName, int channelCount)
+{
+    subscriber->id = id;
+    subscriber->tasks = (ReaderTask *)malloc(channelCount * sizeof(ReaderTask));
+    subscriber->taskCount = 0;
+    subscriber->open = 0;
+    subscriber->reads = 0;
+    initializeExecutor(&subscriber->executor);
+
+    if (openOutputSink(&subscriber->sink, sinkName, id))
+    {
+        printf("Error: Could not open output sink for subscriber %d.\n", id);
+    }
+}
+
+/*
+ * Adds a task to a subscriber to read a channel's buffer as its reader id, one of the readers counted
+ * after the buffer's own. Each item is forwarded to the subscriber's sink tagged with the channel's name.
+ * Subscribers neither aggregate nor filter, but check what they read with --verify.
+ */
+void addSubscriberTask(Subscriber *subscriber, RWConfig *rwConfig, int id)
+{
+    ReaderTask *readerTask = &subscriber->tasks[subscriber->taskCount++];
+    ReadCursor *cursor = &readerTask->cursor;
+
+    readerTask->rwConfig = rwConfig;
+    readerTask->suspended = false;
+    readerTask->subscriber = subscriber;
+    openReadCursor(cursor, id, &rwConfig->readerStates[id], &subscriber->sink, NULL, &rwConfig->latencies[id],
+        readerStats(rwConfig->stats, id));
+    cursor->tag = rwConfig->pConfig->channelName;
+    if (rwConfig->checksums != NULL)
+    {
+        openVerifier(&readerTask->verifier, selectChecksumKernel(), 0);
+        cursor->verifier = &readerTask->verifier;
+    }
+
+    subscriber->open++;
+    addTask(&subscriber->executor, &readerTask->task, &stepReaderTask, readerTask);
+}
+
+/*
+ * Frees a subscriber once its executor has finished every task.
+ */
+void closeSubscriber(Subscriber *subscriber)
+{
+    /* A subscriber given no channels to read has no task to close its sink. */
+    closeOutputSink(&subscriber->sink);
+    destroyExecutor(&subscriber->executor);
+    free(subscriber->tasks);
+}
+
+/*
+ * Reader thread callback.
+ *
+ * Takes the next reader identifier, then reads all items from a buffer.
+ */
+void *reader(void *vpConfig)
+{
+    RWConfig *rwConfig = (RWConfig *)vpConfig;
+    int id;
+
+    pthread_mutex_lock(&rwConfig->rcMutex);
+    id = rwConfig->nextReaderId++;
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+
+    return ret(runReader(rwConfig, id));
+}
+
+/*
+ * Journal reader thread callback.
+ *
+ * Reads all items from a buffer like any other reader, recording each with its sequence number, writer
+ * and publish time in the journal named on the command line.
+ */
+void *journalReader(void *vpConfig)
+{
+    RWConfig *rwConfig = (RWConfig *)vpConfig;
+    int reads;
+    ReadCursor cursor;
+    OutputSink sink;
+    Journal journal;
+
+    /* The journal reader is not one of the readers in the statistics region. Its counters are private. */
+    WorkerStats stats = { 0 };
+
+    /* The journal reader has no output sink. It must still read every item, even if the journal could
+     * not be created, because writers wait for it. */
+    openOutputSink(&sink, NULL, 0);
+    if (openJournal(&journal, rwConfig->pConfig->journalName))
+    {
+        printf("Error: Could not create journal %s.\n", rwConfig->pConfig->journalName);
+    }
+
+    openReadCursor(&cursor, JOURNAL_READER_ID, &rwConfig->readerStates[rwConfig->pConfig->readerCount], &sink,
+        &journal, NULL, &stats);
+    reads = readStream(rwConfig, &cursor);
+
+    simWriteFinish(rwConfig->fPtrSimOut, "journal", "recording", "from", pthread_self(), reads);
+
+    closeJournal(&journal);
 
-    free(cache);
     return ret(reads);
 }
+
+/*
+ * Waits while the autoscaler has parked the member ranked rank within its group, until it is unparked or
+ * the stream ends. A parked member holds no claim, so the group's other members claim its items in order
+ * without it.
+ */
+static void parkMember(RWConfig *rwConfig, GroupState *group, int rank)
+{
+    pthread_mutex_lock(&rwConfig->parkMutex);
+    while (rank >= group->activeMembers && !rwConfig->eof)
+    {
+        pthread_cond_wait(&rwConfig->parkCond, &rwConfig->parkMutex);
+    }
+    pthread_mutex_unlock(&rwConfig->parkMutex);
+}
+
+/*
+ * Consumes items on behalf of a consumer group, or waits if the group has claimed every item published.
+ * Each item the member claims is forwarded to the sink; the group's other members never see it. Progress
+ * and waits are published to stats, and traced as reader id.
+ *
+ * The member's claim is kept in state while it reads the item, so that the item is not released from the
+ * spill file under it. In overwrite mode, a group that was lapped skips to the newest item. The member is
+ * ranked rank among its group's members, and waits between items while the autoscaler has parked it.
+ *
+ * Returns the number of items consumed by this member.
+ */
+static int consumeGroup(RWConfig *rwConfig, int id, int rank, GroupState *group, ReaderState *state,
+    OutputSink *sink, WorkerStats *stats)
+{
+    int consumed = 0, claimed, idx, value, itemFields = rwConfig->pConfig->itemFields;
+    int fields[MAX_ITEM_FIELDS];
+    long long waitStart;
+    bool done = false, spilled, overwritten;
+    SpillRecord record;
+
+    while (!done)
+    {
+        parkMember(rwConfig, group, rank);
+
+        /*
+         * Wait until the item the group is up to has been published, or moved to the spill file, then
+         * claim it. Every waiting member is woken for the same item; the first to take the mutex claims
+         * it, and the rest wait for the next.
+         *
+         * Stop once the writers have reported end-of-stream and the group has claimed every item.
+         */
+        waitStart = 0;
+        pthread_mutex_lock(&rwConfig->rpMutex);
+        idx = ringSlot(&rwConfig->ring, group->cursor);
+        while (!(spilled = spillHolds(&rwConfig->spill, group->cursor)) &&
+            rwConfig->sequence[idx] != group->cursor && !(rwConfig->eof && group->cursor >= rwConfig->writes))
+        {
+            if (rwConfig->pConfig->overwrite && rwConfig->sequence[idx] > group->cursor)
+            {
+                if (rwConfig->pConfig->trace)
+                {
+                    printf("Member %d was lapped by the writers and skipped items #%d to #%d.\n", id,
+                        group->cursor, rwConfig->writes - 2);
+                }
+                group->lost += rwConfig->writes - 1 - group->cursor;
+                group->cursor = rwConfig->writes - 1;
+                idx = ringSlot(&rwConfig->ring, group->cursor);
+                continue;
+            }
+
+            /* Write out anything buffered for the sink before going to sleep, as readers do. */
+            if (sinkHasPending(sink))
+            {
+                pthread_mutex_unlock(&rwConfig->rpMutex);
+                flushOutputSink(sink);
+                pthread_mutex_lock(&rwConfig->rpMutex);
+                idx = ringSlot(&rwConfig->ring, group->cursor);
+                continue;
+            }
+
+            if (!waitStart)
+            {
+                waitStart = readClockNs();
+                STATS_STORE(stats->waits, stats->waits + 1);
+                SDS_PROBE(reader_wait_begin, group->cursor, idx, id);
+            }
+            pthread_cond_wait(&rwConfig->emptyCond, &rwConfig->rpMutex);
+            STATS_STORE(stats->wakeups, stats->wakeups + 1);
+            idx = ringSlot(&rwConfig->ring, group->cursor);
+        }
+        claimed = group->cursor;
+        done = !spilled && rwConfig->sequence[idx] != claimed;
+        if (!done)
+        {
+            group->cursor++;
+            state->cursor = claimed;
+            state->detached = false;
+        }
+
+        /* A spilled item is copied out while we hold the mutex, as readers do. */
+        if (spilled)
+        {
+            record = *readSpillRecord(&rwConfig->spill, claimed);
+            state->detached = true;
+            group->consumed++;
+            if ((claimed + 1 - rwConfig->spill.base) % SPILL_SEGMENT_RECORDS == 0 ||
+                claimed + 1 == rwConfig->spill.end)
+            {
+                reclaimSpill(&rwConfig->spill, oldestUnread(rwConfig));
+            }
+        }
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+
+        if (waitStart)
+        {
+            STATS_STORE(stats->waitNs, stats->waitNs + readClockNs() - waitStart);
+            SDS_PROBE(reader_wait_end, claimed, idx, id);
+        }
+
+        if (done)
+        {
+            break;
+        }
+
+        if (!spilled)
+        {
+            /* In overwrite mode the item is copied out without holding off the writers, which mark a slot
+             * before overwriting it; the claim is checked below as it is given up, as readers do. */
+            if (!rwConfig->pConfig->overwrite)
+            {
+                startReading(rwConfig);
+            }
+            /* The group's claim is given up before the item is forwarded, so a larger item is copied out. */
+            value = rwConfig->data[idx * rwConfig->stride];
+            if (itemFields > 1)
+            {
+                memcpy(fields, &rwConfig->data[idx * rwConfig->stride], itemFields * sizeof(int));
+            }
+
+            /* Give up the group's claim on the slot. A writer may have overwritten the item, or moved it to
+             * the spill file, after we claimed it and before we started reading; then the slot holds no
+             * claim, and the item is lost or read from the spill file instead. */
+            overwritten = false;
+            pthread_mutex_lock(&rwConfig->rpMutex);
+            if (rwConfig->sequence[idx] == claimed)
+            {
+                rwConfig->pendingReads[idx]--;
+                group->consumed++;
+            }
+            else if (spillHolds(&rwConfig->spill, claimed))
+            {
+                value = readSpillRecord(&rwConfig->spill, claimed)->value;
+                spilled = true;
+                group->consumed++;
+            }
+            else
+            {
+                group->lost++;
+                overwritten = true;
+            }
+            state->detached = true;
+            pthread_mutex_unlock(&rwConfig->rpMutex);
+
+            if (!rwConfig->pConfig->overwrite)
+            {
+                stopReading(rwConfig);
+            }
+            pthread_cond_signal(&rwConfig->fullCond);
+            resumeWaitingWriters(rwConfig);
+
+            if (overwritten)
+            {
+                if (rwConfig->pConfig->trace)
+                {
+                    printf("Member %d lost item #%d, which the writers overwrote.\n", id, claimed);
+                }
+                continue;
+            }
+        }
+        else
+        {
+            value = record.value;
+        }
+
+        if (rwConfig->pConfig->trace && spilled)
+        {
+            printf("Member %d consumed value #%d (%d) from the spill file.\n", id, claimed, value);
+        }
+        else if (rwConfig->pConfig->trace)
+        {
+            printf("Member %d consumed value #%d (%d) from data buffer index %d.\n", id, claimed, value, idx);
+        }
+        if (itemFields == 1)
+        {
+            writeSinkItem(sink, value);
+        }
+        else
+        {
+            writeSinkRecord(sink, fields, itemFields);
+        }
+        SDS_PROBE(consume, claimed, idx, id);
+        consumed++;
+        STATS_STORE(stats->items, consumed);
+        STATS_STORE(stats->cursor, claimed + 1);
+
+        sleep(rwConfig->pConfig->readerSleepTime);
+    }
+
+    SDS_PROBE(reader_exit, consumed, idx, id);
+
+    return consumed;
+}
+
+/*
+ * Consumer group member thread callback.
+ *
+ * Shares the items of the stream with the other members of its group, forwarding each item it consumes
+ * to its own output sink. Members are numbered after the readers.
+ */
+void *groupMember(void *vpConfig)
+{
+    RWConfig *rwConfig = (RWConfig *)vpConfig;
+    ProgramConfig *pConfig = rwConfig->pConfig;
+    int consumed, memberId, id, groupId, rank, i;
+    OutputSink sink;
+
+    /* Members are not among the readers in the statistics region. Their counters are private. */
+    WorkerStats stats = { 0 };
+
+    /* Take the next member identifier, and open this member's output sink. */
+    pthread_mutex_lock(&rwConfig->rcMutex);
+    memberId = rwConfig->nextMemberId++;
+    pthread_mutex_unlock(&rwConfig->rcMutex);
+    id = pConfig->readerCount + memberId;
+    if (openOutputSink(&sink, pConfig->sinkName, pConfig->sinkBase + id))
+    {
+        printf("Error: Could not open output sink for member %d.\n", id);
+    }
+
+    /* Rank the member within its group. The autoscaler parks a group's highest ranked members first. */
+    groupId = memberGroup(pConfig, memberId);
+    rank = memberId;
+    for (i = 0; i < groupId; i++)
+    {
+        rank -= pConfig->groupSizes[i];
+    }
+
+    consumed = consumeGroup(rwConfig, id, rank, &rwConfig->groups[groupId],
+        &rwConfig->readerStates[pConfig->readerCount + 1 + memberId], &sink, &stats);
+
+    simWriteFinish(rwConfig->fPtrSimOut, "member", "consuming", "from", pthread_self(), consumed);
+
+    closeOutputSink(&sink);
+
+    return ret(consumed);
+}
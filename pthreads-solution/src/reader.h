@@ -3,7 +3,125 @@
 
 #include "shared.h"
 
+/* What reading the next item tells a reader: it has read or skipped items, and should read again; its
+ * task has been suspended until a writer publishes; or it has read every item, or been detached. */
+#define READ_MORE (0)
+#define READ_PENDING (1)
+#define READ_DONE (2)
+
+/*
+ * A reader's progress through the stream, and where it forwards what it reads. It is kept between items,
+ * so that a reader hosted by an executor can suspend while it waits for the next item, and pick up where
+ * it left off.
+ */
+typedef struct ReadCursor
+{
+    /* The identifier the reader is traced with, and its position as seen by the writers. */
+    int id;
+    ReaderState *state;
+
+    /* Where each item read is forwarded, recorded and timed. journal and latency may be NULL. */
+    OutputSink *sink;
+    Journal *journal;
+    Histogram *latency;
+    WorkerStats *stats;
+
+    /* The operators run over each value read, or NULL to run none. */
+    Aggregate *aggregate;
+
+    /* The filter an item's value must pass to be forwarded, or NULL to forward every item. The number of
+     * items that did not pass, and how many of those were skipped in whole blocks without being read. */
+    ReaderFilter *filter;
+    int filtered;
+    int skipped;
+
+    /* The reader's check of what it reads against what was published, or NULL to not check. */
+    StreamVerifier *verifier;
+
+    /* The tag written ahead of each item forwarded to the sink, or NULL for none. A subscriber tags each
+     * item with the name of its channel. */
+    char *tag;
+
+    /* The sequence number of the next item to read, and the number of items lost by falling behind. */
+    int reads;
+    int lost;
+
+    /* The slot of the item the reader is up to. */
+    int idx;
+
+    /* When the reader began waiting for the item it is up to, or 0 if it is not waiting. */
+    long long waitStart;
+} ReadCursor;
+
+struct Subscriber;
+
+/*
+ * A reader run as a task by an executor, rather than on a thread of its own.
+ */
+typedef struct ReaderTask
+{
+    Task task;
+    RWConfig *rwConfig;
+    ReadCursor cursor;
+    OutputSink sink;
+    Aggregate aggregate;
+    StreamVerifier verifier;
+
+    /* Whether the task is suspended waiting for an item. */
+    bool suspended;
+
+    /* The subscriber the task reads a channel for, or NULL for a reader of the buffer's own. */
+    struct Subscriber *subscriber;
+} ReaderTask;
+
+/*
+ * A reader of several channels at once, which forwards the items of every one of them to a single sink,
+ * each tagged with the name of its channel.
+ *
+ * It runs a reader task on each channel's buffer, all on an executor of its own, so that it waits on every
+ * channel at once: whichever channel publishes first resumes its task. Ready tasks take turns, a step at a
+ * time, so a busy channel never starves a quiet one.
+ */
+typedef struct Subscriber
+{
+    /* The subscriber's number, from 0 in the order given. */
+    int id;
+
+    Executor executor;
+
+    /* A task for each channel read, and the number of them added, and not yet finished. */
+    ReaderTask *tasks;
+    int taskCount;
+    int open;
+
+    /* The items read from every channel. */
+    int reads;
+
+    OutputSink sink;
+} Subscriber;
+
 /* Reader function. */
 void *reader(void *);
 
+/* Reads a stream as the given reader. */
+int runReader(RWConfig *, int);
+
+/* Readies a reader to read a stream as a task of an executor. */
+void addReaderTask(RWConfig *rwConfig, int id, ReaderTask *readerTask, Executor *executor);
+
+/* Readies a subscriber to read the given number of channels, forwarding them to its sink. */
+void openSubscriber(Subscriber *subscriber, int id, char *sinkName, int channelCount);
+
+/* Adds a task to a subscriber to read a channel's buffer as one of its readers. */
+void addSubscriberTask(Subscriber *subscriber, RWConfig *rwConfig, int id);
+
+/* Frees a subscriber once its executor has finished. */
+void closeSubscriber(Subscriber *subscriber);
+
+/* Reader function that records the stream to a journal. */
+void *journalReader(void *);
+
+/* Reader function that shares the stream with the other members of its consumer group. */
+void *groupMember(void *);
+
 #endif /* ifndef READER_H */
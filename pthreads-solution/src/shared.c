@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "shared.h"
 
 /*
@@ -15,27 +17,66 @@ int *createDefaultValueArray(int size, int dVal)
     return data;
 }
 
+/*
+ * Creates the data array of a buffer of the given number of slots, each stride ints long. Slots of more
+ * than one int start on a cache line of their own.
+ */
+static int *createItemArray(int slots, int stride)
+{
+    int *data;
+
+    if (stride == 1)
+    {
+        return createDefaultValueArray(slots, -1);
+    }
+
+    data = (int *)aligned_alloc(ITEM_ALIGNMENT, slots * stride * sizeof(int));
+    memset(data, 0, slots * stride * sizeof(int));
+
+    return data;
+}
+
+/*
+ * Returns the number of ints from the start of one slot of a buffer to the next, for items of the given
+ * number of fields. An item of a single field takes a single int; a larger one is padded to whole cache
+ * lines.
+ */
+int itemStride(int itemFields)
+{
+    int lineInts = ITEM_ALIGNMENT / sizeof(int);
+
+    return itemFields == 1 ? 1 : (itemFields + lineInts - 1) / lineInts * lineInts;
+}
+
 /*
  * Creates the RW config given the program's configuration.
  * Initializes mutex locks and conditional variables.
- * Opens shared files.
+ * Opens shared files. The sim_out file is opened by the caller, and shared by every channel.
  */
-RWConfig *createRWConfig(ProgramConfig *pConfig)
+RWConfig *createRWConfig(ProgramConfig *pConfig, FILE *fPtrSimOut)
 {
     RWConfig *config = (RWConfig *)malloc(sizeof(RWConfig));
+    int i;
 
     /* Readers & Writers need to know how long to sleep for. Encapsulate the information within the RWConfig. */
     config->pConfig = pConfig;
 
-    /* Create the shared memory buffer. */
-    config->data = createDefaultValueArray(SHM_BUFFER_SIZE, -1);
+    /* Lay out the buffer, then create it. An elastic buffer starts at its smallest. */
+    initializeRing(&config->ring, pConfig->capacity, pConfig->maxCapacity);
+    config->stride = itemStride(pConfig->itemFields);
+    config->data = createItemArray(config->ring.slots, config->stride);
 
     /* Initialize the number of readers reading from the buffer. Note that we don't need a corresponding
      * value for writers, because there can only be one. */
     config->activeReaders = 0;
+    config->nextReaderId = 0;
+    config->nextWriterId = 0;
+    config->nextMemberId = 0;
+    config->consumers = pConfig->readerCount + (pConfig->journalName != NULL) + pConfig->groupCount;
 
     /* Initialize the number of writes. This will be used to determine when all values have been written. */
     config->writes = 0;
+    config->eof = false;
 
     /* Initialize the mutexes we require to ensure synchronisation. */
     pthread_mutex_init(&config->writeMutex, NULL);
@@ -44,37 +85,303 @@ RWConfig *createRWConfig(ProgramConfig *pConfig)
     pthread_mutex_init(&config->rcMutex, NULL);
     pthread_mutex_init(&config->rpMutex, NULL);
     pthread_mutex_init(&config->rwMutex, NULL);
+    pthread_mutex_init(&config->parkMutex, NULL);
+    pthread_cond_init(&config->parkCond, NULL);
 
     /* For threads, share a common file resource - much more effective than creating opening the file per
      * thread. */
-    config->fPtrSimOut = fopen("sim_out", "w");
+    config->fPtrSimOut = fPtrSimOut;
 
-    /* Create a file reader for the shared data. */
-    config->fPtrSharedData = fopen(SHARED_FILE_NAME, "r");
+    /* Open the input stream for the writers. The caller checks source.fd to detect failure. The buffer of
+     * a relay has no input stream of its own; the caller attaches the relay's pipe instead. */
+    if (pConfig->inputName != NULL)
+    {
+        openInputSource(&config->source, pConfig->inputName, pConfig->replaySpeed);
+    }
+    else
+    {
+        attachInputSource(&config->source, -1);
+    }
+    config->relayFds = NULL;
 
     /* We want to ensure the read counts are initialised to 0. This prevents readers from reading before
      * any writers have written data to the buffers. */
-    config->pendingReads = (int *)calloc(SHM_BUFFER_SIZE, sizeof(int));
+    config->pendingReads = (int *)calloc(config->ring.slots, sizeof(int));
+
+    /* No slot holds an item yet. */
+    config->sequence = createDefaultValueArray(config->ring.slots, SEQUENCE_NONE);
+    config->writerIds = createDefaultValueArray(config->ring.slots, -1);
+    config->publishTimes = (long long *)calloc(config->ring.slots, sizeof(long long));
+
+    /* With any filter, summarise enough blocks to cover every item the buffer can hold. */
+    config->summaries = NULL;
+    config->summaryCount = config->ring.slots / FILTER_BLOCK_ITEMS + 2;
+    if (pConfig->filterCount)
+    {
+        config->summaries = (BlockSummary *)malloc(config->summaryCount * sizeof(BlockSummary));
+        clearBlockSummaries(config->summaries, config->summaryCount);
+    }
+
+    /* With --verify, checksum the stream as it is published. */
+    config->checksums = NULL;
+    if (pConfig->verify)
+    {
+        config->checksums = (RangeChecksum *)malloc(CHECKSUM_RANGES * sizeof(RangeChecksum));
+        clearRangeChecksums(config->checksums, &config->published);
+    }
+
+    /* Zeroed histograms are empty. */
+    config->latencies = (Histogram *)calloc(pConfig->readerCount, sizeof(Histogram));
+
+    config->stats = (StatsRegion *)malloc(statsRegionSize(pConfig->readerCount, pConfig->writerCount));
+    initializeStatsRegion(config->stats, pConfig->readerCount, pConfig->writerCount, pConfig->capacity);
+
+    /* Every reader starts attached, at the start of the stream. Members hold no claim until they claim an
+     * item, and every group starts at the start of the stream. */
+    config->readerStates = (ReaderState *)calloc(pConfig->readerCount + 1 + pConfig->memberCount,
+        sizeof(ReaderState));
+    config->readerStates[pConfig->readerCount].detached = pConfig->journalName == NULL;
+    for (i = 0; i < pConfig->memberCount; i++)
+    {
+        config->readerStates[pConfig->readerCount + 1 + i].detached = true;
+    }
+    config->groups = (GroupState *)calloc(pConfig->groupCount, sizeof(GroupState));
+    activateWorkers(config);
+
+    /* Create the spill file, if there is to be one. The caller checks spill.fd to detect failure. */
+    openSpill(&config->spill, pConfig->spillName);
 
     /* Start writers from the start of the buffer. */
     config->idxWrite = 0;
 
+    /* No reader task waits until it finds the buffer without its item, and no writer task until it finds
+     * the buffer full, or is parked. */
+    config->waitingTasks = NULL;
+    config->waitingWriters = NULL;
+    config->writerTurn = NULL;
+    config->parkedWriters = NULL;
+
     return config;
 }
 
+/*
+ * Readies a buffer to carry another stream from the start, with only its first readerCount readers
+ * attached. Nothing is allocated: the buffer, its slot arrays and its readers' positions are reused as
+ * they are. The caller opens the new stream's input source.
+ *
+ * Must be called while no reader or writer is running on the buffer.
+ */
+void resetRWConfig(RWConfig *config, int readerCount)
+{
+    ProgramConfig *pConfig = config->pConfig;
+    int i;
+
+    initializeRing(&config->ring, pConfig->capacity, pConfig->maxCapacity);
+    config->idxWrite = 0;
+    config->writes = 0;
+    config->eof = false;
+    config->consumers = readerCount + (pConfig->journalName != NULL) + pConfig->groupCount;
+
+    for (i = 0; i < config->ring.slots; i++)
+    {
+        config->pendingReads[i] = 0;
+        config->sequence[i] = SEQUENCE_NONE;
+        config->writerIds[i] = -1;
+        config->publishTimes[i] = 0;
+    }
+    if (config->summaries != NULL)
+    {
+        clearBlockSummaries(config->summaries, config->summaryCount);
+    }
+    if (config->checksums != NULL)
+    {
+        clearRangeChecksums(config->checksums, &config->published);
+    }
+
+    memset(config->latencies, 0, pConfig->readerCount * sizeof(Histogram));
+    initializeStatsRegion(config->stats, pConfig->readerCount, pConfig->writerCount, pConfig->capacity);
+
+    for (i = 0; i < pConfig->readerCount; i++)
+    {
+        config->readerStates[i].cursor = 0;
+        config->readerStates[i].detached = i >= readerCount;
+    }
+    memset(config->groups, 0, pConfig->groupCount * sizeof(GroupState));
+    activateWorkers(config);
+}
+
 /*
  * Frees all resources associated with a RWConfig instance.
  */
 void freeRWConfig(RWConfig *config)
 {
+    closeSpill(&config->spill, config->pConfig->spillName);
     free(config->data);
     free(config->pConfig);
     free(config->pendingReads);
-    fclose(config->fPtrSimOut);
-    fclose(config->fPtrSharedData);
+    free(config->sequence);
+    free(config->writerIds);
+    free(config->publishTimes);
+    free(config->summaries);
+    free(config->checksums);
+    free(config->latencies);
+    free(config->stats);
+    free(config->readerStates);
+    free(config->groups);
+    free(config->relayFds);
+    closeInputSource(&config->source);
     free(config);
 }
 
+/*
+ * Returns the sequence number of the oldest item that some attached reader, the journal reader or a
+ * consumer group has not yet read. A group has not read the items it has yet to claim, nor those its
+ * members are still reading.
+ *
+ * Must be called with rwConfig->rpMutex held.
+ */
+int oldestUnread(RWConfig *rwConfig)
+{
+    ProgramConfig *pConfig = rwConfig->pConfig;
+    int i, oldest = rwConfig->writes;
+
+    for (i = 0; i < pConfig->readerCount + 1 + pConfig->memberCount; i++)
+    {
+        if (!rwConfig->readerStates[i].detached && rwConfig->readerStates[i].cursor < oldest)
+        {
+            oldest = rwConfig->readerStates[i].cursor;
+        }
+    }
+    for (i = 0; i < pConfig->groupCount; i++)
+    {
+        if (rwConfig->groups[i].cursor < oldest)
+        {
+            oldest = rwConfig->groups[i].cursor;
+        }
+    }
+
+    return oldest;
+}
+
+/*
+ * Returns the consumer group of the member with the given identifier.
+ */
+int memberGroup(ProgramConfig *pConfig, int memberId)
+{
+    int group = 0;
+
+    while (memberId >= pConfig->groupSizes[group])
+    {
+        memberId -= pConfig->groupSizes[group++];
+    }
+
+    return group;
+}
+
+/*
+ * Merges the latency histograms of every reader and writes the distribution to the sim_out file.
+ */
+void reportLatency(RWConfig *config)
+{
+    int i;
+    Histogram *merged = (Histogram *)malloc(sizeof(Histogram));
+
+    initializeHistogram(merged);
+    for (i = 0; i < config->pConfig->readerCount; i++)
+    {
+        mergeHistogram(merged, &config->latencies[i]);
+    }
+    simWriteLatency(config->fPtrSimOut, merged);
+
+    free(merged);
+}
+
+/*
+ * Lets every writer and consumer group member of a buffer run. The autoscaler parks them again as the
+ * backlog allows.
+ */
+void activateWorkers(RWConfig *rwConfig)
+{
+    ProgramConfig *pConfig = rwConfig->pConfig;
+    int i;
+
+    rwConfig->activeWriters = pConfig->writerCount;
+    for (i = 0; i < pConfig->groupCount; i++)
+    {
+        rwConfig->groups[i].activeMembers = pConfig->groupSizes[i];
+    }
+}
+
+/*
+ * Resumes every reader task suspended waiting for an item, now that a writer has published one or ended
+ * the stream. Each is scheduled on its executor, and checks for its item again once it runs, as a reader
+ * thread does when it is woken.
+ */
+void resumeWaitingTasks(RWConfig *rwConfig)
+{
+    Task *task, *next;
+
+    if (!rwConfig->pConfig->executorCount && !rwConfig->pConfig->subscriberCount)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&rwConfig->rpMutex);
+    task = rwConfig->waitingTasks;
+    rwConfig->waitingTasks = NULL;
+    pthread_mutex_unlock(&rwConfig->rpMutex);
+
+    for (; task != NULL; task = next)
+    {
+        next = task->next;
+        scheduleTask(task);
+    }
+}
+
+/*
+ * Resumes every writer task suspended waiting for a slot, now that a reader has freed one, or waiting for
+ * its turn, now that the writer whose turn it was has published. Each checks again once it runs.
+ */
+void resumeWaitingWriters(RWConfig *rwConfig)
+{
+    Task *task, *next;
+
+    if (!rwConfig->pConfig->executorCount)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&rwConfig->rpMutex);
+    task = rwConfig->waitingWriters;
+    rwConfig->waitingWriters = NULL;
+    pthread_mutex_unlock(&rwConfig->rpMutex);
+
+    for (; task != NULL; task = next)
+    {
+        next = task->next;
+        scheduleTask(task);
+    }
+}
+
+/*
+ * Resumes every parked writer task, as parkCond wakes every parked writer thread, for each to check
+ * whether it is still parked.
+ *
+ * Must be called with rwConfig->parkMutex held.
+ */
+void resumeParkedWriters(RWConfig *rwConfig)
+{
+    Task *task, *next;
+
+    task = rwConfig->parkedWriters;
+    rwConfig->parkedWriters = NULL;
+    for (; task != NULL; task = next)
+    {
+        next = task->next;
+        scheduleTask(task);
+    }
+}
+
 /*
  * Creates a dynamic integer on the heap for a persistent return value.
  */
@@ -95,3 +402,38 @@ void simWriteFinish(FILE *fPtr, char *type, char *action, char *dest, int id, in
         type, id, action, reads, dest);
 }
 
+
+/*
+ * Writes to file the distribution of publish-to-consume latencies seen by the readers.
+ */
+void simWriteLatency(FILE *fPtr, Histogram *latency)
+{
+    fprintf(fPtr, "Publish-to-consume latency over %lld reads (ns): p50=%lld p99=%lld p99.9=%lld max=%lld.\n",
+        latency->total, histogramPercentile(latency, 50), histogramPercentile(latency, 99),
+        histogramPercentile(latency, 99.9), latency->max);
+}
+
+/*
+ * Writes to file the results of the operators a reader ran over the values it read.
+ */
+void simWriteAggregate(FILE *fPtr, char *type, int id, Aggregate *aggregate)
+{
+    char report[AGGREGATE_REPORT_SIZE];
+
+    formatAggregate(aggregate, report, sizeof(report));
+    fprintf(fPtr, "%s-%d aggregated %lld pieces of data with %s kernels: %s.\n", type, id, aggregate->items,
+        aggregate->kernels->name, report);
+}
+
+/*
+ * Writes to file the outcome of a reader's check of the stream it read against the one published.
+ */
+void simWriteVerification(FILE *fPtr, char *type, int id, StreamVerifier *verifier)
+{
+    char report[VERIFICATION_REPORT_SIZE];
+
+    formatVerification(verifier, report, sizeof(report));
+    fprintf(fPtr, "%s-%d %s %d pieces of data with %s CRC32C: %s.\n", type, id,
+        verifierDiverged(verifier) ? "diverged over" : "verified", verifier->stream.items, verifier->kernel->name,
+        report);
+}
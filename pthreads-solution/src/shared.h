@@ -16,6 +16,31 @@
 /* For false etc. */
 #include <stdbool.h>
 
+/* For InputSource. */
+#include "source.h"
+
+/* For OutputSink. */
+#include "sink.h"
+
+/* For Journal. */
+#include "journal.h"
+
+/* For readClockNs(). */
+#include "clock.h"
+
+/* For Histogram. */
+#include "histogram.h"
+
+/* For StatsRegion. */
+#include "stats.h"
+#include "probes.h"
+#include "spill.h"
+#include "ring.h"
+#include "executor.h"
+#include "aggregate.h"
+#include "filter.h"
+#include "integrity.h"
+
 /* Name of the file containing data to be read from the filesystem. */
 #define SHARED_FILE_NAME "shared_data"
 
@@ -34,6 +59,77 @@
 /* The number of elements in the shared_data file. */
 #define NUM_ELEMENTS_DATA_FILE (100)
 
+/* The sequence number of a slot that has never been written to. */
+#define SEQUENCE_NONE (-1)
+
+/* The sequence number of a slot whose item has been moved to the spill file. */
+#define SEQUENCE_SPILLED (-2)
+
+/* The sequence number of a slot a writer is overwriting, in overwrite mode. */
+#define SEQUENCE_WRITING (-3)
+
+/* The identifier the journal reader is traced with. It is not counted among the readers. */
+#define JOURNAL_READER_ID (-1)
+
+/* What happens to a reader that falls further behind than the lag limit: it is detached, so writers stop
+ * waiting for it and it stops reading; or it catches up, skipping every item it has not yet read. */
+#define LAG_POLICY_DETACH (0)
+#define LAG_POLICY_CATCH_UP (1)
+
+/* The most consumer groups a run can have. */
+#define MAX_CONSUMER_GROUPS (8)
+
+/* The most channels a run can host. */
+#define MAX_CHANNELS (32)
+
+/* The most subscribers, each reading several channels at once, a run can have. */
+#define MAX_SUBSCRIBERS (32)
+
+/* The most relays a stream can fan out through. */
+#define MAX_RELAYS (64)
+
+/* The largest item --item-size allows, in bytes, and the most integer fields it holds. */
+#define MAX_ITEM_SIZE (256)
+#define MAX_ITEM_FIELDS (MAX_ITEM_SIZE / 4)
+
+/* The alignment of the slots of a buffer whose items hold more than one field: a cache line, so that
+ * publishing and consuming an item copies whole lines. */
+#define ITEM_ALIGNMENT (64)
+
+/*
+ * A reader's position in the stream, as seen by the writers. Bound to rpMutex.
+ *
+ * A consumer group member uses one to hold the item it has claimed while it reads it: the cursor is that
+ * item, and the member is marked detached whenever it holds no claim.
+ */
+typedef struct ReaderState
+{
+    /* The sequence number of the next item the reader will read. A writer moves this forward when it
+     * makes the reader catch up. */
+    int cursor;
+
+    /* Set by a writer that detached the reader. */
+    bool detached;
+} ReaderState;
+
+/*
+ * The progress of a consumer group. Each item goes to exactly one of the group's members, so the group
+ * as a whole holds a single claim on each slot, like one reader. Bound to rpMutex.
+ */
+typedef struct GroupState
+{
+    /* The sequence number of the next item for a member to claim. */
+    int cursor;
+
+    /* The number of items the group's members have consumed, and the number the group lost because the
+     * writers overwrote them before a member claimed them. */
+    int consumed;
+    int lost;
+
+    /* The number of the group's members that may claim items; the rest are parked. Bound to parkMutex. */
+    int activeMembers;
+} GroupState;
+
 /*
  * Struct to store the command-line configuration for the program.
  */
@@ -51,6 +147,107 @@ typedef struct ProgramConfig
     /* How long each writer should sleep for once it is done writing an element to the buffer. */
     int writerSleepTime;
 
+    /* The input source writers read from: a file name, "-", "fifo:PATH" or "unix:PATH". */
+    char *inputName;
+
+    /* The output sink each reader forwards its stream to: NULL, "file:PATH", "fifo:PATH" or "unix:PATH". */
+    char *sinkName;
+
+    /* The journal file to record the published stream to, or NULL to not record. */
+    char *journalName;
+
+    /* How fast a journal source is replayed relative to the recorded times; 0 replays without pacing. */
+    double replaySpeed;
+
+    /* Whether to print live statistics once a second while the program runs. */
+    bool top;
+
+    /* A reader holding up a writer is lagging if it is at least this many items behind, or if the item
+     * it has not read has been in the buffer for at least this many nanoseconds. 0 disables each limit;
+     * with both disabled, writers wait for every reader. */
+    int maxLagItems;
+    long long maxLagNs;
+
+    /* What happens to a lagging reader: LAG_POLICY_DETACH or LAG_POLICY_CATCH_UP. */
+    int lagPolicy;
+
+    /* Whether writers overwrite the oldest item rather than wait for every reader to read it. Readers
+     * that are lapped skip to the newest item. */
+    bool overwrite;
+
+    /* The file writers move unread items to when the buffer is full, rather than wait, or NULL to wait. */
+    char *spillName;
+
+    /* The number of slots in the buffer, and the smallest an elastic buffer shrinks to. */
+    int capacity;
+
+    /* The most slots an elastic buffer may grow to under a sustained backlog, or 0 for a buffer fixed at
+     * capacity slots. */
+    int maxCapacity;
+
+    /* The number of consumer groups, and the number of members in each. Members are numbered from 0
+     * across every group in turn. */
+    int groupCount;
+    int groupSizes[MAX_CONSUMER_GROUPS];
+    int memberCount;
+
+    /* The channels the run hosts, each given as NAME[:SIZE]=SOURCE, or none to host a single unnamed
+     * channel read from inputName. */
+    int channelCount;
+    char *channelSpecs[MAX_CHANNELS];
+
+    /* The channels each subscriber reads, each given as NAME,NAME..., and the number of subscribers among
+     * this buffer's readers. Subscribers are counted, and numbered, after the buffer's own readers. */
+    int subscriptionCount;
+    char *subscriptionSpecs[MAX_SUBSCRIBERS];
+    int subscriberCount;
+
+    /* The number of relays the stream fans out through, or 0 for readers to read it directly. Each relay
+     * reads the stream like a reader, and publishes it again to a buffer of its own that serves its
+     * share of the readers. */
+    int relayCount;
+
+    /* The number added to the identifiers of this buffer's readers and members to number their sinks. The
+     * buffer of a relay serves readers after the first; a stream that fans out numbers its members after
+     * the readers of every relay. */
+    int sinkBase;
+
+    /* The name of the channel this configuration is for, or NULL for the unnamed channel. */
+    char *channelName;
+
+    /* The control socket a daemon accepts jobs on, or NULL to run a single stream and exit. */
+    char *daemonName;
+
+    /* Whether to park and unpark writers and consumer group members as the backlog changes, and the
+     * fewest writers, and members of each group, to keep running. */
+    bool autoscale;
+    int minWriters;
+    int minMembers;
+
+    /* The number of integer fields in each item, 1 unless set by --item-size. The first is the item's
+     * value, which traces show; the source gives each item's fields in turn. */
+    int itemFields;
+
+    /* The number of executor threads that run the readers as tasks, or 0 to run each reader on a thread
+     * of its own. */
+    int executorCount;
+
+    /* The operators every reader runs over the values it reads, as given by --aggregate; a pipeline of
+     * none unless set. */
+    AggregatePipeline aggregate;
+
+    /* The filters readers subscribe with, as given by --filter. A reader without one reads every item. */
+    int filterCount;
+    ReaderFilter filters[MAX_FILTERS];
+
+    /* Whether writers checksum the stream they publish, and readers the stream they read, to check that
+     * each reader read exactly what was published. */
+    bool verify;
+
+    /* Whether readers, writers and consumer group members print a line for each item they handle. Off
+     * with --no-trace, and with --verify, whose runs are meant to be long. */
+    bool trace;
+
 } ProgramConfig;
 
 /*
@@ -64,9 +261,17 @@ typedef struct RWConfig
 {
     /* The shared memory. Since the threading component of the solution does not need shared memory,
      * (because memory is shared betweeh threads), this is just an array shared between threads.
-     * The size of this array will be SHM_BUFFER_SIZE. */
+     * The size of this array will be ring.slots slots of stride ints each. */
     int *data;
 
+    /* The number of ints from the start of one slot of data to the next: one for an item of a single
+     * field, and whole cache lines for a larger one. */
+    int stride;
+
+    /* Which slots hold which items. Writers begin a new generation of an elastic buffer as the backlog
+     * grows or shrinks. */
+    Ring ring;
+
     /* The index we are currently writing to. Writers use this to cooperate in writing to the data buffer. */
     int idxWrite;
 
@@ -76,9 +281,31 @@ typedef struct RWConfig
     /* Store the number of readers so that we know when to enable writers to write. */
     int activeReaders;
 
+    /* The identifier the next reader to start will take. Readers use their identifier to name their
+     * output sink. Bound to rcMutex. */
+    int nextReaderId;
+
+    /* The identifier the next writer to start will take. Bound to writeMutex. */
+    int nextWriterId;
+
+    /* The identifier the next consumer group member to start will take. Bound to rcMutex. */
+    int nextMemberId;
+
+    /* The number of readers that must read each slot before it can be overwritten: every reader, plus
+     * the journal reader when recording, plus one for each consumer group. */
+    int consumers;
+
+    /* The number of writers that may publish; writers with higher identifiers are parked. Bound to
+     * parkMutex. */
+    int activeWriters;
+
     /* Per specification: the number of writes performed. */
     int writes;
 
+    /* Set by the writer that finds the input source exhausted. Once set, writes is the total number of
+     * items in the stream, and readers stop after reading that many. */
+    bool eof;
+
     /* Mutex for modifying the activeReaders variable. */
     pthread_mutex_t rcMutex;
 
@@ -104,21 +331,98 @@ typedef struct RWConfig
 
     pthread_mutex_t rwMutex;
 
+    /* Mutex and conditional variable parked writers and members wait on, until the autoscaler unparks
+     * them or the stream ends. */
+    pthread_mutex_t parkMutex;
+    pthread_cond_t parkCond;
+
     /* The number of pending reads for each particular shared memory slot. This should point to
      * an array of size S, where S is the number of shared memory slots. */
     int *pendingReads;
 
+    /* The sequence number of the item held in each shared memory slot, or SEQUENCE_NONE. Readers use this
+     * to tell a newly written slot from the one they read on the previous pass. This should point to an
+     * array of size S, where S is the number of shared memory slots. */
+    int *sequence;
+
+    /* The identifier of the writer that published the item held in each shared memory slot, and the time
+     * it was published, from readClockNs(). Both arrays are of size S. */
+    int *writerIds;
+    long long *publishTimes;
+
+    /* With any filter, summaries of the summaryCount most recent blocks of items published, which
+     * filtering readers skip blocks by; otherwise NULL. Bound to rpMutex. */
+    BlockSummary *summaries;
+    int summaryCount;
+
+    /* With --verify, the checksums of the CHECKSUM_RANGES most recent ranges of items published, and of
+     * the whole stream, which readers check theirs against; otherwise NULL. Bound to rpMutex. */
+    RangeChecksum *checksums;
+    StreamChecksum published;
+
+    /* The publish-to-consume latency of every item each reader has read, in nanoseconds. This should
+     * point to an array of size R, where R is the number of readers, indexed by reader identifier. Each
+     * reader only records into its own histogram, so no locking is needed. */
+    Histogram *latencies;
+
+    /* Live counters for every reader and writer. Each worker only updates its own counters. */
+    StatsRegion *stats;
+
+    /* The position of every reader, indexed by reader identifier, followed by that of the journal reader,
+     * then the claim of every consumer group member, indexed by member identifier. Writers use this to
+     * find and release readers that have fallen behind, though never the journal reader or a member.
+     * When not recording, the journal reader's entry is marked detached. */
+    ReaderState *readerStates;
+
+    /* The progress of every consumer group. */
+    GroupState *groups;
+
+    /* With fan-out, the write end of the pipe each relay forwards the stream down, by relay identifier.
+     * NULL if the readers of this buffer are not relays. */
+    int *relayFds;
+
+    /* Items moved out of the buffer before every reader had read them. */
+    Spill spill;
+
+    /* The reader tasks suspended until a writer publishes the item each is up to, or ends the stream.
+     * Bound to rpMutex. */
+    Task *waitingTasks;
+
+    /* The writer tasks suspended until a reader frees a slot, or until the writer whose turn it is
+     * publishes. Bound to rpMutex. */
+    Task *waitingWriters;
+
+    /* The writer task that read the next item from the source and suspended, holding it, until its slot
+     * is free, or NULL. The other writers wait their turn until it has published the item, so that the
+     * stream keeps its order. Bound to writeMutex. */
+    Task *writerTurn;
+
+    /* The writer tasks suspended while the autoscaler has them parked. Bound to parkMutex. */
+    Task *parkedWriters;
+
     /* sim_out file reference. */
     FILE *fPtrSimOut;
 
-    /* shared_data file reference. */
-    FILE *fPtrSharedData;
+    /* The input stream that writers read from. */
+    InputSource source;
 } RWConfig;
 
-RWConfig *createRWConfig(ProgramConfig *);
+RWConfig *createRWConfig(ProgramConfig *, FILE *);
+void resetRWConfig(RWConfig *config, int readerCount);
 void freeRWConfig(RWConfig *);
 int *ret(int);
 int *createDefaultValueArray(int, int);
+int itemStride(int itemFields);
+int oldestUnread(RWConfig *rwConfig);
+int memberGroup(ProgramConfig *pConfig, int memberId);
+void activateWorkers(RWConfig *rwConfig);
+void resumeWaitingTasks(RWConfig *rwConfig);
+void resumeWaitingWriters(RWConfig *rwConfig);
+void resumeParkedWriters(RWConfig *rwConfig);
 void simWriteFinish(FILE *fPtr, char *type, char *action, char *dest, int id, int val);
+void simWriteLatency(FILE *fPtr, Histogram *latency);
+void simWriteAggregate(FILE *fPtr, char *type, int id, Aggregate *aggregate);
+void simWriteVerification(FILE *fPtr, char *type, int id, StreamVerifier *verifier);
+void reportLatency(RWConfig *config);
 
 #endif /* ifndef SHARED_H */
@@ -0,0 +1,264 @@
+#include "source.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "clock.h"
+
+/*
+ * Listens on a Unix-domain socket at path and waits for a single producer to connect.
+ *
+ * Returns the connected socket, or -1 if the socket could not be created.
+ */
+static int acceptUnixSocket(char *path)
+{
+    int listener, fd = -1;
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener >= 0)
+    {
+        /* Remove any socket left behind by a previous run. */
+        unlink(path);
+        if (!bind(listener, (struct sockaddr *)&addr, sizeof(addr)) && !listen(listener, 1))
+        {
+            fd = accept(listener, NULL, NULL);
+        }
+        close(listener);
+        unlink(path);
+    }
+
+    return fd;
+}
+
+/*
+ * Opens a named pipe for reading, creating it first if it does not exist.
+ *
+ * Opening blocks until a producer opens the other end.
+ */
+static int openFifo(char *path)
+{
+    if (mkfifo(path, 0666) && errno != EEXIST)
+    {
+        return -1;
+    }
+
+    return open(path, O_RDONLY);
+}
+
+/*
+ * Opens the input source described by name:
+ *   "-"             standard input,
+ *   "fifo:PATH"     a named pipe,
+ *   "unix:PATH"     a Unix-domain socket,
+ *   "journal:PATH"  a journal, replayed at replaySpeed times the recorded rate,
+ *   otherwise       a regular file.
+ *
+ * Returns 0 on success, or -1 if the source could not be opened.
+ */
+int openInputSource(InputSource *source, char *name, double replaySpeed)
+{
+    source->start = 0;
+    source->end = 0;
+    source->eof = false;
+    source->journal = NULL;
+    source->nextRecord = 0;
+    source->replaySpeed = replaySpeed;
+
+    if (!strncmp(name, SOURCE_JOURNAL_PREFIX, strlen(SOURCE_JOURNAL_PREFIX)))
+    {
+        source->journal = mapJournal(name + strlen(SOURCE_JOURNAL_PREFIX), &source->journalRecords,
+            &source->journalBytes);
+        /* The journal is read through its mapping; the descriptor is only used to report success. */
+        source->fd = source->journal == NULL ? -1 : STDIN_FILENO;
+    }
+    else if (!strcmp(name, SOURCE_STDIN_NAME))
+    {
+        source->fd = STDIN_FILENO;
+    }
+    else if (!strncmp(name, SOURCE_FIFO_PREFIX, strlen(SOURCE_FIFO_PREFIX)))
+    {
+        source->fd = openFifo(name + strlen(SOURCE_FIFO_PREFIX));
+    }
+    else if (!strncmp(name, SOURCE_UNIX_PREFIX, strlen(SOURCE_UNIX_PREFIX)))
+    {
+        source->fd = acceptUnixSocket(name + strlen(SOURCE_UNIX_PREFIX));
+    }
+    else
+    {
+        source->fd = open(name, O_RDONLY);
+    }
+
+    return source->fd < 0 ? -1 : 0;
+}
+
+/*
+ * Reads from a file descriptor that is already open, such as the read end of a pipe. The source takes
+ * over the descriptor, and closes it when it is closed.
+ */
+void attachInputSource(InputSource *source, int fd)
+{
+    source->fd = fd;
+    source->start = 0;
+    source->end = 0;
+    source->eof = false;
+    source->journal = NULL;
+    source->nextRecord = 0;
+    source->replaySpeed = 0;
+}
+
+/*
+ * Refills the buffer from the file descriptor. Any partially parsed item is moved to the start of the
+ * buffer so that it can be completed by the newly read bytes.
+ */
+static void fillSourceBuffer(InputSource *source)
+{
+    ssize_t count;
+
+    memmove(source->buffer, source->buffer + source->start, source->end - source->start);
+    source->end -= source->start;
+    source->start = 0;
+
+    /* An item as large as the whole buffer cannot be a valid integer. Discard it. */
+    if (source->end == SOURCE_BUFFER_SIZE)
+    {
+        source->end = 0;
+    }
+
+    do
+    {
+        count = read(source->fd, source->buffer + source->end, SOURCE_BUFFER_SIZE - source->end);
+    } while (count < 0 && errno == EINTR);
+
+    /* Treat read errors as end-of-stream; there is nothing more the writers can publish. */
+    if (count <= 0)
+    {
+        source->eof = true;
+    }
+    else
+    {
+        source->end += count;
+    }
+}
+
+/*
+ * Reads the next record from a journal into value, first sleeping until it is due: its offset from the
+ * first record's publish time, divided by the replay speed, after the replay started.
+ */
+static bool readNextJournalItem(InputSource *source, int *value)
+{
+    JournalRecord *records = (JournalRecord *)(source->journal + 1);
+    long long due, now;
+    struct timespec delay;
+
+    if (source->nextRecord >= source->journalRecords)
+    {
+        source->eof = true;
+        return false;
+    }
+
+    if (!source->nextRecord)
+    {
+        source->replayStart = readClockNs();
+    }
+    else if (source->replaySpeed > 0)
+    {
+        due = source->replayStart + (long long)((records[source->nextRecord].publishTime -
+            records[0].publishTime) / source->replaySpeed);
+        now = readClockNs();
+        if (due > now)
+        {
+            delay.tv_sec = (due - now) / 1000000000LL;
+            delay.tv_nsec = (due - now) % 1000000000LL;
+            nanosleep(&delay, NULL);
+        }
+    }
+
+    *value = records[source->nextRecord++].value;
+    return true;
+}
+
+/*
+ * Reads the next integer from the source into value.
+ *
+ * Tokens that are not integers are skipped.
+ *
+ * Returns true if a value was read, or false once the source is exhausted.
+ */
+bool readNextSourceItem(InputSource *source, int *value)
+{
+    int tokenEnd;
+    char *parseEnd;
+    long parsed;
+
+    if (source->journal != NULL)
+    {
+        return readNextJournalItem(source, value);
+    }
+
+    while (true)
+    {
+        while (source->start < source->end && isspace((unsigned char)source->buffer[source->start]))
+        {
+            source->start++;
+        }
+
+        tokenEnd = source->start;
+        while (tokenEnd < source->end && !isspace((unsigned char)source->buffer[tokenEnd]))
+        {
+            tokenEnd++;
+        }
+
+        /* A token is complete if it is followed by whitespace, or if nothing more will follow it. */
+        if (tokenEnd > source->start && (tokenEnd < source->end || source->eof))
+        {
+            /* The byte after the token is whitespace, or unused if the source is exhausted (the buffer is
+             * never full at end-of-stream), so it can be overwritten to terminate the token. */
+            source->buffer[tokenEnd] = '\0';
+            parsed = strtol(source->buffer + source->start, &parseEnd, 10);
+            source->start = tokenEnd + (tokenEnd < source->end);
+
+            if (*parseEnd == '\0')
+            {
+                *value = (int)parsed;
+                return true;
+            }
+        }
+        else if (source->eof)
+        {
+            return false;
+        }
+        else
+        {
+            fillSourceBuffer(source);
+        }
+    }
+}
+
+/*
+ * Closes the input source.
+ */
+void closeInputSource(InputSource *source)
+{
+    if (source->journal != NULL)
+    {
+        munmap(source->journal, source->journalBytes);
+    }
+    else if (source->fd > STDIN_FILENO)
+    {
+        close(source->fd);
+    }
+}
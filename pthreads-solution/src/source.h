@@ -0,0 +1,74 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+/* For bool etc. */
+#include <stdbool.h>
+
+/* For JournalHeader etc. */
+#include "journal.h"
+
+/* Source name selecting standard input instead of a file. */
+#define SOURCE_STDIN_NAME "-"
+
+/* Prefix selecting a named pipe, e.g. fifo:/tmp/sds.in. The pipe is created if it does not exist. */
+#define SOURCE_FIFO_PREFIX "fifo:"
+
+/* Prefix selecting a local Unix-domain socket, e.g. unix:/tmp/sds.sock. The first producer to connect
+ * is accepted as the input stream. */
+#define SOURCE_UNIX_PREFIX "unix:"
+
+/* Prefix selecting a journal recorded with --record, e.g. journal:/tmp/run.sdsj. The recorded values are
+ * published again, paced by their recorded publish times. */
+#define SOURCE_JOURNAL_PREFIX "journal:"
+
+/* The number of bytes pulled from the input source by a single read(). */
+#define SOURCE_BUFFER_SIZE (65536)
+
+/*
+ * A stream of whitespace-separated integers read from a file descriptor.
+ *
+ * Input is pulled in large blocks into the buffer and parsed in place, so writers do not perform a
+ * system call per item. Writers hold writeMutex while reading from the source, so the source itself
+ * needs no locking.
+ */
+typedef struct InputSource
+{
+    /* The file descriptor being read from. */
+    int fd;
+
+    /* The position of the first unparsed byte in the buffer. */
+    int start;
+
+    /* The position one past the last byte read into the buffer. */
+    int end;
+
+    /* Set once the file descriptor has reported end-of-stream. */
+    bool eof;
+
+    /* Bytes read from the file descriptor but not yet parsed. */
+    char buffer[SOURCE_BUFFER_SIZE];
+
+    /* The mapped journal being replayed, or NULL if the source is not a journal. */
+    JournalHeader *journal;
+
+    /* The size of the journal mapping in bytes. */
+    long long journalBytes;
+
+    /* The number of records in the journal, and the index of the next one to replay. */
+    long long journalRecords;
+    long long nextRecord;
+
+    /* How fast to replay relative to the recorded times: 1 replays at the recorded rate, 2 twice as fast.
+     * 0 replays as fast as the writers can publish. */
+    double replaySpeed;
+
+    /* The time the first record was replayed, from readClockNs(). */
+    long long replayStart;
+} InputSource;
+
+int openInputSource(InputSource *source, char *name, double replaySpeed);
+void attachInputSource(InputSource *source, int fd);
+bool readNextSourceItem(InputSource *source, int *value);
+void closeInputSource(InputSource *source);
+
+#endif /* ifndef SOURCE_H */
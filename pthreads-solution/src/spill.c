@@ -0,0 +1,151 @@
+/* For fallocate(). */
+#define _GNU_SOURCE
+
+#include "spill.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+ * Creates an empty spill file at path, replacing any existing file, and maps it.
+ *
+ * With a NULL path, spilling is disabled and the call succeeds.
+ *
+ * Returns 0 on success, or -1 if the spill file could not be created.
+ */
+int openSpill(Spill *spill, char *path)
+{
+    spill->fd = -1;
+    spill->records = NULL;
+    spill->base = 0;
+    spill->end = 0;
+    spill->reclaimed = 0;
+    spill->capacity = 0;
+
+    if (path == NULL)
+    {
+        return 0;
+    }
+
+    spill->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (spill->fd >= 0)
+    {
+        spill->records = (SpillRecord *)mmap(0, (long long)SPILL_MAX_RECORDS * sizeof(SpillRecord),
+            PROT_READ | PROT_WRITE, MAP_SHARED, spill->fd, 0);
+        if (spill->records == MAP_FAILED)
+        {
+            spill->records = NULL;
+            close(spill->fd);
+            spill->fd = -1;
+        }
+    }
+
+    return spill->fd < 0 ? -1 : 0;
+}
+
+/*
+ * Appends an item to the spill file. Items must be appended in increasing sequence order. There may be
+ * gaps between them, for items that every reader had read before they left the buffer.
+ *
+ * Returns false if spilling is disabled or the item could not be stored; the caller must then keep the
+ * item in the buffer.
+ */
+bool appendSpillRecord(Spill *spill, int sequence, int writerId, long long publishTime, int value)
+{
+    SpillRecord *record;
+    int capacity;
+
+    if (spill->fd < 0)
+    {
+        return false;
+    }
+
+    /* An empty spill file starts again from the item being spilled. */
+    if (spill->base == spill->end)
+    {
+        spill->base = spill->end = spill->reclaimed = sequence;
+    }
+
+    while (sequence - spill->base >= spill->capacity)
+    {
+        /* Reserve the blocks a segment at a time, rather than faulting them in one page at a time. */
+        capacity = spill->capacity + SPILL_SEGMENT_RECORDS;
+        if (capacity > SPILL_MAX_RECORDS ||
+            posix_fallocate(spill->fd, 0, (long long)capacity * sizeof(SpillRecord)))
+        {
+            return false;
+        }
+        spill->capacity = capacity;
+    }
+
+    record = &spill->records[sequence - spill->base];
+    record->publishTime = publishTime;
+    record->writerId = writerId;
+    record->value = value;
+    spill->end = sequence + 1;
+
+    return true;
+}
+
+/*
+ * Returns true if the item with the given sequence number is held in the spill file.
+ */
+bool spillHolds(Spill *spill, int sequence)
+{
+    return sequence >= spill->base && sequence < spill->end;
+}
+
+/*
+ * Returns the record of an item held in the spill file.
+ */
+SpillRecord *readSpillRecord(Spill *spill, int sequence)
+{
+    return &spill->records[sequence - spill->base];
+}
+
+/*
+ * Releases the space of every whole segment that precedes oldestUnread, the oldest item that some reader
+ * has not yet read. Once every reader has read everything spilled, the file is truncated to nothing.
+ */
+void reclaimSpill(Spill *spill, int oldestUnread)
+{
+    int reclaimTo;
+
+    if (spill->fd < 0 || spill->base == spill->end)
+    {
+        return;
+    }
+
+    if (oldestUnread >= spill->end)
+    {
+        ftruncate(spill->fd, 0);
+        spill->base = spill->end = spill->reclaimed = oldestUnread;
+        spill->capacity = 0;
+        return;
+    }
+
+    reclaimTo = spill->base + (oldestUnread - spill->base) / SPILL_SEGMENT_RECORDS * SPILL_SEGMENT_RECORDS;
+    if (reclaimTo > spill->reclaimed)
+    {
+        fallocate(spill->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+            (long long)(spill->reclaimed - spill->base) * sizeof(SpillRecord),
+            (long long)(reclaimTo - spill->reclaimed) * sizeof(SpillRecord));
+        spill->reclaimed = reclaimTo;
+    }
+}
+
+/*
+ * Unmaps and removes the spill file.
+ */
+void closeSpill(Spill *spill, char *path)
+{
+    if (spill->fd < 0)
+    {
+        return;
+    }
+
+    munmap(spill->records, (long long)SPILL_MAX_RECORDS * sizeof(SpillRecord));
+    close(spill->fd);
+    unlink(path);
+}
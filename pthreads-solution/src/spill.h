@@ -0,0 +1,65 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+/* For bool etc. */
+#include <stdbool.h>
+
+/* The number of records the spill file grows by whenever it fills, and the number of records released
+ * together once every reader has read them. */
+#define SPILL_SEGMENT_RECORDS (65536)
+
+/* The most records the spill file can hold. The whole range is mapped once, up front, so the mapping
+ * never moves while readers use it; only the part of the file that has been allocated is touched. */
+#define SPILL_MAX_RECORDS (1 << 26)
+
+/*
+ * An item moved out of the buffer to the spill file. The item's sequence number is given by its position
+ * in the file.
+ */
+typedef struct SpillRecord
+{
+    /* The time the item was published, from readClockNs(). */
+    long long publishTime;
+
+    /* The identifier of the writer that published the item. */
+    int writerId;
+
+    /* The item itself. */
+    int value;
+} SpillRecord;
+
+/*
+ * Overflow for items that a writer needed the slot of before every reader had read them.
+ *
+ * Every item from base up to end has left the buffer. Those that some reader had not yet read are held
+ * here; readers that have fallen behind the buffer read them from here, in order, then rejoin the
+ * buffer. Bound to rpMutex.
+ */
+typedef struct Spill
+{
+    /* The spill file, or -1 if spilling is disabled. */
+    int fd;
+
+    /* The mapped spill file, with room for SPILL_MAX_RECORDS records. Record 0 holds item base. */
+    SpillRecord *records;
+
+    /* The sequence numbers of the first item in the file, and one past the last. Equal when the file
+     * holds nothing. */
+    int base;
+    int end;
+
+    /* Items before this sequence number have been read by every reader, and their space released. */
+    int reclaimed;
+
+    /* The number of records the file has space allocated for. */
+    int capacity;
+} Spill;
+
+int openSpill(Spill *spill, char *path);
+bool appendSpillRecord(Spill *spill, int sequence, int writerId, long long publishTime, int value);
+bool spillHolds(Spill *spill, int sequence);
+SpillRecord *readSpillRecord(Spill *spill, int sequence);
+void reclaimSpill(Spill *spill, int oldestUnread);
+void closeSpill(Spill *spill, char *path);
+
+#endif /* ifndef SPILL_H */
@@ -0,0 +1,90 @@
+#ifndef STATS_H
+#define STATS_H
+
+/* For FILE. */
+#include <stdio.h>
+
+/* The number of seconds between samples printed by the monitor. */
+#define STATS_INTERVAL (1)
+
+/* Stores to and loads from a statistics field. Each field is only stored to by the worker that owns it,
+ * so a relaxed store is enough; the monitor may see a slightly stale value, never a torn one. */
+#define STATS_STORE(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+#define STATS_LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+/*
+ * Live counters for a single reader or writer. Padded to a cache line, so that workers updating their
+ * own counters never contend with each other.
+ */
+typedef struct WorkerStats
+{
+    /* The number of items read or written. */
+    long long items;
+
+    /* The number of times the worker had to wait for a slot, and the total time spent waiting. */
+    long long waits;
+    long long waitNs;
+
+    /* The number of times the worker was woken while waiting. */
+    long long wakeups;
+
+    /* For readers, the sequence number of the next item to read. For writers, the number of items
+     * published by all writers when this worker last published. */
+    long long cursor;
+
+    /* For readers, how many published items had not yet been read when this reader last read. */
+    long long lag;
+
+    /* For readers, the number of items skipped after falling behind. For writers, the number of lagging
+     * readers released. */
+    long long lost;
+    long long evictions;
+} WorkerStats;
+
+/*
+ * The statistics of every worker in a run. Readers come first, indexed by reader identifier, followed
+ * by writers, indexed by writer identifier.
+ */
+typedef struct StatsRegion
+{
+    /* The number of readers and writers. */
+    int readerCount;
+    int writerCount;
+
+    /* The number of slots in the buffer. Writers update it as an elastic buffer grows and shrinks. */
+    int capacity;
+
+    /* Set once every worker has finished. */
+    int finished;
+
+    /* Keeps the worker counters on cache lines of their own. */
+    char padding[48];
+
+    WorkerStats workers[];
+} StatsRegion;
+
+/*
+ * Counters summed over every reader or every writer, as seen by the monitor at one sample.
+ */
+typedef struct StatsTotals
+{
+    /* The number of items published by all writers, and read by all readers. */
+    long long published;
+    long long read;
+
+    /* The number of waits by all readers, and by all writers. */
+    long long readerWaits;
+    long long writerWaits;
+
+    /* The number of lagging readers released by all writers. */
+    long long evictions;
+} StatsTotals;
+
+long long statsRegionSize(int readerCount, int writerCount);
+void initializeStatsRegion(StatsRegion *stats, int readerCount, int writerCount, int capacity);
+WorkerStats *readerStats(StatsRegion *stats, int readerId);
+WorkerStats *writerStats(StatsRegion *stats, int writerId);
+void printStatsSample(FILE *fPtr, StatsRegion *stats, StatsTotals *previous, char *channelName);
+void monitorStats(FILE *fPtr, StatsRegion *stats, char *channelName);
+
+#endif /* ifndef STATS_H */
@@ -1,130 +1,592 @@
+#include <string.h>
+
 #include "writer.h"
 
 /*
- * Reads a single data item from the file.
+ * Releases every reader that is holding up the slot at rwConfig->idxWrite and has fallen further behind
+ * than the lag limits allow. The slot holds the oldest item in the buffer, so a reader holds it up if it
+ * has not yet read that item. A released reader no longer holds any slot: it is either detached, or made
+ * to catch up to the next item published.
+ *
+ * Must be called with rwConfig->writeMutex and rwConfig->rpMutex held.
+ *
+ * Returns the number of readers released.
  */
-static int readNextDataItem(RWConfig *rwConfig)
+static int releaseLaggingReaders(RWConfig *rwConfig)
 {
-    int val = -1;
+    ProgramConfig *pConfig = rwConfig->pConfig;
+    ReaderState *state;
+    int i, slot, released = 0, oldest = rwConfig->sequence[rwConfig->idxWrite];
+    long long age = readClockNs() - rwConfig->publishTimes[rwConfig->idxWrite];
+
+    for (i = 0; i < pConfig->readerCount; i++)
+    {
+        state = &rwConfig->readerStates[i];
+        if (state->detached || state->cursor > oldest ||
+            !((pConfig->maxLagItems && rwConfig->writes - state->cursor >= pConfig->maxLagItems) ||
+            (pConfig->maxLagNs && age >= pConfig->maxLagNs)))
+        {
+            continue;
+        }
+
+        /* Give up the reader's claim on every item it has not yet read. */
+        for (slot = 0; slot < rwConfig->ring.slots; slot++)
+        {
+            if (rwConfig->sequence[slot] >= state->cursor)
+            {
+                rwConfig->pendingReads[slot]--;
+            }
+        }
 
-    fscanf(rwConfig->fPtrSharedData, "%d", &val);
+        if (pConfig->lagPolicy == LAG_POLICY_DETACH)
+        {
+            state->detached = true;
+            rwConfig->consumers--;
+        }
+        else
+        {
+            state->cursor = rwConfig->writes;
+        }
+        released++;
+    }
 
-    return val;
+    return released;
 }
 
 /*
- * Writes to a shared memory buffer the values read from a file.
+ * Moves the item in the slot at rwConfig->idxWrite to the spill file, so that the slot can be written
+ * without waiting for the readers that have not yet read it. They will read it from the spill file.
+ *
+ * Must be called with rwConfig->writeMutex and rwConfig->rpMutex held.
+ *
+ * Returns false if spilling is disabled or the spill file is full.
  */
-void *writer(void *vpConfig)
+static bool spillOldestItem(RWConfig *rwConfig)
 {
-    RWConfig *rwConfig = (RWConfig *)vpConfig;
-    int value, *data = rwConfig->data, selfWrites = 0;
-    bool done = false;
+    int idx = rwConfig->idxWrite;
 
-    while (!done)
+    if (!appendSpillRecord(&rwConfig->spill, rwConfig->sequence[idx], rwConfig->writerIds[idx],
+        rwConfig->publishTimes[idx], rwConfig->data[idx]))
     {
-        /*
-         * This loop is required in order to repeatedly acquire a mutex lock. Without it, synchronisation
-         * issues may occur and writers may overwrite to the buffer.
-         *
-         * We cannot simply write
-         *     while (rwConfig->writes < NUM_ELEMENTS_DATA_FILE) ...
-         * because:
-         * 1. We need to acquire a mutex lock in order to prevent synchronisation issues of rwConfig->writes.
-         * 2. Each writer must be able to cooperate, i.e. a writer may release the mutex lock after each
-         *    write, not only after it is completely exhausted the total write count.
-         */
+        return false;
+    }
+
+    rwConfig->pendingReads[idx] = 0;
+    rwConfig->sequence[idx] = SEQUENCE_SPILLED;
+
+    return true;
+}
+
+/*
+ * Grows an elastic buffer that writers keep finding full, or shrinks one that readers keep up with, before
+ * the next item is published. The new generation begins with that item, in the bank the previous
+ * generation used; readers finish the current generation first, then follow the writers into the new one.
+ *
+ * Must be called with rwConfig->writeMutex and rwConfig->rpMutex held.
+ */
+static void resizeRing(RWConfig *rwConfig)
+{
+    int oldest;
+
+    if (!ringIsElastic(&rwConfig->ring))
+    {
+        return;
+    }
+
+    oldest = oldestUnread(rwConfig);
+    if (adjustRing(&rwConfig->ring, rwConfig->writes, rwConfig->pendingReads[rwConfig->idxWrite] != 0,
+        rwConfig->writes - oldest, oldest >= rwConfig->ring.current.start))
+    {
+        rwConfig->idxWrite = rwConfig->ring.current.base;
+        STATS_STORE(rwConfig->stats->capacity, rwConfig->ring.current.capacity);
+        printf("Resized the buffer to %d slots from item #%d.\n", rwConfig->ring.current.capacity,
+            rwConfig->writes);
+    }
+}
+
+/*
+ * Waits while the autoscaler has parked writer id, until it is unparked or the stream ends. A parked writer
+ * holds no item and no slot, so the writers still running publish the stream in order without it.
+ *
+ * A writer hosted by an executor passes its task, and rather than wait, suspends it: the task is added to
+ * rwConfig->parkedWriters, for the autoscaler to schedule again when it unparks writers, or the writer that
+ * ends the stream.
+ *
+ * Returns true if the task was suspended.
+ */
+static bool parkWriter(RWConfig *rwConfig, int id, Task *task)
+{
+    pthread_mutex_lock(&rwConfig->parkMutex);
+    while (id >= rwConfig->activeWriters && !rwConfig->eof)
+    {
+        if (task != NULL)
+        {
+            task->next = rwConfig->parkedWriters;
+            rwConfig->parkedWriters = task;
+            pthread_mutex_unlock(&rwConfig->parkMutex);
+            return true;
+        }
+        pthread_cond_wait(&rwConfig->parkCond, &rwConfig->parkMutex);
+    }
+    pthread_mutex_unlock(&rwConfig->parkMutex);
+
+    return false;
+}
+
+/*
+ * Writer task timeout. Resumes a writer task whose slot still held an item when the item reached the time
+ * limit on lag, unless a reader has already resumed it, so that it checks for readers to release.
+ */
+static void expireWriterWait(Task *task)
+{
+    RWConfig *rwConfig = ((WriterTask *)task->context)->rwConfig;
+    Task **link;
+    bool waiting;
+
+    pthread_mutex_lock(&rwConfig->rpMutex);
+    for (link = &rwConfig->waitingWriters; *link != NULL && *link != task; link = &(*link)->next)
+    {
+    }
+    waiting = *link != NULL;
+    if (waiting)
+    {
+        *link = task->next;
+    }
+    pthread_mutex_unlock(&rwConfig->rpMutex);
+
+    if (waiting)
+    {
+        scheduleTask(task);
+    }
+}
+
+/*
+ * Writes the next item of the input source to a shared memory buffer through a writer's cursor, or waits
+ * if the slot it is to go in holds an item not every reader has read yet. Once the source is exhausted,
+ * ends the stream.
+ *
+ * A writer hosted by an executor passes its task, and rather than wait, suspends it, keeping the item it
+ * read in its cursor: the task is added to rwConfig->waitingWriters, for the next reader to free a slot to
+ * schedule again, and holds the writers' turn, rwConfig->writerTurn, until it publishes the item. Any other
+ * writer task that finds the turn held suspends on the same list until then. With a time limit on lag, the
+ * task also sets a timer for when the item in the slot reaches it, to check again.
+ *
+ * Returns WRITE_MORE once the writer has published an item, and should write again; WRITE_PENDING once the
+ * task has been suspended; or WRITE_DONE once the stream has ended.
+ */
+static int writeNextItem(RWConfig *rwConfig, WriteCursor *cursor, Task *task)
+{
+    int *data = rwConfig->data, released, stride = rwConfig->stride, id = cursor->id, i;
+    unsigned long long hash = 0;
+    bool done, hasValue, handedOn = false,
+        lagLimited = rwConfig->pConfig->maxLagItems || rwConfig->pConfig->maxLagNs;
+    WorkerStats *stats = cursor->stats;
+    struct timespec deadline;
+
+    if (!cursor->holding && parkWriter(rwConfig, id, task))
+    {
+        return WRITE_PENDING;
+    }
+
+    /*
+     * This is called repeatedly in order to repeatedly acquire a mutex lock. Without it, synchronisation
+     * issues may occur and writers may overwrite to the buffer.
+     *
+     * We cannot simply write
+     *     while (!rwConfig->eof) ...
+     * because:
+     * 1. We need to acquire a mutex lock in order to prevent synchronisation issues of rwConfig->writes.
+     * 2. Each writer must be able to cooperate, i.e. a writer may release the mutex lock after each
+     *    write, not only after it is completely exhausted the total write count.
+     */
+
+    /* Only allow one writer to read/write to the writer count simultaneously. */
+    pthread_mutex_lock(&rwConfig->writeMutex);
 
-        /* Only allow one writer to read/write to the writer count simultaneously. */
-        pthread_mutex_lock(&rwConfig->writeMutex);
+    /* While a writer task holds the next item, every other writer task waits for it to publish first. Only
+     * tasks take the turn, and writers run either all as tasks or all on threads of their own, so a writer
+     * on its own thread never finds it held. */
+    if (task != NULL && rwConfig->writerTurn != NULL && rwConfig->writerTurn != task)
+    {
+        pthread_mutex_lock(&rwConfig->rpMutex);
+        task->next = rwConfig->waitingWriters;
+        rwConfig->waitingWriters = task;
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+        pthread_mutex_unlock(&rwConfig->writeMutex);
+        return WRITE_PENDING;
+    }
+
+    /*
+     * Read the next value from the input source, unless we already hold it. This is synchronised by
+     * rwConfig->writeMutex. It is done before acquiring rwConfig->rwMutex so that readers are not held up
+     * while a slow producer fills the pipe or socket.
+     */
+    hasValue = cursor->holding || (!rwConfig->eof && readNextSourceItem(&rwConfig->source, &cursor->value));
+
+    /* An item of more than one field takes the values that follow for the rest of its fields. A source
+     * that ends part way through an item leaves the rest of them zero. */
+    for (i = 1; hasValue && !cursor->holding && i < rwConfig->pConfig->itemFields; i++)
+    {
+        if (!readNextSourceItem(&rwConfig->source, &cursor->fields[i]))
+        {
+            cursor->fields[i] = 0;
+        }
+    }
 
+    /*
+     * It's possible that the writer encounters a buffer that has not been fully read. In this case,
+     * we need to wait until a number of readers read from the buffer. We will respond to each
+     * signal, until we eventually find rwConfig->pendingReads[idx] to be 0.
+     *
+     * We are guaranteed to eventually reach this state as long as there exists a reader, because
+     * readers will only wait if they cannot read the buffer slot they are up to, but this condition
+     * only occurs if all buffer slots have been fully read; the conditions for waiting are mutually
+     * exclusive, so no deadlock can occur.
+     *
+     * In overwrite mode, never wait: the oldest item is overwritten, and readers that had not read it
+     * skip ahead.
+     *
+     * A writer that moves the item to the spill file does not wait either.
+     *
+     * An elastic buffer first grows if writers keep finding it full, or shrinks if it is mostly empty. A
+     * writer task resuming with the item it holds has already given it the chance.
+     */
+    pthread_mutex_lock(&rwConfig->rpMutex);
+    if (hasValue && !cursor->holding)
+    {
+        resizeRing(rwConfig);
+    }
+    while (hasValue && !rwConfig->pConfig->overwrite && rwConfig->pendingReads[rwConfig->idxWrite])
+    {
         /*
-         * It's possible that the writer encounters a buffer that has not been fully read. In this case,
-         * we need to wait until a number of readers read from the buffer. We will respond to each
-         * signal, until we eventually find rwConfig->pendingReads[idx] to be 0.
+         * We cannot write because a reader is waiting to read this. Wait until a reader reports that
+         * it has finished reading, and check again.
+         *
+         * On each wait, we need to release the mutex for the pending reads, because otherwise the
+         * readers will be stuck in a deadlock trying to acquire this mutex lock.
+         *
+         * With a spill file, move the item to it rather than wait; we only wait once it is full.
          *
-         * We are guaranteed to eventually reach this state as long as there exists a reader, because
-         * readers will only wait if they cannot read the buffer slot they are up to, but this condition
-         * only occurs if all buffer slots have been fully read; the conditions for waiting are mutually
-         * exclusive, so no deadlock can occur.
+         * If the readers holding us up have fallen too far behind, stop waiting for them instead. With
+         * a time limit, wake when the item in the slot reaches it, to check again.
          */
-        pthread_mutex_lock(&rwConfig->rpMutex);
-        while (rwConfig->pendingReads[rwConfig->idxWrite])
-        {
-            /*
-             * We cannot write because a reader is waiting to read this. Wait until a reader reports that
-             * it has finished reading, and check again.
-             *
-             * On each wait, we need to release the mutex for the pending reads, because otherwise the
-             * readers will be stuck in a deadlock trying to acquire this mutex lock.
-             */
-            pthread_cond_wait(&rwConfig->fullCond, &rwConfig->rpMutex);
+        if (spillOldestItem(rwConfig))
+        {
+            continue;
         }
-        pthread_mutex_unlock(&rwConfig->rpMutex);
 
-        pthread_mutex_lock(&rwConfig->rwMutex);
+        if (lagLimited)
+        {
+            released = releaseLaggingReaders(rwConfig);
+            if (released)
+            {
+                STATS_STORE(stats->evictions, stats->evictions + released);
+                continue;
+            }
+        }
+
+        if (!cursor->waitStart)
+        {
+            cursor->waitStart = readClockNs();
+            STATS_STORE(stats->waits, stats->waits + 1);
+            SDS_PROBE(writer_wait_begin, rwConfig->writes, rwConfig->idxWrite, id);
+        }
 
-        if (rwConfig->writes < NUM_ELEMENTS_DATA_FILE)
-        {
-
-            /* Read value from file. */
-            value = readNextDataItem(rwConfig);
-
-            /*
-             * Place value in buffer. Since only one writer can be executing in its critical section
-             * simultaneously, rwConfig->idxWrite is guaranteed to be synchronised, as only writers
-             * access this value. Variables rwConfig->writes, selfWrites must also be updated; these are
-             * also synchronised for the same reason. 
-             */
-            data[rwConfig->idxWrite] = value;
-            rwConfig->writes++;
-            selfWrites++;
-            printf("Write #%d/%d (%d) to data buffer index %d\n", selfWrites, rwConfig->writes, value,
-                rwConfig->idxWrite);
-
-            /*
-             * Reset the pending reads to ensure readers can begin reading again. We still have the mutex
-             * lock rwConfig->rpMutex, so we can do this.
-             *
-             * On resetting, release the mutex lock. We don't need to change pendingReads again.
-             */
-            pthread_mutex_lock(&rwConfig->rpMutex);
-            rwConfig->pendingReads[rwConfig->idxWrite] = rwConfig->pConfig->readerCount;
+        /* A task must not hold up its executor's thread, which runs readers that may be the ones holding
+         * us up. We are added to the waiting writers before releasing the mutex, so that a reader that
+         * frees the slot after we checked is guaranteed to see us and resume us. */
+        if (task != NULL)
+        {
+            cursor->holding = true;
+            rwConfig->writerTurn = task;
+            if (rwConfig->pConfig->maxLagNs)
+            {
+                setTaskTimer(task, rwConfig->publishTimes[rwConfig->idxWrite] + rwConfig->pConfig->maxLagNs,
+                    &expireWriterWait);
+            }
+            task->next = rwConfig->waitingWriters;
+            rwConfig->waitingWriters = task;
             pthread_mutex_unlock(&rwConfig->rpMutex);
+            pthread_mutex_unlock(&rwConfig->writeMutex);
+            return WRITE_PENDING;
+        }
+        if (rwConfig->pConfig->maxLagNs)
+        {
+            readDeadline(&deadline, rwConfig->publishTimes[rwConfig->idxWrite] + rwConfig->pConfig->maxLagNs);
+            pthread_cond_timedwait(&rwConfig->fullCond, &rwConfig->rpMutex, &deadline);
+        }
+        else
+        {
+            pthread_cond_wait(&rwConfig->fullCond, &rwConfig->rpMutex);
+        }
+        STATS_STORE(stats->wakeups, stats->wakeups + 1);
+    }
+
+    /* A writer task that held the turn passes it on once its item has a slot. */
+    if (cursor->holding)
+    {
+        cursor->holding = false;
+        rwConfig->writerTurn = NULL;
+        handedOn = true;
+    }
+
+    /* In overwrite mode, the slot is marked as being written before it is overwritten, since readers
+     * copy items out without holding us off; see readNextItem(). */
+    if (hasValue && rwConfig->pConfig->overwrite)
+    {
+        rwConfig->sequence[rwConfig->idxWrite] = SEQUENCE_WRITING;
+    }
+    pthread_mutex_unlock(&rwConfig->rpMutex);
 
-            /*
-             * Writers must progress to the next buffer slot. This is bound to rwConfig->writeMutex, which
-             * ensures that only one writer will ever access rwConfig->idxWrite is accessed simultaneously.
-             */
-            rwConfig->idxWrite = (rwConfig->idxWrite + 1) % SHM_BUFFER_SIZE;
+    if (cursor->waitStart)
+    {
+        STATS_STORE(stats->waitNs, stats->waitNs + readClockNs() - cursor->waitStart);
+        SDS_PROBE(writer_wait_end, rwConfig->writes, rwConfig->idxWrite, id);
+        cursor->waitStart = 0;
+    }
+    if (hasValue)
+    {
+        SDS_PROBE(slot_claim, rwConfig->writes, rwConfig->idxWrite, id);
+    }
 
+    /* In overwrite mode, writers never wait for readers, so they do not take rwMutex either. */
+    if (!rwConfig->pConfig->overwrite)
+    {
+        pthread_mutex_lock(&rwConfig->rwMutex);
+    }
+
+    if (hasValue)
+    {
+        /*
+         * Place value in buffer. Since only one writer can be executing in its critical section
+         * simultaneously, rwConfig->idxWrite is guaranteed to be synchronised, as only writers
+         * access this value. Variables rwConfig->writes, cursor->writes must also be updated; these are
+         * also synchronised for the same reason. 
+         */
+        if (stride == 1)
+        {
+            data[rwConfig->idxWrite] = cursor->value;
+        }
+        else
+        {
+            cursor->fields[0] = cursor->value;
+            memcpy(&data[rwConfig->idxWrite * stride], cursor->fields, stride * sizeof(int));
+        }
+        rwConfig->writerIds[rwConfig->idxWrite] = id;
+        rwConfig->publishTimes[rwConfig->idxWrite] = readClockNs();
+        rwConfig->writes++;
+        cursor->writes++;
+        STATS_STORE(stats->items, cursor->writes);
+        STATS_STORE(stats->cursor, rwConfig->writes);
+        if (rwConfig->pConfig->trace)
+        {
+            printf("Write #%d/%d (%d) to data buffer index %d\n", cursor->writes, rwConfig->writes,
+                cursor->value, rwConfig->idxWrite);
         }
-        pthread_mutex_unlock(&rwConfig->rwMutex);
 
-        /* If we've reached the end, signal that we are done. */
-        done = !(rwConfig->writes < NUM_ELEMENTS_DATA_FILE);
-        pthread_mutex_unlock(&rwConfig->writeMutex);
+        /* With --verify, the item is hashed with its sequence number before taking rpMutex, so that
+         * only the sum is added while holding it. */
+        if (cursor->kernel != NULL)
+        {
+            hash = hashItem(cursor->kernel, rwConfig->writes - 1, stride == 1 ? &cursor->value : cursor->fields,
+                rwConfig->pConfig->itemFields * sizeof(int));
+        }
+
+        /*
+         * Reset the pending reads to ensure readers can begin reading again. We still have the mutex
+         * lock rwConfig->rpMutex, so we can do this.
+         *
+         * On resetting, release the mutex lock. We don't need to change pendingReads again.
+         *
+         * Filtering readers skip whole blocks by their summaries, so the item is added to its block's
+         * summary as it is published. Likewise, verifying readers check their checksums against the
+         * writers', so the item is added to those of its range and of the whole stream.
+         */
+        pthread_mutex_lock(&rwConfig->rpMutex);
+        rwConfig->pendingReads[rwConfig->idxWrite] = rwConfig->consumers;
+        rwConfig->sequence[rwConfig->idxWrite] = rwConfig->writes - 1;
+        if (rwConfig->summaries != NULL)
+        {
+            summarizeItem(rwConfig->summaries, rwConfig->summaryCount, rwConfig->writes - 1, cursor->value,
+                hash);
+        }
+        if (rwConfig->checksums != NULL)
+        {
+            addItemChecksum(rwConfig->checksums, &rwConfig->published, rwConfig->writes - 1, hash);
+        }
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+        SDS_PROBE(publish, rwConfig->writes - 1, rwConfig->idxWrite, id);
 
         /*
-         * If any readers were waiting because their buffers were empty (fully read), then we need to
-         * wake them up.
+         * Writers must progress to the next buffer slot. This is bound to rwConfig->writeMutex, which
+         * ensures that only one writer will ever access rwConfig->idxWrite is accessed simultaneously.
          */
-        pthread_cond_signal(&rwConfig->emptyCond);
+        rwConfig->idxWrite = ringSlot(&rwConfig->ring, rwConfig->writes);
+    }
+    else if (!rwConfig->eof)
+    {
+        /*
+         * The input source is exhausted. Propagate end-of-stream to the readers: rwConfig->writes is
+         * now the total number of items, and readers stop once they have read that many.
+         */
+        pthread_mutex_lock(&rwConfig->rpMutex);
+        rwConfig->eof = true;
+        pthread_mutex_unlock(&rwConfig->rpMutex);
+
+        /* Parked writers and members have nothing left to wait for. */
+        pthread_mutex_lock(&rwConfig->parkMutex);
+        pthread_cond_broadcast(&rwConfig->parkCond);
+        resumeParkedWriters(rwConfig);
+        pthread_mutex_unlock(&rwConfig->parkMutex);
+    }
+    if (!rwConfig->pConfig->overwrite)
+    {
+        pthread_mutex_unlock(&rwConfig->rwMutex);
+    }
+
+    /* If we've reached the end, signal that we are done. */
+    done = rwConfig->eof;
+    pthread_mutex_unlock(&rwConfig->writeMutex);
+
+    /*
+     * If any readers were waiting because their buffers were empty (fully read), then we need to
+     * wake them up. Every reader may be waiting on the same slot, so wake them all, and resume every
+     * reader task suspended on it. Writer tasks that waited for our turn to pass may now take theirs.
+     */
+    pthread_cond_broadcast(&rwConfig->emptyCond);
+    resumeWaitingTasks(rwConfig);
+    if (handedOn)
+    {
+        resumeWaitingWriters(rwConfig);
+    }
 
-        /* Per specification: sleep after writing and updating the counter. */
+    /* Per specification: sleep after writing and updating the counter. Even a sleep of no time costs a
+     * system call and the timer's slack, which a task pays for every writer on its executor's thread. */
+    if (rwConfig->pConfig->writerSleepTime)
+    {
         sleep(rwConfig->pConfig->writerSleepTime);
     }
 
+    return done ? WRITE_DONE : WRITE_MORE;
+}
+
+/*
+ * Readies a writer's cursor to write a stream as writer id.
+ */
+static void openWriter(RWConfig *rwConfig, int id, WriteCursor *cursor)
+{
+    cursor->id = id;
+    cursor->stats = writerStats(rwConfig->stats, id);
+    cursor->kernel = rwConfig->checksums != NULL ? selectChecksumKernel() : NULL;
+    cursor->writes = 0;
+    cursor->holding = false;
+    memset(cursor->fields, 0, sizeof(cursor->fields));
+    cursor->waitStart = 0;
+}
+
+/*
+ * Records that a writer has finished, once the stream has ended.
+ */
+static void finishWriter(RWConfig *rwConfig, WriteCursor *cursor)
+{
+    SDS_PROBE(writer_exit, cursor->writes, -1, cursor->id);
+
     /*
      * Write the number of writes to file.
      *
-     * Per discussion with Soh: For multithreading solution, use thread ID instead of process ID.
+     * Per discussion with Soh: For multithreading solution, use thread ID instead of process ID. A writer
+     * task is reported by its executor's thread.
      */
-    simWriteFinish(rwConfig->fPtrSimOut, "writer", "writing", "to", pthread_self(), selfWrites);
+    simWriteFinish(rwConfig->fPtrSimOut, "writer", "writing", "to", pthread_self(), cursor->writes);
+}
+
+/*
+ * Writes to a shared memory buffer, as writer id, the values read from the input source until it is
+ * exhausted. Published items are stamped with id.
+ *
+ * Returns the number of items this writer published.
+ */
+int runWriter(RWConfig *rwConfig, int id)
+{
+    WriteCursor cursor;
+
+    openWriter(rwConfig, id, &cursor);
+    while (writeNextItem(rwConfig, &cursor, NULL) != WRITE_DONE)
+    {
+    }
+    finishWriter(rwConfig, &cursor);
+
+    return cursor.writes;
+}
+
+/*
+ * Writer task step.
+ *
+ * Publishes up to TASK_STEP_ITEMS items, then yields to the executor's other tasks. Suspends the task while
+ * the slot for the next item is full, its turn is held, or it is parked, rather than wait.
+ */
+static int stepWriterTask(Task *task)
+{
+    WriterTask *writerTask = (WriterTask *)task->context;
+    WriteCursor *cursor = &writerTask->cursor;
+    int status = WRITE_MORE, i;
+
+    /* Being resumed is a wakeup, as for a thread. */
+    if (writerTask->suspended)
+    {
+        STATS_STORE(cursor->stats->wakeups, cursor->stats->wakeups + 1);
+        writerTask->suspended = false;
+    }
+
+    for (i = 0; i < TASK_STEP_ITEMS && status == WRITE_MORE; i++)
+    {
+        status = writeNextItem(writerTask->rwConfig, cursor, task);
+    }
+
+    if (status == WRITE_PENDING)
+    {
+        writerTask->suspended = true;
+        return TASK_PENDING;
+    }
+    if (status == WRITE_MORE)
+    {
+        return TASK_YIELD;
+    }
+
+    finishWriter(writerTask->rwConfig, cursor);
+
+    return TASK_DONE;
+}
+
+/*
+ * Readies writer id to run as a task of executor, rather than on a thread of its own, and gives it to the
+ * executor.
+ */
+void addWriterTask(RWConfig *rwConfig, int id, WriterTask *writerTask, Executor *executor)
+{
+    writerTask->rwConfig = rwConfig;
+    writerTask->suspended = false;
+    openWriter(rwConfig, id, &writerTask->cursor);
+    addTask(executor, &writerTask->task, &stepWriterTask, writerTask);
+}
+
+/*
+ * Writer thread callback.
+ *
+ * Takes the next writer identifier, then writes to a shared memory buffer the values read from a file.
+ */
+void *writer(void *vpConfig)
+{
+    RWConfig *rwConfig = (RWConfig *)vpConfig;
+    int id;
+
+    pthread_mutex_lock(&rwConfig->writeMutex);
+    id = rwConfig->nextWriterId++;
+    pthread_mutex_unlock(&rwConfig->writeMutex);
 
     /*
      * While we could call pthread_exit(0), it is equivalent to return. Pthreads will still clean up
      * the resources.
      */
-    return ret(selfWrites);
+    return ret(runWriter(rwConfig, id));
 }
@@ -3,7 +3,60 @@
 
 #include "shared.h"
 
+/* What writing the next item tells a writer: it has published an item, and should write again; its task
+ * has been suspended until a reader frees a slot, it is unparked, or it has its turn; or the stream has
+ * ended. */
+#define WRITE_MORE (0)
+#define WRITE_PENDING (1)
+#define WRITE_DONE (2)
+
+/*
+ * A writer's progress through the stream. It is kept between items, so that a writer hosted by an
+ * executor can suspend while it waits for a slot, and pick up where it left off.
+ */
+typedef struct WriteCursor
+{
+    /* The identifier published items are stamped with. */
+    int id;
+
+    WorkerStats *stats;
+
+    /* The kernel items are hashed with for --verify, or NULL. */
+    const ChecksumKernel *kernel;
+
+    /* The number of items this writer has published. */
+    int writes;
+
+    /* Whether the writer holds the next item of the stream, read from the source but not yet published,
+     * and the item's fields. */
+    bool holding;
+    int value;
+    _Alignas(ITEM_ALIGNMENT) int fields[MAX_ITEM_FIELDS];
+
+    /* When the writer began waiting for the slot of the item it holds, or 0 if it is not waiting. */
+    long long waitStart;
+} WriteCursor;
+
+/*
+ * A writer run as a task by an executor, rather than on a thread of its own.
+ */
+typedef struct WriterTask
+{
+    Task task;
+    RWConfig *rwConfig;
+    WriteCursor cursor;
+
+    /* Whether the task is suspended waiting for a slot, its turn, or to be unparked. */
+    bool suspended;
+} WriterTask;
+
 /* Writer function. */
 void *writer(void *);
 
+/* Writes a stream as the given writer. */
+int runWriter(RWConfig *, int);
+
+/* Readies a writer to write a stream as a task of an executor. */
+void addWriterTask(RWConfig *rwConfig, int id, WriterTask *writerTask, Executor *executor);
+
 #endif /* ifndef WRITER_H */